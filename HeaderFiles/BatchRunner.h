@@ -0,0 +1,82 @@
+#pragma once
+#include "ImageIntegrationProcess.h"
+#include "StageTimer.h"
+
+//runs integration, stacking and drizzle jobs from a job file without the gui or an event loop
+//progress, per stage timings and peak memory are written to a text stream
+//
+//a job file holds one or more jobs, each starting with its name in brackets
+//
+//	[m31]
+//	process = integration
+//	light = lights/m31			#a file, or a directory meaning every image file in it
+//	dark = masters/dark.fits
+//	rejection = winsorized_sigma_clip
+//	output = out/m31.fits
+//
+//relative paths are taken from the job file's directory, # starts a comment
+class BatchRunner {
+public:
+	enum class Process : uint8_t {
+		integration,	//calibrate, register and stack lights
+		stacking,		//stack frames that are already registered
+		drizzle			//drizzle lights with alignment data written by an earlier integration
+	};
+
+	struct Job {
+		std::string name;
+		Process process = Process::integration;
+
+		PathVector lights;
+		PathVector alignments;
+		PathVector weight_maps;
+
+		std::filesystem::path dark;
+		std::filesystem::path flat;
+		std::filesystem::path output;
+
+		ImageStacking::Integration integration = ImageStacking::Integration::average;
+		ImageStacking::Normalization normalization = ImageStacking::Normalization::none;
+		ImageStacking::Rejection rejection = ImageStacking::Rejection::none;
+		float sigma_low = 4.0f;
+		float sigma_high = 3.0f;
+
+		uint16_t max_stars = 200;
+		bool generate_weight_maps = false;
+
+		float drop_size = 0.9f;
+		uint8_t scale_factor = 2;
+
+		//0 uses every core
+		uint32_t threads = 0;
+	};
+
+private:
+	std::ostream* m_log = &std::cout;
+
+public:
+	BatchRunner() = default;
+
+	BatchRunner(std::ostream& log) : m_log(&log) {}
+
+	static Status parseJobFile(const std::filesystem::path& job_file, std::vector<Job>& jobs);
+
+	//every job is run even if an earlier one fails, returns the number that failed
+	int run(const std::vector<Job>& jobs);
+
+	Status runJob(const Job& job);
+
+	//entry point for the command line, returns the process exit code
+	int runFile(const std::filesystem::path& job_file);
+
+private:
+	Status integrate(const Job& job, Image32& output, StageTimer& timer);
+
+	Status stack(const Job& job, Image32& output, StageTimer& timer);
+
+	Status drizzle(const Job& job, Image32& output, StageTimer& timer);
+
+	void connectSignals(const Job& job, const ImageStackingSignal* iss);
+
+	void writeReport(const Job& job, const StageTimer& timer, double seconds);
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include "StarField.h"
+
+//times the core kernels and the stacking pipeline on synthetic star fields
+//every case is run once to warm up and then timed over several iterations
+//results go out one json object per line so runs from different releases can be compared
+class Benchmark {
+public:
+	struct Options {
+		uint32_t size = 2048;
+		uint32_t stacking_size = 1024;
+		std::vector<uint32_t> frame_counts = { 4, 8, 16 };
+		uint32_t iterations = 5;
+		uint32_t stacking_iterations = 2;
+	};
+
+private:
+	struct Result {
+		std::string name;
+		//rendered json values
+		std::vector<std::pair<std::string, std::string>> fields;
+		std::vector<double> ms;
+
+		Result(const std::string& name) : name(name) {}
+
+		Result& add(const std::string& key, const std::string& value);
+
+		Result& add(const std::string& key, double value);
+	};
+
+	Options m_options;
+	std::ostream* m_out = &std::cout;
+
+public:
+	Benchmark() : Benchmark(Options()) {}
+
+	Benchmark(const Options& options) : m_options(options) {}
+
+	//returns the process exit code
+	int run(std::ostream& out);
+
+	int runToFile(const std::filesystem::path& path);
+
+private:
+	template<typename Setup, typename Func>
+	void measure(Result& result, uint32_t iterations, Setup&& setup, Func&& func);
+
+	void write(const Result& result);
+
+	void registration(const StarField& field);
+
+	void interpolation(const StarField& field);
+
+	void filters(const StarField& field);
+
+	void fileIO(const StarField& field);
+
+	void stacking();
+};
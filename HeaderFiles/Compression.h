@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+//block codecs shared by the image file formats
+class Compression {
+public:
+	enum class Codec : uint8_t {
+		none,
+		zlib,
+		lz4,
+		lz4hc,
+		gzip
+	};
+
+	Compression() = delete;
+
+	static std::vector<uint8_t> compress(Codec codec, const uint8_t* src, size_t size);
+
+	//false if the stream is malformed or does not decode to exactly dst_size bytes
+	static bool decompress(Codec codec, const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size);
+
+	//groups byte k of every item together, trailing bytes are copied as is
+	static void shuffle(const uint8_t* src, uint8_t* dst, size_t size, size_t item_size);
+
+	static void unshuffle(const uint8_t* src, uint8_t* dst, size_t size, size_t item_size);
+
+	//fits rice coding of 8, 16 or 32 bit integers, differences wrap at the type width
+	template<typename T>
+	static std::vector<uint8_t> riceCompress(const T* src, size_t count, int block_size = 32);
+
+	template<typename T>
+	static bool riceDecompress(const uint8_t* src, size_t size, T* dst, size_t count, int block_size = 32);
+
+	static uint32_t crc32(const uint8_t* src, size_t size);
+
+	//tiff flavour of lzw, msb first codes that widen one code early
+	static std::vector<uint8_t> lzwCompress(const uint8_t* src, size_t size);
+
+	//stops at end of information or when dst is full, false if the stream is malformed or short
+	static bool lzwDecompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size);
+
+private:
+	//max_attempts is the hash chain search depth, 1 is plain greedy lz4
+	static std::vector<uint8_t> lz4Compress(const uint8_t* src, size_t size, int max_attempts);
+
+	static bool lz4Decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size);
+
+	static std::vector<uint8_t> gzipCompress(const uint8_t* src, size_t size);
+
+	static bool gzipDecompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size);
+
+	//raw deflate stream
+	static bool inflate(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size);
+};
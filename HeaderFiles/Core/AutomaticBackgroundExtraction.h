@@ -65,10 +65,12 @@ private:
     int m_poly_degree = 4;
     int m_poly_length = computePolynomialLength(m_poly_degree);
 
+    int m_downsample = 1; //model is fit on a binned image when > 1
+
 
     Correction m_correction = Correction::subtraction;
 
-    static std::vector<double> polynomial(int x, uint32_t degrees = 4);
+    static std::vector<double> polynomial(double x, uint32_t degrees = 4);
 
     static uint32_t computePolynomialLength(uint32_t degrees = 4);
 
@@ -117,15 +119,26 @@ public:
 
     void setCorrectionMethod(Correction method) { m_correction = method; }
 
+    int downsampleFactor()const { return m_downsample; }
+
+    void setDownsampleFactor(int factor) { m_downsample = math::max(factor, 1); }
+
 private:
     int polynomialLength()const { return m_poly_length; }
 
+    //maps pixel coordinates to [-1,1] so the fit is independent of image size
+    static double normalize(double x, uint32_t size) { return (size > 1) ? (2 * x) / (size - 1) - 1 : 0.0; }
+
     template<typename T>
-    float sampleMedian(const Image<T>& img, const ImagePoint& p)const;
+    float sampleMedian(const Image<T>& img, const ImagePoint& p, int radius, std::vector<T>& sample)const;
+
+    void insertMatrixRow(Matrix& matrix, int row, const PointD& p)const;
 
-    void insertMatrixRow(Matrix& matrix, int row, const Point& p)const;
+    //scale maps img coordinates onto the full resolution image of rows x cols
+    template<typename T>
+    Matrix fitModel(const Image<T>& img, uint32_t ch, int scale, uint32_t rows, uint32_t cols)const;
 
-    double computePolynomial(const Matrix& coefficients, const Point& p)const;
+    void evaluateModel(const Matrix& coefficients, Image32& background, uint32_t ch)const;
 
     template<typename T>
     void drawSamples(Image<T>& img)const;
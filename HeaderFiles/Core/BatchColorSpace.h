@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+
+//batched float counterpart of ColorSpace, transfer functions are table driven
+class BatchColorSpace {
+public:
+	BatchColorSpace() = delete;
+
+	//serial, in place on planar float rows
+	static void RGBtoCIELabRow(float* R_L, float* G_a, float* B_b, size_t count);
+
+	static void CIELabtoRGBRow(float* L_R, float* a_G, float* b_B, size_t count);
+
+	static void RGBtoCIELRow(const float* R, const float* G, const float* B, float* L, size_t count);
+
+	//hue is in radians
+	static void RGBtoCIELchRow(float* R_L, float* G_c, float* B_h, size_t count);
+
+	static void CIELchtoRGBRow(float* L_R, float* c_G, float* h_B, size_t count);
+
+	//parallel over whole planes, src and dst may alias
+	template<typename T>
+	static void RGBtoCIELab(const T* R, const T* G, const T* B, T* L, T* a, T* b, size_t count);
+
+	template<typename T>
+	static void CIELabtoRGB(const T* L, const T* a, const T* b, T* R, T* G, T* B, size_t count);
+
+	template<typename T>
+	static void RGBtoCIEL(const T* R, const T* G, const T* B, T* L, size_t count);
+
+	static void RGBtoCIELch(const float* R, const float* G, const float* B, float* L, float* c, float* h, size_t count);
+
+	static void CIELchtoRGB(const float* L, const float* c, const float* h, float* R, float* G, float* B, size_t count);
+};
@@ -3,13 +3,20 @@
 //#include "ProcessDialog.h"
 
 class BilateralFilter {
+public:
+	enum class Method : uint8_t {
+		brute_force,
+		fast
+	};
 
+private:
 	//ProgressSignal* m_ps = new ProgressSignal();
 
 	float m_sigma_s = 2.0; //spatial/gaussiam
 	float m_sigma_r = 0.5; //pixel_intensity
 	int m_kernel_dim = 3;
 	bool m_is_circular = false;
+	Method m_method = Method::brute_force;
 
 public:
 	//ProgressSignal* progressSignal() const { return m_ps; }
@@ -27,6 +34,39 @@ public:
 
 	void setKernelSize(int kernel_dim) { m_kernel_dim = math::max(kernel_dim, 1); }
 
+	Method method()const { return m_method; }
+
+	void setMethod(Method method) { m_method = method; }
+
+private:
+	//fast path is only used with square kernels, circular masks are not separable
+	//small kernels with a narrow range sigma are cheaper to compute directly
+	int rangeLevels()const { return ceil(std::numbers::sqrt2 / m_sigma_r) + 1; }
+
+	//the spatial gaussian is cut at 4 sigma when the kernel reaches further than that
+	int spatialRadius()const { return math::min((m_kernel_dim - 1) / 2, int(ceil(4 * m_sigma_s))); }
+
+	//kernels reaching past 4 sigma use a recursive gaussian, whose cost does not depend on the radius
+	bool useRecursiveGaussian()const { return m_sigma_s >= 0.5f && (m_kernel_dim - 1) / 2 >= 4 * m_sigma_s; }
+
+	//operations per pixel and range level of the two spatial passes
+	int fastPassCost()const { return 2 * ((useRecursiveGaussian()) ? 8 : 2 * spatialRadius() + 1); }
+
+	bool useFastPath()const {
+		return m_method == Method::fast && !m_is_circular && rangeLevels() * fastPassCost() < m_kernel_dim * m_kernel_dim;
+	}
+
+	//the fast path filters every source pixel of a preview region, brute force only the sampled ones
+	//so it only pays off when the region is not much larger than the preview
+	bool useFastPath(size_t region_px, size_t dst_px)const {
+		return useFastPath() && size_t(rangeLevels()) * fastPassCost() * region_px < size_t(m_kernel_dim) * m_kernel_dim * dst_px;
+	}
+
+	//piecewise-linear range approximation with separable spatial passes
+	template<typename T>
+	void fastFilter(const Image<T>& src, Image<T>& dst);
+
+public:
 	template<typename T>
 	void apply(Image<T>& img);
 
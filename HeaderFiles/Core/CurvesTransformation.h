@@ -3,6 +3,7 @@
 #include "CurveInterpolation.h"
 #include "Maths.h"
 #include "RGBColorSpace.h"
+#include "PointOperation.h"
 
 
 
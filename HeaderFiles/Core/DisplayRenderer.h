@@ -0,0 +1,55 @@
+#pragma once
+#include "Image.h"
+#include "HistogramTransformation.h"
+
+//8 bit interleaved rows laid out as in a grayscale8 or rgb888 QImage
+struct DisplayBuffer {
+	uint8_t* data = nullptr;
+	uint32_t channels = 0;
+	size_t bytes_per_line = 0;
+
+	uint8_t* row(int y)const { return data + y * bytes_per_line; }
+};
+
+//source pixels to 8 bit display values, through the rgb/k stf curve when one is given
+//integer images index a table over their whole range, float images a piecewise linear table over [0,1]
+template<typename T>
+class DisplayLUT {
+
+	static constexpr int m_float_segments = 65536;
+
+	std::vector<uint8_t> m_lut;
+
+	//display values scaled to [0,255] at each segment end, and the rise over each segment
+	std::vector<float> m_table;
+	std::vector<float> m_slope;
+
+public:
+	DisplayLUT() { build(nullptr); }
+
+	void build(const HistogramTransformation* stf);
+
+	uint8_t operator()(T pixel)const {
+		if constexpr (std::is_same_v<T, float>) {
+			float x = math::clipf(pixel) * m_float_segments;
+			int i = math::min(int(x), m_float_segments - 1);
+			return m_table[i] + (x - i) * m_slope[i];
+		}
+		else
+			return m_lut[pixel];
+	}
+};
+
+//fills display rows in parallel, each display pixel being the mean of a bin x bin block of src starting at (xs[x], ys[y])
+//a bin of one picks single pixels, which is how zoomed in views are drawn
+class DisplayRenderer {
+public:
+	//first pixel of each display pixel's bin on a pyramid level, clamped so the bin stays inside the level
+	static std::vector<int> binIndices(double offset, uint32_t count, int factor, int level, int bin, uint32_t size);
+
+	//pixel under each display pixel when every source pixel is drawn factor x factor, starting from display pixel first
+	static std::vector<int> upsampleIndices(int first, uint32_t count, int factor, uint32_t size);
+
+	template<typename T>
+	static void render(const Image<T>& src, const std::vector<int>& xs, const std::vector<int>& ys, int bin, const DisplayLUT<T>& lut, const DisplayBuffer& dst);
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include "DisplayRenderer.h"
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+
+//square tiles of rendered display pixels, so a pan only renders the tiles it newly exposes
+//tiles sit on a grid anchored at the top left of the whole image as it would be drawn at a zoom,
+//and the variant tells apart renderings that differ in something other than zoom, like the stf
+class DisplayTileCache {
+public:
+	static constexpr int m_tile_size = 256;
+
+	struct Key {
+		int zoom = 0;
+		int variant = 0;
+		int tx = 0;
+		int ty = 0;
+
+		auto operator<=>(const Key&)const = default;
+	};
+
+	//fills a whole tile whose top left display pixel is (x, y)
+	using Render = std::function<void(int x, int y, const DisplayBuffer& tile)>;
+
+private:
+	struct Tile {
+		Key key;
+		std::vector<uint8_t> pixels;
+	};
+
+	uint32_t m_channels = 0;
+	size_t m_bytes = 0;
+
+	//budget shared by every cache, each window has two and a workspace can hold many windows
+	//a cache evicts only its own tiles and always keeps the one being drawn
+	static constexpr size_t m_max_bytes = 256 << 20;
+	inline static std::atomic<size_t> m_shared_bytes = 0;
+
+	//most recently used first
+	std::list<Tile> m_tiles;
+	std::map<Key, std::list<Tile>::iterator> m_index;
+
+public:
+	DisplayTileCache() = default;
+
+	DisplayTileCache(const DisplayTileCache&) = delete;
+
+	DisplayTileCache& operator=(const DisplayTileCache&) = delete;
+
+	~DisplayTileCache() { clear(); }
+
+	size_t tileCount()const { return m_tiles.size(); }
+
+	void clear();
+
+	//copies display pixels [x, x + cols) x [y, y + rows) at zoom into dst, rendering the tiles that are missing
+	void draw(int zoom, int variant, int x, int y, uint32_t cols, uint32_t rows, const Render& render, const DisplayBuffer& dst);
+
+private:
+	const Tile& tile(const Key& key, const Render& render);
+};
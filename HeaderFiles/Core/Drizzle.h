@@ -3,6 +3,7 @@
 #include "Interpolator.h"
 #include "Maths.h"
 #include "ImageCalibration.h"
+#include "StageTimer.h"
 
 class Drizzle {
 
@@ -69,8 +70,7 @@ class DrizzleIntegrationProcesss {
 	FileVector m_alignment_paths;
 	FileVector m_weight_paths;
 
-	std::filesystem::path m_dark_path;
-	std::filesystem::path m_flat_path;
+	StageTimer* m_stage_timer = nullptr;
 
 public:
 	DrizzleIntegrationProcesss() = default;
@@ -87,5 +87,8 @@ public:
 
 	void setWeightPaths(const FileVector& weight_paths) { m_weight_paths = weight_paths; }
 
+	//null stops timing
+	void setStageTimer(StageTimer* timer) { m_stage_timer = timer; }
+
 	Status drizzleImages(Image32& output);
 };
\ No newline at end of file
@@ -58,6 +58,8 @@ public:
 
 	void setSigma(float sigma);
 
+	int kernelRadius()const { return (m_kernel_dim - 1) / 2; }
+
 	//void setKernelDimension(int kernel_dimension);
 
 private:
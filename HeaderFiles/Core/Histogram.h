@@ -1,5 +1,6 @@
 #pragma once
 #include "Image.h"
+#include "ThreadPool.h"
 
 class Histogram {
 public:
@@ -56,22 +57,9 @@ public:
 
 	void fill(uint32_t val);
 
+	//channels are counted into the one histogram
 	template<typename T>
-	void constructHistogram(const Image<T>& img) {
-
-		uint16_t k = 1;
-		m_resolution = Resolution(Pixel<T>::max() + 1);
-
-		if (std::is_same<T, float>::value) {
-			m_resolution = Resolution::_16bit;
-			k = 65535;
-		}
-
-		m_data = std::make_unique<uint32_t[]>(resolution());
-
-		for (auto pixel : img)
-			m_data[pixel * k]++;
-	}
+	void constructHistogram(const Image<T>& img);
 
 	void addPixel(uint8_t pixel) {
 		m_data[Pixel<float>::toType(pixel) * resolution()]++;
@@ -87,41 +75,10 @@ public:
 	}
 
 	template<typename T>
-	void constructHistogram(const Image<T>& img, int ch) {
-
-		uint16_t k = 1;
-		m_resolution = Resolution(Pixel<T>::max() + 1);
-
-		if (std::is_same<T, float>::value) {
-			m_resolution = Resolution::_16bit;
-			k = 65535;
-		}
-
-		m_data = std::make_unique<uint32_t[]>(resolution());
-
-		for (auto pixel : image_channel(img, ch))
-			m_data[pixel * k]++;
-	}
+	void constructHistogram(const Image<T>& img, int ch);
 
 	template<typename T>
-	void constructMADHistogram(const Image<T>& img, int ch, T median, bool clip) {
-
-		int k = 1;
-		m_resolution = Resolution(Pixel<T>::max() + 1);
-
-		if (std::is_same<T, float>::value) {
-			m_resolution = Resolution::_16bit;
-			k = 65535;
-		}
-
-		m_data = std::make_unique<uint32_t[]>(resolution());
-
-		for (auto pixel : image_channel(img, ch))
-			m_data[abs(pixel - median) * k]++;
-
-		if (clip)
-			m_data[0] = m_data[resolution() - 1] = 0;	
-	}
+	void constructMADHistogram(const Image<T>& img, int ch, T median, bool clip);
 
 	void resample(Resolution new_resolution);
 
@@ -152,4 +109,109 @@ public:
 	void convertToCDF();
 };
 
-typedef std::vector<Histogram> HistogramVector;
\ No newline at end of file
+typedef std::vector<Histogram> HistogramVector;
+
+
+
+//builds histograms in parallel, every chunk of rows counts into bins of its own which are summed at the end
+class HistogramBuilder {
+public:
+	HistogramBuilder() = delete;
+
+	//one histogram per channel of view from a single pass
+	//integer pixels are scaled to the resolution, float pixels are clamped to [0,1]
+	template<typename T>
+	static HistogramVector build(const ImageView<const T>& view, Histogram::Resolution resolution);
+
+	template<typename T>
+	static HistogramVector build(const ImageView<const T>& view) { return build(view, nativeResolution<T>()); }
+
+	//a bin per value for 8 and 16 bit, 16 bit bins for float
+	template<typename T>
+	static constexpr Histogram::Resolution nativeResolution() {
+		return (std::is_same_v<T, uint8_t>) ? Histogram::Resolution::_8bit : Histogram::Resolution::_16bit;
+	}
+
+	//count sets of size bins over rows [0, rows), func(start, end, bins) adds its rows into bins[0] to bins[count - 1]
+	//bins are zeroed and private to the call so func needs no synchronisation
+	template<typename Func>
+	static std::vector<std::vector<uint32_t>> accumulate(int rows, int count, uint32_t size, Func&& func, int min_rows = 1) {
+
+		using Bins = std::vector<std::vector<uint32_t>>;
+
+		int tc = ThreadPool::threadCount();
+		int grain = math::max(min_rows, (rows + tc - 1) / tc);
+
+		auto map = [&](int start, int end) {
+
+			Bins bins(count, std::vector<uint32_t>(size, 0));
+
+			std::vector<uint32_t*> ptrs(count);
+			for (int i = 0; i < count; ++i)
+				ptrs[i] = bins[i].data();
+
+			func(start, end, ptrs.data());
+
+			return bins;
+		};
+
+		auto reduce = [](Bins a, Bins b) {
+
+			if (a.empty())
+				return b;
+
+			for (size_t h = 0; h < a.size(); ++h)
+				for (size_t i = 0; i < a[h].size(); ++i)
+					a[h][i] += b[h][i];
+
+			return a;
+		};
+
+		return ThreadPool::parallelReduce(0, rows, Bins(), map, reduce, grain);
+	}
+};
+
+
+
+template<typename T>
+void Histogram::constructHistogram(const Image<T>& img) {
+
+	auto histograms = HistogramBuilder::build(img.view());
+	if (histograms.empty())
+		return;
+
+	*this = histograms[0];
+
+	for (size_t ch = 1; ch < histograms.size(); ++ch)
+		for (uint32_t i = 0; i < resolution(); ++i)
+			m_data[i] += histograms[ch][i];
+}
+
+template<typename T>
+void Histogram::constructHistogram(const Image<T>& img, int ch) {
+	*this = HistogramBuilder::build(img.channelView(ch))[0];
+}
+
+template<typename T>
+void Histogram::constructMADHistogram(const Image<T>& img, int ch, T median, bool clip) {
+
+	m_resolution = HistogramBuilder::nativeResolution<T>();
+	uint32_t k = (std::is_same_v<T, float>) ? resolution() - 1 : 1;
+
+	auto view = img.channelView(ch);
+
+	auto bins = HistogramBuilder::accumulate(view.rows(), 1, resolution(), [&](int start, int end, uint32_t** bins) {
+		for (int y = start; y < end; ++y) {
+			const T* row = view.row(y);
+			for (uint32_t x = 0; x < view.cols(); ++x)
+				bins[0][uint32_t(math::min(std::fabs(float(row[x]) - float(median)), float(Pixel<T>::max())) * k)]++;
+		}
+		});
+
+	m_data = std::make_unique<uint32_t[]>(resolution());
+	if (!bins.empty())
+		memcpy(m_data.get(), bins[0].data(), resolution() * sizeof(uint32_t));
+
+	if (clip)
+		m_data[0] = m_data[resolution() - 1] = 0;
+}
\ No newline at end of file
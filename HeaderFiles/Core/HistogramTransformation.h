@@ -2,6 +2,7 @@
 #include "Image.h"
 #include "RGBColorSpace.h"
 #include "Histogram.h"
+#include "PointOperation.h"
 
 class HistogramTransformation {
 
@@ -16,8 +17,6 @@ class HistogramTransformation {
 		float dv = 1.0 / (m_highlights - m_shadow);
 
 	public:
-		std::vector<uint16_t> m_lut;
-
 		MTFCurve(float shadow, float midtone, float highlight) : m_shadow(shadow), m_midtone(midtone), m_highlights(highlight) {}
 
 		MTFCurve() = default;
@@ -49,13 +48,6 @@ class HistogramTransformation {
 		float MTF(float pixel)const;
 
 		float transformPixel(float pixel)const;
-
-		void generate16Bit_LUT();
-
-		void generate8Bit_LUT();
-
-		template <typename T>
-		void applyChannel(Image<T>& img, int ch);
 	};
 
 private:
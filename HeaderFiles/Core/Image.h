@@ -1,6 +1,10 @@
 #pragma once
 //#include"Matrix.h"
 #include "RGBColorSpace.h"
+#include "BatchColorSpace.h"
+#include "ImageAllocator.h"
+#include "ImageView.h"
+#include "Quantile.h"
 #include "Maths.h"
 
 enum class ImageType : uint8_t {
@@ -213,7 +217,7 @@ private:
 	T* m_green = nullptr;
 	T* m_blue = nullptr;
 
-	std::unique_ptr<T[]> m_data;
+	ImageAllocator::Buffer<T> m_data;
 
 public:
 	Image(uint32_t rows, uint32_t cols, uint32_t channels = 1);
@@ -224,6 +228,11 @@ public:
 
 	Image(Image&& other)noexcept;
 
+	//packed copy of the pixels a view covers
+	explicit Image(const ImageView<const T>& view) : Image(view.rows(), view.cols(), view.channels()) {
+		view.copyTo(this->view());
+	}
+
 	~Image() {}
 
 	struct Iterator {
@@ -513,6 +522,7 @@ public:
 		return ConstIterator(this->m_data.get() + (channel + 1) * m_pixel_count);
 	}
 
+	//aligned to ImageAllocator::alignment
 	T* data()const { return m_data.get(); }
 
 	uint32_t rows()const { return m_rows; }
@@ -529,6 +539,18 @@ public:
 
 	bool exists()const { return m_data != nullptr; }
 
+	ImageView<T> view() { return ImageView<T>(m_data.get(), m_rows, m_cols, m_channels, m_cols, m_pixel_count); }
+
+	ImageView<const T> view()const { return ImageView<const T>(m_data.get(), m_rows, m_cols, m_channels, m_cols, m_pixel_count); }
+
+	ImageView<T> region(int x, int y, int width, int height) { return view().region(x, y, width, height); }
+
+	ImageView<const T> region(int x, int y, int width, int height)const { return view().region(x, y, width, height); }
+
+	ImageView<T> channelView(int ch) { return view().channel(ch); }
+
+	ImageView<const T> channelView(int ch)const { return view().channel(ch); }
+
 	template <typename P>
 	bool isSameSize(const Image<P>& other)const {
 		return(rows() == other.rows() && cols() == other.cols());
@@ -673,13 +695,12 @@ public:
 		if (m_channels == 1)
 			return;
 
-		if (m_channels == 3) {
-#pragma omp parallel for num_threads(2)
-			for (int el = 0; el < pxCount(); ++el)
-				m_data[el] = Pixel<T>::toType(ColorSpace::CIEL(color<double>(el)));
-		}
+		if (m_channels == 3)
+			BatchColorSpace::RGBtoCIEL(m_red, m_green, m_blue, m_data.get(), pxCount());
 		
-		m_data.reset((T*)std::realloc(m_data.release(), pxCount() * sizeof(T)));
+		auto gray = ImageAllocator::make<T>(pxCount(), false);
+		memcpy(gray.get(), m_data.get(), pxCount() * sizeof(T));
+		m_data = std::move(gray);
 
 		m_channels = 1;
 		m_total_pixel_count = m_pixel_count;
@@ -690,12 +711,7 @@ public:
 		if (m_channels != 3)
 			return;
 
-#pragma omp parallel for num_threads(2)
-		for (int el = 0; el < pxCount(); ++el) {
-			double L, a, b;
-			ColorSpace::RGBtoCIELab(color<double>(el), L, a, b);
-			setColor<>(el, Color<double>(L, a, b));
-		}
+		BatchColorSpace::RGBtoCIELab(m_red, m_green, m_blue, m_red, m_green, m_blue, pxCount());
 	}
 
 	void CIELabtoRGB() {
@@ -703,11 +719,7 @@ public:
 		if (m_channels != 3)
 			return;
 
-#pragma omp parallel for num_threads(2)
-		for (int el = 0; el < pxCount(); ++el) {
-			auto c = color<double>(el);//
-			setColor<>(el, ColorSpace::CIELabtoRGB(c.red, c.green, c.blue));
-		}
+		BatchColorSpace::CIELabtoRGB(m_red, m_green, m_blue, m_red, m_green, m_blue, pxCount());
 	}
 
 	Image<T> createGrayscaleImage()const;
@@ -763,12 +775,12 @@ public:
 		if (y < 0)
 			y = -y;
 		else if (y >= rows())
-			y = 2 * rows() - (y + 1);
+			y = 2 * rows() - (y + 2);
 
 		if (x < 0)
 			x = -x;
 		else if (x >= cols())
-			x = 2 * cols() - (x + 1);
+			x = 2 * cols() - (x + 2);
 
 		return this->at(x, y);
 	}
@@ -780,12 +792,12 @@ public:
 		if (y < 0)
 			y = -y;
 		else if (y >= rows())
-			y = 2 * rows() - (y + 1);
+			y = 2 * rows() - (y + 2);
 
 		if (x < 0)
 			x = -x;
 		else if (x >= cols())
-			x = 2 * cols() - (x + 1);
+			x = 2 * cols() - (x + 2);
 
 		return at(x, y, ch);
 	}
@@ -864,7 +876,7 @@ public:
 
 	float computeMean(int ch, bool clip = false)const;
 
-	T computeMedian(int ch, bool clip = false)const;
+	T computeMedian(int ch, bool clip, Quantile::Mode mode)const;
 
 	float computeStdDev(int ch, bool clip = false)const;
 
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+
+//64 byte aligned pixel buffers, freed buffers are kept in size buckets and handed out again
+//so the temporaries processes create on every call do not go back to the os each time
+class ImageAllocator {
+public:
+	static constexpr size_t alignment = 64;
+
+	template<typename T>
+	struct Deleter {
+		void operator()(T* ptr)const { deallocate(ptr); }
+	};
+
+	template<typename T>
+	using Buffer = std::unique_ptr<T[], Deleter<T>>;
+
+	ImageAllocator() = delete;
+
+	//zeroed unless zero is false
+	static void* allocate(size_t bytes, bool zero = true);
+
+	static void deallocate(void* ptr);
+
+	template<typename T>
+	static Buffer<T> make(size_t count, bool zero = true) {
+		return Buffer<T>(static_cast<T*>(allocate(count * sizeof(T), zero)));
+	}
+
+	//upper bound on memory held by free buffers, 0 disables pooling
+	static void setPoolLimit(size_t bytes);
+
+	static size_t poolLimit();
+
+	static size_t pooledBytes();
+
+	//bytes handed out and not yet returned, pooled buffers are not counted
+	static size_t liveBytes();
+
+	//most live bytes since the last resetPeak
+	static size_t peakBytes();
+
+	static void resetPeak();
+
+	//returns every free buffer to the os
+	static void releasePool();
+
+	//back large buffers with huge pages where the os allows it, falls back silently
+	static void setHugePages(bool enable);
+
+	static bool hugePages();
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include "Image.h"
+
+//mip levels of an image for display, each a 2x2 box average of the one before
+//level 0 is the source itself, the others are built the first time they are asked for
+//the source must outlive the pyramid, and invalidate() must be called whenever it changes
+template<typename T>
+class ImagePyramid {
+
+	const Image<T>* m_source = nullptr;
+
+	//m_levels[i] holds level i + 1
+	std::vector<Image<T>> m_levels;
+
+public:
+	ImagePyramid(const Image<T>& src) : m_source(&src) {}
+
+	ImagePyramid(const ImagePyramid&) = delete;
+
+	ImagePyramid& operator=(const ImagePyramid&) = delete;
+
+	void invalidate() { m_levels.clear(); }
+
+	//highest level at least two pixels each way
+	int maxLevel()const;
+
+	//level binned by the largest power of two not above factor
+	int levelForFactor(int factor)const;
+
+	//bin that is left to apply on a level to reach factor, never larger than the level
+	int residualFactor(int factor, int level)const;
+
+	const Image<T>& level(int level);
+
+private:
+	static Image<T> downsample(const Image<T>& src);
+};
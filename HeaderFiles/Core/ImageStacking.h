@@ -3,6 +3,7 @@
 #include "Maths.h"
 #include "Star.h"
 #include "ImageFileReader.h"
+#include "StageTimer.h"
 
 
 class ImageStackingSignal : public QObject {
@@ -63,8 +64,6 @@ protected:
 		int m_num_imgs = 0; //number of rows/images
 		int m_size = 0;
 
-		int m_max_threads = (omp_get_max_threads() < 4) ? omp_get_max_threads() : 4;
-
 	public:
 		PixelRows(int num_imgs, int width, ImageStacking& is);
 
@@ -99,6 +98,8 @@ protected:
 	float m_perc_low = 0.1f;
 	float m_perc_high = 0.9f;
 
+	StageTimer* m_stage_timer = nullptr;
+
 public:
 	ImageStacking() = default;
 
@@ -118,6 +119,8 @@ public:
 
 		m_perc_low = other.m_perc_low;
 		m_perc_high = other.m_perc_high;
+
+		m_stage_timer = other.m_stage_timer;
 	}
 
 	ImageStackingSignal* imageStackingSignal() { return &m_iss; }
@@ -142,6 +145,9 @@ public:
 
 	void setSigmaHigh(float sigma_high) { m_sigma_high = sigma_high; }
 
+	//null stops timing
+	void setStageTimer(StageTimer* timer) { m_stage_timer = timer; }
+
 private:
 	float mean(const std::vector<float>& pixelstack);
 
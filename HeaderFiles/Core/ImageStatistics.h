@@ -0,0 +1,46 @@
+#pragma once
+#include "Image.h"
+
+//every per channel statistic from one parallel pass over the pixels
+//each chunk of rows fills its own histogram and moments, which are merged afterwards
+//median, avgdev, mad and bwmv are then read off the merged histogram without touching the pixels again
+//8 and 16 bit images get a bin per value so those are exact, float is binned at 16 bit resolution
+class ImageStatistics {
+public:
+	//values are in the units of the image type
+	struct Channel {
+		uint32_t count = 0;
+		float min = 0;
+		float max = 0;
+		double mean = 0;
+		double stdDev = 0;
+		float median = 0;
+		double avgDev = 0;
+		float MAD = 0;
+		double sqrtBWMV = 0;
+	};
+
+private:
+	std::vector<Channel> m_all;
+	std::vector<Channel> m_clipped;
+
+public:
+	ImageStatistics() = default;
+
+	template<typename T>
+	explicit ImageStatistics(const ImageView<const T>& view);
+
+	template<typename T>
+	explicit ImageStatistics(const Image<T>& img) : ImageStatistics(img.view()) {}
+
+	int channels()const { return m_all.size(); }
+
+	bool empty()const { return m_all.empty(); }
+
+	//clipped statistics leave out pixels at the type's min and max, both come from the same pass
+	const Channel& channel(int ch, bool clip = false)const { return (clip) ? m_clipped[ch] : m_all[ch]; }
+
+	//about a given median rather than the channel's own, single channel views only
+	template<typename T>
+	static double sqrtBWMV(const ImageView<const T>& view, float median, bool clip = false);
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+//non owning window onto planar pixels, strides are in elements
+//region and channel views share the storage of whatever they were taken from
+template<typename T>
+class ImageView {
+
+	T* m_data = nullptr;
+	uint32_t m_rows = 0;
+	uint32_t m_cols = 0;
+	uint32_t m_channels = 0;
+	size_t m_row_stride = 0;
+	size_t m_channel_stride = 0;
+
+public:
+	using ValueType = std::remove_const_t<T>;
+
+	ImageView() = default;
+
+	ImageView(T* data, uint32_t rows, uint32_t cols, uint32_t channels, size_t row_stride, size_t channel_stride) :
+		m_data(data), m_rows(rows), m_cols(cols), m_channels(channels), m_row_stride(row_stride), m_channel_stride(channel_stride) {}
+
+	//writable views convert to read only ones
+	operator ImageView<const T>()const requires(!std::is_const_v<T>) {
+		return ImageView<const T>(m_data, m_rows, m_cols, m_channels, m_row_stride, m_channel_stride);
+	}
+
+	T* data()const { return m_data; }
+
+	uint32_t rows()const { return m_rows; }
+
+	uint32_t cols()const { return m_cols; }
+
+	uint32_t channels()const { return m_channels; }
+
+	size_t rowStride()const { return m_row_stride; }
+
+	size_t channelStride()const { return m_channel_stride; }
+
+	size_t pxCount()const { return size_t(m_rows) * m_cols; }
+
+	bool empty()const { return m_data == nullptr || pxCount() == 0; }
+
+	//rows follow each other without padding, channels too
+	bool isContiguous()const {
+		return m_row_stride == m_cols && (m_channels == 1 || m_channel_stride == pxCount());
+	}
+
+	T& operator()(int x, int y, int ch = 0)const {
+		return m_data[ch * m_channel_stride + y * m_row_stride + x];
+	}
+
+	T* row(int y, int ch = 0)const {
+		return m_data + ch * m_channel_stride + y * m_row_stride;
+	}
+
+	ImageView region(int x, int y, int width, int height)const {
+		assert(x >= 0 && y >= 0 && x + width <= int(m_cols) && y + height <= int(m_rows));
+		return ImageView(row(y) + x, height, width, m_channels, m_row_stride, m_channel_stride);
+	}
+
+	ImageView channel(int ch)const {
+		assert(ch < int(m_channels));
+		return ImageView(row(0, ch), m_rows, m_cols, 1, m_row_stride, m_channel_stride);
+	}
+
+	//shapes must match
+	void copyTo(const ImageView<ValueType>& dst)const {
+
+		assert(dst.rows() == rows() && dst.cols() == cols() && dst.channels() == channels());
+
+		for (uint32_t ch = 0; ch < m_channels; ++ch)
+			for (uint32_t y = 0; y < m_rows; ++y)
+				memcpy(dst.row(y, ch), row(y, ch), m_cols * sizeof(T));
+	}
+
+	void fill(ValueType value)const requires(!std::is_const_v<T>) {
+
+		for (uint32_t ch = 0; ch < m_channels; ++ch)
+			for (uint32_t y = 0; y < m_rows; ++y)
+				std::fill_n(row(y, ch), m_cols, value);
+	}
+};
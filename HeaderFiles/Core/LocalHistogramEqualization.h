@@ -4,7 +4,13 @@
 #include "ProcessDialog.h"
 
 class LocalHistogramEqualization {
+public:
+	enum class Method : uint8_t {
+		tiled,
+		sliding
+	};
 
+private:
 	std::unique_ptr<ProgressSignal> m_ps =  std::make_unique<ProgressSignal>();
 
 	int m_kernel_radius = 64;
@@ -12,6 +18,7 @@ class LocalHistogramEqualization {
 	float m_amount = 1.0;
 
 	bool m_is_circular = false;
+	Method m_method = Method::sliding;
 
 	Histogram::Resolution m_hist_res = Histogram::Resolution::_8bit;
 
@@ -31,6 +38,7 @@ public:
 			m_amount = other.amount();
 			m_is_circular = other.isCircular();
 			m_hist_res = other.histogramResolution();
+			m_method = other.method();
 		}
 		return *this;
 	}
@@ -42,6 +50,11 @@ private:
 		uint16_t m_multiplier = m_histogram.resolution() - 1;
 		uint32_t m_count = 0;
 
+		//fenwick tree of clipped bin counts, clipped excess is tracked separately
+		std::vector<uint32_t> m_clipped;
+		uint32_t m_limit = 0;
+		uint32_t m_excess = 0;
+
 		int m_radius = 64;
 		uint32_t m_dimension = 2 * m_radius + 1;
 
@@ -54,6 +67,14 @@ private:
 		int radius()const { return m_radius; }
 
 		uint32_t dimension()const { return m_dimension; }
+
+		void addPixel(uint32_t bin);
+
+		void removePixel(uint32_t bin);
+
+		uint32_t clippedCount(uint32_t bin)const;
+
+		uint32_t firstBin()const;
 	public:
 		KernelHistogram(Histogram::Resolution resolution, int kernel_radius, bool circular);
 
@@ -63,11 +84,16 @@ private:
 
 		uint32_t count()const { return m_count; }
 
+		void setClipLimit(uint32_t limit) { m_limit = limit; }
+
+		//clipped cdf with the excess spread evenly over all bins, normalized to [0,1]
+		float equalize(uint32_t bin)const;
+
 		template<typename T>
-		void populate(Image<T>& img, int y);
+		void populate(const Image<T>& img, int y);
 
 		template<typename T>
-		void update(Image<T>& img, int x, int y);
+		void update(const Image<T>& img, int x, int y);
 	};
 
 public:
@@ -94,7 +120,21 @@ public:
 
 	void setHistogramResolution(Histogram::Resolution resolution) { m_hist_res = resolution; }
 
+	Method method()const { return m_method; }
+
+	void setMethod(Method method) { m_method = method; }
+
 	template<typename T>
 	void apply(Image<T>&img);
+
+private:
+	uint32_t clipLimit(uint32_t count)const;
+
+	//clipped cdf is computed once per tile and bilinearly interpolated between tile centers
+	template<typename T>
+	void applyTiled(const Image<T>& img, Image<T>& dst);
+
+	template<typename T>
+	void applySliding(const Image<T>& img, Image<T>& dst);
 };
 
@@ -1,5 +1,6 @@
 #pragma once
 #include "pch.h"
+#include "ThreadPool.h"
 #include <numbers>
 
 namespace math {
@@ -415,9 +416,13 @@ public:
 
 
 
+//contiguous ranges on the shared ThreadPool, thread_num is the index of the range
+//ranges are a fraction of the per thread share so uneven rows balance across workers
 class Threads {
 
-    uint32_t m_thread_count = std::thread::hardware_concurrency();
+    uint32_t m_thread_count = ThreadPool::threadCount();
+
+    uint32_t grain(uint32_t size)const { return math::max<uint32_t>(1, size / (m_thread_count * 8)); }
 
 public:
     std::mutex mutex;
@@ -443,18 +448,7 @@ public:
         if (size == 0 || m_thread_count == 0)
             return;
 
-        uint32_t thread_count = math::min<uint32_t>(size, m_thread_count);
-        uint32_t chunk_size = (size > m_thread_count) ? (size / m_thread_count) + 1 : 1;
-
-        std::vector<std::thread> threads;
-
-        for (uint32_t i = 0; i < thread_count; ++i) {
-            uint32_t start = i * chunk_size;
-            threads.emplace_back(func, start, math::min(start + chunk_size, size));
-        }
-
-        for (auto& th : threads)
-            th.join();
+        ThreadPool::parallelFor(0, size, [&](int start, int end) { func(start, end); }, grain(size));
     }
 
     void run(std::function<void(uint32_t start, uint32_t end, uint32_t thread_num)> func, uint32_t size)const {
@@ -462,18 +456,9 @@ public:
         if (size == 0 || m_thread_count == 0)
             return;
 
-        uint32_t thread_count = math::min<uint32_t>(size, m_thread_count);
-        uint32_t chunk_size = (size > m_thread_count) ? (size / m_thread_count) + 1 : 1;
-
-        std::vector<std::thread> threads;
-
-        for (uint32_t i = 0; i < thread_count; ++i) {
-            uint32_t start = i * chunk_size;
-            threads.emplace_back(func, start, math::min(start + chunk_size, size), i);
-        }
+        uint32_t chunk_size = grain(size);
 
-        for (auto& th : threads)
-            th.join();
+        ThreadPool::parallelFor(0, size, [&](int start, int end) { func(start, end, start / chunk_size); }, chunk_size);
     }
 };
 
@@ -481,16 +466,17 @@ public:
 //get rid of event loop
 class QThreads : QObject{
 
-    uint32_t m_thread_count = std::thread::hardware_concurrency();
+    uint32_t m_thread_count = ThreadPool::threadCount();
 public:
     QMutex qmutex;
 
-    QThreads(uint32_t thread_count = std::thread::hardware_concurrency()) : m_thread_count(thread_count) {}
+    QThreads(uint32_t thread_count = ThreadPool::threadCount()) : m_thread_count(thread_count) {}
 
     template<class Func, class... Args>
     static void runThread(Func&& func, Args&&... args) {
 
-        auto thread = QThread::create(func, args...);
+        //openmp settings are per thread
+        auto thread = QThread::create([=]() mutable { omp_set_num_threads(ThreadPool::threadCount()); std::invoke(func, args...); });
         thread->start();
     }
 
@@ -557,18 +543,18 @@ public:
 
 class QEventThreads : QObject {
 
-    uint32_t m_thread_count = std::thread::hardware_concurrency();
+    uint32_t m_thread_count = ThreadPool::threadCount();
     //std::mutex m;
 public:
     QMutex qmutex;
 
-    QEventThreads(uint32_t thread_count = std::thread::hardware_concurrency()) : m_thread_count(thread_count) {}
+    QEventThreads(uint32_t thread_count = ThreadPool::threadCount()) : m_thread_count(thread_count) {}
 
     template<class Func, class... Args>
     static void runThread(Func&& func, Args&&... args) {
 
         QEventLoop loop;
-        auto thread = QThread::create(func, args...);
+        auto thread = QThread::create([=]() mutable { omp_set_num_threads(ThreadPool::threadCount()); std::invoke(func, args...); });
         connect(thread, &QThread::finished, [&]() { loop.quit(); });
         thread->start();
         loop.exec();
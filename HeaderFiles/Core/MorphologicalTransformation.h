@@ -69,6 +69,106 @@ public:
 };
 
 
+
+//run of true mask elements in a kernel row, offset is relative to the kernel center
+struct KernelSegment {
+	int offset = 0;
+	int length = 0;
+
+	bool operator==(const KernelSegment& other)const { return offset == other.offset && length == other.length; }
+};
+
+
+
+//van Herk/Gil-Werman min/max filter
+//mask rows are decomposed into horizontal line segments, each costing O(1) per pixel
+template<typename T>
+class MinMaxFilter {
+
+	int m_dim = 0;
+	int m_radius = 0;
+
+	std::vector<KernelSegment> m_rows;
+	std::vector<int> m_lengths;
+	std::vector<int> m_length_index;
+
+	bool m_decomposable = true;
+	bool m_rectangular = false;
+	KernelSegment m_vertical;
+
+public:
+	MinMaxFilter(const MorphologicalTransformation& mt);
+
+	//false if a mask row is not a single contiguous segment
+	bool isDecomposable()const { return m_decomposable; }
+
+	bool isRectangular()const { return m_rectangular; }
+
+	void minimum(const Image<T>& src, Image<T>& dst, int ch)const;
+
+	void maximum(const Image<T>& src, Image<T>& dst, int ch)const;
+
+private:
+	template<typename Op>
+	static void lineFilter(const T* src, T* dst, int size, int length, T* g, T* h, Op op);
+
+	template<typename Op>
+	void rectangularFilter(const Image<T>& src, Image<T>& dst, int ch, Op op)const;
+
+	template<typename Op>
+	void segmentFilter(const Image<T>& src, Image<T>& dst, int ch, Op op)const;
+};
+
+
+
+//histogram rank filter (median/selection), 8-bit bins for Image8, 16-bit bins otherwise
+//full kernels use Perreault-Hebert column histograms, O(1) per pixel
+//masks with contiguous rows slide the kernel histogram one segment end at a time
+template<typename T>
+class RankFilter {
+
+	static constexpr int m_bits = (std::is_same_v<T, uint8_t>) ? 8 : 16;
+	static constexpr int m_coarse_bits = m_bits / 2;
+	static constexpr int m_coarse_size = 1 << m_coarse_bits;
+	static constexpr int m_fine_size = 1 << m_bits;
+	static constexpr int m_max_bin = m_fine_size - 1;
+
+	int m_dim = 0;
+	int m_radius = 0;
+	int m_count = 0;
+
+	std::vector<KernelSegment> m_rows;
+
+	bool m_supported = true;
+	bool m_full = false;
+
+public:
+	RankFilter(const MorphologicalTransformation& mt);
+
+	//false if a mask row is not a single contiguous segment
+	bool isSupported()const { return m_supported; }
+
+	int count()const { return m_count; }
+
+	//rank is the 0 based position of the output value among the sorted masked pixels
+	void apply(const Image<T>& src, Image<T>& dst, int ch, int rank)const;
+
+	void median(const Image<T>& src, Image<T>& dst, int ch)const { apply(src, dst, ch, m_count / 2); }
+
+private:
+	static uint16_t toBin(T pixel);
+
+	static T fromBin(int bin);
+
+	//returns the bin holding rank and subtracts the counts of the preceding bins from rank
+	static int findBin(const uint32_t* histogram, int& rank);
+
+	void fullKernelFilter(const Image<T>& src, Image<T>& dst, int ch, int rank)const;
+
+	void segmentFilter(const Image<T>& src, Image<T>& dst, int ch, int rank)const;
+};
+
+
 class MorphologicalTransformation {
 
 public:
@@ -148,6 +248,9 @@ public:
 
 	std::vector<uint16_t> maskedLocations()const;
 
+	//one segment per kernel row, false if a row is not a single contiguous segment
+	bool maskSegments(std::vector<KernelSegment>& segments)const;
+
 private:
 	int maskCount()const;
 
@@ -156,6 +259,9 @@ private:
 		return T(m_orig_amount * old_pixel + m_amount * new_pixel);
 	}
 
+	template<typename T>
+	void blendFiltered(const Image<T>& img, Image<T>& filtered);
+
 	template <typename T>
 	void erosion(Image<T>&img);
 
@@ -0,0 +1,40 @@
+#pragma once
+#include "Image.h"
+
+//chains per-channel point transforms and applies them as one lookup per pixel
+class PointOperation {
+public:
+	using Function = std::function<float(float)>;
+
+private:
+	//float images use a piecewise linear table over [0,1]
+	static constexpr int m_float_segments = 65536;
+
+	std::array<std::vector<Function>, 3> m_chains;
+
+	//clipped after every stage, and for integer images stored as T between stages, as if each were applied on its own
+	template<typename T>
+	double evaluate(int ch, float pixel)const;
+
+	template<typename T>
+	void applyLUT(Image<T>& img, int ch)const;
+
+	void applyTable(Image32& img, int ch)const;
+
+public:
+	PointOperation() = default;
+
+	//appends to every channel
+	void append(const Function& func);
+
+	void append(int ch, const Function& func);
+
+	bool isIdentity(int ch)const { return m_chains[ch].empty(); }
+
+	bool isIdentity()const;
+
+	void clear();
+
+	template<typename T>
+	void apply(Image<T>& img)const;
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include "ImageView.h"
+
+//order statistics over the first channel of a view
+//exact selection radix selects on the pixel bits a digit at a time, counting digits in parallel and
+//only following the bucket holding the wanted rank, so no pixels are copied or sorted
+//approximate selection works on a random sample and reports how far off it may be
+class Quantile {
+public:
+	enum class Mode : uint8_t {
+		exact,
+		approximate
+	};
+
+	struct Estimate {
+		float value = 0;
+		//the exact quantile lies within [lower, upper] with 99% confidence
+		float lower = 0;
+		float upper = 0;
+		//bound on the distance between the requested and the returned quantile, as a fraction of the pixels
+		double rank_error = 0;
+	};
+
+	static constexpr uint32_t default_sample_size = 100'000;
+
+	Quantile() = delete;
+
+	//q in [0,1], interpolates between neighbouring ranks, clip leaves out pixels at the type's min and max
+	template<typename T>
+	static float quantile(const ImageView<const T>& view, double q, bool clip = false);
+
+	template<typename T>
+	static float median(const ImageView<const T>& view, bool clip = false) { return quantile(view, 0.5, clip); }
+
+	template<typename T>
+	static float median(const ImageView<const T>& view, bool clip, Mode mode) {
+		return (mode == Mode::exact) ? median(view, clip) : approximateMedian(view, clip).value;
+	}
+
+	//median of the absolute deviations from median
+	template<typename T>
+	static float mad(const ImageView<const T>& view, float median, bool clip = false);
+
+	//exact when the sample would cover every pixel
+	template<typename T>
+	static Estimate approximateQuantile(const ImageView<const T>& view, double q, bool clip = false, uint32_t sample_size = default_sample_size);
+
+	template<typename T>
+	static Estimate approximateMedian(const ImageView<const T>& view, bool clip = false, uint32_t sample_size = default_sample_size) {
+		return approximateQuantile(view, 0.5, clip, sample_size);
+	}
+};
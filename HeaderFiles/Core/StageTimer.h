@@ -0,0 +1,49 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+//wall time and peak image memory per named stage of a process, summed over every time the stage is entered
+//stages are entered one after another from the thread running the process, never nested
+class StageTimer {
+public:
+	struct Stage {
+		std::string name;
+		uint32_t calls = 0;
+		double seconds = 0;
+		//most ImageAllocator::liveBytes seen while in the stage
+		size_t peak_bytes = 0;
+	};
+
+	//times its own lifetime, does nothing when timer is null so processes need not check
+	class Scope {
+		StageTimer* m_timer = nullptr;
+		const char* m_name = nullptr;
+		std::chrono::steady_clock::time_point m_start;
+
+	public:
+		Scope(StageTimer* timer, const char* name);
+
+		Scope(const Scope&) = delete;
+
+		Scope& operator=(const Scope&) = delete;
+
+		~Scope();
+	};
+
+private:
+	//in the order they were first entered
+	std::vector<Stage> m_stages;
+
+public:
+	StageTimer() = default;
+
+	const std::vector<Stage>& stages()const { return m_stages; }
+
+	void add(const char* name, double seconds, size_t peak_bytes);
+
+	void clear() { m_stages.clear(); }
+
+	//largest resident set of the process so far, as reported by the os
+	static size_t peakProcessMemory();
+};
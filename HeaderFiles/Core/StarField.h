@@ -0,0 +1,58 @@
+#pragma once
+#include "Star.h"
+
+//synthetic star fields with known stars, for timing and checking detection, registration and stacking
+//every frame of a field shows the same stars, placed by the frame's offset and rotation about the image centre
+//noise and hot pixels differ from frame to frame, as they do once dithered frames are registered
+class StarField {
+public:
+	struct Parameters {
+		uint32_t rows = 2048;
+		uint32_t cols = 2048;
+		uint32_t channels = 1;
+		uint32_t star_count = 1500;
+		PSF::Type psf = PSF::Type::gaussian;
+		float fwhm = 3.0f;
+		float beta = 4.0f; //moffat only
+		float background = 0.05f;
+		float noise = 0.005f; //standard deviation of the gaussian noise
+		uint32_t hot_pixels = 200;
+		uint32_t seed = 1;
+	};
+
+	//pixels and radians
+	struct Placement {
+		double dx = 0;
+		double dy = 0;
+		double rotation = 0;
+	};
+
+	struct TrueStar {
+		float x = 0;
+		float y = 0;
+		float amplitude = 0;
+	};
+
+private:
+	Parameters m_params;
+
+	//field coordinates, which are the coordinates of a frame with no offset or rotation
+	std::vector<TrueStar> m_stars;
+
+public:
+	StarField() : StarField(Parameters()) {}
+
+	StarField(const Parameters& params);
+
+	const Parameters& parameters()const { return m_params; }
+
+	const std::vector<TrueStar>& stars()const { return m_stars; }
+
+	//field to frame coordinates, the same way round as the homographies registration computes
+	Matrix placementMatrix(const Placement& placement)const;
+
+	//frame_index picks the noise and hot pixels
+	Image32 frame(const Placement& placement, uint32_t frame_index = 0)const;
+
+	Image32 frame()const { return frame(Placement()); }
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//process wide pool of persistent workers, each with its own task deque
+//idle workers steal from the front of the others, the calling thread works on its own job while waiting
+class ThreadPool {
+
+	using Task = std::function<void()>;
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	struct Job;
+
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::atomic_int m_queued = 0;
+	std::atomic_int m_idle = 0;
+	std::atomic_uint32_t m_next_queue = 0;
+	bool m_stop = false;
+
+	uint32_t m_thread_count = 1;
+
+	ThreadPool(uint32_t thread_count) { start(thread_count); }
+
+	~ThreadPool() { stop(); }
+
+	static ThreadPool& instance();
+
+	void start(uint32_t thread_count);
+
+	void stop();
+
+	void workerLoop(int index);
+
+	void push(Task task);
+
+	//own queue from the back, others from the front
+	bool take(int index, Task& task);
+
+	void run(int begin, int end, int grain, const std::function<void(int start, int end)>& func);
+
+public:
+	ThreadPool(const ThreadPool&) = delete;
+
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	//total threads including the caller, also used for openmp regions
+	static uint32_t threadCount();
+
+	//the one place the thread count is set, call while no parallel work is running
+	static void setThreadCount(uint32_t thread_count);
+
+	static bool isWorkerThread();
+
+	//func(start, end) over chunks of grain indices, grain 0 gives a few chunks per thread
+	//nested calls from workers only hand chunks to idle workers and otherwise run inline
+	template<typename Func>
+	static void parallelFor(int begin, int end, Func&& func, int grain = 0) {
+		instance().run(begin, end, grain, std::function<void(int, int)>(std::forward<Func>(func)));
+	}
+
+	//map(start, end) -> T per chunk, results are combined in chunk order so the result is deterministic
+	template<typename T, typename Map, typename Reduce>
+	static T parallelReduce(int begin, int end, T identity, Map&& map, Reduce&& reduce, int grain = 0) {
+
+		int size = end - begin;
+		if (size <= 0)
+			return identity;
+
+		if (grain <= 0)
+			grain = defaultGrain(size);
+
+		int chunks = (size + grain - 1) / grain;
+		std::vector<T> results(chunks, identity);
+
+		parallelFor(0, chunks, [&](int first, int last) {
+			for (int c = first; c < last; ++c)
+				results[c] = map(begin + c * grain, std::min(begin + (c + 1) * grain, end));
+			}, 1);
+
+		T result = std::move(identity);
+		for (auto& r : results)
+			result = reduce(std::move(result), std::move(r));
+
+		return result;
+	}
+
+	static int defaultGrain(int size) {
+		return std::max<int>(1, size / int(4 * threadCount()));
+	}
+};
@@ -2,15 +2,31 @@
 #include "ImageFile.h"
 #include "Image.h"
 #include "Maths.h"
+#include "Compression.h"
+#include <unordered_map>
+#include <mutex>
 
 class FITS : public ImageFile {
 
+public:
+	//tile compression of the fpack/cfitsio convention
+	enum class TileCodec : uint8_t {
+		none,
+		rice,
+		gzip,
+		gzip_shuffle
+	};
+
+private:
 	struct FITSHeader {
 		typedef std::array<char, 80> header_line;
 
 		std::vector<header_line> header_block = std::vector<header_line>(36);
 		int keyword_count = 0;
 
+		//line of the first occurrence of each keyword
+		std::unordered_map<std::string, int> keyword_index;
+
 		FITSHeader() = default;
 
 		FITSHeader(int bitpix, std::array<uint32_t, 3> axis, bool end = true);
@@ -25,13 +41,24 @@ class FITS : public ImageFile {
 
 		void addIntegerKeyword(const std::string& keyword, int integer, const std::string& comment = "");
 
-		//void addStringKeyword(const std::string& keword, const std::string& value);
+		void addStringKeyword(const std::string& keyword, const std::string& value, const std::string& comment = "");
 
 		//void addCommentKeyword(const std::string& data);
 
 		//void addHistoryKeyword(const std::string& data);
 
-		int keywordValue(const std::string& keyword);
+		int keywordValue(const std::string& keyword)const;
+
+		//nullptr if missing
+		const header_line* findKeyword(const std::string& keyword)const;
+
+		bool hasKeyword(const std::string& keyword)const { return findKeyword(keyword) != nullptr; }
+
+		std::string keywordString(const std::string& keyword)const;
+
+		double keywordDouble(const std::string& keyword, double default_value = 0.0)const;
+
+		bool keywordLogical(const std::string& keyword)const;
 
 		void resizeHeaderBlock() {
 			header_block.resize(header_block.size() + 36);
@@ -39,31 +66,150 @@ class FITS : public ImageFile {
 
 		void endHeader();
 
-		void read(std::fstream& stream);
+		//reads whole 2880 byte blocks until END and indexes the keywords
+		void read(std::fstream& stream, std::streampos start = 0);
 
 		void write(std::fstream& stream);
 
 	};
 
+	//primary header, or the tile table header which carries the image keywords of compressed files
 	FITSHeader m_fits_header;
 
 	std::streampos m_data_pos = 2880;
 
+	//headers of files opened this session, stale entries are detected by size and write time
+	class HeaderCache {
+		struct Entry {
+			std::filesystem::file_time_type write_time;
+			uintmax_t size = 0;
+			FITSHeader header;
+			std::streampos data_pos = 0;
+		};
+
+		std::mutex m_mutex;
+		std::unordered_map<std::string, Entry> m_entries;
+		static constexpr size_t m_max_entries = 4096;
+
+	public:
+		bool find(const std::filesystem::path& path, FITSHeader& header, std::streampos& data_pos);
+
+		void insert(const std::filesystem::path& path, const FITSHeader& header, std::streampos data_pos);
+
+		void erase(const std::filesystem::path& path);
+	};
+
+	static HeaderCache& headerCache();
+
+	enum class Quantize : uint8_t {
+		none,
+		no_dither,
+		subtractive_dither_1,
+		subtractive_dither_2
+	};
+
+	struct Tile {
+		uint64_t size = 0;
+		uint64_t position = 0; //in file
+		uint64_t gzip_size = 0; //fallback column for tiles rice could not code
+		uint64_t gzip_position = 0;
+		double scale = 1.0;
+		double zero = 0.0;
+	};
+
+	//image stored as a tile table in a binary table extension
+	struct TiledImage {
+		TileCodec codec = TileCodec::none;
+		int zbitpix = 0;
+		std::array<uint32_t, 3> tile_size = { 1, 1, 1 }; //x, y, channel
+		std::array<uint32_t, 3> tile_count = { 1, 1, 1 };
+		int block_size = 32;
+		int bytepix = 4;
+		double bzero = 0.0;
+		Quantize quantize = Quantize::none;
+		int dither_seed = 1;
+		bool has_blank = false;
+		int32_t blank = 0;
+		std::vector<Tile> tiles;
+	};
+
+	TiledImage m_tiled;
+
+	//decoded tiles of the last tile row read by readRow_toFloat
+	int m_cached_tile_row = -1;
+	std::vector<std::vector<float>> m_tile_cache;
+
+	//tile rows a single compressed tile spans when writing, one image row like fpack
+	static constexpr uint32_t m_write_tile_rows = 1;
+
 public:
 
 	FITS() : ImageFile(Type::FITS) {};// = default;
 
 	FITS(FITS&& other) noexcept : ImageFile(std::move(other)) {
+		m_fits_header = std::move(other.m_fits_header);
 		m_data_pos = other.m_data_pos;
+		m_tiled = std::move(other.m_tiled);
 	}
 
 
 private:
 	ImageType imageTypefromFile();
 
+	bool openTiledImage();
+
+	size_t tilePixelCount(int tile)const;
+
+	//x, y, channel of the first pixel of the tile
+	std::array<uint32_t, 3> tileOrigin(int tile)const;
+
+	void readTile(int tile, std::vector<uint8_t>& data, std::vector<uint8_t>& gzip_data);
+
+	template<typename T>
+	bool decodeTile(int tile, const std::vector<uint8_t>& data, const std::vector<uint8_t>& gzip_data, T* dst)const;
+
+	//decompresses tiles in parallel, sequential reads of the compressed data are done first
+	template<typename T>
+	void decodeTiles(const std::vector<int>& tiles, std::vector<std::vector<T>>& dst);
+
+	template<typename T>
+	void readTiled(Image<T>& dst);
+
+	//copies the part of image row, channel held by a decoded tile
+	void copyTileRow(int tile, const std::vector<float>& decoded, uint32_t row, uint32_t channel, float* dst)const;
+
+	//parses the primary header and the tile table header that may follow it
+	bool readHeader();
+
 public:
+	//acquisition keywords used to validate and group frames
+	struct FrameInfo {
+		uint32_t rows = 0;
+		uint32_t cols = 0;
+		uint32_t channels = 1;
+		ImageType type = ImageType::UBYTE;
+		bool tile_compressed = false;
+		float exposure = 0.0f; //seconds
+		float gain = 0.0f;
+		float ccd_temp = 0.0f; //celsius
+		std::string filter;
+	};
+
 	std::streampos dataPosition()const { return m_data_pos; }
 
+	bool hasKeyword(const std::string& keyword)const { return m_fits_header.hasKeyword(keyword); }
+
+	std::string keywordString(const std::string& keyword)const { return m_fits_header.keywordString(keyword); }
+
+	double keywordDouble(const std::string& keyword, double default_value = 0.0)const { return m_fits_header.keywordDouble(keyword, default_value); }
+
+	bool keywordLogical(const std::string& keyword)const { return m_fits_header.keywordLogical(keyword); }
+
+	FrameInfo frameInfo()const;
+
+	//header only, served from the session cache when the file is unchanged
+	static FrameInfo readFrameInfo(const std::filesystem::path& path);
+
 	static bool isFITS(std::filesystem::path file_name) {
 
 		std::string ext = file_name.extension().string();
@@ -73,6 +219,10 @@ public:
 
 	bool isFITSFile();
 
+	bool isTileCompressed()const { return m_tiled.codec != TileCodec::none; }
+
+	TileCodec tileCodec()const { return m_tiled.codec; }
+
 	void open(std::filesystem::path path) override;
 
 	void create(std::filesystem::path path) override;
@@ -91,6 +241,9 @@ private:
 public:
 	void readRow_toFloat(float* dst, uint32_t row, uint32_t channel);
 
+	//reads count consecutive rows into dst, compressed files only decode the tiles covering them
+	void readRows_toFloat(float* dst, uint32_t row, uint32_t count, uint32_t channel);
+
 private:
 	template<typename T>
 	void writePixels_8(const Image<T>& src);
@@ -101,7 +254,10 @@ private:
 	template<typename T>
 	void writePixels_float(const Image<T>& src);
 
+	template<typename T>
+	void writeTiled(const Image<T>& src, ImageType new_type, TileCodec codec);
+
 public:
 	template <typename T>
-	void write(const Image<T>& src, ImageType new_type);
+	void write(const Image<T>& src, ImageType new_type, TileCodec codec = TileCodec::none);
 };
@@ -24,6 +24,8 @@ class AutomaticBackgroundExtractionDialog : public ProcessDialog {
 
     ComboBox* m_correction_combo = nullptr;
 
+    SpinBox* m_downsample_sb = nullptr;
+
     PushButton* m_apply_to_preview_pb = nullptr;
     const QString m_apply_to_preview = "Apply to Preview";
 
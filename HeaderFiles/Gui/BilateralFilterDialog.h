@@ -15,6 +15,7 @@ class BilateralFilterDialog : public ProcessDialog {
 
 	CheckBox* m_circular_cb = nullptr;
 	ComboBox* m_kernel_size_cb = nullptr;
+	ComboBox* m_method_cb = nullptr;
 
 public:
 	BilateralFilterDialog(Workspace* parent = nullptr);
@@ -26,6 +27,8 @@ private:
 
 	void addKernelSizeInputs();
 
+	void addMethodInputs();
+
 	void resetDialog();
 
 	void apply();
@@ -23,6 +23,8 @@ class LocalHistogramEqualizationDialog : public ProcessDialog {
 
 	ComboBox* m_hist_res_combo = nullptr;
 
+	ComboBox* m_method_combo = nullptr;
+
 public:
 	LocalHistogramEqualizationDialog(Workspace* parent = nullptr);
 
@@ -33,6 +35,8 @@ private:
 
 	void addAmountInputs();
 
+	void addMethodInputs();
+
 	void resetDialog();
 
 	void apply();
@@ -1,6 +1,7 @@
 #pragma once
 #include "Image.h"
 #include "Histogram.h"
+#include "ImageStatistics.h"
 #include "CustomWidgets.h"
 #include <QtDataVisualization/Q3DSurface>
 #include <QtDataVisualization/Q3DScatter>
@@ -104,7 +105,7 @@ struct Statistics {
 	float stdDev = 0.0;
 	float avgDev = 0.0;
 	float MAD = 0;
-	//float sqrtBWMV = 0.0;
+	float sqrtBWMV = 0.0;
 	float min = 0;
 	float max = 1;
 
@@ -117,6 +118,7 @@ private:
 		stdDev *= int(bitdepth);
 		avgDev *= int(bitdepth);
 		MAD *= int(bitdepth);
+		sqrtBWMV *= int(bitdepth);
 		min *= int(bitdepth);
 		max *= int(bitdepth);
 
@@ -127,6 +129,9 @@ public:
 	template<typename T>
 	static StatsVector computeStatistics(const Image<T>& img, bool clip = false);
 
+	//clipped and unclipped vectors come out of the same ImageStatistics
+	static StatsVector computeStatistics(const ImageStatistics& stats, ImageType type, bool clip = false);
+
 private:
 	template<typename T>
 	void normalizedFromType(Statistics& s)const {
@@ -136,6 +141,7 @@ private:
 		s.stdDev = stdDev / Pixel<T>::max();
 		s.avgDev = avgDev / Pixel<T>::max();
 		s.MAD = Pixel<float>::toType(T(MAD));
+		s.sqrtBWMV = sqrtBWMV / Pixel<T>::max();
 		s.min = Pixel<float>::toType(T(min));
 		s.max = Pixel<float>::toType(T(max));
 	}
@@ -167,7 +173,7 @@ class StatisticsDialog : public Dialog {
 
 	QTableWidget* m_stats_table;
 	
-	const QStringList m_stat_labels = { "Px Count","Mean","Median","StdDev","AvgDev","MAD","Minimum","Maximum","","" };
+	const QStringList m_stat_labels = { "Px Count","Mean","Median","StdDev","AvgDev","MAD","sqrt BWMV","Minimum","Maximum","" };
 
 public:
 	StatisticsDialog(const QString& img_name, const Statistics::StatsVector& statsvector, int precision, QWidget* parent);
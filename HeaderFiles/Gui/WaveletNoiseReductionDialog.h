@@ -0,0 +1,34 @@
+#pragma once
+#include "Wavelet.h"
+#include "ProcessDialog.h"
+#include "CustomWidgets.h"
+
+class WaveletNoiseReductionDialog : public ProcessDialog {
+
+	WaveletNoiseReduction m_wnr;
+
+	SpinBox* m_layers_sb = nullptr;
+	ComboBox* m_scaling_func_combo = nullptr;
+	ComboBox* m_method_combo = nullptr;
+
+	ComboBox* m_layer_combo = nullptr;
+	CheckBox* m_layer_enabled_cb = nullptr;
+	DoubleInput* m_threshold_input = nullptr;
+	DoubleInput* m_amount_input = nullptr;
+
+public:
+	WaveletNoiseReductionDialog(Workspace* parent);
+
+private:
+	void addWaveletInputs();
+
+	void addLayerInputs();
+
+	void onLayerChanged(int layer);
+
+	void resetDialog();
+
+	void apply();
+
+	void applyPreview();
+};
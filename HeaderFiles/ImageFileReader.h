@@ -68,7 +68,7 @@ class ImageFileReader {
 	Workspace* m_workspace;
 
 	inline static QString m_typelist =
-		"All Accepted Formats(*.bmp *.fits *.fts *.fit *.jpg *.jpeg *.png *.tiff *.tif);;"
+		"All Accepted Formats(*.bmp *.fits *.fts *.fit *.jpg *.jpeg *.png *.tiff *.tif *.xisf);;"
 		"BMP file(*.bmp);;"
 		"FITS file(*.fits *.fts *.fit);;"
 		"JPEG file(*.jpg *.jpeg);;"
@@ -38,8 +38,9 @@ public:
 
 	const FileVector& filePaths()const { return m_fv; }
 
+	//temp frames are read back row by row, compressing them trades stacking speed for disk space
 	template<typename T>
-	void writeTempFits(const Image<T>& src, std::filesystem::path file_path);
+	void writeTempFits(const Image<T>& src, std::filesystem::path file_path, FITS::TileCodec codec = FITS::TileCodec::none);
 };
 
 
@@ -131,6 +132,8 @@ class ImageIntegrationProcess {
 
 	bool m_generate_weight_maps = false;
 
+	StageTimer* m_stage_timer = nullptr;
+
 	bool isLightsSameSize();
 
 public:
@@ -169,6 +172,12 @@ public:
 
 	const ImageStackingSignal* imageStackingSignal()const { return &m_iss; }
 
+	//times every stage including stacking, null stops timing
+	void setStageTimer(StageTimer* timer) {
+		m_stage_timer = timer;
+		m_is.setStageTimer(timer);
+	}
+
 	Status integrateImages(Image32& out);
 
 };
@@ -1,6 +1,8 @@
 #pragma once
 //#include "ui_ImageWindow.h"
 #include "Image.h"
+#include "ImagePyramid.h"
+#include "DisplayTileCache.h"
 #include "HistogramTransformation.h"
 #include "AutomaticBackgroundExtraction.h"
 #include "BilateralFilter.h"
@@ -388,9 +390,17 @@ template<typename T>
 class ImageWindow : public ImageWindowBase {
 
 	Image<T> m_source;
+	//binned copies of m_source for zoomed out display
+	ImagePyramid<T> m_pyramid = ImagePyramid<T>(m_source);
+	//source to display values, with the stf folded in while it is enabled
+	DisplayLUT<T> m_display_lut;
+	DisplayTileCache m_tiles;
+	//bumped whenever m_source changes, so views derived from it know to rebuild
+	uint32_t m_source_revision = 0;
 
 	const ImageWindow<uint8_t>* m_mask = nullptr;
 	QImage m_mask_display;
+	DisplayTileCache m_mask_tiles;
 	QColor m_mask_color = Qt::cyan;// { 127, 0, 255 };
 	bool m_mask_enabled = true;
 	bool m_invert_mask = false;
@@ -415,11 +425,20 @@ private:
 		return m_offset.y = math::clip(m_offset.y, 0.0, math::max(0.0, m_source.rows() - rows() / factor()));
 	}
 
+	//top left of the view on the grid of the whole image drawn at the current zoom
+	int displayOriginX()const { return std::lround(m_offset.x * factor()); }
+
+	int displayOriginY()const { return std::lround(m_offset.y * factor()); }
+
 public:
 	Image<T>& source() { return m_source; }
 
 	const Image<T>& source()const { return m_source; }
 
+	const DisplayLUT<T>& displayLUT()const { return m_display_lut; }
+
+	uint32_t sourceRevision()const { return m_source_revision; }
+
 	const ImageWindow<uint8_t>* mask()const { return m_mask; }
 
 	bool maskExists()const { return (m_mask != nullptr) ? true : false; }
@@ -442,7 +461,7 @@ public:
 
 	QColor maskColor()const { return m_mask_color; }
 
-	void setMaskColor(const QColor& color) { m_mask_color = color; displayImage(); }
+	void setMaskColor(const QColor& color) { m_mask_color = color; m_mask_tiles.clear(); displayImage(); }
 
 	bool previewExists()const { return (m_preview.get() != nullptr); }
 
@@ -515,6 +534,7 @@ public:
 		QApplication::restoreOverrideCursor();
 		m_workspace->enableChildren(true);
 		m_compute_stf = true;
+		sourceChanged();
 
 		resizeImageLabel();
 		displayImage();
@@ -537,6 +557,7 @@ public:
 		QApplication::restoreOverrideCursor();
 		m_workspace->enableChildren(true);
 		m_compute_stf = true;
+		sourceChanged();
 
 		m_zoom_window.reset();
 		enableZoomWindowMode(m_enable_zoom_win);
@@ -550,6 +571,12 @@ public:
 	}
 
 private:
+	void sourceChanged() {
+		m_pyramid.invalidate();
+		m_tiles.clear();
+		m_source_revision++;
+	}
+
 	void resizeImageLabel();
 
 	void displayImage();
@@ -564,20 +591,25 @@ private:
 
 	void binToWindow(int factor);
 
-	void binToWindow_RGB(int factor);
-
 	void binToWindow_Colorspace(int factor);
 
 	template<typename P>
-	void binToWindow_Mask(const Image<P>& mask_src, int factor) {
+	void binToWindow_Mask(const Image<P>& mask_src, int factor, int x0, int y0, const DisplayBuffer& tile) {
 
 		int factor2 = factor * factor;
 		const uint8_t b = m_mask_color.blue();
 		const uint8_t g = m_mask_color.green();
 		const uint8_t r = m_mask_color.red();
 
-		for (int y = 0, y_s = m_offset.y; y < rows(); ++y, y_s += factor) {
-			for (int x = 0, x_s = m_offset.x; x < cols(); ++x, x_s += factor) {
+		int max_x = math::max(0, int(mask_src.cols()) - factor);
+		int max_y = math::max(0, int(mask_src.rows()) - factor);
+
+		for (int y = 0; y < DisplayTileCache::m_tile_size; ++y) {
+			int y_s = math::min((y0 + y) * factor, max_y);
+			uint8_t* p = tile.row(y);
+
+			for (int x = 0; x < DisplayTileCache::m_tile_size; ++x, p += 4) {
+				int x_s = math::min((x0 + x) * factor, max_x);
 
 				uint8_t max_pixel = 0;
 
@@ -593,7 +625,6 @@ private:
 
 				float n = Pixel<float>::toType(max_pixel);
 
-				uint8_t* p = &m_mask_display.scanLine(y)[4 * x];
 				*p = n * b;
 				*(p + 1) = n * g;
 				*(p + 2) = n * r;
@@ -604,22 +635,19 @@ private:
 
 	void upsampleToWindow(int factor);
 
-	void upsampleToWindow_RGB(int factor);
-
 	template<typename P>
-	void upsampleToWindow_Mask(const Image<P>& mask_src, int factor) {
-
-		int factor2 = factor * factor;
-		double dd = 1.0 / factor;
+	void upsampleToWindow_Mask(const Image<P>& mask_src, int factor, int x0, int y0, const DisplayBuffer& tile) {
 
 		const uint8_t b = m_mask_color.blue();
 		const uint8_t g = m_mask_color.green();
 		const uint8_t r = m_mask_color.red();
 
-		double y_s = m_offset.y;
-		for (int y = 0; y < rows(); ++y, y_s += dd) {
-			double x_s = m_offset.x;
-			for (int x = 0; x < cols(); ++x, x_s += dd) {
+		for (int y = 0; y < DisplayTileCache::m_tile_size; ++y) {
+			int y_s = math::min((y0 + y) / factor, int(mask_src.rows()) - 1);
+			uint8_t* p = tile.row(y);
+
+			for (int x = 0; x < DisplayTileCache::m_tile_size; ++x, p += 4) {
+				int x_s = math::min((x0 + x) / factor, int(mask_src.cols()) - 1);
 
 				uint8_t max_pixel = 0;
 				for (int ch = 0; ch < mask_src.channels(); ++ch)
@@ -629,14 +657,12 @@ private:
 
 				float n = Pixel<float>::toType(max_pixel);
 
-				uint8_t* p = &m_mask_display.scanLine(y)[4 * x];
 				*p = n * b;
 				*(p + 1) = n * g;
 				*(p + 2) = n * r;
 				*(p + 3) = max_pixel;
 			}
 		}
-		
 	}
 
 	void resetWindowSize();
@@ -647,6 +673,8 @@ private:
 
 	void openStatisticsDialog();
 
+	void computeStatistics();
+
 	void updateStatisticsDialog();
 
 	void openImage3DDialog();
@@ -871,6 +899,32 @@ class PreviewWindow : public PreviewWindowBase {
 	const ImageWindow<T>* m_image_window = nullptr;
 	Image<T> m_source;
 
+	//what a cached resample was made from, anything differing means the parent or the previewed region moved on
+	struct SourceKey {
+		uint32_t revision = 0;
+		QPointF zwtl;
+		double scale = 0;
+		uint32_t rows = 0;
+		uint32_t cols = 0;
+		int apron = 0;
+
+		bool operator==(const SourceKey&)const = default;
+	};
+
+	//parent pixels under the preview at its scale, plus up to an apron of pixels around them where the parent has any
+	//m_source is the part of it at (m_apron_left, m_apron_top)
+	Image<T> m_source_cache;
+	SourceKey m_source_key;
+	int m_apron_left = 0;
+	int m_apron_top = 0;
+
+	Image32 m_mask_cache;
+	SourceKey m_mask_key;
+	const ImageWindow<uint8_t>* m_cached_mask = nullptr;
+
+	//latest preview job, earlier ones still running when it starts are discarded as they finish
+	uint32_t m_job = 0;
+
 public:
 	PreviewWindow(ImageWindow<T>* iw, bool ignore_zoomwindow = false);
 
@@ -882,8 +936,18 @@ protected:
 	void resizeSource();
 
 private:
+	SourceKey sourceKey(uint32_t revision, int apron)const { return { revision, m_zwtl, m_scale_factor, rows(), cols(), apron }; }
+
+	//resamples the parent only when it or the previewed region changed since the last call
+	const Image<T>& sourceCache(int apron = 0);
+
 	void updateSource();
 
+	//crops the apron off a processed cache sized image into m_source
+	void setSource(Image<T>&& img);
+
+	const Image32& maskCache();
+
 	template<typename P>
 	Image32 getMask() {
 
@@ -942,10 +1006,24 @@ public:
 	template<class P>
 	void updatePreview(P& obj, void (P::* apply)(Image<T>&)) {
 
-		updateSource();
+		uint32_t job = ++m_job;
+
+		//processes reading neighbouring pixels get them from the parent rather than the preview's edge
+		int apron = 0;
+		if constexpr (requires(const P& p) { p.kernelRadius(); })
+			apron = obj.kernelRadius();
+
+		Image<T> img(sourceCache(apron));
+		SourceKey key = m_source_key;
 
-		//std::thread(apply, obj, std::ref(m_source)).join();
-		QEventThreads::runThread(apply, obj, std::ref(m_source));
+		//the gui keeps running while the job does, so newer parameters may start their own job meanwhile
+		//and the parent or the previewed region may change under it
+		QEventThreads::runThread(apply, obj, std::ref(img));
+
+		if (job != m_job || key != m_source_key)
+			return;
+
+		setSource(std::move(img));
 
 		if (m_image_window->maskEnabled() && m_image_window->maskExists())
 			return updatePreview_Mask();
@@ -955,18 +1033,34 @@ public:
 
 	void updatePreview(AutomaticBackgroundExtraction& obj, void (AutomaticBackgroundExtraction::* apply)(const Image<T>&, Image<T>&, float)) {
 
+		uint32_t job = ++m_job;
+
 		resizeSource();
-		QEventThreads::runThread(apply, obj, std::ref(m_image_window->source()), std::ref(m_source), scaleFactor());
+		Image<T> img(rows(), cols(), channels());
+		QEventThreads::runThread(apply, obj, std::ref(m_image_window->source()), std::ref(img), scaleFactor());
+
+		if (job != m_job || img.rows() != rows() || img.cols() != cols())
+			return;
+
+		m_source = std::move(img);
 		displayImage();
 	}
 
 	void updatePreview(BilateralFilter& obj, void (BilateralFilter::* apply)(const Image<T>&, Image<T>&, float, const QRectF&)) {
 
+		uint32_t job = ++m_job;
+
 		resizeSource();
 		auto& s = m_image_window->source();
 		auto r = (!m_ingore_zoom_window && m_image_window->zoomWindow()) ? m_image_window->zoomWindow()->imageRectF() : QRectF(0, 0, s.cols(), s.rows());
 
-		QEventThreads::runThread(apply, obj, std::ref(m_image_window->source()), std::ref(m_source), scaleFactor(), r);
+		Image<T> img(rows(), cols(), channels());
+		QEventThreads::runThread(apply, obj, std::ref(m_image_window->source()), std::ref(img), scaleFactor(), r);
+
+		if (job != m_job || img.rows() != rows() || img.cols() != cols())
+			return;
+
+		m_source = std::move(img);
 
 		if (m_image_window->maskEnabled() && m_image_window->maskExists())
 			return updatePreview_Mask();
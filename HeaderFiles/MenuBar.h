@@ -29,6 +29,7 @@
 
 //
 #include "WaveletLayersDialog.h"
+#include "WaveletNoiseReductionDialog.h"
 #include "StarAlignment.h"
 
 //mask
@@ -259,12 +260,15 @@ class WaveletTransformationMenu : public Menu {
     Q_OBJECT
 
     std::unique_ptr<WaveletLayersDialog> m_wld = nullptr;
+    std::unique_ptr<WaveletNoiseReductionDialog> m_wnrd = nullptr;
 
 public:
     WaveletTransformationMenu(Workspace* workspace, QWidget* parent = nullptr);
 
 private:
     void waveletLayersSelection();
+
+    void waveletNoiseReductionSelection();
 };
 
 class ProcessMenu : public Menu {
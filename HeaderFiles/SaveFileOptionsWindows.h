@@ -1,6 +1,9 @@
 #pragma once
 #include "pch.h"
 #include "Image.h"
+#include "Compression.h"
+#include "FITS.h"
+#include "TIFF.h"
 
 class FITSWindow : public QDialog {
     Q_OBJECT
@@ -11,9 +14,11 @@ class FITSWindow : public QDialog {
     QRadioButton* bd8;
     QRadioButton* bd16;
     QRadioButton* bd32;
+    QComboBox* compression;
     QPushButton* save;
 
     ImageType m_type =ImageType::UBYTE;
+    FITS::TileCodec m_codec = FITS::TileCodec::none;
 
 public:
     FITSWindow(ImageType type, QWidget* parent) : m_type(type), QDialog(parent) {
@@ -48,6 +53,12 @@ public:
             break;
         }
 
+        //floats are always written losslessly, rice falls back to gzip with byte shuffle
+        compression = new QComboBox(this);
+        compression->addItems({ "None", "Rice", "GZIP", "GZIP Shuffle" });
+        compression->setCurrentIndex(int(m_codec));
+        layout->addWidget(compression);
+
         save = new QPushButton(this);
         save->setText("Save");
         layout->addWidget(save);
@@ -55,6 +66,7 @@ public:
         connect(bd8, &QRadioButton::toggled, this, [this]() { m_type = ImageType::UBYTE; });
         connect(bd16, &QRadioButton::toggled, this, [this]() { m_type = ImageType::USHORT; });
         connect(bd32, &QRadioButton::toggled, this, [this]() { m_type = ImageType::FLOAT; });
+        connect(compression, &QComboBox::activated, this, [this](int index) { m_codec = FITS::TileCodec(index); });
 
         connect(save, &QPushButton::pressed, this, &FITSWindow::saveImage);
 
@@ -71,6 +83,7 @@ public:
 
     ImageType imageType()const { return m_type; }
 
+    FITS::TileCodec tileCodec()const { return m_codec; }
 };
 
 
@@ -83,17 +96,21 @@ class TIFFWindow : public QDialog {
     QRadioButton* bd16;
     QRadioButton* bd32;
     QCheckBox* planar;
+    QComboBox* compression;
+    QCheckBox* tile;
     QPushButton* save;
 
     ImageType m_type = ImageType::UBYTE;
     bool planar_contig = true;
+    TIFF::Codec m_codec = TIFF::Codec::none;
+    bool m_tiled = false;
 
 public:
-    TIFFWindow(ImageType type, QWidget* parent) : m_type(type), QDialog(this)  {
+    TIFFWindow(ImageType type, QWidget* parent) : m_type(type), QDialog(parent)  {
         layout = new QVBoxLayout;
 
-        this->resize(200, 100);
-        this->setWindowTitle("FITS Save Options");
+        this->resize(200, 150);
+        this->setWindowTitle("TIFF Save Options");
 
         bd8 = new QRadioButton;
         bd8->setText("8-bit unsigned int");
@@ -124,14 +141,27 @@ public:
             break;
         }
 
+        //compressed files use the horizontal predictor, floating point predictor for floats
+        compression = new QComboBox;
+        compression->addItems({ "None", "LZW", "Deflate" });
+        layout->addWidget(compression);
+
+        tile = new QCheckBox;
+        tile->setText("Tiled");
+        layout->addWidget(tile);
+
         save = new QPushButton;
         save->setText("Save");
         layout->addWidget(save);
 
         connect(bd8, &QRadioButton::toggled, this, [this]() {m_type = ImageType::UBYTE; });
-        connect(bd16, &QRadioButton::toggled, this, [this]() {m_type = ImageType::UBYTE; });
-        connect(bd32, &QRadioButton::toggled, this, [this]() {m_type = ImageType::UBYTE; });
+        connect(bd16, &QRadioButton::toggled, this, [this]() {m_type = ImageType::USHORT; });
+        connect(bd32, &QRadioButton::toggled, this, [this]() {m_type = ImageType::FLOAT; });
         connect(planar, &QCheckBox::clicked, this, [this](bool v) { planar_contig = v; });
+        connect(compression, &QComboBox::activated, this, [this](int index) {
+            static constexpr TIFF::Codec codecs[3] = { TIFF::Codec::none, TIFF::Codec::lzw, TIFF::Codec::deflate };
+            m_codec = codecs[index]; });
+        connect(tile, &QCheckBox::clicked, this, [this](bool v) { m_tiled = v; });
         connect(save, &QPushButton::pressed, this, [this]() { this->accept(); });
 
         this->setLayout(layout);
@@ -142,4 +172,88 @@ public:
 
     bool planarContig() { return planar_contig; }
 
+    TIFF::Codec codec()const { return m_codec; }
+
+    bool tiled()const { return m_tiled; }
+};
+
+
+class XISFWindow : public QDialog {
+    Q_OBJECT
+
+    QVBoxLayout* layout;
+
+    QRadioButton* bd8;
+    QRadioButton* bd16;
+    QRadioButton* bd32;
+    QComboBox* compression;
+    QCheckBox* shuffle;
+    QPushButton* save;
+
+    ImageType m_type = ImageType::UBYTE;
+    Compression::Codec m_codec = Compression::Codec::lz4;
+    bool m_byte_shuffle = true;
+
+public:
+    XISFWindow(ImageType type, QWidget* parent) : m_type(type), QDialog(parent) {
+        layout = new QVBoxLayout(this);
+
+        this->resize(200, 150);
+        this->setWindowTitle("XISF Save Options");
+
+        bd8 = new QRadioButton(this);
+        bd8->setText("8-bit unsigned int");
+        layout->addWidget(bd8);
+
+        bd16 = new QRadioButton(this);
+        bd16->setText("16-bit unsigned int");
+        layout->addWidget(bd16);
+
+        bd32 = new QRadioButton(this);
+        bd32->setText("32-bit floating point");
+        layout->addWidget(bd32);
+
+        switch (type) {
+        case ImageType::UBYTE:
+            bd8->setChecked(true);
+            break;
+        case ImageType::USHORT:
+            bd16->setChecked(true);
+            break;
+        case ImageType::FLOAT:
+            bd32->setChecked(true);
+            break;
+        }
+
+        compression = new QComboBox(this);
+        compression->addItems({ "None", "zlib", "LZ4", "LZ4HC" });
+        compression->setCurrentIndex(int(m_codec));
+        layout->addWidget(compression);
+
+        shuffle = new QCheckBox(this);
+        shuffle->setText("Byte Shuffle");
+        shuffle->setChecked(m_byte_shuffle);
+        layout->addWidget(shuffle);
+
+        save = new QPushButton(this);
+        save->setText("Save");
+        layout->addWidget(save);
+
+        connect(bd8, &QRadioButton::toggled, this, [this]() { m_type = ImageType::UBYTE; });
+        connect(bd16, &QRadioButton::toggled, this, [this]() { m_type = ImageType::USHORT; });
+        connect(bd32, &QRadioButton::toggled, this, [this]() { m_type = ImageType::FLOAT; });
+        connect(compression, &QComboBox::activated, this, [this](int index) { m_codec = Compression::Codec(index); });
+        connect(shuffle, &QCheckBox::clicked, this, [this](bool v) { m_byte_shuffle = v; });
+        connect(save, &QPushButton::pressed, this, [this]() { this->accept(); });
+
+        this->setLayout(layout);
+        this->setAttribute(Qt::WA_DeleteOnClose);
+        this->show();
+    }
+
+    ImageType imageType()const { return m_type; }
+
+    Compression::Codec codec()const { return m_codec; }
+
+    bool byteShuffle()const { return m_byte_shuffle; }
 };
@@ -33,6 +33,11 @@ public:
         YResolution = 283,
         PlanarConfiguration = 284,
         ResolutionUnit = 296,
+        Predictor = 317,
+        TileWidth = 322,
+        TileLength = 323,
+        TileOffsets = 324,
+        TileByteCounts = 325,
         SampleFormat = 339
     };
 
@@ -47,6 +52,18 @@ public:
         Float,
         Undefined
     };
+
+    enum class Codec : uint16_t {
+        none = 1,
+        lzw = 5,
+        deflate = 8
+    };
+
+    enum class Predictor : uint16_t {
+        none = 1,
+        horizontal = 2,
+        floating_point = 3
+    };
 private:
     struct TIFFHeader {
         char byte_order[2] = { 'I','I' };
@@ -71,66 +88,6 @@ private:
 
         IFD() = default;
 
-        template <typename Image>
-        IFD(Image& img, ImageType type, bool planar_contig = true) {
-
-            uint16_t bytes = typeSize(type);
-            uint16_t bits = bytes * 8;
-
-            int offset = img.totalPxCount() * bytes + 8 + 2 + (12 * 14);
-
-            AddEntry(TIFFTAG::ImageWidth, FieldType::SHORT, 1, img.cols());
-            AddEntry(TIFFTAG::ImageLength, FieldType::SHORT, 1, img.rows());
-            AddEntry(TIFFTAG::Compression, FieldType::SHORT, 1, 1);
-
-            int photo = (img.channels() == 1) ? 1 : 2;
-            AddEntry(TIFFTAG::PhotometricInterpretation, FieldType::SHORT, 1, photo);
-            AddEntry(TIFFTAG::RowsPerStrip, FieldType::SHORT, 1, 1);
-
-            int res[2] = { 72,1 };
-            AddEntry(TIFFTAG::XResolution, FieldType::RATIONAL, 1, offset, (char*)res, 8);
-            offset += 8;
-            AddEntry(TIFFTAG::YResolution, FieldType::RATIONAL, 1, offset, (char*)res, 8);
-            offset += 8;
-            AddEntry(TIFFTAG::ResolutionUnit, FieldType::SHORT, 1, 2);
-
-            uint16_t sample_format = 1;
-            if (type == ImageType::FLOAT)
-                sample_format = 3;
-
-            if (img.channels() == 3) {
-                uint16_t bda[3] = { bits,bits,bits };
-                AddEntry(TIFFTAG::BitsPerSample, FieldType::SHORT, 3, offset, (char*)bda, 6);
-                offset += 6;
-                uint16_t sf[3] = { sample_format,sample_format,sample_format };
-                AddEntry(TIFFTAG::SampleFormat, FieldType::SHORT, 3, offset, (char*)sf, 6);
-                offset += 6;
-            }
-
-            else {
-                AddEntry(TIFFTAG::BitsPerSample, FieldType::SHORT, 1, bits);
-                AddEntry(TIFFTAG::SampleFormat, FieldType::SHORT, 1, sample_format);
-            }
-
-            //rgb cont correct
-            if (img.channels() == 1 || planar_contig) {
-                AddEntry(TIFFTAG::StripOffsets, FieldType::LONG, img.rows(), offset);
-                AddEntry(TIFFTAG::StripByteCounts, FieldType::LONG, img.rows(), offset + img.rows() * 4);
-                AddEntry(TIFFTAG::PlanarConfiguration, FieldType::SHORT, 1, (uint32_t)PlanarConfig::Contiguous);
-            }
-
-            //rgb sep correct
-            else {
-                AddEntry(TIFFTAG::StripOffsets, FieldType::LONG, img.rows() * img.channels(), offset);
-                AddEntry(TIFFTAG::StripByteCounts, FieldType::LONG, img.rows() * img.channels(), offset + (img.rows() * img.channels() * 4));
-                AddEntry(TIFFTAG::PlanarConfiguration, FieldType::SHORT, 1, (uint32_t)PlanarConfig::Seperate);
-            }
-
-
-            AddEntry(TIFFTAG::SamplesPerPixel, FieldType::SHORT, 1, img.channels());
-
-        }
-
         void AddEntry(TIFFTAG tag, FieldType type, uint32_t count, uint32_t value);
 
         void AddEntry(TIFFTAG tag, FieldType type, uint32_t count, uint32_t offset, char* value, uint32_t num_bytes);
@@ -149,9 +106,26 @@ private:
 
     PlanarConfig m_planar_config = PlanarConfig::Contiguous;
 
+    Codec m_codec = Codec::none;
+    Predictor m_predictor = Predictor::none;
+
+    //strips are chunks of image width, tiles are always stored full size
+    bool m_tiled = false;
+    uint32_t m_chunk_width = 0;
+    uint32_t m_chunk_height = 0;
+
+    //offsets and byte counts of the strips or tiles
     std::vector<uint32_t> m_strip_offsets;
     std::vector<uint32_t> m_strip_byte_counts;
 
+    //decoded chunks of the last chunk row, for scan line reads
+    int m_cached_chunk_row = -1;
+    std::vector<std::vector<uint8_t>> m_chunk_cache;
+
+    //strip size targeted when writing, large enough to keep the ifd small and compress well
+    static constexpr uint32_t m_write_strip_bytes = 1 << 18;
+    static constexpr uint32_t m_write_tile_size = 256;
+
     uint32_t dataPosition()const { return m_data_pos; }
 public:
     TIFF() : ImageFile(Type::TIFF) {}
@@ -164,6 +138,12 @@ public:
         byteswap = other.byteswap;
         m_planar_config = other.m_planar_config;
 
+        m_codec = other.m_codec;
+        m_predictor = other.m_predictor;
+        m_tiled = other.m_tiled;
+        m_chunk_width = other.m_chunk_width;
+        m_chunk_height = other.m_chunk_height;
+
         m_strip_offsets = std::move(other.m_strip_offsets);
         m_strip_byte_counts = std::move(other.m_strip_byte_counts);
 
@@ -178,18 +158,51 @@ public:
 
     PlanarConfig planarConfig()const { return m_planar_config; }
 
+    Codec codec()const { return m_codec; }
+
+    bool isTiled()const { return m_tiled; }
+
 private:
-    void getStripVectors();
+    //SHORT or LONG array, inline or at its offset
+    std::vector<uint32_t> readArray(TIFFTAG tag);
 
-    void makeStripVectors(ImageType type);
+    void getStripVectors();
 
     ImageType imageTypefromFile();
 
+    uint32_t chunksAcross()const { return (m_cols + m_chunk_width - 1) / m_chunk_width; }
+
+    uint32_t chunksDown()const { return (m_rows + m_chunk_height - 1) / m_chunk_height; }
+
+    uint32_t chunkCount()const { return chunksAcross() * chunksDown() * ((m_planar_config == PlanarConfig::Contiguous) ? 1 : m_channels); }
+
+    uint32_t chunkSamples()const { return (m_planar_config == PlanarConfig::Contiguous) ? m_channels : 1; }
+
+    //x, y, plane of the first pixel of the chunk
+    std::array<uint32_t, 3> chunkOrigin(int chunk)const;
+
+    uint32_t chunkRows(int chunk)const;
+
+    bool decodeChunk(int chunk, const std::vector<uint8_t>& src, std::vector<uint8_t>& dst)const;
+
+    //compressed chunks are read sequentially and decoded in parallel
+    void decodeChunks(const std::vector<int>& chunks, std::vector<std::vector<uint8_t>>& dst);
+
+    template<typename T>
+    void copyChunk(int chunk, const std::vector<uint8_t>& data, Image<T>& dst)const;
+
+    template<typename D, typename T>
+    std::vector<uint8_t> encodeChunk(const Image<T>& src, int chunk)const;
+
+    void makeIFD(uint32_t ifd_offset);
+
     const std::vector<uint32_t>& stripOffsets()const { return m_strip_offsets; }
 
     const std::vector<uint32_t>& stripByteCounts()const { return m_strip_byte_counts; }
 
 public:
+    bool hasTag(TIFFTAG tag)const;
+
     FieldType tiffType(TIFFTAG tag);
 
     uint32_t tiffCount(TIFFTAG tag);
@@ -204,15 +217,6 @@ public:
 
     void close() override;
 
-private:
-    template< typename T>
-    void readScanLine(T* buffer, uint32_t row, uint32_t channel = 0) {
-
-        m_stream.seekg(stripOffsets()[row] + (channel * pxCount()));
-        m_stream.read((char*)buffer, stripByteCounts()[row]);
-    }
-
-public:
     void readScanLine_toFloat(float* dst, uint32_t row, uint32_t channel = 0);
 
     template<typename T>
@@ -220,47 +224,8 @@ public:
 
     void readAny(Image32& dst);
 
-private:
-    template< typename T>
-    void writeScanLine(T* buffer, uint32_t row, uint32_t channel = 0) {
-
-        m_stream.seekp(m_strip_offsets[row] + channel * m_px_count * sizeof(T));
-        m_stream.write((char*)buffer, m_strip_byte_counts[row]);
-    }
-
-    template <typename D, typename T>
-    void writePixels_Seperate(const Image<T>& src) {
-
-        std::vector<D> buffer(m_cols);
-        for (int ch = 0; ch < m_channels; ++ch) {
-            for (int y = 0; y < m_rows; ++y) {
-                for (int x = 0; x < m_cols; ++x) {
-                    buffer[x] = Pixel<D>::toType(src(x, y, ch));
-                }
-                writeScanLine(buffer.data(), y);
-            }
-        }
-    }
-
-    template <typename D, typename T>
-    void writePixels_Contiguous(const Image<T>& src) {
-
-        std::vector<D> buffer(m_cols * m_channels);
-        for (int y = 0; y < m_rows; ++y) {
-            for (int x = 0, i = 0; x < m_cols; ++x) {
-
-                buffer[i++] = Pixel<D>::toType(src(x, y, 0));
-                buffer[i++] = Pixel<D>::toType(src(x, y, 1));
-                buffer[i++] = Pixel<D>::toType(src(x, y, 2));
-
-            }
-            writeScanLine(buffer.data(), y);
-        }
-    }
-
-public:
     template<typename T>
-    void write(const Image<T>& src, ImageType new_type, bool planar_contiguous = true);
+    void write(const Image<T>& src, ImageType new_type, bool planar_contiguous = true, Codec codec = Codec::none, bool tiled = false);
 };
 
 
@@ -1,6 +1,7 @@
 #pragma once
 #include "Image.h"
 #include "GaussianFilter.h"
+#include <mutex>
 //#include "ProcessDialog.h"
 
 class Wavelet {
@@ -25,13 +26,20 @@ private:
 	const std::vector<float>& scalingFunctionKernel(ScalingFunction sf) const;
 
 protected:
+	//source holds the smoothed image of the current scale (the residual after the last layer)
+	//wavelet holds the most recent layer, both buffers are reused for every scale
 	struct Images {
 		Image32 source;
-		Image32 convolved;
 		Image32 wavelet;
 
+		Images() = default;
+
+		template<typename T>
+		Images(const Image<T>& src, bool to_grayscale = false);
+
+		//reallocates only if src differs in shape from the current buffers
 		template<typename T>
-		Images(const Image<T> src, bool to_grayscale = false);
+		void load(const Image<T>& src, bool to_grayscale = false);
 	};
 
 public:
@@ -61,12 +69,27 @@ public:
 
 	void setLayers(int layers) { m_layers = layers; }
 
+	//layer image is only valid during the call and may be modified
+	using LayerFunction = std::function<void(int layer, Image32& wavelet)>;
+
+	//calls func with each wavelet layer in turn, then with the residual (layer == layers()) if requested
+	//memory use is two image buffers regardless of layer count
+	template<typename T>
+	void transform(const Image<T>& src, const LayerFunction& func, bool residual = false, bool to_grayscale = false);
+
 protected:
 	void atrous(uint8_t layer, Images& images);
 
-	void LinearNoiseReduction(float threshold = 3, float amount = 1);
+	void transform(Images& images, const LayerFunction& func, bool residual = false);
+
+	//k-sigma clipped standard deviation of a zero mean layer, large layers are sampled
+	static double kSigma(const Image32& img, int ch, float K = 3.0f, float eps = 0.01f, int n = 10);
 
-	void MedianNoiseReduction(float threshold = 3, float amount = 1);
+	//coefficients below threshold are attenuated by amount, the rest are shrunk by threshold
+	static void LinearNoiseReduction(Image32& wavelet, int ch, float threshold = 3, float amount = 1);
+
+	//coefficients below threshold are attenuated by amount, the rest are kept
+	static void MedianNoiseReduction(Image32& wavelet, int ch, float threshold = 3, float amount = 1);
 
 };
 
@@ -95,11 +118,85 @@ public:
 
 	void setSigmaK(float K) { m_K = K; }
 
+	template<typename T>
+	Image8Vector generateMaps(const Image<T>& img);
+};
+
+
+
+
+
+class WaveletNoiseReduction : public Wavelet {
+
+public:
+	enum class Method {
+		linear,
+		median
+	};
+
+	struct LayerParameters {
+		bool enabled = true;
+		float threshold = 3.0f; //in units of the layer's k-sigma noise estimate
+		float amount = 1.0f;
+	};
+
 private:
-	double kSigma(const Image32& img, float K = 3.0f, float eps = 0.01f, int n = 10);
+	struct Buffers {
+		Images images;
+		Image32 reconstruction;
+	};
+
+	//decomposition buffers kept between applies, reallocated only when the image shape changes
+	//copies made for preview threads share the pool, but each running apply takes a set of its own
+	class BufferPool {
+		std::mutex m_mutex;
+		std::unique_ptr<Buffers> m_free;
+
+	public:
+		std::unique_ptr<Buffers> acquire() {
+			std::lock_guard lock(m_mutex);
+			return (m_free) ? std::move(m_free) : std::make_unique<Buffers>();
+		}
+
+		//keeps a single set, buffers of overlapping jobs beyond that are freed
+		void release(std::unique_ptr<Buffers>&& buffers) {
+			std::lock_guard lock(m_mutex);
+			m_free = std::move(buffers);
+		}
+	};
+
+	Method m_method = Method::linear;
+	float m_K = 3.0f;
+
+	std::array<LayerParameters, 6> m_layer_params = { {{true, 3.0f, 1.0f}, {true, 2.0f, 1.0f}, {true, 1.0f, 1.0f}, {true, 0.5f, 1.0f}, {false, 0.5f, 1.0f}, {false, 0.5f, 1.0f}} };
+
+	std::shared_ptr<BufferPool> m_buffers = std::make_shared<BufferPool>();
+
+public:
+	WaveletNoiseReduction() { setLayers(4); }
+
+	static constexpr int maxLayers() { return 6; }
+
+	Method method()const { return m_method; }
+
+	void setMethod(Method method) { m_method = method; }
+
+	float sigmaK()const { return m_K; }
+
+	void setSigmaK(float K) { m_K = K; }
+
+	const LayerParameters& layerParameters(int layer)const { return m_layer_params[layer]; }
+
+	void setLayerEnabled(int layer, bool enabled) { m_layer_params[layer].enabled = enabled; }
+
+	void setLayerThreshold(int layer, float threshold) { m_layer_params[layer].threshold = threshold; }
+
+	void setLayerAmount(int layer, float amount) { m_layer_params[layer].amount = amount; }
+
+private:
+	void reduceNoise(Image32& wavelet, const LayerParameters& lp)const;
 
 public:
 	template<typename T>
-	Image8Vector generateMaps(const Image<T>& img);
+	void apply(Image<T>& img);
 };
-
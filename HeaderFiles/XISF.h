@@ -0,0 +1,136 @@
+#pragma once
+#include "ImageFile.h"
+#include "Image.h"
+#include "Compression.h"
+#include <deque>
+
+class XISF : public ImageFile {
+
+public:
+	enum class SampleFormat : uint8_t {
+		UInt8,
+		UInt16,
+		UInt32,
+		Float32,
+		Float64
+	};
+
+	enum class PixelStorage : uint8_t {
+		planar,
+		normal
+	};
+
+private:
+	//independently compressed piece of the data block
+	struct Subblock {
+		uint64_t compressed_size = 0;
+		uint64_t size = 0;
+		uint64_t position = 0; //in file
+		uint64_t offset = 0; //in uncompressed block
+	};
+
+	SampleFormat m_sample_format = SampleFormat::UInt8;
+	PixelStorage m_pixel_storage = PixelStorage::planar;
+	bool m_big_endian = false;
+	uint32_t m_file_channels = 1;
+	std::array<double, 2> m_bounds = { 0.0, 1.0 };
+
+	uint64_t m_block_pos = 0;
+	uint64_t m_block_size = 0;
+	uint64_t m_uncompressed_size = 0;
+
+	Compression::Codec m_codec = Compression::Codec::none;
+	bool m_byte_shuffle = false;
+	uint32_t m_item_size = 1;
+	std::vector<Subblock> m_subblocks;
+
+	//recently decompressed subblocks for row reads, oldest first
+	std::deque<std::pair<int, std::vector<uint8_t>>> m_subblock_cache;
+	size_t m_cached_bytes = 0;
+
+	//budget shared by every open file, stacking keeps all of its frames open at once
+	//each file evicts only its own subblocks and always keeps the one being read
+	static constexpr size_t m_max_cached_bytes = 256 << 20;
+	inline static std::atomic<size_t> m_shared_cached_bytes = 0;
+
+	//subblock size used when writing, small enough that a row read only decompresses a few
+	static constexpr size_t m_write_subblock_size = 1 << 20;
+
+public:
+	XISF() : ImageFile(Type::XISF) {}
+
+	XISF(XISF&& other) noexcept : ImageFile(std::move(other)) {
+
+		m_sample_format = other.m_sample_format;
+		m_pixel_storage = other.m_pixel_storage;
+		m_big_endian = other.m_big_endian;
+		m_file_channels = other.m_file_channels;
+		m_bounds = other.m_bounds;
+
+		m_block_pos = other.m_block_pos;
+		m_block_size = other.m_block_size;
+		m_uncompressed_size = other.m_uncompressed_size;
+
+		m_codec = other.m_codec;
+		m_byte_shuffle = other.m_byte_shuffle;
+		m_item_size = other.m_item_size;
+		m_subblocks = std::move(other.m_subblocks);
+	}
+
+	~XISF() { clearSubblockCache(); }
+
+	static bool isXISF(std::filesystem::path file_name) {
+
+		std::string ext = file_name.extension().string();
+
+		return (ext == ".xisf");
+	}
+
+	bool isXISFFile();
+
+	SampleFormat sampleFormat()const { return m_sample_format; }
+
+	Compression::Codec codec()const { return m_codec; }
+
+private:
+	size_t sampleSize()const;
+
+	bool readHeader(const QByteArray& xml);
+
+	QByteArray writeHeader(ImageType type, uint64_t position, uint64_t size, const QString& compression, const QString& subblocks)const;
+
+	std::vector<uint8_t> decompressSubblock(int index);
+
+	const std::vector<uint8_t>& subblock(int index);
+
+	void clearSubblockCache();
+
+	void readUncompressed(uint64_t offset, uint64_t size, uint8_t* dst);
+
+	//reads count samples starting at sample index first
+	void readSamples(uint64_t first, uint64_t count, uint8_t* dst);
+
+	std::vector<uint8_t> readBlock();
+
+	void swapBytes(uint8_t* data, size_t count)const;
+
+	template<typename T>
+	void convertSamples(const uint8_t* src, T* dst, size_t count, size_t stride)const;
+
+public:
+	void open(std::filesystem::path path) override;
+
+	void create(std::filesystem::path path) override;
+
+	void close() override;
+
+	template<typename T>
+	void read(Image<T>& dst);
+
+	void readAny(Image32& dst);
+
+	void readRow_toFloat(float* dst, uint32_t row, uint32_t channel);
+
+	template <typename T>
+	void write(const Image<T>& src, ImageType new_type, Compression::Codec codec = Compression::Codec::none, bool byte_shuffle = true);
+};
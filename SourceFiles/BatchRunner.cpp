@@ -0,0 +1,434 @@
+#include "pch.h"
+#include "BatchRunner.h"
+#include "Drizzle.h"
+#include "FITS.h"
+#include "TIFF.h"
+#include "XISF.h"
+#include "ThreadPool.h"
+#include <iomanip>
+
+namespace {
+
+	std::string trim(const std::string& str) {
+
+		size_t first = str.find_first_not_of(" \t\r");
+		if (first == std::string::npos)
+			return "";
+
+		size_t last = str.find_last_not_of(" \t\r");
+		return str.substr(first, last - first + 1);
+	}
+
+	std::string lower(std::string str) {
+		std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return std::tolower(c); });
+		return str;
+	}
+
+	template<typename E, size_t N>
+	bool parseEnum(const std::string& value, const std::array<const char*, N>& names, E& e) {
+
+		for (size_t i = 0; i < N; ++i) {
+			if (value == names[i]) {
+				e = E(i);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool parseBool(const std::string& value, bool& b) {
+
+		if (value == "true" || value == "yes" || value == "1")
+			b = true;
+		else if (value == "false" || value == "no" || value == "0")
+			b = false;
+		else
+			return false;
+
+		return true;
+	}
+
+	template<typename T>
+	bool parseNumber(const std::string& value, T& number, double min, double max) {
+
+		try {
+			size_t end = 0;
+			double v = std::stod(value, &end);
+			if (end != value.size() || v < min || v > max)
+				return false;
+			number = T(v);
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+
+		return true;
+	}
+
+	bool isImageFile(const std::filesystem::path& path) {
+		return FITS::isFITS(path) || TIFF::isTIFF(path) || XISF::isXISF(path);
+	}
+
+	//a directory stands for the files in it that accept() takes, in name order
+	void addPaths(const std::filesystem::path& path, PathVector& paths, bool(*accept)(const std::filesystem::path&)) {
+
+		if (!std::filesystem::is_directory(path))
+			return paths.push_back(path);
+
+		PathVector files;
+		for (auto& entry : std::filesystem::directory_iterator(path))
+			if (entry.is_regular_file() && accept(entry.path()))
+				files.push_back(entry.path());
+
+		std::sort(files.begin(), files.end());
+		paths.insert(paths.end(), files.begin(), files.end());
+	}
+
+	Status writeImage(const Image32& img, const std::filesystem::path& path) {
+
+		if (path.has_parent_path())
+			std::filesystem::create_directories(path.parent_path());
+
+		//create adds the extension back
+		auto stem = std::filesystem::path(path).replace_extension();
+
+		if (FITS::isFITS(path)) {
+			FITS fits;
+			fits.create(stem);
+			fits.write(img, ImageType::FLOAT);
+		}
+
+		else if (XISF::isXISF(path)) {
+			XISF xisf;
+			xisf.create(stem);
+			xisf.write(img, ImageType::FLOAT);
+		}
+
+		else if (TIFF::isTIFF(path)) {
+			TIFF tiff;
+			tiff.create(stem);
+			tiff.write(img, ImageType::FLOAT);
+		}
+
+		if (!std::filesystem::exists(path))
+			return { false, QString("Could not write ") + path.string().c_str() };
+
+		return Status();
+	}
+
+	std::string megabytes(size_t bytes) {
+		std::ostringstream ss;
+		ss << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MB";
+		return ss.str();
+	}
+}
+
+Status BatchRunner::parseJobFile(const std::filesystem::path& job_file, std::vector<Job>& jobs) {
+
+	std::ifstream stream(job_file);
+	if (!stream)
+		return { false, QString("Could not open job file ") + job_file.string().c_str() };
+
+	auto dir = job_file.parent_path();
+
+	std::string line;
+	int line_no = 0;
+
+	auto error = [&](const std::string& message) {
+		return Status(false, QString::fromStdString(job_file.filename().string() + " line " + std::to_string(line_no) + ": " + message));
+	};
+
+	while (std::getline(stream, line)) {
+		line_no++;
+
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty())
+			continue;
+
+		if (line.front() == '[') {
+			if (line.back() != ']' || line.size() == 2)
+				return error("expected [job name]");
+
+			jobs.emplace_back();
+			jobs.back().name = trim(line.substr(1, line.size() - 2));
+			continue;
+		}
+
+		size_t eq = line.find('=');
+		if (eq == std::string::npos)
+			return error("expected key = value");
+
+		if (jobs.empty())
+			return error("setting outside a [job]");
+
+		Job& job = jobs.back();
+		std::string key = lower(trim(line.substr(0, eq)));
+		std::string value = trim(line.substr(eq + 1));
+		std::string lvalue = lower(value);
+
+		auto path = [&]() { return std::filesystem::path(value).is_absolute() ? std::filesystem::path(value) : dir / value; };
+
+		bool ok = true;
+
+		if (key == "process")
+			ok = parseEnum(lvalue, std::array{ "integration", "stacking", "drizzle" }, job.process);
+
+		else if (key == "light")
+			addPaths(path(), job.lights, isImageFile);
+
+		else if (key == "alignment")
+			addPaths(path(), job.alignments, [](const std::filesystem::path& p) { return p.extension() == ".info"; });
+
+		else if (key == "weight_map")
+			addPaths(path(), job.weight_maps, [](const std::filesystem::path& p) { return p.extension() == ".wmi"; });
+
+		else if (key == "dark")
+			job.dark = path();
+
+		else if (key == "flat")
+			job.flat = path();
+
+		else if (key == "output") {
+			job.output = path();
+			auto ext = job.output.extension();
+			ok = (ext == ".fits" || ext == ".xisf" || ext == ".tiff");
+			if (!ok)
+				return error("output must end in .fits, .xisf or .tiff");
+		}
+
+		else if (key == "integration")
+			ok = parseEnum(lvalue, std::array{ "average", "median", "min", "max" }, job.integration);
+
+		else if (key == "normalization")
+			ok = parseEnum(lvalue, std::array{ "none", "additive", "multiplicative", "additive_scaling", "multiplicative_scaling" }, job.normalization);
+
+		else if (key == "rejection")
+			ok = parseEnum(lvalue, std::array{ "none", "sigma_clip", "winsorized_sigma_clip", "percentile_clip" }, job.rejection);
+
+		else if (key == "sigma_low")
+			ok = parseNumber(value, job.sigma_low, 0, 10);
+
+		else if (key == "sigma_high")
+			ok = parseNumber(value, job.sigma_high, 0, 10);
+
+		else if (key == "max_stars")
+			ok = parseNumber(value, job.max_stars, 1, 65535);
+
+		else if (key == "weight_maps")
+			ok = parseBool(lvalue, job.generate_weight_maps);
+
+		else if (key == "drop_size")
+			ok = parseNumber(value, job.drop_size, 0.1, 1.0);
+
+		else if (key == "scale_factor")
+			ok = parseNumber(value, job.scale_factor, 2, 8);
+
+		else if (key == "threads")
+			ok = parseNumber(value, job.threads, 0, 1024);
+
+		else
+			return error("unknown key " + key);
+
+		if (!ok)
+			return error("invalid value for " + key + ": " + value);
+	}
+
+	for (auto& job : jobs) {
+		if (job.lights.empty())
+			return { false, QString::fromStdString("Job " + job.name + " has no lights.") };
+
+		if (job.output.empty())
+			return { false, QString::fromStdString("Job " + job.name + " has no output.") };
+	}
+
+	return Status();
+}
+
+int BatchRunner::run(const std::vector<Job>& jobs) {
+
+	int failed = 0;
+
+	for (auto& job : jobs) {
+		Status s = runJob(job);
+		if (!s) {
+			failed++;
+			*m_log << "[" << job.name << "] failed: " << s.m_message.toStdString() << std::endl;
+		}
+	}
+
+	*m_log << jobs.size() - failed << " of " << jobs.size() << " jobs succeeded" << std::endl;
+
+	return failed;
+}
+
+Status BatchRunner::runJob(const Job& job) {
+
+	ThreadPool::setThreadCount((job.threads != 0) ? job.threads : std::thread::hardware_concurrency());
+
+	std::array<const char*, 3> names = { "integration", "stacking", "drizzle" };
+	*m_log << "[" << job.name << "] " << names[int(job.process)] << " of " << job.lights.size() << " frames on " << ThreadPool::threadCount() << " threads" << std::endl;
+
+	StageTimer timer;
+	Image32 output;
+	Status s;
+
+	auto start = std::chrono::steady_clock::now();
+
+	try {
+		switch (job.process) {
+		case Process::integration:
+			s = integrate(job, output, timer);
+			break;
+
+		case Process::stacking:
+			s = stack(job, output, timer);
+			break;
+
+		case Process::drizzle:
+			s = drizzle(job, output, timer);
+			break;
+		}
+
+		if (s) {
+			StageTimer::Scope stage(&timer, "output write");
+			s = writeImage(output, job.output);
+		}
+	}
+	catch (const std::exception& e) {
+		s = { false, e.what() };
+	}
+
+	if (s)
+		writeReport(job, timer, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+	return s;
+}
+
+int BatchRunner::runFile(const std::filesystem::path& job_file) {
+
+	std::vector<Job> jobs;
+
+	Status s = parseJobFile(job_file, jobs);
+	if (!s) {
+		*m_log << s.m_message.toStdString() << std::endl;
+		return 2;
+	}
+
+	return (run(jobs) == 0) ? 0 : 1;
+}
+
+Status BatchRunner::integrate(const Job& job, Image32& output, StageTimer& timer) {
+
+	ImageIntegrationProcess iip;
+
+	iip.setPaths(job.lights, job.alignments);
+	iip.setMaxStars(job.max_stars);
+	iip.setGenerateWeightMaps(job.generate_weight_maps);
+	iip.setStageTimer(&timer);
+
+	ImageCalibrator& calibrator = iip.imageCalibrator();
+	calibrator.setMasterDarkPath(job.dark);
+	calibrator.setMasterFlatPath(job.flat);
+	calibrator.setApplyMasterDark(!job.dark.empty());
+	calibrator.setApplyMasterFlat(!job.flat.empty());
+
+	ImageStacking& is = iip.imageStacker();
+	is.setIntegrationMethod(job.integration);
+	is.setNormalation(job.normalization);
+	is.setRejectionMethod(job.rejection);
+	is.setSigmaLow(job.sigma_low);
+	is.setSigmaHigh(job.sigma_high);
+
+	connectSignals(job, iip.imageStackingSignal());
+	connectSignals(job, is.imageStackingSignal());
+
+	return iip.integrateImages(output);
+}
+
+Status BatchRunner::stack(const Job& job, Image32& output, StageTimer& timer) {
+
+	ImageStacking is;
+
+	is.setIntegrationMethod(job.integration);
+	is.setNormalation(job.normalization);
+	is.setRejectionMethod(job.rejection);
+	is.setSigmaLow(job.sigma_low);
+	is.setSigmaHigh(job.sigma_high);
+	is.setStageTimer(&timer);
+
+	connectSignals(job, is.imageStackingSignal());
+
+	if (job.generate_weight_maps)
+		return ImageStackingWeightMap(is).stackImages(job.lights, output, job.lights[0].parent_path());
+
+	return is.stackImages(job.lights, output);
+}
+
+Status BatchRunner::drizzle(const Job& job, Image32& output, StageTimer& timer) {
+
+	//the first light is the reference, every later one needs its alignment
+	if (job.alignments.size() + 1 < job.lights.size())
+		return { false, "Missing alignment data for some lights." };
+
+	DrizzleIntegrationProcesss dip;
+
+	dip.setLightPaths(job.lights);
+	dip.setAlignmentPaths(job.alignments);
+	dip.setWeightPaths(job.weight_maps);
+	dip.setStageTimer(&timer);
+
+	dip.drizzle().setDropSize(job.drop_size);
+	dip.drizzle().setScaleFactor(job.scale_factor);
+
+	ImageCalibrator& calibrator = dip.imageCalibrator();
+	calibrator.setMasterDarkPath(job.dark);
+	calibrator.setMasterFlatPath(job.flat);
+	calibrator.setApplyMasterDark(!job.dark.empty());
+	calibrator.setApplyMasterFlat(!job.flat.empty());
+
+	connectSignals(job, dip.imageStackingSignal());
+
+	return dip.drizzleImages(output);
+}
+
+void BatchRunner::connectSignals(const Job& job, const ImageStackingSignal* iss) {
+
+	std::string prefix = "[" + job.name + "] ";
+
+	//no receiver object, so the slots run directly on the processing thread
+	QObject::connect(iss, &ImageStackingSignal::emitText, [this, prefix](const QString& txt) {
+		*m_log << prefix << txt.toStdString() << std::endl;
+		});
+
+	QObject::connect(iss, &ImageStackingSignal::emitPSFData, [this, prefix](uint16_t size, const PSF&) {
+		*m_log << prefix << size << " stars" << std::endl;
+		});
+
+	//progress comes every row, only every tenth percent is logged
+	auto last = std::make_shared<int>(-10);
+	QObject::connect(iss, &ImageStackingSignal::emitProgress, [this, prefix, last](int progress) {
+		if (progress / 10 == *last / 10)
+			return;
+		*last = progress;
+		*m_log << prefix << progress << "%" << std::endl;
+		});
+}
+
+void BatchRunner::writeReport(const Job& job, const StageTimer& timer, double seconds) {
+
+	std::string prefix = "[" + job.name + "] ";
+	auto& log = *m_log;
+
+	log << prefix << "finished in " << std::fixed << std::setprecision(2) << seconds << " s, wrote " << job.output.string() << "\n";
+	log << prefix << std::left << std::setw(18) << "stage" << std::right << std::setw(8) << "calls" << std::setw(12) << "time" << std::setw(16) << "peak image mem" << "\n";
+
+	for (auto& stage : timer.stages())
+		log << prefix << std::left << std::setw(18) << stage.name << std::right << std::setw(8) << stage.calls
+			<< std::setw(10) << stage.seconds << " s" << std::setw(16) << megabytes(stage.peak_bytes) << "\n";
+
+	log << prefix << "peak process memory " << megabytes(StageTimer::peakProcessMemory()) << std::endl;
+
+	log.unsetf(std::ios::floatfield);
+	log << std::setprecision(6);
+}
@@ -0,0 +1,367 @@
+#include "pch.h"
+#include "Benchmark.h"
+#include "ImageIntegrationProcess.h"
+#include "StarMatching.h"
+#include "Homography.h"
+#include "ImageGeometry.h"
+#include "GaussianFilter.h"
+#include "MorphologicalTransformation.h"
+#include "ThreadPool.h"
+#include "FITS.h"
+#include "TIFF.h"
+#include <iomanip>
+
+namespace {
+
+	//a dithered frame, rotated by a third of a degree
+	const StarField::Placement dither = { 12.3, -7.8, math::degreesToRadians(0.35) };
+
+	std::string quoted(const std::string& str) {
+		return "\"" + str + "\"";
+	}
+
+	std::string compiler() {
+#if defined(_MSC_VER)
+		return "msvc " + std::to_string(_MSC_VER);
+#elif defined(__VERSION__)
+		return __VERSION__;
+#else
+		return "unknown";
+#endif
+	}
+
+	//largest distance between where h and the true placement put a grid of points across the frame
+	double registrationError(const Matrix& h, const Matrix& truth, uint32_t rows, uint32_t cols) {
+
+		double error = 0;
+
+		for (int j = 0; j <= 2; ++j) {
+			for (int i = 0; i <= 2; ++i) {
+				double x = i * (cols - 1) / 2.0;
+				double y = j * (rows - 1) / 2.0;
+
+				double hz = h(2, 0) * x + h(2, 1) * y + h(2, 2);
+				double hx = (h(0, 0) * x + h(0, 1) * y + h(0, 2)) / hz;
+				double hy = (h(1, 0) * x + h(1, 1) * y + h(1, 2)) / hz;
+
+				double tx = truth(0, 0) * x + truth(0, 1) * y + truth(0, 2);
+				double ty = truth(1, 0) * x + truth(1, 1) * y + truth(1, 2);
+
+				error = math::max(error, sqrt((hx - tx) * (hx - tx) + (hy - ty) * (hy - ty)));
+			}
+		}
+
+		return error;
+	}
+
+	double rmsDifference(const Image32& a, const Image32& b) {
+
+		double sum = 0;
+		for (size_t i = 0; i < a.totalPxCount(); ++i) {
+			double d = a.data()[i] - b.data()[i];
+			sum += d * d;
+		}
+
+		return sqrt(sum / a.totalPxCount());
+	}
+}
+
+Benchmark::Result& Benchmark::Result::add(const std::string& key, const std::string& value) {
+	fields.emplace_back(key, quoted(value));
+	return *this;
+}
+
+Benchmark::Result& Benchmark::Result::add(const std::string& key, double value) {
+
+	//json has no nan or infinity
+	if (!std::isfinite(value)) {
+		fields.emplace_back(key, "null");
+		return *this;
+	}
+
+	std::ostringstream ss;
+	ss << std::setprecision(6) << value;
+	fields.emplace_back(key, ss.str());
+	return *this;
+}
+
+template<typename Setup, typename Func>
+void Benchmark::measure(Result& result, uint32_t iterations, Setup&& setup, Func&& func) {
+
+	setup();
+	func();
+
+	for (uint32_t i = 0; i < iterations; ++i) {
+		setup();
+		auto start = std::chrono::steady_clock::now();
+		func();
+		result.ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+}
+
+void Benchmark::write(const Result& result) {
+
+	std::vector<double> ms = result.ms;
+	std::sort(ms.begin(), ms.end());
+
+	double mean = 0;
+	for (auto t : ms)
+		mean += t;
+
+	Result r = result;
+	r.add("iterations", ms.size());
+
+	if (!ms.empty()) {
+		r.add("min_ms", ms.front());
+		r.add("median_ms", ms[ms.size() / 2]);
+		r.add("mean_ms", mean / ms.size());
+	}
+
+	*m_out << "{" << quoted("benchmark") << ":" << quoted(r.name);
+	for (auto& [key, value] : r.fields)
+		*m_out << "," << quoted(key) << ":" << value;
+	*m_out << "}" << std::endl;
+
+	std::clog << std::left << std::setw(24) << r.name;
+	for (auto& [key, value] : result.fields)
+		std::clog << " " << key << "=" << value;
+	if (!ms.empty())
+		std::clog << "  " << std::fixed << std::setprecision(2) << ms[ms.size() / 2] << " ms";
+	std::clog << std::defaultfloat << std::endl;
+}
+
+void Benchmark::registration(const StarField& field) {
+
+	const auto& p = field.parameters();
+
+	Image32 ref = field.frame();
+	Image32 tgt = field.frame(dither, 1);
+
+	StarDetector sd;
+	StarVector ref_sv, tgt_sv;
+
+	Result detection("star_detection");
+	measure(detection, m_options.iterations, [] {}, [&] { ref_sv = sd.DAOFIND(ref); });
+	detection.add("rows", p.rows).add("cols", p.cols).add("true_stars", p.star_count).add("stars", ref_sv.size());
+	write(detection);
+
+	tgt_sv = sd.DAOFIND(tgt);
+
+	//as many as integration matches
+	ref_sv.shrink_to_size(200);
+	tgt_sv.shrink_to_size(200);
+
+	StarMatching sm;
+	StarPairVector spv;
+
+	Result matching("star_matching");
+	measure(matching, m_options.iterations, [] {}, [&] { spv = sm.matchStars(ref_sv, tgt_sv); });
+	matching.add("stars", ref_sv.size()).add("pairs", spv.size());
+	write(matching);
+
+	Matrix h;
+
+	//ransac draws from rand, seeding it gives every run the same draws
+	Result homography("homography");
+	measure(homography, m_options.iterations, [] { srand(1); }, [&] { h = Homography::computeHomography(spv); });
+	homography.add("pairs", spv.size()).add("error_px", registrationError(h, field.placementMatrix(dither), p.rows, p.cols));
+	write(homography);
+}
+
+void Benchmark::interpolation(const StarField& field) {
+
+	Image32 tgt = field.frame(dither, 1);
+	Image32 img;
+
+	std::array<const char*, 7> names = { "nearest_neighbor", "bilinear", "bicubic_spline", "bicubic_b_spline", "cubic_b_spline", "catmull_rom", "lanczos3" };
+
+	for (int i = 0; i < names.size(); ++i) {
+
+		HomographyTransformation ht;
+		ht.setHomography(field.placementMatrix(dither));
+		ht.setInterpolationType(Interpolator::Type(i));
+
+		Result result("interpolation");
+		measure(result, m_options.iterations, [&] { img = Image32(tgt); }, [&] { ht.apply(img); });
+		result.add("type", names[i]).add("rows", img.rows()).add("cols", img.cols());
+		write(result);
+	}
+}
+
+void Benchmark::filters(const StarField& field) {
+
+	Image32 src = field.frame();
+	Image32 img;
+
+	for (float sigma : { 2.0f, 10.0f }) {
+		GaussianFilter gf(sigma);
+
+		Result result("gaussian_filter");
+		measure(result, m_options.iterations, [&] { img = Image32(src); }, [&] { gf.apply(img); });
+		result.add("sigma", sigma).add("rows", img.rows()).add("cols", img.cols());
+		write(result);
+	}
+
+	using Type = MorphologicalTransformation::Type;
+	std::array<std::pair<Type, const char*>, 5> types = { {
+		{ Type::erosion, "erosion" },
+		{ Type::dialation, "dialation" },
+		{ Type::opening, "opening" },
+		{ Type::median, "median" },
+		{ Type::selection, "selection" } } };
+
+	for (auto& [type, name] : types) {
+		for (int dim : { 5, 15 }) {
+			MorphologicalTransformation mt(type);
+			mt.resizeKernel(dim);
+			mt.setMask_All(true);
+
+			Result result("morphology");
+			measure(result, m_options.iterations, [&] { img = Image32(src); }, [&] { mt.apply(img); });
+			result.add("type", name).add("kernel", dim).add("rows", img.rows()).add("cols", img.cols());
+			write(result);
+		}
+	}
+}
+
+void Benchmark::fileIO(const StarField& field) {
+
+	Image32 src = field.frame();
+	Image32 dst;
+
+	TempFolder temp("FastStackBenchmark");
+	auto stem = temp.folderPath() / "frame";
+
+	auto fileSize = [](const std::filesystem::path& path) { return double(std::filesystem::file_size(path)); };
+
+	struct FITSCase { FITS::TileCodec codec; ImageType type; const char* name; };
+	std::array<FITSCase, 3> fits_cases = { {
+		{ FITS::TileCodec::none, ImageType::FLOAT, "none" },
+		{ FITS::TileCodec::gzip, ImageType::FLOAT, "gzip" },
+		{ FITS::TileCodec::rice, ImageType::USHORT, "rice" } } };
+
+	for (auto& c : fits_cases) {
+		auto path = std::filesystem::path(stem) += ".fits";
+
+		Result write_result("fits_write");
+		measure(write_result, m_options.iterations, [] {}, [&] { FITS fits; fits.create(stem); fits.write(src, c.type, c.codec); });
+		write_result.add("codec", c.name).add("bits", (c.type == ImageType::FLOAT) ? 32 : 16).add("bytes", fileSize(path));
+		write(write_result);
+
+		Result read_result("fits_read");
+		measure(read_result, m_options.iterations, [] {}, [&] { FITS fits; fits.open(path); fits.readAny(dst); });
+		read_result.add("codec", c.name).add("bits", (c.type == ImageType::FLOAT) ? 32 : 16).add("bytes", fileSize(path));
+		write(read_result);
+	}
+
+	struct TIFFCase { TIFF::Codec codec; ImageType type; const char* name; };
+	std::array<TIFFCase, 3> tiff_cases = { {
+		{ TIFF::Codec::none, ImageType::FLOAT, "none" },
+		{ TIFF::Codec::deflate, ImageType::FLOAT, "deflate" },
+		{ TIFF::Codec::lzw, ImageType::USHORT, "lzw" } } };
+
+	for (auto& c : tiff_cases) {
+		auto path = std::filesystem::path(stem) += ".tiff";
+
+		Result write_result("tiff_write");
+		measure(write_result, m_options.iterations, [] {}, [&] { TIFF tiff; tiff.create(stem); tiff.write(src, c.type, true, c.codec); });
+		write_result.add("codec", c.name).add("bits", (c.type == ImageType::FLOAT) ? 32 : 16).add("bytes", fileSize(path));
+		write(write_result);
+
+		Result read_result("tiff_read");
+		measure(read_result, m_options.iterations, [] {}, [&] { TIFF tiff; tiff.open(path); tiff.readAny(dst); });
+		read_result.add("codec", c.name).add("bits", (c.type == ImageType::FLOAT) ? 32 : 16).add("bytes", fileSize(path));
+		write(read_result);
+	}
+}
+
+void Benchmark::stacking() {
+
+	StarField::Parameters params;
+	params.rows = params.cols = m_options.stacking_size;
+	params.star_count = 400;
+
+	StarField field(params);
+
+	//the noiseless frame the stack should come back to
+	params.noise = 0;
+	params.hot_pixels = 0;
+	Image32 truth = StarField(params).frame();
+
+	uint32_t max_frames = *std::max_element(m_options.frame_counts.begin(), m_options.frame_counts.end());
+
+	TempFolder temp("FastStackBenchmark");
+	for (uint32_t i = 0; i < max_frames; ++i)
+		temp.writeTempFits(field.frame(StarField::Placement(), i), "frame" + std::to_string(i));
+
+	using Rejection = ImageStacking::Rejection;
+	using Integration = ImageStacking::Integration;
+
+	struct Case { Integration integration; Rejection rejection; const char* integration_name; const char* rejection_name; };
+	std::array<Case, 5> cases = { {
+		{ Integration::average, Rejection::none, "average", "none" },
+		{ Integration::average, Rejection::sigma_clip, "average", "sigma_clip" },
+		{ Integration::average, Rejection::winsorized_sigma_clip, "average", "winsorized_sigma_clip" },
+		{ Integration::average, Rejection::percintile_clip, "average", "percentile_clip" },
+		{ Integration::median, Rejection::none, "median", "none" } } };
+
+	for (auto& c : cases) {
+		for (uint32_t count : m_options.frame_counts) {
+
+			FileVector paths(temp.filePaths().begin(), temp.filePaths().begin() + count);
+
+			ImageStacking is;
+			is.setIntegrationMethod(c.integration);
+			is.setRejectionMethod(c.rejection);
+
+			Image32 output;
+
+			Result result("stacking");
+			measure(result, m_options.stacking_iterations, [] {}, [&] { is.stackImages(paths, output); });
+			result.add("integration", c.integration_name).add("rejection", c.rejection_name).add("frames", count)
+				.add("rows", params.rows).add("cols", params.cols).add("residual_rms", rmsDifference(output, truth));
+			write(result);
+		}
+	}
+}
+
+int Benchmark::run(std::ostream& out) {
+
+	m_out = &out;
+
+	Result environment("environment");
+	environment.add("threads", ThreadPool::threadCount()).add("compiler", compiler());
+	write(environment);
+
+	try {
+		StarField::Parameters params;
+		params.rows = params.cols = m_options.size;
+		StarField field(params);
+
+		registration(field);
+		interpolation(field);
+		filters(field);
+		fileIO(field);
+		stacking();
+	}
+	catch (const std::exception& e) {
+		std::clog << "benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+int Benchmark::runToFile(const std::filesystem::path& path) {
+
+	if (path.empty())
+		return run(std::cout);
+
+	std::ofstream stream(path);
+	if (!stream) {
+		std::clog << "could not open " << path.string() << std::endl;
+		return 1;
+	}
+
+	return run(stream);
+}
@@ -0,0 +1,1012 @@
+#include "pch.h"
+#include "Compression.h"
+#include "Maths.h"
+
+std::vector<uint8_t> Compression::compress(Codec codec, const uint8_t* src, size_t size) {
+
+	switch (codec) {
+	case Codec::zlib: {
+		//qCompress prefixes the zlib stream with the big endian uncompressed size
+		QByteArray data = qCompress(src, size);
+		return std::vector<uint8_t>(data.begin() + 4, data.end());
+	}
+	case Codec::lz4:
+		return lz4Compress(src, size, 1);
+
+	case Codec::lz4hc:
+		return lz4Compress(src, size, 64);
+
+	case Codec::gzip:
+		return gzipCompress(src, size);
+
+	default:
+		return std::vector<uint8_t>(src, src + size);
+	}
+}
+
+bool Compression::decompress(Codec codec, const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size) {
+
+	switch (codec) {
+	case Codec::zlib: {
+		QByteArray data(size + 4, Qt::Uninitialized);
+		data[0] = char(dst_size >> 24);
+		data[1] = char(dst_size >> 16);
+		data[2] = char(dst_size >> 8);
+		data[3] = char(dst_size);
+		memcpy(data.data() + 4, src, size);
+
+		data = qUncompress(data);
+		if (data.size() != dst_size)
+			return false;
+
+		memcpy(dst, data.data(), dst_size);
+		return true;
+	}
+	case Codec::lz4:
+	case Codec::lz4hc:
+		return lz4Decompress(src, size, dst, dst_size);
+
+	case Codec::gzip:
+		return gzipDecompress(src, size, dst, dst_size);
+
+	default:
+		if (size != dst_size)
+			return false;
+		memcpy(dst, src, size);
+		return true;
+	}
+}
+
+void Compression::shuffle(const uint8_t* src, uint8_t* dst, size_t size, size_t item_size) {
+
+	if (item_size <= 1) {
+		memcpy(dst, src, size);
+		return;
+	}
+
+	int64_t count = size / item_size;
+
+#pragma omp parallel for
+	for (int64_t i = 0; i < count; ++i)
+		for (int k = 0; k < item_size; ++k)
+			dst[k * count + i] = src[i * item_size + k];
+
+	size_t tail = count * item_size;
+	memcpy(dst + tail, src + tail, size - tail);
+}
+
+void Compression::unshuffle(const uint8_t* src, uint8_t* dst, size_t size, size_t item_size) {
+
+	if (item_size <= 1) {
+		memcpy(dst, src, size);
+		return;
+	}
+
+	int64_t count = size / item_size;
+
+#pragma omp parallel for
+	for (int64_t i = 0; i < count; ++i)
+		for (int k = 0; k < item_size; ++k)
+			dst[i * item_size + k] = src[k * count + i];
+
+	size_t tail = count * item_size;
+	memcpy(dst + tail, src + tail, size - tail);
+}
+
+static uint32_t read32(const uint8_t* p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static void writeLength(std::vector<uint8_t>& dst, size_t length) {
+
+	for (; length >= 255; length -= 255)
+		dst.push_back(255);
+
+	dst.push_back(uint8_t(length));
+}
+
+std::vector<uint8_t> Compression::lz4Compress(const uint8_t* src, size_t size, int max_attempts) {
+
+	//lz4 block format, the last 5 bytes are always literals and
+	//the last match starts at least 12 bytes before the end
+	constexpr int min_match = 4;
+	constexpr int last_literals = 5;
+	constexpr int mf_limit = 12;
+	constexpr int hash_bits = 16;
+	constexpr int window = 65535;
+
+	std::vector<uint8_t> dst;
+	dst.reserve(size + size / 255 + 16);
+
+	auto hash = [](uint32_t v) { return (v * 2654435761u) >> (32 - hash_bits); };
+
+	std::vector<int64_t> head(1 << hash_bits, -1);
+	std::vector<int64_t> chain((max_attempts > 1) ? window + 1 : 0, -1);
+
+	auto insert = [&](int64_t pos) {
+		uint32_t h = hash(read32(src + pos));
+		if (chain.size())
+			chain[pos & window] = head[h];
+		head[h] = pos;
+	};
+
+	int64_t anchor = 0;
+	int64_t ip = 0;
+	int64_t match_limit = int64_t(size) - last_literals;
+
+	while (ip + mf_limit <= int64_t(size)) {
+
+		uint32_t v = read32(src + ip);
+		int64_t candidate = head[hash(v)];
+
+		int64_t best_len = 0, best_pos = 0;
+
+		for (int attempts = max_attempts; candidate >= 0 && ip - candidate <= window && attempts > 0; --attempts) {
+			if (read32(src + candidate) == v) {
+				int64_t len = min_match;
+				while (ip + len < match_limit && src[candidate + len] == src[ip + len])
+					++len;
+
+				if (len > best_len) {
+					best_len = len;
+					best_pos = candidate;
+				}
+			}
+			candidate = (chain.size()) ? chain[candidate & window] : -1;
+		}
+
+		insert(ip);
+
+		if (best_len < min_match) {
+			++ip;
+			continue;
+		}
+
+		while (ip > anchor && best_pos > 0 && src[ip - 1] == src[best_pos - 1]) {
+			--ip;
+			--best_pos;
+			++best_len;
+		}
+
+		size_t literals = ip - anchor;
+		size_t match = best_len - min_match;
+
+		dst.push_back(uint8_t((math::min<size_t>(literals, 15) << 4) | math::min<size_t>(match, 15)));
+
+		if (literals >= 15)
+			writeLength(dst, literals - 15);
+
+		dst.insert(dst.end(), src + anchor, src + ip);
+
+		uint16_t offset = uint16_t(ip - best_pos);
+		dst.push_back(uint8_t(offset));
+		dst.push_back(uint8_t(offset >> 8));
+
+		if (match >= 15)
+			writeLength(dst, match - 15);
+
+		//hc also indexes the positions covered by the match
+		if (chain.size())
+			for (int64_t p = ip + 1; p < ip + best_len && p + min_match <= int64_t(size); ++p)
+				insert(p);
+
+		ip += best_len;
+		anchor = ip;
+	}
+
+	size_t literals = size - anchor;
+	dst.push_back(uint8_t(math::min<size_t>(literals, 15) << 4));
+
+	if (literals >= 15)
+		writeLength(dst, literals - 15);
+
+	dst.insert(dst.end(), src + anchor, src + size);
+
+	return dst;
+}
+
+bool Compression::lz4Decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size) {
+
+	size_t ip = 0, op = 0;
+
+	auto readLength = [&](size_t& length) {
+		uint8_t b;
+		do {
+			if (ip >= size)
+				return false;
+			b = src[ip++];
+			length += b;
+		} while (b == 255);
+		return true;
+	};
+
+	while (ip < size) {
+
+		uint8_t token = src[ip++];
+
+		size_t literals = token >> 4;
+		if (literals == 15 && !readLength(literals))
+			return false;
+
+		if (ip + literals > size || op + literals > dst_size)
+			return false;
+
+		memcpy(dst + op, src + ip, literals);
+		ip += literals;
+		op += literals;
+
+		//last sequence has no match
+		if (ip == size)
+			break;
+
+		if (ip + 2 > size)
+			return false;
+
+		size_t offset = src[ip] | (src[ip + 1] << 8);
+		ip += 2;
+
+		if (offset == 0 || offset > op)
+			return false;
+
+		size_t match = token & 15;
+		if (match == 15 && !readLength(match))
+			return false;
+		match += 4;
+
+		if (op + match > dst_size)
+			return false;
+
+		const uint8_t* m = dst + op - offset;
+		if (offset >= match)
+			memcpy(dst + op, m, match);
+		else
+			for (size_t i = 0; i < match; ++i)
+				dst[op + i] = m[i];
+
+		op += match;
+	}
+
+	return op == dst_size;
+}
+
+uint32_t Compression::crc32(const uint8_t* src, size_t size) {
+
+	static const auto table = []() {
+		std::array<uint32_t, 256> t;
+		for (uint32_t n = 0; n < 256; ++n) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k)
+				c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			t[n] = c;
+		}
+		return t;
+	}();
+
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = 0; i < size; ++i)
+		crc = table[(crc ^ src[i]) & 0xFF] ^ (crc >> 8);
+
+	return crc ^ 0xFFFFFFFF;
+}
+
+std::vector<uint8_t> Compression::gzipCompress(const uint8_t* src, size_t size) {
+
+	//the zlib stream from qCompress is a 4 byte size, 2 byte zlib header,
+	//raw deflate data and a 4 byte adler32 trailer
+	QByteArray data = qCompress(src, size);
+
+	std::vector<uint8_t> dst = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 255 };
+	dst.insert(dst.end(), data.begin() + 6, data.end() - 4);
+
+	uint32_t crc = crc32(src, size);
+	uint32_t isize = uint32_t(size);
+
+	for (int i = 0; i < 4; ++i)
+		dst.push_back(uint8_t(crc >> (8 * i)));
+
+	for (int i = 0; i < 4; ++i)
+		dst.push_back(uint8_t(isize >> (8 * i)));
+
+	return dst;
+}
+
+bool Compression::gzipDecompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size) {
+
+	if (size < 18 || src[0] != 0x1f || src[1] != 0x8b || src[2] != 8)
+		return false;
+
+	uint8_t flags = src[3];
+	size_t pos = 10;
+
+	//FEXTRA
+	if (flags & 4) {
+		if (pos + 2 > size)
+			return false;
+		pos += 2 + (src[pos] | (src[pos + 1] << 8));
+	}
+
+	//FNAME, FCOMMENT
+	for (int f : { 8, 16 })
+		if (flags & f) {
+			while (pos < size && src[pos] != 0)
+				++pos;
+			++pos;
+		}
+
+	//FHCRC
+	if (flags & 2)
+		pos += 2;
+
+	if (pos + 8 > size)
+		return false;
+
+	return inflate(src + pos, size - pos - 8, dst, dst_size);
+}
+
+namespace {
+	class BitReader {
+		const uint8_t* m_src;
+		size_t m_size;
+		size_t m_pos = 0;
+		uint64_t m_buffer = 0;
+		int m_count = 0;
+
+	public:
+		BitReader(const uint8_t* src, size_t size) : m_src(src), m_size(size) {}
+
+		//reads past the end return zeros
+		bool overrun()const { return m_pos > m_size + 8; }
+
+		void fill(int n) {
+			while (m_count < n) {
+				uint64_t byte = (m_pos < m_size) ? m_src[m_pos] : 0;
+				m_pos++;
+				m_buffer |= byte << m_count;
+				m_count += 8;
+			}
+		}
+
+		uint32_t peek(int n) {
+			fill(n);
+			return uint32_t(m_buffer & ((uint64_t(1) << n) - 1));
+		}
+
+		void consume(int n) {
+			m_buffer >>= n;
+			m_count -= n;
+		}
+
+		uint32_t bits(int n) {
+			uint32_t v = peek(n);
+			consume(n);
+			return v;
+		}
+
+		//drops to the next byte boundary and hands back buffered bytes
+		const uint8_t* alignedBytes(size_t n) {
+			consume(m_count % 8);
+			m_pos -= m_count / 8;
+			m_buffer = 0;
+			m_count = 0;
+
+			if (m_pos + n > m_size)
+				return nullptr;
+
+			const uint8_t* p = m_src + m_pos;
+			m_pos += n;
+			return p;
+		}
+	};
+
+	class Huffman {
+		static constexpr int fast_bits = 10;
+
+		std::array<uint16_t, 16> m_count = {};
+		std::array<uint16_t, 288> m_symbol = {};
+		//symbol | length << 9 for codes of at most fast_bits
+		std::array<uint16_t, 1 << fast_bits> m_fast = {};
+
+	public:
+		bool build(const uint8_t* lengths, int n) {
+
+			m_count.fill(0);
+			m_fast.fill(0);
+
+			for (int s = 0; s < n; ++s)
+				m_count[lengths[s]]++;
+			m_count[0] = 0;
+
+			std::array<uint16_t, 16> offset = {};
+			for (int len = 1; len < 15; ++len)
+				offset[len + 1] = offset[len] + m_count[len];
+
+			for (int s = 0; s < n; ++s)
+				if (lengths[s] != 0)
+					m_symbol[offset[lengths[s]]++] = s;
+
+			//canonical codes, reversed since deflate packs them msb first
+			int code = 0;
+			int index = 0;
+			for (int len = 1; len <= 15; ++len) {
+				for (int i = 0; i < m_count[len]; ++i, ++code, ++index) {
+					if (len > fast_bits)
+						continue;
+
+					int reversed = 0;
+					for (int b = 0; b < len; ++b)
+						reversed |= ((code >> b) & 1) << (len - 1 - b);
+
+					for (int r = reversed; r < (1 << fast_bits); r += (1 << len))
+						m_fast[r] = uint16_t(m_symbol[index] | (len << 9));
+				}
+				code <<= 1;
+			}
+
+			return true;
+		}
+
+		int decode(BitReader& br)const {
+
+			uint16_t e = m_fast[br.peek(15) & ((1 << fast_bits) - 1)];
+			if (e != 0) {
+				br.consume(e >> 9);
+				return e & 511;
+			}
+
+			int code = 0, first = 0, index = 0;
+			for (int len = 1; len <= 15; ++len) {
+				code |= br.bits(1);
+				int count = m_count[len];
+				if (code - count < first)
+					return m_symbol[index + (code - first)];
+				index += count;
+				first += count;
+				first <<= 1;
+				code <<= 1;
+			}
+
+			return -1;
+		}
+	};
+}
+
+bool Compression::inflate(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size) {
+
+	static constexpr uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static constexpr uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static constexpr uint16_t dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static constexpr uint8_t dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	static constexpr uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	static const auto fixed = []() {
+		std::array<uint8_t, 320> lengths;
+		std::fill(lengths.begin(), lengths.begin() + 144, 8);
+		std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+		std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+		std::fill(lengths.begin() + 280, lengths.begin() + 288, 8);
+		std::fill(lengths.begin() + 288, lengths.end(), 5);
+
+		std::pair<Huffman, Huffman> tables;
+		tables.first.build(lengths.data(), 288);
+		tables.second.build(lengths.data() + 288, 30);
+		return tables;
+	}();
+
+	BitReader br(src, size);
+	Huffman lit_dynamic, dist_dynamic;
+	size_t op = 0;
+
+	for (bool last = false; !last;) {
+
+		last = br.bits(1);
+		int type = br.bits(2);
+
+		if (type == 0) {
+			const uint8_t* header = br.alignedBytes(4);
+			if (!header)
+				return false;
+
+			uint16_t len = header[0] | (header[1] << 8);
+			uint16_t nlen = header[2] | (header[3] << 8);
+			if (len != uint16_t(~nlen) || op + len > dst_size)
+				return false;
+
+			const uint8_t* data = br.alignedBytes(len);
+			if (!data)
+				return false;
+
+			memcpy(dst + op, data, len);
+			op += len;
+			continue;
+		}
+
+		const Huffman* lit = &fixed.first;
+		const Huffman* dist = &fixed.second;
+
+		if (type == 2) {
+			int hlit = br.bits(5) + 257;
+			int hdist = br.bits(5) + 1;
+			int hclen = br.bits(4) + 4;
+
+			std::array<uint8_t, 19> cl_lengths = {};
+			for (int i = 0; i < hclen; ++i)
+				cl_lengths[order[i]] = br.bits(3);
+
+			Huffman cl;
+			cl.build(cl_lengths.data(), 19);
+
+			std::array<uint8_t, 320> lengths = {};
+			for (int i = 0; i < hlit + hdist;) {
+				int sym = cl.decode(br);
+				if (sym < 0)
+					return false;
+
+				if (sym < 16) {
+					lengths[i++] = sym;
+					continue;
+				}
+
+				int repeat = 0;
+				uint8_t value = 0;
+				if (sym == 16) {
+					if (i == 0)
+						return false;
+					value = lengths[i - 1];
+					repeat = 3 + br.bits(2);
+				}
+				else if (sym == 17)
+					repeat = 3 + br.bits(3);
+				else
+					repeat = 11 + br.bits(7);
+
+				if (i + repeat > hlit + hdist)
+					return false;
+
+				while (repeat--)
+					lengths[i++] = value;
+			}
+
+			lit_dynamic.build(lengths.data(), hlit);
+			dist_dynamic.build(lengths.data() + hlit, hdist);
+			lit = &lit_dynamic;
+			dist = &dist_dynamic;
+		}
+
+		else if (type != 1)
+			return false;
+
+		while (true) {
+			int sym = lit->decode(br);
+
+			if (sym < 0 || br.overrun())
+				return false;
+
+			if (sym < 256) {
+				if (op >= dst_size)
+					return false;
+				dst[op++] = uint8_t(sym);
+				continue;
+			}
+
+			if (sym == 256)
+				break;
+
+			sym -= 257;
+			if (sym >= 29)
+				return false;
+
+			size_t length = length_base[sym] + br.bits(length_extra[sym]);
+
+			int dsym = dist->decode(br);
+			if (dsym < 0 || dsym >= 30)
+				return false;
+
+			size_t distance = dist_base[dsym] + br.bits(dist_extra[dsym]);
+
+			if (distance > op || op + length > dst_size)
+				return false;
+
+			const uint8_t* m = dst + op - distance;
+			if (distance >= length)
+				memcpy(dst + op, m, length);
+			else
+				for (size_t i = 0; i < length; ++i)
+					dst[op + i] = m[i];
+
+			op += length;
+		}
+	}
+
+	return op == dst_size;
+}
+
+namespace {
+	class BitWriter {
+		std::vector<uint8_t>& m_dst;
+		uint64_t m_buffer = 0;
+		int m_count = 0;
+
+	public:
+		BitWriter(std::vector<uint8_t>& dst) : m_dst(dst) {}
+
+		//n <= 32, msb first
+		void write(uint32_t value, int n) {
+			m_buffer = (m_buffer << n) | (value & ((uint64_t(1) << n) - 1));
+			m_count += n;
+
+			while (m_count >= 8) {
+				m_count -= 8;
+				m_dst.push_back(uint8_t(m_buffer >> m_count));
+			}
+			m_buffer &= (uint64_t(1) << m_count) - 1;
+		}
+
+		void writeZeros(uint32_t n) {
+			for (; n > 32; n -= 32)
+				write(0, 32);
+			write(0, n);
+		}
+
+		void flush() {
+			if (m_count > 0)
+				m_dst.push_back(uint8_t(m_buffer << (8 - m_count)));
+			m_count = 0;
+			m_buffer = 0;
+		}
+	};
+
+	template<typename T>
+	struct RiceParameters {
+		static constexpr int bytepix = sizeof(T);
+		static constexpr int fsbits = (bytepix == 1) ? 3 : (bytepix == 2) ? 4 : 5;
+		static constexpr int fsmax = (bytepix == 1) ? 6 : (bytepix == 2) ? 14 : 25;
+		static constexpr int bbits = 1 << fsbits;
+		static constexpr uint32_t mask = uint32_t((uint64_t(1) << (8 * bytepix)) - 1);
+	};
+}
+
+template<typename T>
+std::vector<uint8_t> Compression::riceCompress(const T* src, size_t count, int block_size) {
+
+	using U = std::make_unsigned_t<T>;
+	using RP = RiceParameters<T>;
+
+	std::vector<uint8_t> dst;
+	dst.reserve(count * sizeof(T) / 2);
+
+	if (count == 0)
+		return dst;
+
+	//first pixel is stored raw, big endian
+	uint32_t last = U(src[0]);
+	for (int i = RP::bytepix - 1; i >= 0; --i)
+		dst.push_back(uint8_t(last >> (8 * i)));
+
+	BitWriter bw(dst);
+	std::vector<uint32_t> diff(block_size);
+
+	for (size_t i = 0; i < count; i += block_size) {
+
+		int n = int(math::min<size_t>(block_size, count - i));
+		double pixelsum = 0;
+
+		for (int j = 0; j < n; ++j) {
+			uint32_t next = U(src[i + j]);
+			uint32_t d = (next - last) & RP::mask;
+
+			//sign extend and map to non negative
+			int32_t sd = (RP::bytepix == 4) ? int32_t(d) : int32_t(d << (32 - 8 * RP::bytepix)) >> (32 - 8 * RP::bytepix);
+			diff[j] = ((sd < 0) ? ~(uint32_t(sd) << 1) : uint32_t(sd) << 1) & RP::mask;
+
+			pixelsum += diff[j];
+			last = next;
+		}
+
+		double dpsum = math::max(0.0, (pixelsum - (n / 2) - 1) / n);
+		uint32_t psum = uint32_t(dpsum) >> 1;
+
+		int fs = 0;
+		for (; psum > 0; ++fs)
+			psum >>= 1;
+
+		if (fs >= RP::fsmax) {
+			bw.write(RP::fsmax + 1, RP::fsbits);
+			for (int j = 0; j < n; ++j)
+				bw.write(diff[j], RP::bbits);
+		}
+
+		else if (fs == 0 && pixelsum == 0)
+			bw.write(0, RP::fsbits);
+
+		else {
+			bw.write(fs + 1, RP::fsbits);
+			for (int j = 0; j < n; ++j) {
+				bw.writeZeros(diff[j] >> fs);
+				bw.write(1, 1);
+				if (fs > 0)
+					bw.write(diff[j], fs);
+			}
+		}
+	}
+
+	bw.flush();
+
+	return dst;
+}
+template std::vector<uint8_t> Compression::riceCompress(const uint8_t*, size_t, int);
+template std::vector<uint8_t> Compression::riceCompress(const int16_t*, size_t, int);
+template std::vector<uint8_t> Compression::riceCompress(const int32_t*, size_t, int);
+
+template<typename T>
+bool Compression::riceDecompress(const uint8_t* src, size_t size, T* dst, size_t count, int block_size) {
+
+	using U = std::make_unsigned_t<T>;
+	using RP = RiceParameters<T>;
+
+	if (size < RP::bytepix)
+		return false;
+
+	size_t pos = 0;
+	auto next = [&]() -> uint64_t { return (pos < size) ? src[pos++] : (pos++, 0); };
+
+	auto bitLength = [](uint64_t v) {
+		int n = 0;
+		for (; v > 0; ++n)
+			v >>= 1;
+		return n;
+	};
+
+	uint32_t last = 0;
+	for (int i = 0; i < RP::bytepix; ++i)
+		last = (last << 8) | uint32_t(next());
+
+	auto store = [&](size_t i, uint32_t diff) {
+		int32_t sd = (diff & 1) ? ~int32_t(diff >> 1) : int32_t(diff >> 1);
+		last = (last + uint32_t(sd)) & RP::mask;
+		dst[i] = T(U(last));
+	};
+
+	uint64_t b = next();
+	int nbits = 8;
+
+	for (size_t i = 0; i < count;) {
+
+		nbits -= RP::fsbits;
+		while (nbits < 0) {
+			b = (b << 8) | next();
+			nbits += 8;
+		}
+
+		int fs = int(b >> nbits) - 1;
+		b &= (uint64_t(1) << nbits) - 1;
+
+		size_t imax = math::min(i + block_size, count);
+
+		//low entropy, all differences are zero
+		if (fs < 0) {
+			for (; i < imax; ++i)
+				dst[i] = T(U(last));
+		}
+
+		//high entropy, differences are stored raw
+		else if (fs == RP::fsmax) {
+			for (; i < imax; ++i) {
+				int k = RP::bbits - nbits;
+				uint64_t diff = b << k;
+
+				for (k -= 8; k >= 0; k -= 8) {
+					b = next();
+					diff |= b << k;
+				}
+
+				if (nbits > 0) {
+					b = next();
+					diff |= b >> (-k);
+					b &= (uint64_t(1) << nbits) - 1;
+				}
+				else
+					b = 0;
+
+				store(i, uint32_t(diff));
+			}
+		}
+
+		else {
+			for (; i < imax; ++i) {
+				while (b == 0) {
+					if (pos > size)
+						return false;
+					nbits += 8;
+					b = next();
+				}
+
+				int nzero = nbits - bitLength(b);
+				nbits -= nzero + 1;
+				b ^= uint64_t(1) << nbits;
+
+				nbits -= fs;
+				while (nbits < 0) {
+					b = (b << 8) | next();
+					nbits += 8;
+				}
+
+				store(i, uint32_t((uint64_t(nzero) << fs) | (b >> nbits)));
+				b &= (uint64_t(1) << nbits) - 1;
+			}
+		}
+
+		if (pos > size + 1)
+			return false;
+	}
+
+	return true;
+}
+template bool Compression::riceDecompress(const uint8_t*, size_t, uint8_t*, size_t, int);
+template bool Compression::riceDecompress(const uint8_t*, size_t, int16_t*, size_t, int);
+template bool Compression::riceDecompress(const uint8_t*, size_t, int32_t*, size_t, int);
+
+namespace {
+	constexpr int lzw_clear = 256;
+	constexpr int lzw_eoi = 257;
+	constexpr int lzw_first = 258;
+	constexpr int lzw_max_bits = 12;
+}
+
+std::vector<uint8_t> Compression::lzwCompress(const uint8_t* src, size_t size) {
+
+	std::vector<uint8_t> dst;
+	dst.reserve(size / 2 + 16);
+
+	BitWriter bw(dst);
+
+	//open addressing on prefix code and next byte
+	constexpr int table_size = 9001;
+	std::vector<int32_t> keys(table_size, -1);
+	std::vector<uint16_t> codes(table_size);
+
+	int width = 9;
+	int next = lzw_first;
+
+	bw.write(lzw_clear, width);
+
+	if (size == 0) {
+		bw.write(lzw_eoi, width);
+		bw.flush();
+		return dst;
+	}
+
+	int prefix = src[0];
+
+	for (size_t i = 1; i < size; ++i) {
+		int32_t key = (prefix << 8) | src[i];
+		int h = ((src[i] << 12) ^ prefix) % table_size;
+
+		while (keys[h] != -1 && keys[h] != key)
+			if (++h == table_size)
+				h = 0;
+
+		if (keys[h] == key) {
+			prefix = codes[h];
+			continue;
+		}
+
+		bw.write(prefix, width);
+
+		keys[h] = key;
+		codes[h] = next++;
+
+		if (next == (1 << lzw_max_bits) - 2) {
+			bw.write(lzw_clear, width);
+			std::fill(keys.begin(), keys.end(), -1);
+			width = 9;
+			next = lzw_first;
+		}
+		else if (next > (1 << width) - 1)
+			width++;
+
+		prefix = src[i];
+	}
+
+	bw.write(prefix, width);
+
+	//the decoder adds an entry for the last code before reading eoi
+	if (++next > (1 << width) - 1 && width < lzw_max_bits)
+		width++;
+
+	bw.write(lzw_eoi, width);
+	bw.flush();
+
+	return dst;
+}
+
+bool Compression::lzwDecompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size) {
+
+	constexpr int table_size = 1 << lzw_max_bits;
+
+	std::array<uint16_t, table_size> prefix;
+	std::array<uint8_t, table_size> suffix;
+	std::array<uint8_t, table_size> first;
+	std::array<uint16_t, table_size> length;
+
+	for (int i = 0; i < 256; ++i) {
+		prefix[i] = 0;
+		suffix[i] = first[i] = i;
+		length[i] = 1;
+	}
+
+	uint64_t buffer = 0;
+	int count = 0;
+	size_t ip = 0;
+	size_t op = 0;
+
+	int width = 9;
+	int next = lzw_first;
+	int old = -1;
+
+	std::array<uint8_t, table_size> overflow;
+
+	while (op < dst_size) {
+		while (count < width && ip < size) {
+			buffer = (buffer << 8) | src[ip++];
+			count += 8;
+		}
+
+		if (count < width)
+			break;
+
+		count -= width;
+		int code = (buffer >> count) & ((1 << width) - 1);
+
+		if (code == lzw_eoi)
+			break;
+
+		if (code == lzw_clear) {
+			width = 9;
+			next = lzw_first;
+			old = -1;
+			continue;
+		}
+
+		if (old == -1) {
+			if (code > 255)
+				return false;
+			dst[op++] = code;
+			old = code;
+			continue;
+		}
+
+		if (code > next || (code == next && next == table_size))
+			return false;
+
+		if (next < table_size) {
+			prefix[next] = old;
+			suffix[next] = (code < next) ? first[code] : first[old];
+			first[next] = first[old];
+			length[next] = length[old] + 1;
+			next++;
+		}
+
+		//strings are written back to front, through a scratch buffer if dst can't hold it
+		int len = length[code];
+		uint8_t* out = (op + len <= dst_size) ? dst + op : overflow.data();
+
+		for (int i = len - 1, c = code; i >= 0; --i, c = prefix[c])
+			out[i] = suffix[c];
+
+		if (out == overflow.data()) {
+			std::copy(overflow.begin(), overflow.begin() + (dst_size - op), dst + op);
+			op = dst_size;
+		}
+		else
+			op += len;
+
+		old = code;
+
+		if (next + 1 >= (1 << width) && width < lzw_max_bits)
+			width++;
+	}
+
+	return op == dst_size;
+}
@@ -2,6 +2,7 @@
 #include "FastStack.h"
 #include "ASinhStretch.h"
 #include "Histogram.h"
+#include "PointOperation.h"
 
 template<typename T>
 void ASinhStretch::computeBlackpoint(const Image<T>& img) {
@@ -43,11 +44,13 @@ void ASinhStretch::applyMono(Image<T>& img) {
 
 	float max = Pixel<float>::toType(img.computeMax(0));
 
-#pragma omp parallel for num_threads(2)
-	for (int el = 0; el < img.pxCount(); ++el) {
-		float r = (Pixel<float>::toType(img[el]) - blackpoint()) / (max - blackpoint());
-		img[el] = Pixel<T>::toType(math::clip((r != 0) ? asinh(r * beta) / asinhb : beta / asinhb));
-	}
+	PointOperation op;
+	op.append(0, [&, this](float pixel) {
+		float r = (pixel - blackpoint()) / (max - blackpoint());
+		return (r != 0) ? asinh(r * beta) / asinhb : beta / asinhb;
+		});
+
+	op.apply(img);
 }
 template void ASinhStretch::applyMono(Image8&);
 template void ASinhStretch::applyMono(Image16&);
@@ -68,7 +71,7 @@ void ASinhStretch::applyRGB(Image<T>& img) {
 	std::array<float, 3> color_space = { 0.333333f, 0.333333f, 0.333333f };
 	if (m_srbg) color_space = { 0.222491f, 0.716888f, 0.060621f };
 
-#pragma omp parallel for num_threads(2)
+#pragma omp parallel for
 	for (int y = 0; y < img.rows(); ++y) {
 		for (int x = 0; x < img.cols(); ++x) {
 			auto color = img.template color<float>(x,y);
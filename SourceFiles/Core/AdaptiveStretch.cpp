@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "AdaptiveStretch.h"
 #include "FastStack.h"
+#include "Histogram.h"
 
 template<typename T>
 static Image<T> RGBtoL(const Image<T>& src) {
@@ -25,9 +26,6 @@ void AdaptiveStretch::computeCDF(const Image<T>& img) {
 		return computeCDF(temp);
 	}
 
-	std::vector<uint32_t> pos;
-	std::vector<uint32_t> neg;
-
 	int size = [&]() {
 		switch (img.type()) {
 		case ImageType::UBYTE:
@@ -42,53 +40,62 @@ void AdaptiveStretch::computeCDF(const Image<T>& img) {
 	}();
 	uint32_t K = size - 1;
 
-	pos.resize(size, 0);
-	neg.resize(size, 0);
 	m_cdf_curve.resize(size);	
 
 	float thresh = m_noise_thresh;
 	float contrast = (m_contrast_protection) ? m_contrast_threshold : 0;
 
 	auto tp = getTimePoint();
-#pragma omp parallel for firstprivate(K, thresh) num_threads(4)
-	for (int y = 0; y < img.rows(); ++y) {
-		for (int x = 0; x < img.cols(); ++x) {
 
-			float a0 = img.template pixel<float>(x, y);
+	//pos and neg counts, each chunk of rows counts into bins of its own
+	auto counts = HistogramBuilder::accumulate(img.rows(), 2, size, [&](int start, int end, uint32_t** bins) {
+
+		uint32_t* pos = bins[0];
+		uint32_t* neg = bins[1];
+
+		for (int y = start; y < end; ++y) {
+			for (int x = 0; x < img.cols(); ++x) {
+
+				float a0 = img.template pixel<float>(x, y);
 
-			float a1 = Pixel<float>::toType(img.at_replicated(x + 1, y));
-			uint32_t l1 = math::min(a0, a1) * K;
+				float a1 = Pixel<float>::toType(img.at_replicated(x + 1, y));
+				uint32_t l1 = math::min(a0, a1) * K;
 
-			float a2 = Pixel<float>::toType(img.at_replicated(x - 1, y + 1));
-			uint32_t l2 = math::min(a0, a2) * K;
+				float a2 = Pixel<float>::toType(img.at_replicated(x - 1, y + 1));
+				uint32_t l2 = math::min(a0, a2) * K;
 
-			float a3 = Pixel<float>::toType(img.at_replicated(x, y + 1));
-			uint32_t l3 = math::min(a0, a3) * K;
+				float a3 = Pixel<float>::toType(img.at_replicated(x, y + 1));
+				uint32_t l3 = math::min(a0, a3) * K;
 
-			float a4 = Pixel<float>::toType(img.at_replicated(x + 1, y + 1));
-			uint32_t l4 = math::min(a0, a4) * K;
+				float a4 = Pixel<float>::toType(img.at_replicated(x + 1, y + 1));
+				uint32_t l4 = math::min(a0, a4) * K;
 
-			if (abs(a0 - a1) > thresh)
-				pos[l1]++;
-			else
-				neg[l1]++;
+				if (abs(a0 - a1) > thresh)
+					pos[l1]++;
+				else
+					neg[l1]++;
 
-			if (abs(a0 - a2) > thresh)
-				pos[l2]++;
-			else
-				neg[l2]++;
+				if (abs(a0 - a2) > thresh)
+					pos[l2]++;
+				else
+					neg[l2]++;
 
-			if (abs(a0 - a3) > thresh)
-				pos[l3]++;
-			else
-				neg[l3]++;
+				if (abs(a0 - a3) > thresh)
+					pos[l3]++;
+				else
+					neg[l3]++;
 
-			if (abs(a0 - a4) > thresh)
-				pos[l4]++;
-			else
-				neg[l4]++;
+				if (abs(a0 - a4) > thresh)
+					pos[l4]++;
+				else
+					neg[l4]++;
+			}
 		}
-	}
+		});
+
+	const auto& pos = counts[0];
+	const auto& neg = counts[1];
+
 	displayTimeDuration(tp);
 	m_cdf_curve[0] = pos[0] - contrast * neg[0];
 	for (int i = 1; i < m_cdf_curve.size(); ++i)
@@ -122,7 +122,7 @@ void AutoHistogram::apply(Image<T>& img) {
     for (int ch = 0; ch < img.channels(); ++ch) {
 
         histogram.constructHistogram(img, ch);
-        float median = (img.type() == ImageType::FLOAT) ? histogram.medianf() : histogram.median();
+        float median = Quantile::median<T>(img.channelView(ch)) / Pixel<T>::max();
 
         if (m_histogram_clipping) {
 
@@ -2,10 +2,11 @@
 #include "FastStack.h"
 #include "AutomaticBackgroundExtraction.h"
 #include "ImageWindow.h"
+#include "ImageGeometry.h"
 
 using ABE = AutomaticBackgroundExtraction;
 
-std::vector<double> ABE::polynomial(int x, uint32_t degrees) {
+std::vector<double> ABE::polynomial(double x, uint32_t degrees) {
 
     std::vector<double> poly(degrees + 1);
     poly[0] = 1;
@@ -26,22 +27,23 @@ uint32_t ABE::computePolynomialLength(uint32_t degrees) {
 }
 
 template<typename T>
-float ABE::sampleMedian(const Image<T>& img, const ImagePoint& p)const {
+float ABE::sampleMedian(const Image<T>& img, const ImagePoint& p, int radius, std::vector<T>& sample)const {
 
-    std::vector<T> sample(size());
-    size_t memsize = dimension() * sizeof(T);
-    int x = p.x() - radius();
-    int y = p.y() - radius();
+    int dim = 2 * radius + 1;
+    sample.resize(dim * dim);
+    size_t memsize = dim * sizeof(T);
+    int x = p.x() - radius;
+    int y = p.y() - radius;
 
-    for (int i = 0; i < dimension(); ++i)
-        memcpy(&sample[i * dimension()], &img(x, y + i, p.channel()), memsize);
+    for (int i = 0; i < dim; ++i)
+        memcpy(&sample[i * dim], &img(x, y + i, p.channel()), memsize);
 
     std::nth_element(sample.begin(), sample.begin() + sample.size() / 2, sample.end());
 
     return Pixel<float>::toType(sample[sample.size() / 2]);
 }
 
-void ABE::insertMatrixRow(Matrix& matrix, int row, const Point& p)const {
+void ABE::insertMatrixRow(Matrix& matrix, int row, const PointD& p)const {
 
     std::vector<double> xv = polynomial(p.x, polynomialDegree());
     std::vector<double> yv = polynomial(p.y, polynomialDegree());
@@ -51,18 +53,107 @@ void ABE::insertMatrixRow(Matrix& matrix, int row, const Point& p)const {
             matrix(row, col++) = xv[i] * yv[j];
 }
 
-double ABE::computePolynomial(const Matrix& coefficients, const Point& p)const {
+template<typename T>
+Matrix ABE::fitModel(const Image<T>& img, uint32_t ch, int scale, uint32_t rows, uint32_t cols)const {
 
-    std::vector<double> xv = polynomial(p.x, polynomialDegree());
-    std::vector<double> yv = polynomial(p.y, polynomialDegree());
+    T med = img.computeMedian(ch, false, Quantile::Mode::approximate);
+    float median = Pixel<float>::toType(med);
 
-    double sum = 0.0;
+    float sigma = Pixel<float>::toType(img.computeAvgDev(ch, med));//src.ComputeStdDev(ch);
 
-    for (int j = 0, el = 0; j <= polynomialDegree(); ++j)
-        for (int i = 0; i <= polynomialDegree() - j; ++i)
-            sum += xv[i] * yv[j] * coefficients[el++];
-       
-    return sum;
+    float upper = median + sigmaKUpper() * sigma;
+    float lower = median - sigmaKLower() * sigma;
+
+    //sample boxes and spacing are given in full resolution pixels, so a binned img samples the same areas
+    int rad = math::max<int>(1, std::lround(double(radius()) / scale));
+    int dist = math::max<int>(1, std::lround(double(distance()) / scale));
+
+    std::vector<Point> grid;
+    int buffer = rad + 1;
+
+    for (int y = buffer; y < int(img.rows()) - buffer; y += dist)
+        for (int x = buffer; x < int(img.cols()) - buffer; x += dist)
+            grid.push_back({ x, y });
+
+    std::vector<float> medians(grid.size());
+
+#pragma omp parallel
+    {
+        std::vector<T> sample;
+
+#pragma omp for schedule(dynamic, 16)
+        for (int s = 0; s < grid.size(); ++s)
+            medians[s] = sampleMedian(img, { grid[s].x, grid[s].y, ch }, rad, sample);
+    }
+
+    Matrix variables(grid.size(), polynomialLength());
+    Matrix bgv(grid.size());
+
+    int row = 0;
+
+    for (int s = 0; s < grid.size(); ++s) {
+
+        float val = medians[s];
+
+        if (val > upper || val < lower) continue;
+
+        //sample center in full resolution pixel coordinates
+        double x = (grid[s].x + 0.5) * scale - 0.5;
+        double y = (grid[s].y + 0.5) * scale - 0.5;
+
+        insertMatrixRow(variables, row, { normalize(x, cols), normalize(y, rows) });
+        bgv[row++] = val;
+    }
+
+    row -= 1;
+
+    variables.resize(row, polynomialLength());
+    bgv.resize(row);
+
+    return Matrix::leastSquares(variables, bgv);
+}
+
+void ABE::evaluateModel(const Matrix& coefficients, Image32& background, uint32_t ch)const {
+
+    int degree = polynomialDegree();
+
+    //coefficients are stored by power of y, then power of x
+    std::vector<int> offset(degree + 1);
+    for (int j = 1; j <= degree; ++j)
+        offset[j] = offset[j - 1] + (degree + 2 - j);
+
+    std::vector<float> u(background.cols());
+    for (int x = 0; x < background.cols(); ++x)
+        u[x] = normalize(x, background.cols());
+
+#pragma omp parallel
+    {
+        std::vector<float> row_coef(degree + 1);
+
+#pragma omp for
+        for (int y = 0; y < background.rows(); ++y) {
+
+            double v = normalize(y, background.rows());
+
+            //collapse y powers once per row with horner
+            for (int i = 0; i <= degree; ++i) {
+                double c = 0.0;
+                for (int j = degree - i; j >= 0; --j)
+                    c = c * v + coefficients[offset[j] + i];
+                row_coef[i] = c;
+            }
+
+            //horner in x over the whole row
+            float* out = &background(0, y, ch);
+            std::fill(out, out + background.cols(), row_coef[degree]);
+
+            for (int i = degree - 1; i >= 0; --i) {
+                float c = row_coef[i];
+                for (int x = 0; x < background.cols(); ++x)
+                    out[x] = out[x] * u[x] + c;
+            }
+        }
+    }
 }
 
 template<typename T>
@@ -92,49 +183,23 @@ template<typename T>
 Image32 ABE::createBackgroundModel(const Image<T>& src)const {
 
     Image32 background(src.rows(), src.cols(), src.channels());
-    int number_of_samples = (src.rows() / distance()) * (src.cols() / distance());
-
-    for (uint32_t ch = 0; ch < src.channels(); ++ch) {
-
-        T med = src.computeMedian(ch);
-        float median = Pixel<float>::toType(med);
 
-        float sigma = Pixel<float>::toType(src.computeAvgDev(ch, med));//src.ComputeStdDev(ch);
+    //low resolution model, polynomial is evaluated directly at full resolution
+    if (m_downsample > 1) {
 
-        float upper = median + sigmaKUpper() * sigma;
-        float lower = median - sigmaKLower() * sigma;
+        Image<T> binned(src);
 
-        Matrix variables(number_of_samples, polynomialLength());
-        Matrix bgv(number_of_samples);
+        IntegerResample ir;
+        ir.setFactor(m_downsample);
+        ir.apply(binned);
 
-        int row = 0;
-        int buffer = radius() + 1;
-
-        for (int y = buffer; y < src.rows() - buffer; y += distance()) {
-            for (int x = buffer; x < src.cols() - buffer; x += distance()) {
-
-                float val = sampleMedian(src, { x, y, ch });
-
-                if (val > upper || val < lower) continue;
-
-                insertMatrixRow(variables, row, { x, y });
-                bgv[row++] = val;
-            }
-        }
-
-        row -= 1;
-
-        variables.resize(row, polynomialLength());
-        bgv.resize(row);
-
-        Matrix coef(polynomialLength());
-        coef = Matrix::leastSquares(variables, bgv);
-
-#pragma omp parallel for
-        for (int y = 0; y < src.rows(); ++y)
-            for (int x = 0; x < src.cols(); ++x)
-                background(x, y, ch) = computePolynomial(coef, { x, y });
+        for (uint32_t ch = 0; ch < src.channels(); ++ch)
+            evaluateModel(fitModel(binned, ch, m_downsample, src.rows(), src.cols()), background, ch);
+    }
 
+    else {
+        for (uint32_t ch = 0; ch < src.channels(); ++ch)
+            evaluateModel(fitModel(src, ch, 1, src.rows(), src.cols()), background, ch);
     }
 
     return background;
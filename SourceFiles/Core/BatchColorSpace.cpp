@@ -0,0 +1,282 @@
+#include "pch.h"
+#include "BatchColorSpace.h"
+#include "Image.h"
+
+using CC = BatchColorSpace;
+
+static constexpr float k_116 = (24389.0 / 27.0) / 116.0;
+static constexpr float _16_116 = 16.0 / 116.0;
+static constexpr float esp = 216.0 / 24389.0;
+static constexpr float chroma_norm = 1.272792206;
+static constexpr float _2pi = 2 * std::numbers::pi;
+
+static constexpr float RGB_XYZ[9] = { 0.4360747, 0.3850649, 0.1430804,
+									  0.2225045, 0.7168786, 0.0606169,
+									  0.0139322, 0.0971045, 0.7141733 };
+
+static constexpr float XYZ_RGB[9] = { 3.1338561, -1.6168667, -0.4906146,
+									 -0.9787684,  1.9161415,  0.0334540,
+									  0.0719453, -0.2289914,  1.4052427 };
+
+static constexpr float D50_X = 0.96422;
+static constexpr float D50_Z = 0.82521;
+
+//piecewise linear table over [0, max]
+class TransferLUT {
+	std::vector<float> m_lut;
+	float m_max = 1.0f;
+	float m_scale = 1.0f;
+
+public:
+	template<typename Func>
+	TransferLUT(Func func, float max, int size = 65536) : m_lut(size + 1), m_max(max), m_scale(size / max) {
+		for (int i = 0; i <= size; ++i)
+			m_lut[i] = func(double(i) / m_scale);
+	}
+
+	float operator()(float x)const {
+		x = std::clamp(x, 0.0f, m_max) * m_scale;
+		int i = math::min<int>(x, m_lut.size() - 2);
+		return m_lut[i] + (x - i) * (m_lut[i + 1] - m_lut[i]);
+	}
+};
+
+static const TransferLUT& toLinearLUT() {
+	static const TransferLUT lut([](double x) { return (x <= 0.04045) ? x / 12.92 : pow((x + 0.055) / 1.055, 2.4); }, 1.0f);
+	return lut;
+}
+
+static const TransferLUT& tosRGBLUT() {
+	static const TransferLUT lut([](double x) { return (x <= 0.0031308) ? 12.92 * x : 1.055 * pow(x, 1 / 2.4) - 0.055; }, 1.0f);
+	return lut;
+}
+
+//X / D50_X and Z / D50_Z exceed 1
+static const TransferLUT& labLUT() {
+	static const TransferLUT lut([](double x) { return (x > esp) ? cbrt(x) : k_116 * x + _16_116; }, 2.0f);
+	return lut;
+}
+
+static float labInverse(float x) {
+	float x3 = x * x * x;
+	return (x3 > esp) ? x3 : (x - _16_116) / k_116;
+}
+
+//R,G,B are replaced by f(X/Xn), f(Y), f(Z/Zn)
+static void RGBtoLabF(float* R, float* G, float* B, size_t count) {
+
+	const auto& linear = toLinearLUT();
+	const auto& f = labLUT();
+
+	for (size_t i = 0; i < count; ++i) {
+		float r = linear(R[i]);
+		float g = linear(G[i]);
+		float b = linear(B[i]);
+
+		float X = math::clipf(RGB_XYZ[0] * r + RGB_XYZ[1] * g + RGB_XYZ[2] * b);
+		float Y = math::clipf(RGB_XYZ[3] * r + RGB_XYZ[4] * g + RGB_XYZ[5] * b);
+		float Z = math::clipf(RGB_XYZ[6] * r + RGB_XYZ[7] * g + RGB_XYZ[8] * b);
+
+		R[i] = f(X / D50_X);
+		G[i] = f(Y);
+		B[i] = f(Z / D50_Z);
+	}
+}
+
+//inverse of RGBtoLabF
+static void LabFtoRGB(float* X, float* Y, float* Z, size_t count) {
+
+	const auto& srgb = tosRGBLUT();
+
+	for (size_t i = 0; i < count; ++i) {
+		float x = labInverse(X[i]) * D50_X;
+		float y = labInverse(Y[i]);
+		float z = labInverse(Z[i]) * D50_Z;
+
+		X[i] = srgb(math::clipf(XYZ_RGB[0] * x + XYZ_RGB[1] * y + XYZ_RGB[2] * z));
+		Y[i] = srgb(math::clipf(XYZ_RGB[3] * x + XYZ_RGB[4] * y + XYZ_RGB[5] * z));
+		Z[i] = srgb(math::clipf(XYZ_RGB[6] * x + XYZ_RGB[7] * y + XYZ_RGB[8] * z));
+	}
+}
+
+void CC::RGBtoCIELabRow(float* R_L, float* G_a, float* B_b, size_t count) {
+
+	RGBtoLabF(R_L, G_a, B_b, count);
+
+	for (size_t i = 0; i < count; ++i) {
+		float X = R_L[i], Y = G_a[i], Z = B_b[i];
+		R_L[i] = 1.16f * Y - 0.16f;
+		G_a[i] = (5 * (X - Y) + 0.9f) / 1.8f;
+		B_b[i] = (2 * (Y - Z) + 0.9f) / 1.8f;
+	}
+}
+
+void CC::CIELabtoRGBRow(float* L_R, float* a_G, float* b_B, size_t count) {
+
+	for (size_t i = 0; i < count; ++i) {
+		float Y = (L_R[i] + 0.16f) / 1.16f;
+		L_R[i] = (1.8f * a_G[i] - 0.9f) / 5 + Y;
+		b_B[i] = Y - (1.8f * b_B[i] - 0.9f) / 2;
+		a_G[i] = Y;
+	}
+
+	LabFtoRGB(L_R, a_G, b_B, count);
+}
+
+void CC::RGBtoCIELRow(const float* R, const float* G, const float* B, float* L, size_t count) {
+
+	const auto& linear = toLinearLUT();
+	const auto& f = labLUT();
+
+	for (size_t i = 0; i < count; ++i) {
+		float Y = RGB_XYZ[3] * linear(R[i]) + RGB_XYZ[4] * linear(G[i]) + RGB_XYZ[5] * linear(B[i]);
+		L[i] = 1.16f * f(Y) - 0.16f;
+	}
+}
+
+void CC::RGBtoCIELchRow(float* R_L, float* G_c, float* B_h, size_t count) {
+
+	RGBtoLabF(R_L, G_c, B_h, count);
+
+	for (size_t i = 0; i < count; ++i) {
+		float X = R_L[i], Y = G_c[i], Z = B_h[i];
+		float a = 5 * (X - Y);
+		float b = 2 * (Y - Z);
+		float h = atan2f(b, a);
+
+		R_L[i] = 1.16f * Y - 0.16f;
+		G_c[i] = sqrtf(a * a + b * b) / chroma_norm;
+		B_h[i] = (h < 0) ? h + _2pi : h;
+	}
+}
+
+void CC::CIELchtoRGBRow(float* L_R, float* c_G, float* h_B, size_t count) {
+
+	for (size_t i = 0; i < count; ++i) {
+		float c = c_G[i] * chroma_norm;
+		float Y = (L_R[i] + 0.16f) / 1.16f;
+		L_R[i] = c * cosf(h_B[i]) / 5 + Y;
+		h_B[i] = Y - c * sinf(h_B[i]) / 2;
+		c_G[i] = Y;
+	}
+
+	LabFtoRGB(L_R, c_G, h_B, count);
+}
+
+static constexpr int block_size = 1024;
+
+template<typename T>
+static void load(const T* src, float* dst, int count) {
+	for (int i = 0; i < count; ++i)
+		dst[i] = Pixel<float>::toType(src[i]);
+}
+
+template<typename T>
+static void store(const float* src, T* dst, int count) {
+	for (int i = 0; i < count; ++i)
+		dst[i] = Pixel<T>::toType(src[i]);
+}
+
+//splits count pixels into blocks converted to float in thread local buffers
+template<typename Func>
+static void forEachBlock(size_t count, Func func) {
+
+	int blocks = (count + block_size - 1) / block_size;
+
+#pragma omp parallel
+	{
+		std::vector<float> buffer(3 * block_size);
+
+#pragma omp for
+		for (int n = 0; n < blocks; ++n) {
+			size_t start = size_t(n) * block_size;
+			int length = math::min<size_t>(block_size, count - start);
+			func(start, length, buffer.data(), buffer.data() + block_size, buffer.data() + 2 * block_size);
+		}
+	}
+}
+
+template<typename T>
+void CC::RGBtoCIELab(const T* R, const T* G, const T* B, T* L, T* a, T* b, size_t count) {
+
+	forEachBlock(count, [&](size_t start, int length, float* c0, float* c1, float* c2) {
+		load(R + start, c0, length);
+		load(G + start, c1, length);
+		load(B + start, c2, length);
+
+		RGBtoCIELabRow(c0, c1, c2, length);
+
+		store(c0, L + start, length);
+		store(c1, a + start, length);
+		store(c2, b + start, length);
+	});
+}
+template void CC::RGBtoCIELab(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, uint8_t*, uint8_t*, size_t);
+template void CC::RGBtoCIELab(const uint16_t*, const uint16_t*, const uint16_t*, uint16_t*, uint16_t*, uint16_t*, size_t);
+template void CC::RGBtoCIELab(const float*, const float*, const float*, float*, float*, float*, size_t);
+
+template<typename T>
+void CC::CIELabtoRGB(const T* L, const T* a, const T* b, T* R, T* G, T* B, size_t count) {
+
+	forEachBlock(count, [&](size_t start, int length, float* c0, float* c1, float* c2) {
+		load(L + start, c0, length);
+		load(a + start, c1, length);
+		load(b + start, c2, length);
+
+		CIELabtoRGBRow(c0, c1, c2, length);
+
+		store(c0, R + start, length);
+		store(c1, G + start, length);
+		store(c2, B + start, length);
+	});
+}
+template void CC::CIELabtoRGB(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, uint8_t*, uint8_t*, size_t);
+template void CC::CIELabtoRGB(const uint16_t*, const uint16_t*, const uint16_t*, uint16_t*, uint16_t*, uint16_t*, size_t);
+template void CC::CIELabtoRGB(const float*, const float*, const float*, float*, float*, float*, size_t);
+
+template<typename T>
+void CC::RGBtoCIEL(const T* R, const T* G, const T* B, T* L, size_t count) {
+
+	forEachBlock(count, [&](size_t start, int length, float* c0, float* c1, float* c2) {
+		load(R + start, c0, length);
+		load(G + start, c1, length);
+		load(B + start, c2, length);
+
+		RGBtoCIELRow(c0, c1, c2, c0, length);
+
+		store(c0, L + start, length);
+	});
+}
+template void CC::RGBtoCIEL(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, size_t);
+template void CC::RGBtoCIEL(const uint16_t*, const uint16_t*, const uint16_t*, uint16_t*, size_t);
+template void CC::RGBtoCIEL(const float*, const float*, const float*, float*, size_t);
+
+void CC::RGBtoCIELch(const float* R, const float* G, const float* B, float* L, float* c, float* h, size_t count) {
+
+	forEachBlock(count, [&](size_t start, int length, float* c0, float* c1, float* c2) {
+		memcpy(c0, R + start, length * sizeof(float));
+		memcpy(c1, G + start, length * sizeof(float));
+		memcpy(c2, B + start, length * sizeof(float));
+
+		RGBtoCIELchRow(c0, c1, c2, length);
+
+		memcpy(L + start, c0, length * sizeof(float));
+		memcpy(c + start, c1, length * sizeof(float));
+		memcpy(h + start, c2, length * sizeof(float));
+	});
+}
+
+void CC::CIELchtoRGB(const float* L, const float* c, const float* h, float* R, float* G, float* B, size_t count) {
+
+	forEachBlock(count, [&](size_t start, int length, float* c0, float* c1, float* c2) {
+		memcpy(c0, L + start, length * sizeof(float));
+		memcpy(c1, c + start, length * sizeof(float));
+		memcpy(c2, h + start, length * sizeof(float));
+
+		CIELchtoRGBRow(c0, c1, c2, length);
+
+		memcpy(R + start, c0, length * sizeof(float));
+		memcpy(G + start, c1, length * sizeof(float));
+		memcpy(B + start, c2, length * sizeof(float));
+	});
+}
@@ -35,11 +35,267 @@ static std::vector<uint8_t> generateMask(size_t dim, bool circular) {
 	return mask;
 }
 
+static std::vector<float> generateSpatialLUT(int dim, float sigma) {
+
+	std::vector<float> lut(dim);
+	float k_s = 1 / (2 * sigma * sigma);
+	int rad = (dim - 1) / 2;
+
+	for (int i = -rad; i <= rad; ++i)
+		lut[i + rad] = expf(-k_s * (i * i));
+
+	return lut;
+}
+
+static int mirrorIndex(int i, int size) {
+
+	if (i < 0)
+		i = -i;
+	else if (i >= size)
+		i = 2 * size - (i + 2);
+
+	return std::clamp(i, 0, size - 1);
+}
+
+//Young and van Vliet third order recursive gaussian, a constant cost per sample for any sigma >= 0.5
+class RecursiveGaussian {
+	float m_B = 1.0f;
+	std::array<float, 3> m_a = { 0.0f, 0.0f, 0.0f };
+
+public:
+	RecursiveGaussian(float sigma) {
+
+		float q = (sigma >= 2.5f) ? 0.98711f * sigma - 0.96330f : 3.97156f - 4.14554f * sqrtf(1 - 0.26891f * sigma);
+		float q2 = q * q;
+		float q3 = q2 * q;
+
+		float b0 = 1.57825f + 2.44413f * q + 1.4281f * q2 + 0.422205f * q3;
+		m_a = { (2.44413f * q + 2.85619f * q2 + 1.26661f * q3) / b0, -(1.4281f * q2 + 1.26661f * q3) / b0, 0.422205f * q3 / b0 };
+		m_B = 1 - (m_a[0] + m_a[1] + m_a[2]);
+	}
+
+	//forward then backward pass in place, starting each from the steady state of the end sample
+	void apply(float* line, int size)const {
+
+		float w1 = line[0], w2 = w1, w3 = w1;
+		for (int i = 0; i < size; ++i) {
+			float w = m_B * line[i] + m_a[0] * w1 + m_a[1] * w2 + m_a[2] * w3;
+			line[i] = w;
+			w3 = w2; w2 = w1; w1 = w;
+		}
+
+		w1 = w2 = w3 = line[size - 1];
+		for (int i = size - 1; i >= 0; --i) {
+			float w = m_B * line[i] + m_a[0] * w1 + m_a[1] * w2 + m_a[2] * w3;
+			line[i] = w;
+			w3 = w2; w2 = w1; w1 = w;
+		}
+	}
+};
+
+class RangeLUT {
+	std::vector<float> m_lut;
+	float m_scale = 0.0f;
+
+public:
+	//same range weight as brute force, exp(-2 * d^2 / (2 * sigma_r^2))
+	RangeLUT(float sigma_r, float max_distance, int size = 4096) : m_lut(size) {
+
+		float k_r = 1 / (sigma_r * sigma_r);
+		m_scale = (size - 1) / math::max(max_distance, 1e-6f);
+
+		//flush negligible weights to zero, denormals stall the spatial passes
+		for (int i = 0; i < size; ++i) {
+			float d = i / m_scale;
+			float w = expf(-k_r * d * d);
+			m_lut[i] = (w > 1e-10f) ? w : 0.0f;
+		}
+	}
+
+	float operator()(float distance)const {
+		return m_lut[math::min<int>(distance * m_scale + 0.5f, m_lut.size() - 1)];
+	}
+};
+
+template<typename T>
+void BilateralFilter::fastFilter(const Image<T>& src, Image<T>& dst) {
+
+	if (!dst.isSameShape(src))
+		dst = Image<T>(src.rows(), src.cols(), src.channels());
+
+	int rows = src.rows();
+	int cols = src.cols();
+
+	//mirrored samples each spatial pass reads past an edge
+	int rad = spatialRadius();
+	bool recursive = useRecursiveGaussian();
+	auto spatial = generateSpatialLUT(2 * rad + 1, m_sigma_s);
+	RecursiveGaussian gaussian(m_sigma_s);
+
+	Image32 pixels(rows, cols);
+	Image32 weight(rows, cols);
+	Image32 weighted(rows, cols);
+	Image32 result(rows, cols);
+
+	//range levels are spaced at the std dev of the range kernel
+	float sigma = m_sigma_r / std::numbers::sqrt2_v<float>;
+
+	for (uint32_t ch = 0; ch < src.channels(); ++ch) {
+
+#pragma omp parallel for
+		for (int y = 0; y < rows; ++y)
+			for (int x = 0; x < cols; ++x)
+				pixels(x, y) = Pixel<float>::toType(src(x, y, ch));
+
+		auto minmax = std::minmax_element(pixels.data(), pixels.data() + pixels.pxCount());
+		float min = *minmax.first;
+		float range = *minmax.second - min;
+
+		if (range <= 0.0f) {
+#pragma omp parallel for
+			for (int y = 0; y < rows; ++y)
+				for (int x = 0; x < cols; ++x)
+					dst(x, y, ch) = src(x, y, ch);
+			continue;
+		}
+
+		int levels = std::clamp(int(ceil(range / sigma)) + 1, 2, 256);
+		float step = range / (levels - 1);
+		float inv_step = 1 / step;
+		RangeLUT range_lut(m_sigma_r, range);
+
+		result.fillZero();
+
+		for (int k = 0; k < levels; ++k) {
+			float level = min + k * step;
+
+			//range weights and horizontal spatial pass
+#pragma omp parallel
+			{
+				std::vector<float> row_w(cols + 2 * rad);
+				std::vector<float> row_wp(cols + 2 * rad);
+
+#pragma omp for
+				for (int y = 0; y < rows; ++y) {
+
+					for (int x = -rad; x < cols + rad; ++x) {
+						float p = pixels(mirrorIndex(x, cols), y);
+						float w = range_lut(fabs(p - level));
+						row_w[x + rad] = w;
+						row_wp[x + rad] = w * p;
+					}
+
+					float* w_out = &weight(0, y);
+					float* wp_out = &weighted(0, y);
+
+					if (recursive) {
+						gaussian.apply(row_w.data(), row_w.size());
+						gaussian.apply(row_wp.data(), row_wp.size());
+						std::copy_n(row_w.begin() + rad, cols, w_out);
+						std::copy_n(row_wp.begin() + rad, cols, wp_out);
+						continue;
+					}
+
+					for (int x = 0; x < cols; ++x) {
+						float sw = 0.0f, swp = 0.0f;
+						for (int i = 0; i <= 2 * rad; ++i) {
+							sw += spatial[i] * row_w[x + i];
+							swp += spatial[i] * row_wp[x + i];
+						}
+						w_out[x] = sw;
+						wp_out[x] = swp;
+					}
+				}
+			}
+
+			auto interpolate = [&](int y, const float* acc_w, const float* acc_wp) {
+				for (int x = 0; x < cols; ++x) {
+					float d = fabs(pixels(x, y) - level) * inv_step;
+					if (d < 1.0f && acc_w[x] > 0.0f)
+						result(x, y) += (1.0f - d) * acc_wp[x] / acc_w[x];
+				}
+			};
+
+			//vertical spatial pass, then interpolate between the two nearest levels
+			if (recursive) {
+#pragma omp parallel
+				{
+					std::vector<float> col_w(rows + 2 * rad);
+					std::vector<float> col_wp(rows + 2 * rad);
+
+#pragma omp for
+					for (int x = 0; x < cols; ++x) {
+
+						for (int y = -rad; y < rows + rad; ++y) {
+							col_w[y + rad] = weight(x, mirrorIndex(y, rows));
+							col_wp[y + rad] = weighted(x, mirrorIndex(y, rows));
+						}
+
+						gaussian.apply(col_w.data(), col_w.size());
+						gaussian.apply(col_wp.data(), col_wp.size());
+
+						for (int y = 0; y < rows; ++y) {
+							weight(x, y) = col_w[y + rad];
+							weighted(x, y) = col_wp[y + rad];
+						}
+					}
+				}
+
+#pragma omp parallel for
+				for (int y = 0; y < rows; ++y)
+					interpolate(y, &weight(0, y), &weighted(0, y));
+
+				continue;
+			}
+
+#pragma omp parallel
+			{
+				std::vector<float> acc_w(cols);
+				std::vector<float> acc_wp(cols);
+
+#pragma omp for
+				for (int y = 0; y < rows; ++y) {
+
+					std::fill(acc_w.begin(), acc_w.end(), 0.0f);
+					std::fill(acc_wp.begin(), acc_wp.end(), 0.0f);
+
+					for (int j = -rad; j <= rad; ++j) {
+						int yy = mirrorIndex(y + j, rows);
+						float g = spatial[j + rad];
+						const float* w = &weight(0, yy);
+						const float* wp = &weighted(0, yy);
+
+						for (int x = 0; x < cols; ++x) {
+							acc_w[x] += g * w[x];
+							acc_wp[x] += g * wp[x];
+						}
+					}
+
+					interpolate(y, acc_w.data(), acc_wp.data());
+				}
+			}
+		}
+
+#pragma omp parallel for
+		for (int y = 0; y < rows; ++y)
+			for (int x = 0; x < cols; ++x)
+				dst(x, y, ch) = Pixel<T>::toType(result(x, y));
+	}
+}
+template void BilateralFilter::fastFilter(const Image8&, Image8&);
+template void BilateralFilter::fastFilter(const Image16&, Image16&);
+template void BilateralFilter::fastFilter(const Image32&, Image32&);
+
 template<typename T>
 void BilateralFilter::apply(Image<T>& img) {
 
 	Image<T> temp(img.rows(), img.cols(), img.channels());
 
+	if (useFastPath()) {
+		fastFilter(img, temp);
+		return temp.moveTo(img);
+	}
+
 	auto gaussian = generateGausianKernel(m_kernel_dim, m_sigma_s);
 	Kernel<T> kernel(img, m_kernel_dim);
 	auto kmask = generateMask(m_kernel_dim, m_is_circular);
@@ -94,18 +350,50 @@ template void BilateralFilter::apply(Image32&);
 template<typename T>
 void BilateralFilter::applyTo(const Image<T>& src, Image<T>& dst, float scale_factor, const QRectF& r) {
 
-	auto gaussian = generateGausianKernel(m_kernel_dim, m_sigma_s);
-	std::vector<uint8_t> kmask(m_kernel_dim * m_kernel_dim, true);
-
 	if (dst.cols() != uint32_t(r.width() * scale_factor) || dst.rows() != uint32_t(r.height() * scale_factor) || dst.channels() != src.channels()) 
 		dst = Image<T>(r.height() * scale_factor, r.width() * scale_factor, src.channels());
 
 	int kernel_rad = (m_kernel_dim - 1) / 2;
-	float k_r = 1 / (2 * m_sigma_r * m_sigma_r);
 	float _s = 1 / scale_factor;
 
+	//source region plus a kernel radius border
+	int x0 = math::max<int>(r.x() - kernel_rad, 0);
+	int y0 = math::max<int>(r.y() - kernel_rad, 0);
+	int x1 = math::min<int>(ceil(r.x() + r.width()) + kernel_rad, src.cols());
+	int y1 = math::min<int>(ceil(r.y() + r.height()) + kernel_rad, src.rows());
+
+	if (useFastPath(size_t(y1 - y0) * (x1 - x0), size_t(dst.rows()) * dst.cols())) {
+		//filter the whole region, then sample it
+		Image<T> region(y1 - y0, x1 - x0, src.channels());
+
+		for (uint32_t ch = 0; ch < src.channels(); ++ch)
+#pragma omp parallel for
+			for (int y = 0; y < region.rows(); ++y)
+				for (int x = 0; x < region.cols(); ++x)
+					region(x, y, ch) = src(x + x0, y + y0, ch);
+
+		Image<T> filtered(region.rows(), region.cols(), region.channels());
+		fastFilter(region, filtered);
+
+		for (uint32_t ch = 0; ch < dst.channels(); ++ch)
+#pragma omp parallel for
+			for (int y = 0; y < dst.rows(); ++y) {
+				int y_s = math::min<int>(y * _s + r.y() - y0, filtered.rows() - 1);
+				for (int x = 0; x < dst.cols(); ++x) {
+					int x_s = math::min<int>(x * _s + r.x() - x0, filtered.cols() - 1);
+					dst(x, y, ch) = filtered(x_s, y_s, ch);
+				}
+			}
+
+		return;
+	}
+
+	auto gaussian = generateGausianKernel(m_kernel_dim, m_sigma_s);
+	std::vector<uint8_t> kmask(m_kernel_dim * m_kernel_dim, true);
+	float k_r = 1 / (2 * m_sigma_r * m_sigma_r);
+
 	for (uint32_t ch = 0; ch < dst.channels(); ++ch) {
-#pragma omp parallel for firstprivate(kernel_rad, _s, k_r) num_threads(4)
+#pragma omp parallel for firstprivate(kernel_rad, _s, k_r)
 		for (int y = 0; y < dst.rows(); ++y) {
 			int y_s = y * _s + r.y();
 			int o_x = -1;
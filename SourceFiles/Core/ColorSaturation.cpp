@@ -29,21 +29,47 @@ void ColorSaturation::apply(Image<T>& img) {
     if (!img.exists() || img.channels() == 1)
         return;
 
-#pragma omp parallel for
-    for (int y = 0; y < img.rows(); ++y) {
-		for (int x = 0; x < img.cols(); ++x) {
+#pragma omp parallel
+    {
+        std::vector<float> R(img.cols()), G(img.cols()), B(img.cols()), L(img.cols());
 
-			auto rgb = img.template color<double>(x, y);
+#pragma omp for
+        for (int y = 0; y < img.rows(); ++y) {
 
-			double H, S, V, L;
-			ColorSpace::RGBtoHSVL(rgb, H, S, V, L);
+            for (int x = 0; x < img.cols(); ++x) {
+                R[x] = Pixel<float>::toType(img(x, y, 0));
+                G[x] = Pixel<float>::toType(img(x, y, 1));
+                B[x] = Pixel<float>::toType(img(x, y, 2));
+            }
 
-			shiftHue(H, m_hue_shift);
-			double k = scalingFactor(m_scale * m_saturation_curve.interpolate(H));
-			shiftHue(H, -m_hue_shift);
+            BatchColorSpace::RGBtoCIELRow(R.data(), G.data(), B.data(), L.data(), img.cols());
 
-			img.template setColor<>(x, y, ColorSpace::HSVLtoRGB(H, math::clip(S * k), V, L));
-		}
+            for (int x = 0; x < img.cols(); ++x) {
+
+                double H, S, V;
+                ColorSpace::RGBtoHSV(Color<double>(R[x], G[x], B[x]), H, S, V);
+
+                shiftHue(H, m_hue_shift);
+                double k = scalingFactor(m_scale * m_saturation_curve.interpolate(H));
+                shiftHue(H, -m_hue_shift);
+
+                auto rgb = ColorSpace::HSVtoRGB(H, math::clip(S * k), V);
+                R[x] = rgb.red;
+                G[x] = rgb.green;
+                B[x] = rgb.blue;
+            }
+
+            //restore the original lightness
+            BatchColorSpace::RGBtoCIELabRow(R.data(), G.data(), B.data(), img.cols());
+            memcpy(R.data(), L.data(), img.cols() * sizeof(float));
+            BatchColorSpace::CIELabtoRGBRow(R.data(), G.data(), B.data(), img.cols());
+
+            for (int x = 0; x < img.cols(); ++x) {
+                img(x, y, 0) = Pixel<T>::toType(R[x]);
+                img(x, y, 1) = Pixel<T>::toType(G[x]);
+                img(x, y, 2) = Pixel<T>::toType(B[x]);
+            }
+        }
     }
 }
 template void ColorSaturation::apply(Image8&);
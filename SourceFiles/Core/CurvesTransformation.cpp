@@ -29,39 +29,32 @@ void CurveTransform::apply(Image<T>& img) {
 	using CC = ColorComponent;
 	using CCR = const Curve&;
 
-	auto applyChannel = [&, this](const Curve& curve, int ch) {
-		for (auto& p : ImageChannel(img, ch))
-			p = Pixel<T>::toType(math::clip(curve.interpolate(Pixel<float>::toType(p))));
-	};
+	PointOperation op;
 
 	CCR RGB_K = ccurve(CC::rgb_k);
-
-	if (!RGB_K.isIdentity()) {
-
-		for (int ch = 0; ch < img.channels(); ++ch)
-			std::thread(applyChannel, RGB_K, ch).join();
+	if (!RGB_K.isIdentity())
+		op.append([&RGB_K](float pixel) { return float(RGB_K.interpolate(pixel)); });
+
+	if (img.channels() == 3) {
+		for (int ch = 0; ch < 3; ++ch) {
+			CCR curve = ccurve(ColorComponent(ch));
+			if (!curve.isIdentity())
+				op.append(ch, [&curve](float pixel) { return float(curve.interpolate(pixel)); });
+		}
 	}
 
+	op.apply(img);
+
 	if (img.channels() == 1)
 		return;
 
-	CCR red = ccurve(CC::red);
-	CCR green = ccurve(CC::green);
-	CCR blue = ccurve(CC::blue);
-
-	if (!red.isIdentity() || !green.isIdentity() || !blue.isIdentity()) {
-		std::thread(applyChannel, red, 0).join();
-		std::thread(applyChannel, green, 1).join();
-		std::thread(applyChannel, blue, 2).join();
-	}
-
 	CCR Lightness = ccurve(CC::Lightness);
 	CCR a = ccurve(CC::a);
 	CCR b = ccurve(CC::b);
 
 	if (!Lightness.isIdentity() || !a.isIdentity() || !b.isIdentity()) {
 
-#pragma omp parallel for num_threads(3)
+#pragma omp parallel for
 		for (int y = 0; y < img.rows(); ++y) {
 			for (int x = 0; x < img.cols(); ++x) {
 				auto rgb = img.template color<double>(x, y);
@@ -81,7 +74,7 @@ void CurveTransform::apply(Image<T>& img) {
 
 	if (!c.isIdentity()) {
 
-#pragma omp parallel for num_threads(3)
+#pragma omp parallel for
 		for (int y = 0; y < img.rows(); ++y) {
 			for (int x = 0; x < img.cols(); ++x) {
 				auto rgb = img.template color<double>(x, y);
@@ -101,7 +94,7 @@ void CurveTransform::apply(Image<T>& img) {
 	CCR Saturation = ccurve(CC::saturation);
 
 	if (!Hue.isIdentity() || !Saturation.isIdentity()) {
-#pragma omp parallel for num_threads(3)
+#pragma omp parallel for
 		for (int y = 0; y < img.rows(); ++y) {
 			for (int x = 0; x < img.cols(); ++x) {
 				auto rgb = img.template color<double>(x, y);
@@ -0,0 +1,100 @@
+#include "pch.h"
+#include "DisplayRenderer.h"
+#include "ThreadPool.h"
+
+template<typename T>
+void DisplayLUT<T>::build(const HistogramTransformation* stf) {
+
+	auto display = [stf](float pixel) {
+		if (stf)
+			pixel = stf->transformPixel(ColorComponent::rgb_k, pixel);
+		return pixel;
+	};
+
+	if constexpr (std::is_same_v<T, float>) {
+		m_table.resize(m_float_segments + 1);
+		m_slope.resize(m_float_segments);
+
+		for (int el = 0; el <= m_float_segments; ++el)
+			m_table[el] = 255.0f * math::clipf(display(float(el) / m_float_segments));
+
+		for (int el = 0; el < m_float_segments; ++el)
+			m_slope[el] = m_table[el + 1] - m_table[el];
+	}
+	else {
+		//same steps the per pixel display path took, so integer images look exactly as before
+		m_lut.resize(int(Pixel<T>::max()) + 1);
+
+		for (int el = 0; el < m_lut.size(); ++el) {
+			T pixel = T(el);
+			if (stf)
+				pixel = Pixel<T>::toType(display(Pixel<float>::toType(pixel)));
+			m_lut[el] = Pixel<uint8_t>::toType(pixel);
+		}
+	}
+}
+template class DisplayLUT<uint8_t>;
+template class DisplayLUT<uint16_t>;
+template class DisplayLUT<float>;
+
+std::vector<int> DisplayRenderer::binIndices(double offset, uint32_t count, int factor, int level, int bin, uint32_t size) {
+
+	std::vector<int> indices(count);
+
+	for (int i = 0, s = offset; i < count; ++i, s += factor)
+		indices[i] = math::max(0, math::min(s >> level, int(size) - bin));
+
+	return indices;
+}
+
+std::vector<int> DisplayRenderer::upsampleIndices(int first, uint32_t count, int factor, uint32_t size) {
+
+	std::vector<int> indices(count);
+
+	for (int i = 0; i < count; ++i)
+		indices[i] = math::max(0, math::min((first + i) / factor, int(size) - 1));
+
+	return indices;
+}
+
+template<typename T>
+void DisplayRenderer::render(const Image<T>& src, const std::vector<int>& xs, const std::vector<int>& ys, int bin, const DisplayLUT<T>& lut, const DisplayBuffer& dst) {
+
+	const int cols = xs.size();
+	const int channels = dst.channels;
+	const float norm = 1.0f / (bin * bin);
+
+	ThreadPool::parallelFor(0, ys.size(), [&](int start, int end) {
+
+		std::vector<float> sums(cols);
+
+		for (int y = start; y < end; ++y) {
+			uint8_t* out = dst.row(y);
+
+			for (int ch = 0; ch < channels; ++ch) {
+
+				if (bin == 1) {
+					const T* s = &src(0, ys[y], ch);
+					for (int x = 0; x < cols; ++x)
+						out[x * channels + ch] = lut(s[xs[x]]);
+					continue;
+				}
+
+				//whole source rows at a time, so each one is read once per display row
+				std::fill(sums.begin(), sums.end(), 0.0f);
+				for (int j = 0; j < bin; ++j) {
+					const T* s = &src(0, ys[y] + j, ch);
+					for (int x = 0; x < cols; ++x)
+						for (int i = 0; i < bin; ++i)
+							sums[x] += s[xs[x] + i];
+				}
+
+				for (int x = 0; x < cols; ++x)
+					out[x * channels + ch] = lut(T(sums[x] * norm));
+			}
+		}
+	});
+}
+template void DisplayRenderer::render(const Image8&, const std::vector<int>&, const std::vector<int>&, int, const DisplayLUT<uint8_t>&, const DisplayBuffer&);
+template void DisplayRenderer::render(const Image16&, const std::vector<int>&, const std::vector<int>&, int, const DisplayLUT<uint16_t>&, const DisplayBuffer&);
+template void DisplayRenderer::render(const Image32&, const std::vector<int>&, const std::vector<int>&, int, const DisplayLUT<float>&, const DisplayBuffer&);
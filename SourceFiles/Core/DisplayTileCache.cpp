@@ -0,0 +1,78 @@
+#include "pch.h"
+#include "DisplayTileCache.h"
+
+void DisplayTileCache::clear() {
+
+	m_shared_bytes -= m_bytes;
+	m_bytes = 0;
+	m_tiles.clear();
+	m_index.clear();
+}
+
+const DisplayTileCache::Tile& DisplayTileCache::tile(const Key& key, const Render& render) {
+
+	auto it = m_index.find(key);
+
+	if (it != m_index.end()) {
+		m_tiles.splice(m_tiles.begin(), m_tiles, it->second);
+		return m_tiles.front();
+	}
+
+	size_t bytes = size_t(m_tile_size) * m_tile_size * m_channels;
+
+	//reuses the least recently used tile's storage once the shared budget is spent
+	if (!m_tiles.empty() && m_shared_bytes + bytes > m_max_bytes) {
+		m_index.erase(m_tiles.back().key);
+		m_tiles.splice(m_tiles.begin(), m_tiles, std::prev(m_tiles.end()));
+	}
+	else {
+		m_tiles.emplace_front();
+		m_shared_bytes += bytes;
+		m_bytes += bytes;
+	}
+
+	Tile& t = m_tiles.front();
+	t.key = key;
+	t.pixels.resize(bytes);
+
+	render(key.tx * m_tile_size, key.ty * m_tile_size, { t.pixels.data(), m_channels, size_t(m_tile_size) * m_channels });
+
+	m_index[key] = m_tiles.begin();
+	return t;
+}
+
+void DisplayTileCache::draw(int zoom, int variant, int x, int y, uint32_t cols, uint32_t rows, const Render& render, const DisplayBuffer& dst) {
+
+	if (dst.channels != m_channels) {
+		clear();
+		m_channels = dst.channels;
+	}
+
+	if (cols == 0 || rows == 0)
+		return;
+
+	auto tileIndex = [](int v) { return (v >= 0) ? v / m_tile_size : (v - m_tile_size + 1) / m_tile_size; };
+
+	int tx0 = tileIndex(x), tx1 = tileIndex(x + int(cols) - 1);
+	int ty0 = tileIndex(y), ty1 = tileIndex(y + int(rows) - 1);
+
+	for (int ty = ty0; ty <= ty1; ++ty) {
+		for (int tx = tx0; tx <= tx1; ++tx) {
+
+			const Tile& t = tile({ zoom, variant, tx, ty }, render);
+
+			//part of the tile inside the requested area, in display coordinates
+			int left = math::max(x, tx * m_tile_size);
+			int right = math::min(x + int(cols), (tx + 1) * m_tile_size);
+			int top = math::max(y, ty * m_tile_size);
+			int bottom = math::min(y + int(rows), (ty + 1) * m_tile_size);
+
+			size_t bytes = size_t(right - left) * m_channels;
+
+			for (int r = top; r < bottom; ++r) {
+				const uint8_t* s = &t.pixels[(size_t(r - ty * m_tile_size) * m_tile_size + (left - tx * m_tile_size)) * m_channels];
+				memcpy(dst.row(r - y) + size_t(left - x) * m_channels, s, bytes);
+			}
+		}
+	}
+}
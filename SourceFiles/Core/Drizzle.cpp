@@ -125,9 +125,6 @@ Status DrizzleIntegrationProcesss::drizzleImages(Image32& output) {
 
 	ImageCalibrator calibrator = m_calibrator;
 
-	calibrator.setMasterDarkPath(m_dark_path);
-	calibrator.setMasterFlatPath(m_flat_path);
-
 	m_iss.emitText("Drizzling " + QString::number(m_light_paths.size()) + " Images...");
 	m_iss.emitText("Drop size: " + QString::number(m_drizzle.dropSize()));
 	m_iss.emitText("Scale Factor: " + QString::number(m_drizzle.scaleFactor()));
@@ -139,16 +136,25 @@ Status DrizzleIntegrationProcesss::drizzleImages(Image32& output) {
 		//m_iss.emitText(m_light_paths[i].string().c_str());
 
 		Image32 src;
-		FITS fits;
-		fits.open(m_light_paths[i]);
-		fits.readAny(src);
-		calibrator.calibrateImage(src);
+		{
+			StageTimer::Scope stage(m_stage_timer, "read");
+			FITS fits;
+			fits.open(m_light_paths[i]);
+			fits.readAny(src);
+		}
+
+		{
+			StageTimer::Scope stage(m_stage_timer, "calibration");
+			calibrator.calibrateImage(src);
+		}
 
 		//need to scale/normalize images before drizzle
 
 		if (i == 0)
 			output = Image32(src.rows() * m_drizzle.scaleFactor(), src.cols() * m_drizzle.scaleFactor(), src.channels());
 
+		StageTimer::Scope stage(m_stage_timer, "drizzle");
+
 		if (m_weight_paths.size() == m_light_paths.size()) {
 			Image8 wm;
 			WeightMapImage wmi;
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "ExponentialTransformation.h"
 #include "RGBColorSpace.h"
+#include "PointOperation.h"
 
 
 using ET = ExponentialTransformation;
@@ -8,13 +9,24 @@ using ET = ExponentialTransformation;
 template<typename T>
 void ET::apply(Image<T>& img) {
 
+    //without a smoothed or lightness mask each pixel depends only on itself
+    if (sigma() == 0.0f && !lightnessMask()) {
+        PointOperation op;
+        op.append([this](float pixel) {
+            float pix = pow(1 - pixel, order());
+            return (method() == Method::power_inverted_pixels) ? pow(pixel, pix) : 1 - (1 - pixel) * pix;
+            });
+
+        return op.apply(img);
+    }
+
     Image<T> mask;
     if (sigma() != 0.0f) {
         img.copyTo(mask);
         m_gf.apply(mask);
     }
 
-    Threads(2).run([&, this](uint32_t start, uint32_t end) {
+    Threads().run([&, this](uint32_t start, uint32_t end) {
         //auto id = std::this_thread::get_id();
         //std::hash<std::thread::id> hasher;
 
@@ -240,4 +240,76 @@ void Histogram::convertToCDF() {
 
 	for (int i = 1; i < resolution(); ++i)
 		m_data[i] += m_data[i - 1];
-}
\ No newline at end of file
+}
+
+
+
+
+template<typename T>
+HistogramVector HistogramBuilder::build(const ImageView<const T>& view, Histogram::Resolution resolution) {
+
+	const uint32_t size = Histogram::resolutionValue(resolution);
+	const int channels = view.channels();
+	const int cols = view.cols();
+
+	HistogramVector histograms(channels, Histogram(resolution));
+
+	if (view.empty())
+		return histograms;
+
+	//small histograms get a set of bins per lane so runs of equal pixels do not queue on one counter
+	const int lanes = (size <= 4096) ? 4 : 1;
+
+	std::vector<uint32_t> lut;
+	if constexpr (!std::is_same_v<T, float>) {
+		lut.resize(uint32_t(Pixel<T>::max()) + 1);
+		for (uint32_t v = 0; v < lut.size(); ++v)
+			lut[v] = uint64_t(v) * (size - 1) / Pixel<T>::max();
+	}
+
+	auto bin = [&](T pixel) -> uint32_t {
+		if constexpr (std::is_same_v<T, float>)
+			return (pixel > 0.0f) ? uint32_t(math::min(pixel, 1.0f) * (size - 1)) : 0;
+		else
+			return lut[pixel];
+	};
+
+	//chunks cover a few times the bins they have to clear and merge, small images stay on one thread
+	int min_rows = (uint64_t(4) * lanes * size + cols - 1) / cols;
+
+	auto counts = accumulate(view.rows(), channels * lanes, size, [&](int start, int end, uint32_t** bins) {
+
+		for (int ch = 0; ch < channels; ++ch) {
+
+			uint32_t** b = bins + ch * lanes;
+
+			for (int y = start; y < end; ++y) {
+
+				const T* row = view.row(y, ch);
+				int x = 0;
+
+				if (lanes == 4) {
+					for (; x + 4 <= cols; x += 4) {
+						b[0][bin(row[x])]++;
+						b[1][bin(row[x + 1])]++;
+						b[2][bin(row[x + 2])]++;
+						b[3][bin(row[x + 3])]++;
+					}
+				}
+
+				for (; x < cols; ++x)
+					b[0][bin(row[x])]++;
+			}
+		}
+		}, min_rows);
+
+	for (int ch = 0; ch < channels; ++ch)
+		for (int l = 0; l < lanes; ++l)
+			for (uint32_t i = 0; i < size; ++i)
+				histograms[ch][i] += counts[ch * lanes + l][i];
+
+	return histograms;
+}
+template HistogramVector HistogramBuilder::build(const ImageView<const uint8_t>&, Histogram::Resolution);
+template HistogramVector HistogramBuilder::build(const ImageView<const uint16_t>&, Histogram::Resolution);
+template HistogramVector HistogramBuilder::build(const ImageView<const float>&, Histogram::Resolution);
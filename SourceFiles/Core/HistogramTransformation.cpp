@@ -24,43 +24,6 @@ float HT::MTFCurve::transformPixel(float pixel)const {
 	return MTF(pixel);
 }
 
-void HT::MTFCurve::generate16Bit_LUT() {
-	m_lut.resize(65536);
-	for (int el = 0; el < 65536; ++el)
-		m_lut[el] = transformPixel(el / 65535.0f) * 65535;
-}
-
-void HT::MTFCurve::generate8Bit_LUT() {
-	m_lut.resize(256);
-	for (int el = 0; el < 256; ++el)
-		m_lut[el] = transformPixel(el / 255.0f) * 255;
-}
-
-template <typename T>
-void HT::MTFCurve::applyChannel(Image<T>& img, int ch) {
-
-	if (isFloatImage(img))
-		for (auto pixel = img.begin(ch); pixel != img.end(ch); ++pixel)
-			*pixel = transformPixel(*pixel);
-
-	else {
-		if (isUByteImage(img))
-			generate8Bit_LUT();
-
-		else if (isUShortImage(img))
-			generate16Bit_LUT();
-
-		for (auto pixel = img.begin(ch); pixel != img.end(ch); ++pixel)
-			*pixel = m_lut[*pixel];
-	}
-}
-template void HT::MTFCurve::applyChannel(Image8&, int);
-template void HT::MTFCurve::applyChannel(Image16&, int);
-template void HT::MTFCurve::applyChannel(Image32&, int);
-
-
-
-
 float HT::transformPixel(ColorComponent component, float pixel)const {
 	return (*this)[component].transformPixel(pixel);
 }
@@ -100,7 +63,7 @@ void HT::computeSTFCurve(const Image<T>& img){
 
 	float median = 0, nMAD = 0;
 	for (int ch = 0; ch < img.channels(); ++ch) {
-		T cm = img.computeMedian(ch, true);
+		T cm = img.computeMedian(ch, true, Quantile::Mode::approximate);
 		median += cm;
 		nMAD += img.compute_nMAD(ch, cm, true);
 	}
@@ -123,38 +86,21 @@ void HT::apply(Image<T>& img) {
 
 	using CC = ColorComponent;
 
-	if (!(*this)[CC::rgb_k].isIdentity()) {
-		auto rgbk = (*this)[CC::rgb_k];
-
-		if (isFloatImage(img))
-			for (auto& pixel : img)
-				pixel = rgbk.transformPixel(pixel);
-
-		else {
-			if (isUByteImage(img))
-				rgbk.generate8Bit_LUT();
+	PointOperation op;
 
-			else if (isUShortImage(img))
-				rgbk.generate16Bit_LUT();
+	auto rgbk = (*this)[CC::rgb_k];
+	if (!rgbk.isIdentity())
+		op.append([rgbk](float pixel) { return rgbk.transformPixel(pixel); });
 
-			for (auto& pixel : img)
-				pixel = rgbk.m_lut[pixel];
+	if (img.channels() == 3) {
+		for (int ch = 0; ch < 3; ++ch) {
+			auto curve = (*this)[ColorComponent(ch)];
+			if (!curve.isIdentity())
+				op.append(ch, [curve](float pixel) { return curve.transformPixel(pixel); });
 		}
-
 	}
 
-	if (img.channels() == 1)
-		return;
-
-	if (!(*this)[CC::red].isIdentity())
-		(*this)[CC::red].applyChannel(img, 0);
-
-	if (!(*this)[CC::green].isIdentity())
-		(*this)[CC::green].applyChannel(img, 1);
-
-	if (!(*this)[CC::blue].isIdentity())
-		(*this)[CC::blue].applyChannel(img, 2);
-
+	op.apply(img);
 }
 template void HT::apply(Image8&);
 template void HT::apply(Image16&);
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "Image.h"
 #include "Histogram.h"
+#include "ImageStatistics.h"
 
 //class Histogram;
 
@@ -10,7 +11,7 @@ Image<T>::Image(uint32_t rows, uint32_t cols, uint32_t ch) :m_rows(rows), m_cols
 
 	m_type = getImageType<T>();
 
-	m_data = std::make_unique<T[]>(rows * cols * ch);
+	m_data = ImageAllocator::make<T>(rows * cols * ch);
 
 	if (m_channels == 3) {
 		m_red = m_data.get();
@@ -33,7 +34,7 @@ Image<T>::Image(const Image<T>& other) {
 
 	//homography = other.homography;
 	//
-	m_data = std::make_unique<T[]>(m_total_pixel_count);
+	m_data = ImageAllocator::make<T>(m_total_pixel_count, false);
 	memcpy(m_data.get(), other.m_data.get(), m_total_pixel_count * sizeof(T));
 
 	if (m_channels == 3) {
@@ -66,11 +67,8 @@ Image<T> Image<T>::createGrayscaleImage()const {
 
 	Image<T> gray(rows(), cols());
 
-	if (m_channels == 3) {
-#pragma omp parallel for num_threads(2)
-		for (int el = 0; el < pxCount(); ++el)
-			gray[el] = Pixel<T>::toType(ColorSpace::CIEL(this->color<double>(el)));
-	}
+	if (m_channels == 3)
+		BatchColorSpace::RGBtoCIEL(m_red, m_green, m_blue, gray.data(), pxCount());
 	else
 		memcpy(&gray[0], &m_data[0], pxCount() * sizeof(T));
 
@@ -283,12 +281,9 @@ float Image<T>::computeMean(int ch, bool clip)const {
 }
 
 template<typename T>
-T Image<T>::computeMedian(int ch, bool clip)const {
-
-	Histogram histogram;
-	histogram.constructHistogram(*this, ch);
+T Image<T>::computeMedian(int ch, bool clip, Quantile::Mode mode)const {
 
-	return (m_type == ImageType::FLOAT) ? histogram.medianf(clip) : histogram.median(clip);
+	return Quantile::median(channelView(ch), clip, mode);
 }
 
 template<typename T>
@@ -319,7 +314,7 @@ float Image<T>::computeStdDev(int ch, float mean, bool clip)const {
 template<typename T>
 float Image<T>::computeAvgDev(int ch, bool clip)const {
 
-	T median = computeMedian(ch, clip);
+	T median = computeMedian(ch, clip, Quantile::Mode::exact);
 
 	return computeAvgDev(ch, median, clip);
 }
@@ -341,21 +336,13 @@ float Image<T>::computeAvgDev(int ch, T median, bool clip)const {
 template<typename T>
 T Image<T>::computeMAD(int ch, bool clip)const {
 
-	T median = computeMedian(ch, clip);
-
-	Histogram histogram;
-	histogram.constructMADHistogram(*this, ch, median, clip);
-
-	return (m_type == ImageType::FLOAT) ? histogram.medianf(clip) : histogram.median(clip);
+	return computeMAD(ch, computeMedian(ch, clip, Quantile::Mode::exact), clip);
 }
 
 template<typename T>
 T Image<T>::computeMAD(int ch, T median, bool clip)const {
 
-	Histogram histogram;
-	histogram.constructMADHistogram(*this, ch, median, clip);
-
-	return (m_type == ImageType::FLOAT) ? histogram.medianf(clip) : histogram.median(clip);
+	return Quantile::mad(channelView(ch), median, clip);
 }
 
 template<typename T>
@@ -373,37 +360,13 @@ float Image<T>::compute_nMAD(int ch, T median, bool clip)const {
 template<typename T>
 float Image<T>::computeBWMV(int ch, bool clip)const {
 
-	T median = computeMedian(ch, clip);
-
-	return computeBWMV(ch, median, clip);
+	return ImageStatistics(channelView(ch)).channel(0, clip).sqrtBWMV;
 }
 
 template<typename T>
 float Image<T>::computeBWMV(int ch, T median, bool clip)const {
 
-	T mad = computeMAD(ch, median, clip);
-
-	double x9mad = 1 / (9 * mad);
-	double sum1 = 0, sum2 = 0;
-	double Y, a;
-	int count = 0;
-
-	for (T pixel : image_channel(*this, ch)) {
-
-		if (clip && isClipped(pixel)) continue;
-
-		Y = (pixel - median) * x9mad;
-
-		(abs(Y) < 1) ? a = 1 : a = 0;
-
-		Y *= Y;
-
-		sum1 += (a * pow(pixel - median, 2) * pow(1 - Y, 4));
-		sum2 += (a * (1 - Y) * (1 - 5 * Y));
-		count++;
-	}
-
-	return sqrt((count * sum1) / (abs(sum2) * abs(sum2)));
+	return ImageStatistics::sqrtBWMV(channelView(ch), median, clip);
 }
 
 template class Image<uint8_t>;
@@ -0,0 +1,225 @@
+#include "pch.h"
+#include "ImageAllocator.h"
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+	//sits in front of every buffer, its size keeps the buffer aligned
+	struct alignas(ImageAllocator::alignment) BlockHeader {
+		size_t size_class = 0;
+		size_t mapped_size = 0; //nonzero when the block is huge page backed
+	};
+
+	constexpr size_t min_pooled = 1 << 20;
+	constexpr size_t huge_page_min = 2 << 20;
+
+	struct Pool {
+		std::mutex mutex;
+		std::unordered_map<size_t, std::vector<BlockHeader*>> buckets;
+		size_t pooled_bytes = 0;
+		size_t limit = size_t(1) << 30;
+		std::atomic_bool huge_pages = false;
+		std::atomic<size_t> live_bytes = 0;
+		std::atomic<size_t> peak_bytes = 0;
+	};
+
+	//never destroyed, images in statics may still be freed during exit
+	Pool& pool() {
+		static Pool* p = new Pool;
+		return *p;
+	}
+
+	//8 classes per power of two above min_pooled, so a reused buffer is at most 12.5% larger
+	size_t sizeClass(size_t bytes) {
+
+		size_t step = ImageAllocator::alignment;
+
+		if (bytes > min_pooled)
+			step = size_t(1) << (std::bit_width(bytes - 1) - 4);
+
+		return (bytes + step - 1) & ~(step - 1);
+	}
+
+	BlockHeader* mapHuge(size_t bytes) {
+
+		bytes += sizeof(BlockHeader);
+
+#ifdef _WIN32
+		size_t page = GetLargePageMinimum();
+		if (page == 0)
+			return nullptr;
+
+		bytes = (bytes + page - 1) & ~(page - 1);
+		void* ptr = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+#else
+		bytes = (bytes + huge_page_min - 1) & ~(huge_page_min - 1);
+		void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED)
+			return nullptr;
+		madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+		if (ptr == nullptr)
+			return nullptr;
+
+		BlockHeader* block = new (ptr) BlockHeader;
+		block->mapped_size = bytes;
+		return block;
+	}
+
+	void freeBlock(BlockHeader* block) {
+
+		if (block->mapped_size == 0)
+			return ::operator delete(block, std::align_val_t(ImageAllocator::alignment));
+
+#ifdef _WIN32
+		VirtualFree(block, 0, MEM_RELEASE);
+#else
+		munmap(block, block->mapped_size);
+#endif
+	}
+}
+
+void* ImageAllocator::allocate(size_t bytes, bool zero) {
+
+	size_t size_class = sizeClass(bytes);
+	BlockHeader* block = nullptr;
+
+	if (size_class >= min_pooled) {
+		Pool& p = pool();
+		std::lock_guard<std::mutex> lg(p.mutex);
+
+		auto it = p.buckets.find(size_class);
+		if (it != p.buckets.end() && !it->second.empty()) {
+			block = it->second.back();
+			it->second.pop_back();
+			p.pooled_bytes -= size_class;
+		}
+	}
+
+	//fresh pages from the os are already zero
+	bool zeroed = false;
+
+	if (block == nullptr) {
+		if (pool().huge_pages && size_class >= huge_page_min)
+			block = mapHuge(size_class);
+
+		if (block)
+			zeroed = true;
+		else
+			block = new (::operator new(sizeof(BlockHeader) + size_class, std::align_val_t(alignment))) BlockHeader;
+	}
+
+	block->size_class = size_class;
+	void* ptr = block + 1;
+
+	Pool& p = pool();
+	size_t live = p.live_bytes += size_class;
+	size_t peak = p.peak_bytes;
+	while (live > peak && !p.peak_bytes.compare_exchange_weak(peak, live));
+
+	if (zero && !zeroed)
+		memset(ptr, 0, bytes);
+
+	return ptr;
+}
+
+void ImageAllocator::deallocate(void* ptr) {
+
+	if (ptr == nullptr)
+		return;
+
+	BlockHeader* block = static_cast<BlockHeader*>(ptr) - 1;
+	size_t size_class = block->size_class;
+
+	pool().live_bytes -= size_class;
+
+	if (size_class >= min_pooled) {
+		Pool& p = pool();
+		std::lock_guard<std::mutex> lg(p.mutex);
+
+		if (p.pooled_bytes + size_class <= p.limit) {
+			p.buckets[size_class].push_back(block);
+			p.pooled_bytes += size_class;
+			return;
+		}
+	}
+
+	freeBlock(block);
+}
+
+void ImageAllocator::setPoolLimit(size_t bytes) {
+
+	Pool& p = pool();
+	std::lock_guard<std::mutex> lg(p.mutex);
+
+	p.limit = bytes;
+
+	//drop the largest buffers first until under the new limit
+	while (p.pooled_bytes > p.limit) {
+		auto largest = p.buckets.end();
+		for (auto it = p.buckets.begin(); it != p.buckets.end(); ++it)
+			if (!it->second.empty() && (largest == p.buckets.end() || it->first > largest->first))
+				largest = it;
+
+		freeBlock(largest->second.back());
+		largest->second.pop_back();
+		p.pooled_bytes -= largest->first;
+	}
+}
+
+size_t ImageAllocator::poolLimit() {
+
+	Pool& p = pool();
+	std::lock_guard<std::mutex> lg(p.mutex);
+	return p.limit;
+}
+
+size_t ImageAllocator::pooledBytes() {
+
+	Pool& p = pool();
+	std::lock_guard<std::mutex> lg(p.mutex);
+	return p.pooled_bytes;
+}
+
+size_t ImageAllocator::liveBytes() {
+	return pool().live_bytes;
+}
+
+size_t ImageAllocator::peakBytes() {
+	return pool().peak_bytes;
+}
+
+void ImageAllocator::resetPeak() {
+	pool().peak_bytes = pool().live_bytes.load();
+}
+
+void ImageAllocator::releasePool() {
+
+	Pool& p = pool();
+	std::lock_guard<std::mutex> lg(p.mutex);
+
+	for (auto& bucket : p.buckets)
+		for (auto block : bucket.second)
+			freeBlock(block);
+
+	p.buckets.clear();
+	p.pooled_bytes = 0;
+}
+
+void ImageAllocator::setHugePages(bool enable) {
+	pool().huge_pages = enable;
+}
+
+bool ImageAllocator::hugePages() {
+	return pool().huge_pages;
+}
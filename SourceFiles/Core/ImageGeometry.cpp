@@ -390,14 +390,7 @@ template void Resize::apply(Image32&);
 template<typename T>
 void Crop::apply(Image<T>& src) {
 
-	Image<T> temp(m_y2 - m_y1, m_x2 - m_x1, src.channels());
-
-	for (int ch = 0; ch < src.channels(); ++ch)
-		for (int y = 0; y < temp.rows(); ++y)
-			for (int x = 0; x < temp.cols(); ++x)
-				temp(x, y, ch) = src(x + m_x1, y + m_y1, ch);
-
-	src = std::move(temp);
+	src = Image<T>(src.region(m_x1, m_y1, m_x2 - m_x1, m_y2 - m_y1));
 }
 template void Crop::apply(Image8&);
 template void Crop::apply(Image16&);
@@ -0,0 +1,71 @@
+#include "pch.h"
+#include "ImagePyramid.h"
+#include "ThreadPool.h"
+
+template<typename T>
+int ImagePyramid<T>::maxLevel()const {
+
+	int level = 0;
+	while ((m_source->rows() >> (level + 1)) > 1 && (m_source->cols() >> (level + 1)) > 1)
+		level++;
+
+	return level;
+}
+
+template<typename T>
+int ImagePyramid<T>::levelForFactor(int factor)const {
+
+	int level = 0;
+	while ((2 << level) <= factor)
+		level++;
+
+	return math::min(level, maxLevel());
+}
+
+template<typename T>
+int ImagePyramid<T>::residualFactor(int factor, int level)const {
+
+	int bin = math::max(1, int(double(factor) / (1 << level) + 0.5));
+
+	return math::min(bin, int(math::min(m_source->rows(), m_source->cols()) >> level));
+}
+
+template<typename T>
+const Image<T>& ImagePyramid<T>::level(int level) {
+
+	level = math::clip(level, 0, maxLevel());
+
+	while (m_levels.size() < level)
+		m_levels.emplace_back(downsample((m_levels.empty()) ? *m_source : m_levels.back()));
+
+	return (level == 0) ? *m_source : m_levels[level - 1];
+}
+
+template<typename T>
+Image<T> ImagePyramid<T>::downsample(const Image<T>& src) {
+
+	Image<T> dst(src.rows() / 2, src.cols() / 2, src.channels());
+
+	//integer types round instead of truncating so repeated halving does not darken
+	constexpr float round = (std::is_floating_point_v<T>) ? 0.0f : 0.5f;
+
+	ThreadPool::parallelFor(0, dst.rows(), [&](int start, int end) {
+		for (uint32_t ch = 0; ch < dst.channels(); ++ch) {
+			for (int y = start; y < end; ++y) {
+
+				const T* s0 = &src(0, 2 * y, ch);
+				const T* s1 = &src(0, 2 * y + 1, ch);
+				T* d = &dst(0, y, ch);
+
+				for (uint32_t x = 0; x < dst.cols(); ++x)
+					d[x] = T((float(s0[2 * x]) + s0[2 * x + 1] + s1[2 * x] + s1[2 * x + 1]) * 0.25f + round);
+			}
+		}
+	});
+
+	return dst;
+}
+
+template class ImagePyramid<uint8_t>;
+template class ImagePyramid<uint16_t>;
+template class ImagePyramid<float>;
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "ImageStacking.h"
 #include "Drizzle.h"
+#include "XISF.h"
 
 ImageStacking::PixelRows::PixelRows(int num_imgs, int width, ImageStacking& is) : m_width(width), m_num_imgs(num_imgs), m_is(&is) {
     m_size = num_imgs * width;
@@ -9,13 +10,15 @@ ImageStacking::PixelRows::PixelRows(int num_imgs, int width, ImageStacking& is)
 
 void ImageStacking::PixelRows::fill(const ImagePoint& start_point) {
 
-//#pragma omp parallel for num_threads(m_max_threads)
     for (int i = 0; i < m_is->m_imgfile_vector.size(); ++i) {
         //get rid of file type?
         switch (m_is->m_imgfile_vector[i]->type()) {
         case ImageFile::Type::FITS:
             dynamic_cast<FITS*>(m_is->m_imgfile_vector[i].get())->readRow_toFloat(&(*this)(0, i), start_point.y(), start_point.channel());
             break;
+        case ImageFile::Type::XISF:
+            dynamic_cast<XISF*>(m_is->m_imgfile_vector[i].get())->readRow_toFloat(&(*this)(0, i), start_point.y(), start_point.channel());
+            break;
         }
     }
 }
@@ -258,35 +261,55 @@ void ImageStacking::openFiles() {
     m_imgfile_vector.reserve(m_file_paths.size());
 
     for (int i = 0; i < m_file_paths.size(); ++i) {
-        std::unique_ptr<FITS> fits(std::make_unique<FITS>());
-        fits->open(m_file_paths[i]);
-        m_imgfile_vector.push_back(std::move(fits));
+        if (XISF::isXISF(m_file_paths[i])) {
+            std::unique_ptr<XISF> xisf(std::make_unique<XISF>());
+            xisf->open(m_file_paths[i]);
+            m_imgfile_vector.push_back(std::move(xisf));
+        }
+        else {
+            std::unique_ptr<FITS> fits(std::make_unique<FITS>());
+            fits->open(m_file_paths[i]);
+            m_imgfile_vector.push_back(std::move(fits));
+        }
     }
 }
 
 bool ImageStacking::isFilesSameDimenisions() {
     int r_rows = 0, r_cols = 0, r_channels = 1;
 
-    FITS fits;
+    XISF xisf;
     for (int i = 0; i < m_file_paths.size(); ++i) {
-        fits.open(m_file_paths[i]);
+        uint32_t rows = 0, cols = 0, channels = 1;
+
+        if (XISF::isXISF(m_file_paths[i])) {
+            xisf.open(m_file_paths[i]);
+            rows = xisf.rows();
+            cols = xisf.cols();
+            channels = xisf.channels();
+            xisf.close();
+        }
+        else {
+            //header only, later opens of the same frame reuse the cached header
+            FITS::FrameInfo info = FITS::readFrameInfo(m_file_paths[i]);
+            rows = info.rows;
+            cols = info.cols;
+            channels = info.channels;
+        }
 
         if (i == 0) {
-            r_rows = fits.rows();
-            r_cols = fits.cols();
-            r_channels = fits.channels();
+            r_rows = rows;
+            r_cols = cols;
+            r_channels = channels;
         }
 
         else {
-            if (r_rows != fits.rows())
+            if (r_rows != rows)
                 return false;
-            if (r_cols != fits.cols())
+            if (r_cols != cols)
                 return false;
-            if (r_channels != fits.channels())
+            if (r_channels != channels)
                 return false;
         }
-
-        fits.close();
     }
 
     return true;
@@ -315,18 +338,26 @@ void ImageStacking::computeScaleEstimators() {
     Image32 temp;
     FITS fits;
 
+    XISF xisf;
+
     for (int i = 0; i < m_file_paths.size(); ++i) {
-        fits.open(m_file_paths[i]);
-        fits.readAny(temp);
+        if (XISF::isXISF(m_file_paths[i])) {
+            xisf.open(m_file_paths[i]);
+            xisf.readAny(temp);
+        }
+        else {
+            fits.open(m_file_paths[i]);
+            fits.readAny(temp);
+        }
         for (int ch = 0; ch < temp.channels(); ++ch) {
             if (m_normalization == additive_scaling || m_normalization == multiplicative_scaling) {
-                m_le[i][ch] = temp.computeMedian(ch, true);
+                m_le[i][ch] = temp.computeMedian(ch, true, Quantile::Mode::exact);
                 mse[i][ch] = temp.computeBWMV(ch, m_le[i][ch], true);
                 //mle[i][ch] = temp.Median(ch);
                 m_sf[i][ch] = mse[0][ch] / mse[i][ch];
             }
             else
-                m_le[i][ch] = temp.computeMedian(ch, true);
+                m_le[i][ch] = temp.computeMedian(ch, true, Quantile::Mode::exact);
         }
         fits.close();
     }
@@ -348,42 +379,54 @@ Status ImageStacking::stackImages(const FileVector& paths, Image32& output) {
         return { false, "Frames must be of same dimensions." };
     }
     
-    computeScaleEstimators();
-    openFiles();
+    try {
+        {
+            StageTimer::Scope stage(m_stage_timer, "normalization");
+            computeScaleEstimators();
+        }
 
-    output = Image32(m_imgfile_vector[0]->rows(), m_imgfile_vector[0]->cols(), m_imgfile_vector[0]->channels());
+        StageTimer::Scope stage(m_stage_timer, "integration");
+        openFiles();
 
-    PixelRows pixel_rows(m_imgfile_vector.size(), output.cols(), *this);
+        output = Image32(m_imgfile_vector[0]->rows(), m_imgfile_vector[0]->cols(), m_imgfile_vector[0]->channels());
 
-    std::vector<float> pixelstack(pixel_rows.count());
+        PixelRows pixel_rows(m_imgfile_vector.size(), output.cols(), *this);
 
-    int max_threads = (omp_get_max_threads() < 4) ? omp_get_max_threads() : 4;
+        m_iss.emitText("Stacking " + QString::number(m_file_paths.size()) + " Images...");
 
-    m_iss.emitText("Stacking " + QString::number(m_file_paths.size()) + " Images...");
+        for (uint32_t ch = 0; ch < output.channels(); ++ch) {
 
-    for (uint32_t ch = 0; ch < output.channels(); ++ch) {
+            for (int y = 0; y < output.rows(); ++y) {
 
-        for (int y = 0; y < output.rows(); ++y) {
+                pixel_rows.fill({ 0, y, ch });
 
-            pixel_rows.fill({ 0, y, ch });
+                ThreadPool::parallelFor(0, output.cols(), [&](int start, int end) {
 
-#pragma omp parallel for firstprivate(pixelstack) num_threads(max_threads)
-            for (int x = 0; x < output.cols(); ++x) {
+                    std::vector<float> pixelstack(pixel_rows.count());
 
-                pixel_rows.fillPixelStack(pixelstack, x, ch);
+                    for (int x = start; x < end; ++x) {
 
-                pixelRejection(pixelstack);
+                        pixel_rows.fillPixelStack(pixelstack, x, ch);
 
-                output(x,y,ch) = pixelIntegration(pixelstack);
+                        pixelRejection(pixelstack);
 
-            }
+                        output(x, y, ch) = pixelIntegration(pixelstack);
+                    }
+                });
 
-            m_iss.emitProgress(((ch + 1) * (y + 1) * 100) / (output.channels() * output.rows()));
+                m_iss.emitProgress(((ch * output.rows() + y + 1) * 100) / (output.channels() * output.rows()));
+            }
         }
-    }
 
-    if (m_normalization != Normalization::none)
-        output.normalize();
+        if (m_normalization != Normalization::none)
+            output.normalize();
+    }
+    catch (const std::exception& e) {
+        closeFiles();
+        m_file_paths.clear();
+        m_imgfile_vector.clear();
+        return { false, e.what() };
+    }
 
     closeFiles();
 
@@ -616,47 +659,59 @@ Status ImageStackingWeightMap::stackImages(const FileVector& paths, Image32& out
         return { false, "Frames must be of same dimensions." };
     }
 
-    computeScaleEstimators();
-    openFiles();
+    try {
+        {
+            StageTimer::Scope stage(m_stage_timer, "normalization");
+            computeScaleEstimators();
+        }
 
-    output = Image32(m_imgfile_vector[0]->rows(), m_imgfile_vector[0]->cols(), m_imgfile_vector[0]->channels());
+        StageTimer::Scope stage(m_stage_timer, "integration");
+        openFiles();
 
-    PixelRows_t pixel_rows(m_imgfile_vector.size(), output.cols(), *this);
+        output = Image32(m_imgfile_vector[0]->rows(), m_imgfile_vector[0]->cols(), m_imgfile_vector[0]->channels());
 
-    m_weight_maps.resize(m_file_paths.size());
-    for (auto& wm : m_weight_maps)
-        wm = Image8(output.rows(), output.cols(), output.channels());
+        PixelRows_t pixel_rows(m_imgfile_vector.size(), output.cols(), *this);
 
-    Pixelstack_t pixelstack(m_file_paths.size());
+        m_weight_maps.resize(m_file_paths.size());
+        for (auto& wm : m_weight_maps)
+            wm = Image8(output.rows(), output.cols(), output.channels());
 
-    int max_threads = (omp_get_max_threads() < 4) ? omp_get_max_threads() : 4;
+        m_issp->emitText("Stacking " + QString::number(m_file_paths.size()) + " Images & Generate Weight Maps...");
 
-    m_issp->emitText("Stacking " + QString::number(m_file_paths.size()) + " Images & Generate Weight Maps...");
+        for (uint32_t ch = 0; ch < output.channels(); ++ch) {
 
-    for (uint32_t ch = 0; ch < output.channels(); ++ch) {
+            for (int y = 0; y < output.rows(); ++y) {
 
-        for (int y = 0; y < output.rows(); ++y) {
+                pixel_rows.fill({ 0, y, ch });
 
-            pixel_rows.fill({ 0, y, ch });
+                ThreadPool::parallelFor(0, output.cols(), [&](int start, int end) {
 
-#pragma omp parallel for firstprivate(pixelstack) num_threads(max_threads)
-            for (int x = 0; x < output.cols(); ++x) {
+                    Pixelstack_t pixelstack(m_file_paths.size());
 
-                pixel_rows.fillPixelStack(pixelstack, x, ch);
+                    for (int x = start; x < end; ++x) {
 
-                pixelRejection({ x,y,ch }, pixelstack);
+                        pixel_rows.fillPixelStack(pixelstack, x, ch);
 
-                output(x, y, ch) = pixelIntegration(pixelstack);
+                        pixelRejection({ x,y,ch }, pixelstack);
 
+                        output(x, y, ch) = pixelIntegration(pixelstack);
+                    }
+                });
+                m_issp->emitProgress(((ch * output.rows() + y + 1) * 100) / (output.channels() * output.rows()));
             }
-            m_issp->emitProgress(((ch + 1) * (y + 1) * 100) / (output.channels() * output.rows()));
         }
-    }
     
-    writeWeightMaps(parent_directory);
+        writeWeightMaps(parent_directory);
 
-    if (m_normalization != Normalization::none)
-        output.normalize();
+        if (m_normalization != Normalization::none)
+            output.normalize();
+    }
+    catch (const std::exception& e) {
+        closeFiles();
+        m_file_paths.clear();
+        m_imgfile_vector.clear();
+        return { false, e.what() };
+    }
 
     closeFiles();
 
@@ -0,0 +1,371 @@
+#include "pch.h"
+#include "ImageStatistics.h"
+#include "ThreadPool.h"
+
+namespace {
+
+	template<typename T>
+	constexpr uint32_t binCount() {
+		return (std::is_same_v<T, float>) ? 65536 : uint32_t(Pixel<T>::max()) + 1;
+	}
+
+	template<typename T>
+	uint32_t binOf(T pixel) {
+		if constexpr (std::is_same_v<T, float>)
+			return (pixel > 0.0f) ? uint32_t(math::min(pixel, 1.0f) * 65535) : 0;
+		else
+			return pixel;
+	}
+
+	//float bins stand for their centre, the top one only holds 1.0
+	template<typename T>
+	double binValue(uint32_t bin) {
+		if constexpr (std::is_same_v<T, float>)
+			return (bin == 65535) ? 1.0 : (bin + 0.5) / 65535;
+		else
+			return bin;
+	}
+
+	template<typename T>
+	double fromPosition(double pos) {
+		if constexpr (std::is_same_v<T, float>)
+			return math::min(pos / 65535, 1.0);
+		else
+			return pos;
+	}
+
+	//position of the r'th smallest value in bins, a float bin spreads its count evenly across its width
+	template<typename T>
+	double rankPosition(const std::vector<uint32_t>& histogram, uint64_t r) {
+
+		uint64_t before = 0;
+
+		for (uint32_t b = 0; b < histogram.size(); ++b) {
+			if (before + histogram[b] > r) {
+				if constexpr (std::is_same_v<T, float>)
+					return b + (r - before + 0.5) / histogram[b];
+				else
+					return b;
+			}
+			before += histogram[b];
+		}
+
+		return histogram.size() - 1;
+	}
+
+	//integer types truncate like Histogram::median
+	template<typename T>
+	double medianPosition(const std::vector<uint32_t>& histogram, uint64_t count) {
+
+		if (count == 0)
+			return 0;
+
+		double m = (rankPosition<T>(histogram, (count - 1) / 2) + rankPosition<T>(histogram, count / 2)) / 2;
+
+		return (std::is_same_v<T, float>) ? m : floor(m);
+	}
+
+	std::vector<uint32_t> deviationHistogram(const std::vector<uint32_t>& histogram, int median_bin) {
+
+		std::vector<uint32_t> deviation(histogram.size(), 0);
+
+		for (int b = 0; b < int(histogram.size()); ++b)
+			deviation[abs(b - median_bin)] += histogram[b];
+
+		return deviation;
+	}
+
+	template<typename T>
+	double averageDeviation(const std::vector<uint32_t>& histogram, uint64_t count, double median) {
+
+		double sum = 0;
+
+		for (uint32_t b = 0; b < histogram.size(); ++b)
+			if (histogram[b])
+				sum += histogram[b] * fabs(binValue<T>(b) - median);
+
+		return (count != 0) ? sum / count : 0;
+	}
+
+	//bins share a value so the weights are computed once per bin instead of once per pixel
+	template<typename T>
+	double biweightMidvariance(const std::vector<uint32_t>& histogram, uint64_t count, double median, double mad) {
+
+		if (mad == 0)
+			return 0;
+
+		double k = 1 / (9 * mad);
+		double sum1 = 0, sum2 = 0;
+
+		for (uint32_t b = 0; b < histogram.size(); ++b) {
+
+			if (histogram[b] == 0)
+				continue;
+
+			double d = binValue<T>(b) - median;
+			double y = d * k;
+			y *= y;
+
+			if (y >= 1)
+				continue;
+
+			double w = (1 - y) * (1 - y);
+			sum1 += histogram[b] * d * d * w * w;
+			sum2 += histogram[b] * (1 - y) * (1 - 5 * y);
+		}
+
+		return (sum2 != 0) ? sqrt(count * sum1) / fabs(sum2) : 0;
+	}
+
+	//kept as count, mean and squared deviations so chunks merge without cancellation
+	struct Moments {
+		uint64_t count = 0;
+		double mean = 0;
+		double m2 = 0;
+
+		Moments() = default;
+
+		//from sums of pixel - shift
+		Moments(uint64_t n, double shift, double sum, double sumsq) : count(n) {
+			if (n == 0)
+				return;
+			mean = shift + sum / n;
+			m2 = math::max(0.0, sumsq - sum * sum / n);
+		}
+
+		void merge(const Moments& other) {
+
+			if (other.count == 0)
+				return;
+
+			if (count == 0) {
+				*this = other;
+				return;
+			}
+
+			uint64_t n = count + other.count;
+			double delta = other.mean - mean;
+
+			mean += delta * other.count / n;
+			m2 += other.m2 + delta * delta * (double(count) * other.count / n);
+			count = n;
+		}
+	};
+
+	template<typename T>
+	struct Partial {
+		Moments all;
+		Moments clipped;
+
+		T min = std::numeric_limits<T>::max();
+		T max = std::numeric_limits<T>::lowest();
+		T clipped_min = std::numeric_limits<T>::max();
+		T clipped_max = std::numeric_limits<T>::lowest();
+
+		//pixels at the type's min and max
+		uint64_t lo = 0;
+		uint64_t hi = 0;
+
+		std::vector<uint32_t> histogram;
+	};
+
+	template<typename T>
+	Partial<T> gather(const ImageView<const T>& view, int ch) {
+
+		constexpr uint32_t bins = binCount<T>();
+		const int cols = view.cols();
+
+		if (view.empty())
+			return Partial<T>();
+
+		//about one histogram per thread, and none covering fewer pixels than it has bins
+		int tc = ThreadPool::threadCount();
+		int grain = math::max((int(view.rows()) + tc - 1) / tc, int((bins + cols - 1) / cols));
+
+		auto map = [&](int start, int end) {
+
+			Partial<T> p;
+			p.histogram.assign(bins, 0);
+			uint32_t* hist = p.histogram.data();
+
+			double shift = view(0, start, ch);
+			double s[4] = {}, q[4] = {};
+
+			for (int y = start; y < end; ++y) {
+
+				const T* row = view.row(y, ch);
+
+				if constexpr (std::is_same_v<T, float>) {
+					for (int x = 0; x < cols; ++x) {
+						float v = row[x];
+						hist[binOf(v)]++;
+
+						if (v == 0.0f)
+							p.lo++;
+						else if (v == 1.0f)
+							p.hi++;
+						else {
+							p.clipped_min = math::min(p.clipped_min, v);
+							p.clipped_max = math::max(p.clipped_max, v);
+						}
+
+						p.min = math::min(p.min, v);
+						p.max = math::max(p.max, v);
+					}
+				}
+				else {
+					for (int x = 0; x < cols; ++x)
+						hist[row[x]]++;
+				}
+
+				//independent accumulators so the loop vectorises without reordering the sums
+				int x = 0;
+				for (; x + 4 <= cols; x += 4) {
+					for (int i = 0; i < 4; ++i) {
+						double d = row[x + i] - shift;
+						s[i] += d;
+						q[i] += d * d;
+					}
+				}
+
+				for (; x < cols; ++x) {
+					double d = row[x] - shift;
+					s[0] += d;
+					q[0] += d * d;
+				}
+			}
+
+			if constexpr (!std::is_same_v<T, float>) {
+				p.lo = hist[0];
+				p.hi = hist[bins - 1];
+			}
+
+			uint64_t n = uint64_t(end - start) * cols;
+			double sum = s[0] + s[1] + s[2] + s[3];
+			double sumsq = q[0] + q[1] + q[2] + q[3];
+
+			double dl = Pixel<T>::min() - shift;
+			double dh = Pixel<T>::max() - shift;
+
+			p.all = Moments(n, shift, sum, sumsq);
+			p.clipped = Moments(n - p.lo - p.hi, shift, sum - p.lo * dl - p.hi * dh, sumsq - p.lo * dl * dl - p.hi * dh * dh);
+
+			return p;
+		};
+
+		auto reduce = [](Partial<T> a, Partial<T> b) {
+
+			if (a.histogram.empty())
+				return b;
+
+			a.all.merge(b.all);
+			a.clipped.merge(b.clipped);
+
+			a.min = math::min(a.min, b.min);
+			a.max = math::max(a.max, b.max);
+			a.clipped_min = math::min(a.clipped_min, b.clipped_min);
+			a.clipped_max = math::max(a.clipped_max, b.clipped_max);
+
+			a.lo += b.lo;
+			a.hi += b.hi;
+
+			for (uint32_t i = 0; i < bins; ++i)
+				a.histogram[i] += b.histogram[i];
+
+			return a;
+		};
+
+		Partial<T> p = ThreadPool::parallelReduce(0, int(view.rows()), Partial<T>(), map, reduce, grain);
+
+		//integer extremes are exact from the bins
+		if constexpr (!std::is_same_v<T, float>) {
+
+			const auto& h = p.histogram;
+			if (h.empty())
+				return p;
+
+			auto first = [&](uint32_t b, uint32_t e) { for (; b < e; ++b) if (h[b]) return T(b); return T(0); };
+			auto last = [&](uint32_t b, uint32_t e) { for (; e > b; --e) if (h[e - 1]) return T(e - 1); return T(0); };
+
+			p.min = first(0, bins);
+			p.max = last(0, bins);
+			p.clipped_min = first(1, bins - 1);
+			p.clipped_max = last(1, bins - 1);
+		}
+
+		return p;
+	}
+
+	template<typename T>
+	ImageStatistics::Channel derive(const Moments& moments, T min, T max, const std::vector<uint32_t>& histogram) {
+
+		ImageStatistics::Channel s;
+		s.count = moments.count;
+
+		if (s.count == 0)
+			return s;
+
+		s.min = min;
+		s.max = max;
+		s.mean = moments.mean;
+		s.stdDev = sqrt(moments.m2 / moments.count);
+
+		s.median = fromPosition<T>(medianPosition<T>(histogram, s.count));
+		s.avgDev = averageDeviation<T>(histogram, s.count, s.median);
+
+		auto deviation = deviationHistogram(histogram, binOf(T(s.median)));
+		s.MAD = fromPosition<T>(medianPosition<T>(deviation, s.count));
+
+		s.sqrtBWMV = biweightMidvariance<T>(histogram, s.count, s.median, s.MAD);
+
+		return s;
+	}
+}
+
+template<typename T>
+ImageStatistics::ImageStatistics(const ImageView<const T>& view) {
+
+	m_all.resize(view.channels());
+	m_clipped.resize(view.channels());
+
+	for (int ch = 0; ch < view.channels(); ++ch) {
+
+		Partial<T> p = gather(view, ch);
+		if (p.histogram.empty())
+			continue;
+
+		m_all[ch] = derive(p.all, p.min, p.max, p.histogram);
+
+		p.histogram.front() -= p.lo;
+		p.histogram.back() -= p.hi;
+
+		m_clipped[ch] = derive(p.clipped, p.clipped_min, p.clipped_max, p.histogram);
+	}
+}
+template ImageStatistics::ImageStatistics(const ImageView<const uint8_t>& view);
+template ImageStatistics::ImageStatistics(const ImageView<const uint16_t>& view);
+template ImageStatistics::ImageStatistics(const ImageView<const float>& view);
+
+template<typename T>
+double ImageStatistics::sqrtBWMV(const ImageView<const T>& view, float median, bool clip) {
+
+	Partial<T> p = gather(view, 0);
+	if (p.histogram.empty())
+		return 0;
+
+	uint64_t count = p.all.count;
+
+	if (clip) {
+		p.histogram.front() -= p.lo;
+		p.histogram.back() -= p.hi;
+		count = p.clipped.count;
+	}
+
+	auto deviation = deviationHistogram(p.histogram, binOf(T(median)));
+	double mad = fromPosition<T>(medianPosition<T>(deviation, count));
+
+	return biweightMidvariance<T>(p.histogram, count, median, mad);
+}
+template double ImageStatistics::sqrtBWMV(const ImageView<const uint8_t>& view, float median, bool clip);
+template double ImageStatistics::sqrtBWMV(const ImageView<const uint16_t>& view, float median, bool clip);
+template double ImageStatistics::sqrtBWMV(const ImageView<const float>& view, float median, bool clip);
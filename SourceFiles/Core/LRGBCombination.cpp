@@ -22,24 +22,34 @@ void LRGBCombination::combineLuminance(Image32& rgb, const Image<T>& lum) {
     using HT = HistogramTransformation;
 
     double Lt_w = 1 - m_L_weight;
-    //max value of lum midtone is 0.5
-#pragma omp parallel for num_threads(2)
-    for (int y = 0; y < rgb.rows(); ++y) {
-        for (int x = 0; x < rgb.cols(); ++x) {
-            auto color = rgb.color<double>(x, y);
 
-            color.red *= m_R_weight;
-            color.green *= m_G_weight;
-            color.blue *= m_B_weight;
+    float* R = &rgb(0, 0, 0);
+    float* G = &rgb(0, 0, 1);
+    float* B = &rgb(0, 0, 2);
+
+#pragma omp parallel for
+    for (int el = 0; el < rgb.pxCount(); ++el) {
+        R[el] *= m_R_weight;
+        G[el] *= m_G_weight;
+        B[el] *= m_B_weight;
+    }
 
-            double L, c, h;
+    //rgb planes are converted to Lch in place
+    BatchColorSpace::RGBtoCIELch(R, G, B, R, G, B, rgb.pxCount());
 
-            ColorSpace::RGBtoCIELch(color, L, c, h);
-            L = HT::MTF(L * Lt_w + m_L_weight * lum(x,y), m_lightness_mtf);
-            c = HT::MTF(c, m_saturation_mtf) * L + c * (1 - L);
-            rgb.setColor(x, y, ColorSpace::CIELchtoRGB(L, c, h));
+    //max value of lum midtone is 0.5
+#pragma omp parallel for
+    for (int y = 0; y < rgb.rows(); ++y) {
+        for (int x = 0; x < rgb.cols(); ++x) {
+            int el = y * rgb.cols() + x;
+            double L = HT::MTF(R[el] * Lt_w + m_L_weight * Pixel<float>::toType(lum(x, y)), m_lightness_mtf);
+            double c = G[el];
+            R[el] = L;
+            G[el] = HT::MTF(c, m_saturation_mtf) * L + c * (1 - L);
         }
     }
+
+    BatchColorSpace::CIELchtoRGB(R, G, B, R, G, B, rgb.pxCount());
 }
 
 Image32 LRGBCombination::generateLRGBImage() {
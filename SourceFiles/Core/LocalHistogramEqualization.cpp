@@ -8,6 +8,7 @@ LHE::KernelHistogram::KernelHistogram(Histogram::Resolution resolution, int kern
 
 	m_histogram = Histogram(resolution);
 	m_multiplier = m_histogram.resolution() - 1;
+	m_clipped.resize(m_histogram.resolution() + 1);
 
 	int total = dimension() * dimension();
 
@@ -60,6 +61,10 @@ LHE::KernelHistogram::KernelHistogram(const KernelHistogram& kh) {
 	m_multiplier = m_histogram.resolution() - 1;
 	m_count = kh.m_count;
 
+	m_clipped = kh.m_clipped;
+	m_limit = kh.m_limit;
+	m_excess = kh.m_excess;
+
 	m_radius = kh.m_radius;
 	m_dimension = kh.m_dimension;
 
@@ -68,10 +73,64 @@ LHE::KernelHistogram::KernelHistogram(const KernelHistogram& kh) {
 	k_mask = kh.k_mask;
 }
 
+void LHE::KernelHistogram::addPixel(uint32_t bin) {
+
+	if (m_histogram[bin]++ < m_limit)
+		for (uint32_t i = bin + 1; i < m_clipped.size(); i += i & -i)
+			m_clipped[i]++;
+	else
+		m_excess++;
+}
+
+void LHE::KernelHistogram::removePixel(uint32_t bin) {
+
+	if (--m_histogram[bin] < m_limit)
+		for (uint32_t i = bin + 1; i < m_clipped.size(); i += i & -i)
+			m_clipped[i]--;
+	else
+		m_excess--;
+}
+
+uint32_t LHE::KernelHistogram::clippedCount(uint32_t bin)const {
+
+	uint32_t sum = 0;
+	for (uint32_t i = bin + 1; i > 0; i -= i & -i)
+		sum += m_clipped[i];
+
+	return sum;
+}
+
+uint32_t LHE::KernelHistogram::firstBin()const {
+
+	uint32_t pos = 0;
+	uint32_t step = 1;
+	while (2 * step < m_clipped.size())
+		step *= 2;
+
+	//descend to the last position with a zero prefix sum
+	for (; step > 0; step >>= 1)
+		if (pos + step < m_clipped.size() && m_clipped[pos + step] == 0)
+			pos += step;
+
+	return pos;
+}
+
+float LHE::KernelHistogram::equalize(uint32_t bin)const {
+
+	float excess = float(m_excess) / m_histogram.resolution();
+	float cdf = clippedCount(bin) + (bin + 1) * excess;
+	float min = (m_excess > 0) ? clippedCount(0) + excess : clippedCount(firstBin());
+	float max = clippedCount(m_multiplier) + m_excess;
+
+	return (max > min) ? (cdf - min) / (max - min) : float(bin) / m_multiplier;
+}
+
 template<typename T>
-void LHE::KernelHistogram::populate(Image<T>& img, int y) {
+void LHE::KernelHistogram::populate(const Image<T>& img, int y) {
 
 	m_histogram.fill(0);
+	std::fill(m_clipped.begin(), m_clipped.end(), 0);
+	m_excess = 0;
 
 	for (int j = -radius(), j_mask = 0; j <= radius(); ++j, j_mask += dimension()) {
 
@@ -88,17 +147,17 @@ void LHE::KernelHistogram::populate(Image<T>& img, int y) {
 				xx = -xx;
 
 			if (k_mask[j_mask + i_m] && img.isInBounds(xx, yy))
-				m_histogram[Pixel<float>::toType(img(xx,yy)) * multiplier()]++;
-			
+				addPixel(Pixel<float>::toType(img(xx, yy)) * multiplier());
+
 		}
 	}
 }
-template void LHE::KernelHistogram::populate(Image8&, int);
-template void LHE::KernelHistogram::populate(Image16&, int);
-template void LHE::KernelHistogram::populate(Image32&, int);
+template void LHE::KernelHistogram::populate(const Image8&, int);
+template void LHE::KernelHistogram::populate(const Image16&, int);
+template void LHE::KernelHistogram::populate(const Image32&, int);
 
 template<typename T>
-void LHE::KernelHistogram::update(Image<T>& img, int x, int y) {
+void LHE::KernelHistogram::update(const Image<T>& img, int x, int y) {
 
 	for (int j = -radius(), s = 0; j <= radius(); ++j, ++s) {
 
@@ -115,7 +174,7 @@ void LHE::KernelHistogram::update(Image<T>& img, int x, int y) {
 			xx = 2 * img.cols() - (xx + 1);
 
 		if (img.isInBounds(xx, yy))
-			m_histogram[Pixel<float>::toType(img(xx, yy)) * multiplier()]++;
+			addPixel(Pixel<float>::toType(img(xx, yy)) * multiplier());
 
 
 		//back
@@ -125,63 +184,195 @@ void LHE::KernelHistogram::update(Image<T>& img, int x, int y) {
 			xx = -xx;
 
 		if (img.isInBounds(xx,yy))
-			m_histogram[Pixel<float>::toType(img(xx, yy)) * multiplier()]--;
+			removePixel(Pixel<float>::toType(img(xx, yy)) * multiplier());
 	}
 }
-template void LHE::KernelHistogram::update(Image8&, int, int);
-template void LHE::KernelHistogram::update(Image16&, int, int);
-template void LHE::KernelHistogram::update(Image32&, int, int);
+template void LHE::KernelHistogram::update(const Image8&, int, int);
+template void LHE::KernelHistogram::update(const Image16&, int, int);
+template void LHE::KernelHistogram::update(const Image32&, int, int);
+
+uint32_t LHE::clipLimit(uint32_t count)const {
+
+	uint32_t m = Histogram::resolutionValue(histogramResolution()) - 1;
+	return math::max<uint32_t>(1, (contrastLimit() * count) / m + 0.5);
+}
+
+static void clippedMapping(const Histogram& histogram, uint32_t limit, std::vector<float>& map) {
 
+	uint32_t res = histogram.resolution();
+	uint32_t m = res - 1;
+	uint32_t excess = 0;
+	uint32_t first = res;
+
+	for (uint32_t i = 0; i < res; ++i) {
+		if (histogram[i] > limit)
+			excess += histogram[i] - limit;
+		if (histogram[i] != 0 && first == res)
+			first = i;
+	}
+
+	float e = float(excess) / res;
+	uint32_t clipped = 0;
+	float min = 0.0f;
+
+	for (uint32_t i = 0; i < res; ++i) {
+		clipped += math::min(histogram[i], limit);
+		map[i] = clipped + (i + 1) * e;
+		if ((excess > 0 && i == 0) || (excess == 0 && i == first))
+			min = map[i];
+	}
+
+	float max = clipped + excess;
+
+	for (uint32_t i = 0; i < res; ++i)
+		map[i] = (max > min) ? math::max((map[i] - min) / (max - min), 0.0f) : float(i) / m;
+}
 
 template<typename T>
-void LHE::apply(Image<T>& img) {
+void LHE::applyTiled(const Image<T>& img, Image<T>& dst) {
+
+	uint32_t res = Histogram::resolutionValue(histogramResolution());
+	uint32_t m = res - 1;
+	float original_amount = 1.0 - amount();
+
+	int tile = 2 * kernelRadius() + 1;
+	int tiles_x = (img.cols() + tile - 1) / tile;
+	int tiles_y = (img.rows() + tile - 1) / tile;
+
+	//neighbouring tile centers and interpolation weight for each row/column
+	auto interpolation = [tile](int size, int tiles, std::vector<int>& t0, std::vector<int>& t1, std::vector<float>& w) {
+		t0.resize(size);
+		t1.resize(size);
+		w.resize(size);
+
+		for (int p = 0; p < size; ++p) {
+			float pos = (p + 0.5f) / tile - 0.5f;
+			int t = floor(pos);
+
+			if (t < 0)
+				t0[p] = t1[p] = 0, w[p] = 0.0f;
+			else if (t >= tiles - 1)
+				t0[p] = t1[p] = tiles - 1, w[p] = 0.0f;
+			else
+				t0[p] = t, t1[p] = t + 1, w[p] = pos - t;
+		}
+	};
 
-	Image<T> temp;
+	std::vector<int> tx0, tx1, ty0, ty1;
+	std::vector<float> wx, wy;
+	interpolation(img.cols(), tiles_x, tx0, tx1, wx);
+	interpolation(img.rows(), tiles_y, ty0, ty1, wy);
 
-	if (img.channels() == 3) {
-		m_ps->emitText("Getting CIE Luminance...");
-		img.RGBtoCIELab();
-		img.copyTo(temp);
+	//only two rows of tile mappings are kept at a time
+	std::vector<std::vector<float>> upper(tiles_x, std::vector<float>(res));
+	std::vector<std::vector<float>> lower(tiles_x, std::vector<float>(res));
+
+	auto computeTileRow = [&](int ty, std::vector<std::vector<float>>& maps) {
+		int y_end = math::min<int>((ty + 1) * tile, img.rows());
+
+#pragma omp parallel for
+		for (int tx = 0; tx < tiles_x; ++tx) {
+			int x_end = math::min<int>((tx + 1) * tile, img.cols());
+			auto region = img.region(tx * tile, ty * tile, x_end - tx * tile, y_end - ty * tile);
+			Histogram histogram = HistogramBuilder::build(region.channel(0), histogramResolution())[0];
+
+			clippedMapping(histogram, clipLimit(region.pxCount()), maps[tx]);
+		}
+	};
+
+	computeTileRow(0, upper);
+
+	for (int ty = 0, y_start = 0; ty < tiles_y; ++ty) {
+
+		if (ty + 1 < tiles_y)
+			computeTileRow(ty + 1, lower);
+
+		int y_end = y_start;
+		while (y_end < img.rows() && ty0[y_end] == ty)
+			++y_end;
+
+#pragma omp parallel for
+		for (int y = y_start; y < y_end; ++y) {
+			const auto& top = upper;
+			const auto& bottom = (ty1[y] == ty) ? upper : lower;
+
+			for (int x = 0; x < img.cols(); ++x) {
+				float pixel = Pixel<float>::toType(img(x, y));
+				uint32_t bin = pixel * m;
+
+				float t = top[tx0[x]][bin] + wx[x] * (top[tx1[x]][bin] - top[tx0[x]][bin]);
+				float b = bottom[tx0[x]][bin] + wx[x] * (bottom[tx1[x]][bin] - bottom[tx0[x]][bin]);
+
+				dst(x, y) = Pixel<T>::toType((original_amount * pixel) + (amount() * (t + wy[y] * (b - t))));
+			}
+		}
+
+		y_start = y_end;
+		std::swap(upper, lower);
+		m_ps->emitProgress(((ty + 1) * 100) / tiles_y);
 	}
-	else
-		temp = Image<T>(img);
+}
+template void LHE::applyTiled(const Image8&, Image8&);
+template void LHE::applyTiled(const Image16&, Image16&);
+template void LHE::applyTiled(const Image32&, Image32&);
+
+template<typename T>
+void LHE::applySliding(const Image<T>& img, Image<T>& dst) {
 
 	std::atomic_uint32_t psum = 0;
-	m_ps->emitText("CLAHE...");
 
-	Threads().run([&](uint32_t start, uint32_t end, uint32_t num) {
+	Threads().run([&](uint32_t start, uint32_t end) {
 
 		KernelHistogram k_hist(histogramResolution(), kernelRadius(), isCircular());
+		k_hist.setClipLimit(clipLimit(k_hist.count()));
 		float original_amount = 1.0 - amount();
 		uint32_t m = Histogram::resolutionValue(histogramResolution()) - 1;
-		Histogram histogram;
 
 		for (int y = start; y < end; ++y) {
 
 			for (int x = 0; x < img.cols(); ++x) {
-				float pixel = img.pixel<float>(x, y);// Pixel<float>::toType(img(x, y));
+				float pixel = Pixel<float>::toType(img(x, y));
 
 				if (x == 0)
 					k_hist.populate(img, y);
 				else
 					k_hist.update(img, x, y);
 
-				histogram = k_hist.histogram();
-				histogram.clip(math::max<uint32_t>(1, (contrastLimit() * histogram.count()) / m) + 0.5);
-				histogram.convertToCDF();
-				uint32_t min = histogram.minCount();
-				uint32_t max = histogram[m];
-				uint32_t cdf = histogram[pixel * m];
-
-				temp(x, y) = Pixel<T>::toType((original_amount * pixel) + (amount() * float(cdf - min) / (max - min)));
+				dst(x, y) = Pixel<T>::toType((original_amount * pixel) + (amount() * k_hist.equalize(pixel * m)));
 			}
 
 			psum++;
 
-			if (num == 0)
+			//the calling thread runs ranges too and reports for all of them
+			if (!ThreadPool::isWorkerThread())
 				m_ps->emitProgress((psum * 100) / img.rows());
 		}
 	}, img.rows());
+}
+template void LHE::applySliding(const Image8&, Image8&);
+template void LHE::applySliding(const Image16&, Image16&);
+template void LHE::applySliding(const Image32&, Image32&);
+
+
+template<typename T>
+void LHE::apply(Image<T>& img) {
+
+	Image<T> temp;
+
+	if (img.channels() == 3) {
+		m_ps->emitText("Getting CIE Luminance...");
+		img.RGBtoCIELab();
+		img.copyTo(temp);
+	}
+	else
+		temp = Image<T>(img);
+
+	m_ps->emitText("CLAHE...");
+
+	if (method() == Method::tiled)
+		applyTiled(img, temp);
+	else
+		applySliding(img, temp);
 
 	m_ps->emitProgress(100);
 
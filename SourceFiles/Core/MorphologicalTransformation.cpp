@@ -143,6 +143,479 @@ T MorphologicalKernel<T>::midpoint()const {
 
 
 
+
+
+//reflects about the edge pixel on both sides, as at_mirrored does
+static int mirrorIndex(int i, int size) {
+
+	if (i < 0)
+		i = -i;
+	else if (i >= size)
+		i = 2 * size - (i + 2);
+
+	return std::clamp(i, 0, size - 1);
+}
+
+template<typename T>
+struct MinimumOp {
+	static constexpr T identity() { return std::numeric_limits<T>::max(); }
+
+	T operator()(T a, T b)const { return (a < b) ? a : b; }
+};
+
+template<typename T>
+struct MaximumOp {
+	static constexpr T identity() { return std::numeric_limits<T>::lowest(); }
+
+	T operator()(T a, T b)const { return (a > b) ? a : b; }
+};
+
+template<typename T>
+MinMaxFilter<T>::MinMaxFilter(const MorphologicalTransformation& mt) {
+
+	m_dim = mt.kernelDimension();
+	m_radius = (m_dim - 1) / 2;
+
+	m_decomposable = mt.maskSegments(m_rows);
+	if (!m_decomposable)
+		return;
+
+	m_length_index = std::vector<int>(m_dim, -1);
+
+	for (int j = 0; j < m_dim; ++j) {
+		if (m_rows[j].length == 0)
+			continue;
+
+		auto it = std::find(m_lengths.begin(), m_lengths.end(), m_rows[j].length);
+		m_length_index[j] = it - m_lengths.begin();
+		if (it == m_lengths.end())
+			m_lengths.push_back(m_rows[j].length);
+	}
+
+	//rectangles and lines are separable into a horizontal and a vertical segment
+	int first = -1, last = -1;
+	m_rectangular = true;
+
+	for (int j = 0; j < m_dim; ++j) {
+		if (m_rows[j].length == 0)
+			continue;
+
+		if (first == -1)
+			first = j;
+		else if (last != j - 1 || !(m_rows[j] == m_rows[first]))
+			m_rectangular = false;
+		last = j;
+	}
+
+	if (first == -1) {
+		m_decomposable = m_rectangular = false;
+		return;
+	}
+
+	m_vertical = { first - m_radius, last - first + 1 };
+}
+
+template<typename T>
+template<typename Op>
+void MinMaxFilter<T>::lineFilter(const T* src, T* dst, int size, int length, T* g, T* h, Op op) {
+
+	if (length == 1) {
+		memcpy(dst, src, size * sizeof(T));
+		return;
+	}
+
+	for (int i = 0; i < size; ++i)
+		g[i] = (i % length == 0) ? src[i] : op(g[i - 1], src[i]);
+
+	for (int i = size - 1; i >= 0; --i)
+		h[i] = (i == size - 1 || i % length == length - 1) ? src[i] : op(h[i + 1], src[i]);
+
+	for (int i = 0; i <= size - length; ++i)
+		dst[i] = op(h[i], g[i + length - 1]);
+}
+
+template<typename T>
+template<typename Op>
+void MinMaxFilter<T>::rectangularFilter(const Image<T>& src, Image<T>& dst, int ch, Op op)const {
+
+	int rows = src.rows();
+	int cols = src.cols();
+	int size = cols + 2 * m_radius;
+
+	const KernelSegment& hs = m_rows[m_vertical.offset + m_radius];
+	Image<T> horizontal(rows, cols);
+
+	std::vector<T> padded(size), w(size), g(size), h(size);
+
+#pragma omp parallel for firstprivate(padded, w, g, h)
+	for (int y = 0; y < rows; ++y) {
+
+		for (int i = 0; i < size; ++i)
+			padded[i] = src(mirrorIndex(i - m_radius, cols), y, ch);
+
+		lineFilter(padded.data(), w.data(), size, hs.length, g.data(), h.data(), op);
+		memcpy(&horizontal(0, y), &w[hs.offset + m_radius], cols * sizeof(T));
+	}
+
+	//vertical pass runs van Herk blocks over whole rows
+	//s is the first virtual row of the window of output row y, s = y + offset + radius
+	int length = m_vertical.length;
+	int s_min = m_vertical.offset + m_radius;
+	int s_max = rows - 1 + s_min;
+
+	auto sourceRow = [&](int s) { return &horizontal(0, mirrorIndex(s - m_radius, rows)); };
+
+	std::vector<T> h_rows(length * cols), g_rows(length * cols);
+
+#pragma omp parallel for firstprivate(h_rows, g_rows)
+	for (int b = s_min / length; b <= s_max / length; ++b) {
+
+		int b_start = b * length;
+
+		memcpy(&h_rows[(length - 1) * cols], sourceRow(b_start + length - 1), cols * sizeof(T));
+		for (int k = length - 2; k >= 0; --k) {
+			const T* s = sourceRow(b_start + k);
+			const T* hn = &h_rows[(k + 1) * cols];
+			T* hk = &h_rows[k * cols];
+			for (int x = 0; x < cols; ++x)
+				hk[x] = op(hn[x], s[x]);
+		}
+
+		memcpy(&g_rows[0], sourceRow(b_start + length), cols * sizeof(T));
+		for (int k = 1; k < length - 1; ++k) {
+			const T* s = sourceRow(b_start + length + k);
+			const T* gp = &g_rows[(k - 1) * cols];
+			T* gk = &g_rows[k * cols];
+			for (int x = 0; x < cols; ++x)
+				gk[x] = op(gp[x], s[x]);
+		}
+
+		for (int s = math::max(b_start, s_min); s < math::min(b_start + length, s_max + 1); ++s) {
+
+			T* d = &dst(0, s - s_min, ch);
+			const T* hk = &h_rows[(s - b_start) * cols];
+
+			if (s == b_start) {
+				memcpy(d, hk, cols * sizeof(T));
+				continue;
+			}
+
+			const T* gk = &g_rows[(s - b_start - 1) * cols];
+			for (int x = 0; x < cols; ++x)
+				d[x] = op(hk[x], gk[x]);
+		}
+	}
+}
+
+template<typename T>
+template<typename Op>
+void MinMaxFilter<T>::segmentFilter(const Image<T>& src, Image<T>& dst, int ch, Op op)const {
+
+	int rows = src.rows();
+	int cols = src.cols();
+	int size = cols + 2 * m_radius;
+	int lc = m_lengths.size();
+
+	int block = math::max(64, 4 * m_dim);
+	int block_count = (rows + block - 1) / block;
+
+#pragma omp parallel for
+	for (int b = 0; b < block_count; ++b) {
+
+		std::vector<T> padded(size), g(size), h(size);
+		std::vector<T> acc(cols);
+
+		//line filtered rows of the current kernel window, for every segment length
+		std::vector<T> ring(m_dim * lc * size);
+
+		auto slot = [&](int v, int l) { return &ring[(((v % m_dim + m_dim) % m_dim) * lc + l) * size]; };
+
+		auto filterRow = [&](int v) {
+			int yy = mirrorIndex(v, rows);
+			for (int i = 0; i < size; ++i)
+				padded[i] = src(mirrorIndex(i - m_radius, cols), yy, ch);
+
+			for (int l = 0; l < lc; ++l)
+				lineFilter(padded.data(), slot(v, l), size, m_lengths[l], g.data(), h.data(), op);
+		};
+
+		int y_start = b * block;
+		int y_end = math::min(y_start + block, rows);
+
+		for (int v = y_start - m_radius; v < y_start + m_radius; ++v)
+			filterRow(v);
+
+		for (int y = y_start; y < y_end; ++y) {
+
+			filterRow(y + m_radius);
+
+			std::fill(acc.begin(), acc.end(), Op::identity());
+
+			for (int j = 0; j < m_dim; ++j) {
+				const KernelSegment& s = m_rows[j];
+				if (s.length == 0)
+					continue;
+
+				const T* w = slot(y + j - m_radius, m_length_index[j]) + s.offset + m_radius;
+				for (int x = 0; x < cols; ++x)
+					acc[x] = op(acc[x], w[x]);
+			}
+
+			memcpy(&dst(0, y, ch), acc.data(), cols * sizeof(T));
+		}
+	}
+}
+
+template<typename T>
+void MinMaxFilter<T>::minimum(const Image<T>& src, Image<T>& dst, int ch)const {
+
+	if (m_rectangular)
+		return rectangularFilter(src, dst, ch, MinimumOp<T>());
+
+	segmentFilter(src, dst, ch, MinimumOp<T>());
+}
+
+template<typename T>
+void MinMaxFilter<T>::maximum(const Image<T>& src, Image<T>& dst, int ch)const {
+
+	if (m_rectangular)
+		return rectangularFilter(src, dst, ch, MaximumOp<T>());
+
+	segmentFilter(src, dst, ch, MaximumOp<T>());
+}
+template class MinMaxFilter<uint8_t>;
+template class MinMaxFilter<uint16_t>;
+template class MinMaxFilter<float>;
+
+
+
+
+
+template<typename T>
+RankFilter<T>::RankFilter(const MorphologicalTransformation& mt) {
+
+	m_dim = mt.kernelDimension();
+	m_radius = (m_dim - 1) / 2;
+	m_count = mt.maskedLocations().size();
+
+	m_supported = mt.maskSegments(m_rows) && m_count > 0;
+	m_full = (m_count == m_dim * m_dim);
+}
+
+template<typename T>
+uint16_t RankFilter<T>::toBin(T pixel) {
+
+	if constexpr (std::is_same_v<T, float>)
+		return Pixel<uint16_t>::toType(math::clipf(pixel));
+	else
+		return pixel;
+}
+
+template<typename T>
+T RankFilter<T>::fromBin(int bin) {
+
+	if constexpr (std::is_same_v<T, float>)
+		return Pixel<float>::toType(uint16_t(bin));
+	else
+		return T(bin);
+}
+
+template<typename T>
+int RankFilter<T>::findBin(const uint32_t* histogram, int& rank) {
+
+	int bin = 0;
+
+	for (; bin < m_coarse_size - 1; ++bin) {
+		if (rank < int(histogram[bin]))
+			break;
+		rank -= histogram[bin];
+	}
+
+	return bin;
+}
+
+template<typename T>
+void RankFilter<T>::fullKernelFilter(const Image<T>& src, Image<T>& dst, int ch, int rank)const {
+
+	int rows = src.rows();
+	int cols = src.cols();
+
+	//column histograms are kept for vertical stripes to bound memory at 16-bit resolution
+	int stripe = math::max(64, 2 * m_dim);
+	int stripe_count = (cols + stripe - 1) / stripe;
+	int hist_size = m_coarse_size + m_fine_size;
+
+#pragma omp parallel for
+	for (int s = 0; s < stripe_count; ++s) {
+
+		int x_start = s * stripe;
+		int x_end = math::min(x_start + stripe, cols);
+		int column_count = x_end - x_start + 2 * m_radius;
+
+		std::vector<uint16_t> columns(column_count * hist_size, 0);
+		std::vector<int> xx(column_count);
+
+		//kernel fine histograms are only brought up to date for the coarse bin being searched
+		std::vector<uint32_t> coarse(m_coarse_size), fine(m_fine_size);
+		std::vector<int> updated(m_coarse_size);
+
+		for (int c = 0; c < column_count; ++c)
+			xx[c] = mirrorIndex(x_start - m_radius + c, cols);
+
+		auto column = [&](int c) { return &columns[c * hist_size]; };
+
+		auto addRow = [&](int y) {
+			const T* row = &src(0, mirrorIndex(y, rows), ch);
+			for (int c = 0; c < column_count; ++c) {
+				uint16_t bin = toBin(row[xx[c]]);
+				uint16_t* h = column(c);
+				h[bin >> m_coarse_bits]++;
+				h[m_coarse_size + bin]++;
+			}
+		};
+
+		auto removeRow = [&](int y) {
+			const T* row = &src(0, mirrorIndex(y, rows), ch);
+			for (int c = 0; c < column_count; ++c) {
+				uint16_t bin = toBin(row[xx[c]]);
+				uint16_t* h = column(c);
+				h[bin >> m_coarse_bits]--;
+				h[m_coarse_size + bin]--;
+			}
+		};
+
+		for (int j = -m_radius; j <= m_radius; ++j)
+			addRow(j);
+
+		for (int y = 0; y < rows; ++y) {
+
+			if (y > 0) {
+				removeRow(y - m_radius - 1);
+				addRow(y + m_radius);
+			}
+
+			std::fill(coarse.begin(), coarse.end(), 0);
+			std::fill(updated.begin(), updated.end(), x_start - m_dim - 1);
+
+			for (int c = 0; c < m_dim; ++c) {
+				const uint16_t* h = column(c);
+				for (int i = 0; i < m_coarse_size; ++i)
+					coarse[i] += h[i];
+			}
+
+			for (int x = x_start; x < x_end; ++x) {
+
+				int c0 = x - x_start;
+
+				if (x > x_start) {
+					const uint16_t* o = column(c0 - 1);
+					const uint16_t* n = column(c0 + m_dim - 1);
+					for (int i = 0; i < m_coarse_size; ++i)
+						coarse[i] += n[i] - o[i];
+				}
+
+				int r = rank;
+				int b = findBin(coarse.data(), r);
+
+				uint32_t* f = &fine[b * m_coarse_size];
+				int offset = m_coarse_size + b * m_coarse_size;
+
+				if (2 * (x - updated[b]) > m_dim) {
+					std::fill(f, f + m_coarse_size, 0);
+					for (int c = c0; c < c0 + m_dim; ++c) {
+						const uint16_t* h = column(c) + offset;
+						for (int i = 0; i < m_coarse_size; ++i)
+							f[i] += h[i];
+					}
+				}
+				else {
+					for (int p = updated[b] + 1 - x_start; p <= c0; ++p) {
+						const uint16_t* o = column(p - 1) + offset;
+						const uint16_t* n = column(p + m_dim - 1) + offset;
+						for (int i = 0; i < m_coarse_size; ++i)
+							f[i] += n[i] - o[i];
+					}
+				}
+
+				updated[b] = x;
+
+				dst(x, y, ch) = fromBin((b << m_coarse_bits) + findBin(f, r));
+			}
+		}
+	}
+}
+
+template<typename T>
+void RankFilter<T>::segmentFilter(const Image<T>& src, Image<T>& dst, int ch, int rank)const {
+
+	int rows = src.rows();
+	int cols = src.cols();
+
+	std::vector<uint32_t> coarse(m_coarse_size), fine(m_fine_size);
+	std::vector<const T*> kernel_rows(m_dim);
+
+#pragma omp parallel for firstprivate(coarse, fine, kernel_rows)
+	for (int y = 0; y < rows; ++y) {
+
+		std::fill(coarse.begin(), coarse.end(), 0);
+		std::fill(fine.begin(), fine.end(), 0);
+
+		auto add = [&](T pixel) {
+			uint16_t bin = toBin(pixel);
+			coarse[bin >> m_coarse_bits]++;
+			fine[bin]++;
+		};
+
+		auto remove = [&](T pixel) {
+			uint16_t bin = toBin(pixel);
+			coarse[bin >> m_coarse_bits]--;
+			fine[bin]--;
+		};
+
+		for (int j = 0; j < m_dim; ++j) {
+			kernel_rows[j] = &src(0, mirrorIndex(y + j - m_radius, rows), ch);
+
+			const KernelSegment& s = m_rows[j];
+			for (int i = s.offset; i < s.offset + s.length; ++i)
+				add(kernel_rows[j][mirrorIndex(i, cols)]);
+		}
+
+		for (int x = 0; x < cols; ++x) {
+
+			if (x > 0) {
+				for (int j = 0; j < m_dim; ++j) {
+					const KernelSegment& s = m_rows[j];
+					if (s.length == 0)
+						continue;
+
+					remove(kernel_rows[j][mirrorIndex(x - 1 + s.offset, cols)]);
+					add(kernel_rows[j][mirrorIndex(x + s.offset + s.length - 1, cols)]);
+				}
+			}
+
+			int r = rank;
+			int b = findBin(coarse.data(), r);
+			dst(x, y, ch) = fromBin((b << m_coarse_bits) + findBin(&fine[b * m_coarse_size], r));
+		}
+	}
+}
+
+template<typename T>
+void RankFilter<T>::apply(const Image<T>& src, Image<T>& dst, int ch, int rank)const {
+
+	rank = std::clamp(rank, 0, m_count - 1);
+
+	if (m_full)
+		return fullKernelFilter(src, dst, ch, rank);
+
+	segmentFilter(src, dst, ch, rank);
+}
+template class RankFilter<uint8_t>;
+template class RankFilter<uint16_t>;
+template class RankFilter<float>;
+
+
+
 using MT = MorphologicalTransformation;
 
 void MT::resizeKernel(int new_dim) {
@@ -241,6 +714,32 @@ int MT::maskCount()const {
 	return c;
 }
 
+bool MT::maskSegments(std::vector<KernelSegment>& segments)const {
+
+	segments = std::vector<KernelSegment>(m_kernel_dim);
+
+	for (int j = 0; j < m_kernel_dim; ++j) {
+
+		int start = -1, end = -1;
+
+		for (int i = 0; i < m_kernel_dim; ++i) {
+			if (!m_kmask[j * m_kernel_dim + i])
+				continue;
+
+			if (start == -1)
+				start = i;
+			else if (end != i - 1)
+				return false;
+			end = i;
+		}
+
+		if (start != -1)
+			segments[j] = { start - m_kernel_radius, end - start + 1 };
+	}
+
+	return true;
+}
+
 std::vector<uint16_t> MT::maskedLocations()const {
 
 	int count = 0; //number of true values
@@ -257,12 +756,41 @@ std::vector<uint16_t> MT::maskedLocations()const {
 	return locations;
 }
 
+template<typename T>
+void MT::blendFiltered(const Image<T>& img, Image<T>& filtered) {
+
+	if (m_amount == 1.0f)
+		return;
+
+#pragma omp parallel for
+	for (int el = 0; el < img.totalPxCount(); ++el)
+		filtered[el] = blend(img[el], filtered[el]);
+}
+template void MT::blendFiltered(const Image8&, Image8&);
+template void MT::blendFiltered(const Image16&, Image16&);
+template void MT::blendFiltered(const Image32&, Image32&);
+
 template<typename T>
 void MT::erosion(Image<T>& img) {
 
+	m_ps->emitText("Erosion...");
+
+	MinMaxFilter<T> filter(*this);
+
+	if (filter.isDecomposable()) {
+		Image<T> temp(img.rows(), img.cols(), img.channels());
+
+		for (int ch = 0; ch < img.channels(); ++ch) {
+			filter.minimum(img, temp, ch);
+			m_ps->emitProgress(((ch + 1) * 100) / img.channels());
+		}
+
+		blendFiltered(img, temp);
+		return temp.moveTo(img);
+	}
+
 	Image<T> temp(img);
 
-	m_ps->emitText("Erosion...");
 	int sum = 0, total = img.channels() * img.rows();
 
 	MorphologicalKernel<T> kernel(img, *this);
@@ -302,9 +830,24 @@ template void MT::erosion(Image32&);
 template<typename T>
 void MT::dialation(Image<T>& img) {
 
+	m_ps->emitText("Dialation...");
+
+	MinMaxFilter<T> filter(*this);
+
+	if (filter.isDecomposable()) {
+		Image<T> temp(img.rows(), img.cols(), img.channels());
+
+		for (int ch = 0; ch < img.channels(); ++ch) {
+			filter.maximum(img, temp, ch);
+			m_ps->emitProgress(((ch + 1) * 100) / img.channels());
+		}
+
+		blendFiltered(img, temp);
+		return temp.moveTo(img);
+	}
+
 	Image<T> temp(img);
 
-	m_ps->emitText("Dialation...");
 	int sum = 0, total = img.channels() * img.rows();
 
 	MorphologicalKernel<T> kernel(img, *this);
@@ -362,13 +905,27 @@ template void MT::closing(Image32&);
 template <typename T>
 void MT::selection(Image<T>& img) {
 
-	Image<T> temp(img);
-
 	m_ps->emitText("Selection...");
 	int sum = 0, total = img.channels() * img.rows();
 
 	int pivot = (m_selection == 1.0) ? maskCount() - 1 : maskCount() * m_selection;
 
+	RankFilter<T> filter(*this);
+
+	if (filter.isSupported()) {
+		Image<T> temp(img.rows(), img.cols(), img.channels());
+
+		for (int ch = 0; ch < img.channels(); ++ch) {
+			filter.apply(img, temp, ch, pivot);
+			m_ps->emitProgress(((ch + 1) * 100) / img.channels());
+		}
+
+		blendFiltered(img, temp);
+		return temp.moveTo(img);
+	}
+
+	Image<T> temp(img);
+
 	MorphologicalKernel<T> kernel(img, *this);
 
 	for (int ch = 0; ch < img.channels(); ++ch) {
@@ -408,9 +965,24 @@ void MT::median(Image<T>& img) {
 	if (maskCount() == m_kmask.size() && m_kernel_dim <= 9)
 		return fastMedian(img, m_kernel_dim);
 
+	m_ps->emitText("Median...");
+
+	RankFilter<T> filter(*this);
+
+	if (filter.isSupported()) {
+		Image<T> temp(img.rows(), img.cols(), img.channels());
+
+		for (int ch = 0; ch < img.channels(); ++ch) {
+			filter.median(img, temp, ch);
+			m_ps->emitProgress(((ch + 1) * 100) / img.channels());
+		}
+
+		blendFiltered(img, temp);
+		return temp.moveTo(img);
+	}
+
 	Image<T> temp(img);
 
-	m_ps->emitText("Median...");
 	int sum = 0, total = img.channels() * img.rows();
 
 	MorphologicalKernel<T> kernel(img, *this);
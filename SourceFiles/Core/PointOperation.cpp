@@ -0,0 +1,102 @@
+#include "pch.h"
+#include "PointOperation.h"
+
+template<typename T>
+double PointOperation::evaluate(int ch, float pixel)const {
+
+	auto& chain = m_chains[ch];
+	double value = pixel;
+
+	for (int i = 0; i < chain.size(); ++i) {
+		value = math::clip(chain[i](pixel));
+
+		//the caller stores the last stage
+		if constexpr (std::is_same_v<T, float>)
+			pixel = value;
+		else if (i + 1 < chain.size())
+			pixel = Pixel<float>::toType(Pixel<T>::toType(value));
+	}
+
+	return value;
+}
+
+template<typename T>
+void PointOperation::applyLUT(Image<T>& img, int ch)const {
+
+	std::vector<T> lut(int(Pixel<T>::max()) + 1);
+
+#pragma omp parallel for
+	for (int el = 0; el < lut.size(); ++el)
+		lut[el] = Pixel<T>::toType(evaluate<T>(ch, Pixel<float>::toType(T(el))));
+
+	T* pixels = &img(0, 0, ch);
+	const T* table = lut.data();
+
+#pragma omp parallel for
+	for (int el = 0; el < img.pxCount(); ++el)
+		pixels[el] = table[pixels[el]];
+}
+
+void PointOperation::applyTable(Image32& img, int ch)const {
+
+	std::vector<float> table(m_float_segments + 1);
+
+#pragma omp parallel for
+	for (int el = 0; el <= m_float_segments; ++el)
+		table[el] = evaluate<float>(ch, float(el) / m_float_segments);
+
+	//slope per segment so each pixel is a single fused multiply add
+	std::vector<float> slope(m_float_segments);
+	for (int el = 0; el < m_float_segments; ++el)
+		slope[el] = table[el + 1] - table[el];
+
+	float* pixels = &img(0, 0, ch);
+	const float* t = table.data();
+	const float* s = slope.data();
+
+#pragma omp parallel for
+	for (int el = 0; el < img.pxCount(); ++el) {
+		float x = math::clip(pixels[el]) * m_float_segments;
+		int i = math::min(int(x), m_float_segments - 1);
+		pixels[el] = t[i] + (x - i) * s[i];
+	}
+}
+
+void PointOperation::append(const Function& func) {
+	for (auto& chain : m_chains)
+		chain.push_back(func);
+}
+
+void PointOperation::append(int ch, const Function& func) {
+	m_chains[ch].push_back(func);
+}
+
+bool PointOperation::isIdentity()const {
+	for (auto& chain : m_chains)
+		if (!chain.empty())
+			return false;
+
+	return true;
+}
+
+void PointOperation::clear() {
+	for (auto& chain : m_chains)
+		chain.clear();
+}
+
+template<typename T>
+void PointOperation::apply(Image<T>& img)const {
+
+	for (int ch = 0; ch < img.channels(); ++ch) {
+		if (isIdentity(ch))
+			continue;
+
+		if constexpr (std::is_same_v<T, float>)
+			applyTable(img, ch);
+		else
+			applyLUT(img, ch);
+	}
+}
+template void PointOperation::apply(Image8&)const;
+template void PointOperation::apply(Image16&)const;
+template void PointOperation::apply(Image32&)const;
@@ -0,0 +1,310 @@
+#include "pch.h"
+#include "Quantile.h"
+#include "ThreadPool.h"
+#include "Maths.h"
+#include <bit>
+#include <random>
+
+namespace {
+
+	template<typename T>
+	bool isClipped(T pixel) {
+		constexpr T high = (std::is_same_v<T, float>) ? T(1) : std::numeric_limits<T>::max();
+		return pixel == T(0) || pixel == high;
+	}
+
+	//keys sort the same way as the values they stand for
+	template<typename V>
+	struct Key;
+
+	template<>
+	struct Key<uint8_t> {
+		static constexpr int bits = 8;
+		static uint32_t to(uint8_t v) { return v; }
+		static uint8_t from(uint32_t key) { return key; }
+	};
+
+	template<>
+	struct Key<uint16_t> {
+		static constexpr int bits = 16;
+		static uint32_t to(uint16_t v) { return v; }
+		static uint16_t from(uint32_t key) { return key; }
+	};
+
+	//negative floats have their bits flipped so they order below the positives
+	template<>
+	struct Key<float> {
+		static constexpr int bits = 32;
+
+		static uint32_t to(float v) {
+			uint32_t u = std::bit_cast<uint32_t>(v);
+			return (u & 0x80000000) ? ~u : u | 0x80000000;
+		}
+
+		static float from(uint32_t key) {
+			return std::bit_cast<float>((key & 0x80000000) ? key & 0x7FFFFFFF : ~key);
+		}
+	};
+
+	//one chunk of rows per thread, so there is one set of counts per thread to merge
+	template<typename T>
+	int rowGrain(const ImageView<const T>& view) {
+		int tc = ThreadPool::threadCount();
+		return math::max(1, (int(view.rows()) + tc - 1) / tc);
+	}
+
+	template<typename T, typename Func>
+	void forEachPixel(const ImageView<const T>& view, int start, int end, bool clip, Func&& func) {
+
+		for (int y = start; y < end; ++y) {
+			const T* row = view.row(y);
+
+			if (clip) {
+				for (uint32_t x = 0; x < view.cols(); ++x)
+					if (!isClipped(row[x]))
+						func(row[x]);
+			}
+			else {
+				for (uint32_t x = 0; x < view.cols(); ++x)
+					func(row[x]);
+			}
+		}
+	}
+
+	using Counts = std::vector<uint32_t>;
+
+	//bucket counts of the digit at shift, over the keys whose bits above the digit equal prefix
+	template<typename T, typename Transform>
+	Counts countDigit(const ImageView<const T>& view, bool clip, Transform& transform, int shift, int width, uint32_t prefix, bool match_prefix) {
+
+		using V = decltype(transform(T()));
+		uint32_t mask = (1u << width) - 1;
+
+		auto map = [&](int start, int end) {
+
+			Counts counts(size_t(1) << width, 0);
+
+			forEachPixel(view, start, end, clip, [&](T pixel) {
+				uint32_t key = Key<V>::to(transform(pixel));
+				if (!match_prefix || (key >> (shift + width)) == prefix)
+					counts[(key >> shift) & mask]++;
+				});
+
+			return counts;
+		};
+
+		auto reduce = [](Counts a, Counts b) {
+
+			if (a.empty())
+				return b;
+
+			for (size_t i = 0; i < a.size(); ++i)
+				a[i] += b[i];
+
+			return a;
+		};
+
+		return ThreadPool::parallelReduce(0, int(view.rows()), Counts(), map, reduce, rowGrain(view));
+	}
+
+	//smallest key above key
+	template<typename T, typename Transform>
+	uint32_t successor(const ImageView<const T>& view, bool clip, Transform& transform, uint32_t key) {
+
+		using V = decltype(transform(T()));
+
+		auto map = [&](int start, int end) {
+
+			uint32_t next = std::numeric_limits<uint32_t>::max();
+
+			forEachPixel(view, start, end, clip, [&](T pixel) {
+				uint32_t k = Key<V>::to(transform(pixel));
+				if (k > key && k < next)
+					next = k;
+				});
+
+			return next;
+		};
+
+		return ThreadPool::parallelReduce(0, int(view.rows()), std::numeric_limits<uint32_t>::max(), map,
+			[](uint32_t a, uint32_t b) { return math::min(a, b); }, rowGrain(view));
+	}
+
+	//keys whose bits above shift equal prefix
+	template<typename T, typename Transform>
+	std::vector<uint32_t> gatherKeys(const ImageView<const T>& view, bool clip, Transform& transform, int shift, uint32_t prefix) {
+
+		using V = decltype(transform(T()));
+		using Keys = std::vector<uint32_t>;
+
+		auto map = [&](int start, int end) {
+
+			Keys keys;
+
+			forEachPixel(view, start, end, clip, [&](T pixel) {
+				uint32_t key = Key<V>::to(transform(pixel));
+				if ((uint64_t(key) >> shift) == prefix)
+					keys.push_back(key);
+				});
+
+			return keys;
+		};
+
+		auto reduce = [](Keys a, Keys b) {
+			a.insert(a.end(), b.begin(), b.end());
+			return a;
+		};
+
+		return ThreadPool::parallelReduce(0, int(view.rows()), Keys(), map, reduce, rowGrain(view));
+	}
+
+	//buckets at most this big are gathered and selected from directly instead of taking another digit pass
+	constexpr uint64_t gather_limit = 1 << 22;
+
+	//q quantile of transform(pixel), interpolated between the ranks either side of q * (n - 1)
+	//16 bit keys take one counting pass, float keys one counting pass and then usually a gathering pass
+	template<typename T, typename Transform>
+	double select(const ImageView<const T>& view, bool clip, Transform transform, double q) {
+
+		using V = decltype(transform(T()));
+		constexpr int bits = Key<V>::bits;
+
+		if (view.empty())
+			return 0;
+
+		std::vector<int> widths = (bits <= 16) ? std::vector<int>{ bits } : std::vector<int>{ 16, 16 };
+
+		int shift = bits;
+		uint32_t prefix = 0;
+		uint64_t below = 0;
+		uint64_t in_bucket = 0;
+		uint64_t rank = 0;
+		double pos = 0;
+
+		for (size_t d = 0; d < widths.size(); ++d) {
+
+			int width = widths[d];
+			shift -= width;
+
+			Counts counts = countDigit(view, clip, transform, shift, width, prefix, d > 0);
+
+			if (d == 0) {
+				uint64_t n = 0;
+				for (auto c : counts)
+					n += c;
+
+				if (n == 0)
+					return 0;
+
+				pos = std::clamp(q, 0.0, 1.0) * (n - 1);
+				rank = uint64_t(pos);
+			}
+
+			uint32_t b = 0;
+			for (; b < counts.size() - 1; ++b) {
+				if (below + counts[b] > rank)
+					break;
+				below += counts[b];
+			}
+
+			in_bucket = counts[b];
+			prefix = (prefix << width) | b;
+
+			if (shift == 0 || in_bucket > gather_limit)
+				continue;
+
+			auto keys = gatherKeys(view, clip, transform, shift, prefix);
+			auto r = keys.begin() + (rank - below);
+
+			std::nth_element(keys.begin(), r, keys.end());
+			double value = Key<V>::from(*r);
+
+			if (pos == rank)
+				return value;
+
+			uint32_t next = (r + 1 != keys.end()) ? *std::min_element(r + 1, keys.end()) : successor(view, clip, transform, *r);
+
+			return value + (pos - rank) * (Key<V>::from(next) - value);
+		}
+
+		double value = Key<V>::from(prefix);
+		double frac = pos - rank;
+
+		//the next rank holds the same value unless this one was the last of its kind
+		if (frac == 0 || below + in_bucket > rank + 1)
+			return value;
+
+		double next = Key<V>::from(successor(view, clip, transform, prefix));
+
+		return value + frac * (next - value);
+	}
+}
+
+template<typename T>
+float Quantile::quantile(const ImageView<const T>& view, double q, bool clip) {
+	return select(view, clip, [](T pixel) { return pixel; }, q);
+}
+template float Quantile::quantile(const ImageView<const uint8_t>& view, double q, bool clip);
+template float Quantile::quantile(const ImageView<const uint16_t>& view, double q, bool clip);
+template float Quantile::quantile(const ImageView<const float>& view, double q, bool clip);
+
+template<typename T>
+float Quantile::mad(const ImageView<const T>& view, float median, bool clip) {
+	return select(view, clip, [median](T pixel) { return std::fabs(float(pixel) - median); }, 0.5);
+}
+template float Quantile::mad(const ImageView<const uint8_t>& view, float median, bool clip);
+template float Quantile::mad(const ImageView<const uint16_t>& view, float median, bool clip);
+template float Quantile::mad(const ImageView<const float>& view, float median, bool clip);
+
+template<typename T>
+Quantile::Estimate Quantile::approximateQuantile(const ImageView<const T>& view, double q, bool clip, uint32_t sample_size) {
+
+	Estimate estimate;
+
+	size_t px_count = view.pxCount();
+	if (view.empty() || sample_size == 0)
+		return estimate;
+
+	if (sample_size >= px_count) {
+		estimate.value = estimate.lower = estimate.upper = quantile(view, q, clip);
+		return estimate;
+	}
+
+	std::vector<T> sample;
+	sample.reserve(sample_size);
+
+	//seeded by the size so repeated calls on the same image agree
+	std::mt19937_64 rng(px_count);
+	std::uniform_int_distribution<size_t> dist(0, px_count - 1);
+
+	for (uint32_t i = 0; i < sample_size; ++i) {
+		size_t el = dist(rng);
+		T pixel = view(el % view.cols(), el / view.cols());
+		if (!clip || !isClipped(pixel))
+			sample.push_back(pixel);
+	}
+
+	if (sample.empty())
+		return estimate;
+
+	std::sort(sample.begin(), sample.end());
+
+	auto at = [&sample](double p) {
+		double pos = std::clamp(p, 0.0, 1.0) * (sample.size() - 1);
+		size_t r = pos;
+		double value = sample[r];
+		return (r + 1 < sample.size()) ? value + (pos - r) * (double(sample[r + 1]) - value) : value;
+	};
+
+	//dvoretzky-kiefer-wolfowitz bound at 99% confidence
+	estimate.rank_error = sqrt(log(2 / 0.01) / (2.0 * sample.size()));
+
+	estimate.value = at(q);
+	estimate.lower = at(q - estimate.rank_error);
+	estimate.upper = at(q + estimate.rank_error);
+
+	return estimate;
+}
+template Quantile::Estimate Quantile::approximateQuantile(const ImageView<const uint8_t>& view, double q, bool clip, uint32_t sample_size);
+template Quantile::Estimate Quantile::approximateQuantile(const ImageView<const uint16_t>& view, double q, bool clip, uint32_t sample_size);
+template Quantile::Estimate Quantile::approximateQuantile(const ImageView<const float>& view, double q, bool clip, uint32_t sample_size);
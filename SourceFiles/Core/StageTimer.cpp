@@ -0,0 +1,59 @@
+#include "pch.h"
+#include "StageTimer.h"
+#include "ImageAllocator.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+StageTimer::Scope::Scope(StageTimer* timer, const char* name) : m_timer(timer), m_name(name) {
+
+	if (m_timer == nullptr)
+		return;
+
+	ImageAllocator::resetPeak();
+	m_start = std::chrono::steady_clock::now();
+}
+
+StageTimer::Scope::~Scope() {
+
+	if (m_timer == nullptr)
+		return;
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+	m_timer->add(m_name, seconds, ImageAllocator::peakBytes());
+}
+
+void StageTimer::add(const char* name, double seconds, size_t peak_bytes) {
+
+	auto it = std::find_if(m_stages.begin(), m_stages.end(), [name](const Stage& s) { return s.name == name; });
+
+	if (it == m_stages.end()) {
+		m_stages.push_back({ name });
+		it = m_stages.end() - 1;
+	}
+
+	it->calls++;
+	it->seconds += seconds;
+	it->peak_bytes = std::max(it->peak_bytes, peak_bytes);
+}
+
+size_t StageTimer::peakProcessMemory() {
+
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc = {};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return 0;
+	return pmc.PeakWorkingSetSize;
+#else
+	rusage usage = {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	//kilobytes on linux
+	return size_t(usage.ru_maxrss) * 1024;
+#endif
+}
@@ -425,7 +425,7 @@ void StarDetector::daofind(const Image<T>& gray, StarVector& star_vector, PSFVec
 
     Image<T> conv = Image<T>(gray);
 
-    T median = gray.computeMedian(0);
+    T median = gray.computeMedian(0, false, Quantile::Mode::approximate);
     T sigma = gray.computeStdDev(0);
     T t = median + m_K * sigma;
 
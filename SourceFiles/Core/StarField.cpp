@@ -0,0 +1,112 @@
+#include "pch.h"
+#include "StarField.h"
+#include "ThreadPool.h"
+#include <random>
+
+StarField::StarField(const Parameters& params) : m_params(params) {
+
+	std::mt19937 rng(m_params.seed);
+
+	//stars also fill a margin around the frame so rotated and offset frames stay covered
+	float mx = 0.1f * m_params.cols;
+	float my = 0.1f * m_params.rows;
+	std::uniform_real_distribution<float> x_dist(-mx, m_params.cols + mx);
+	std::uniform_real_distribution<float> y_dist(-my, m_params.rows + my);
+	std::uniform_real_distribution<float> u_dist(0.0f, 1.0f);
+
+	m_stars.resize(m_params.star_count);
+
+	//many faint stars and few bright ones
+	for (auto& star : m_stars) {
+		star.x = x_dist(rng);
+		star.y = y_dist(rng);
+		star.amplitude = math::min(0.9f, 0.02f / std::pow(math::max(u_dist(rng), 1e-3f), 0.8f));
+	}
+}
+
+Matrix StarField::placementMatrix(const Placement& placement)const {
+
+	double cx = m_params.cols / 2.0;
+	double cy = m_params.rows / 2.0;
+	double c = cos(placement.rotation);
+	double s = sin(placement.rotation);
+
+	return Matrix(3, 3, { c, -s, cx - c * cx + s * cy + placement.dx,
+						  s, c, cy - s * cx - c * cy + placement.dy,
+						  0, 0, 1 });
+}
+
+Image32 StarField::frame(const Placement& placement, uint32_t frame_index)const {
+
+	const Parameters& p = m_params;
+	Image32 img(p.rows, p.cols, p.channels);
+
+	Matrix h = placementMatrix(placement);
+
+	std::vector<TrueStar> stars;
+	stars.reserve(m_stars.size());
+
+	for (auto star : m_stars) {
+		float x = h(0, 0) * star.x + h(0, 1) * star.y + h(0, 2);
+		float y = h(1, 0) * star.x + h(1, 1) * star.y + h(1, 2);
+		stars.push_back({ x, y, star.amplitude });
+	}
+
+	float sigma = p.fwhm / 2.35482f;
+	float alpha = p.fwhm / (2 * sqrt(pow(2.0f, 1 / p.beta) - 1));
+	int radius = (p.psf == PSF::Type::gaussian) ? ceil(4 * sigma) : ceil(3 * p.fwhm);
+
+	auto profile = [&](float r2) {
+		if (p.psf == PSF::Type::gaussian)
+			return exp(-r2 / (2 * sigma * sigma));
+		return pow(1 + r2 / (alpha * alpha), -p.beta);
+	};
+
+	ThreadPool::parallelFor(0, p.rows, [&](int start, int end) {
+
+		for (auto& star : stars) {
+
+			int y0 = math::max<int>(start, floor(star.y) - radius);
+			int y1 = math::min<int>(end - 1, floor(star.y) + radius);
+			int x0 = math::max<int>(0, floor(star.x) - radius);
+			int x1 = math::min<int>(p.cols - 1, floor(star.x) + radius);
+
+			for (int y = y0; y <= y1; ++y) {
+				for (int x = x0; x <= x1; ++x) {
+					float dx = x - star.x;
+					float dy = y - star.y;
+					float v = star.amplitude * profile(dx * dx + dy * dy);
+
+					for (uint32_t ch = 0; ch < p.channels; ++ch)
+						img(x, y, ch) += v;
+				}
+			}
+		}
+
+		//a generator per row keeps frames identical whatever the thread count
+		for (int y = start; y < end; ++y) {
+			for (uint32_t ch = 0; ch < p.channels; ++ch) {
+
+				std::seed_seq seq = { p.seed, frame_index, uint32_t(y), ch };
+				std::mt19937 rng(seq);
+				std::normal_distribution<float> noise(p.background, math::max(p.noise, 1e-12f));
+
+				float* row = &img(0, y, ch);
+				for (uint32_t x = 0; x < p.cols; ++x)
+					row[x] = math::clip(row[x] + ((p.noise > 0) ? noise(rng) : p.background));
+			}
+		}
+	});
+
+	std::seed_seq seq = { p.seed, frame_index, ~0u };
+	std::mt19937 rng(seq);
+
+	for (uint32_t i = 0; i < p.hot_pixels; ++i) {
+		uint32_t x = rng() % p.cols;
+		uint32_t y = rng() % p.rows;
+		for (uint32_t ch = 0; ch < p.channels; ++ch)
+			img(x, y, ch) = 1.0f;
+	}
+
+	return img;
+}
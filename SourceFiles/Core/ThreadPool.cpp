@@ -0,0 +1,211 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+static thread_local int t_worker_index = -1;
+
+struct ThreadPool::Job {
+	//owned by the caller, which waits for every chunk
+	const std::function<void(int, int)>* func = nullptr;
+	int begin = 0;
+	int end = 0;
+	int grain = 1;
+	int chunks = 0;
+
+	std::atomic_int next = 0;
+	std::atomic_int done = 0;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::exception_ptr exception;
+
+	//claims chunks until none are left, late helpers find nothing and return without touching func
+	void work() {
+
+		for (int c = next++; c < chunks; c = next++) {
+
+			int start = begin + c * grain;
+
+			try {
+				(*func)(start, std::min(start + grain, end));
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lg(mutex);
+				if (!exception)
+					exception = std::current_exception();
+			}
+
+			if (++done == chunks) {
+				std::lock_guard<std::mutex> lg(mutex);
+				cv.notify_all();
+			}
+		}
+	}
+};
+
+ThreadPool& ThreadPool::instance() {
+
+	static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+	return pool;
+}
+
+uint32_t ThreadPool::threadCount() {
+	return instance().m_thread_count;
+}
+
+void ThreadPool::setThreadCount(uint32_t thread_count) {
+
+	thread_count = std::max(1u, thread_count);
+
+	ThreadPool& pool = instance();
+
+	if (thread_count != pool.m_thread_count) {
+		pool.stop();
+		pool.start(thread_count);
+	}
+
+	omp_set_num_threads(thread_count);
+}
+
+bool ThreadPool::isWorkerThread() {
+	return t_worker_index >= 0;
+}
+
+void ThreadPool::start(uint32_t thread_count) {
+
+	m_thread_count = thread_count;
+	m_stop = false;
+
+	//the calling thread is the remaining one
+	for (uint32_t i = 0; i < thread_count - 1; ++i)
+		m_queues.emplace_back(std::make_unique<Queue>());
+
+	for (uint32_t i = 0; i < thread_count - 1; ++i)
+		m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+void ThreadPool::stop() {
+
+	{
+		std::lock_guard<std::mutex> lg(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+
+	m_workers.clear();
+	m_queues.clear();
+	m_queued = 0;
+	m_idle = 0;
+}
+
+void ThreadPool::workerLoop(int index) {
+
+	t_worker_index = index;
+
+	//openmp regions inside pool tasks run serially instead of starting a team per worker
+	omp_set_num_threads(1);
+
+	while (true) {
+
+		Task task;
+		if (take(index, task)) {
+			task();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lk(m_mutex);
+		m_idle++;
+		m_cv.wait(lk, [this]() { return m_stop || m_queued > 0; });
+		m_idle--;
+
+		if (m_stop && m_queued == 0)
+			return;
+	}
+}
+
+void ThreadPool::push(Task task) {
+
+	//workers keep nested work local, others spread it round robin
+	size_t index = (t_worker_index >= 0) ? t_worker_index : m_next_queue++ % m_queues.size();
+
+	{
+		std::lock_guard<std::mutex> lg(m_queues[index]->mutex);
+		m_queues[index]->tasks.push_back(std::move(task));
+	}
+
+	{
+		std::lock_guard<std::mutex> lg(m_mutex);
+		m_queued++;
+	}
+	m_cv.notify_one();
+}
+
+bool ThreadPool::take(int index, Task& task) {
+
+	Queue& own = *m_queues[index];
+	{
+		std::lock_guard<std::mutex> lg(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			m_queued--;
+			return true;
+		}
+	}
+
+	for (size_t i = 1; i < m_queues.size(); ++i) {
+		Queue& other = *m_queues[(index + i) % m_queues.size()];
+
+		std::lock_guard<std::mutex> lg(other.mutex);
+		if (!other.tasks.empty()) {
+			task = std::move(other.tasks.front());
+			other.tasks.pop_front();
+			m_queued--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::run(int begin, int end, int grain, const std::function<void(int start, int end)>& func) {
+
+	int size = end - begin;
+	if (size <= 0)
+		return;
+
+	if (grain <= 0)
+		grain = defaultGrain(size);
+
+	int chunks = (size + grain - 1) / grain;
+
+	int helpers = std::min<int>(chunks - 1, m_workers.size());
+	if (isWorkerThread())
+		helpers = std::min<int>(helpers, m_idle);
+
+	if (helpers <= 0) {
+		for (int start = begin; start < end; start += grain)
+			func(start, std::min(start + grain, end));
+		return;
+	}
+
+	auto job = std::make_shared<Job>();
+	job->func = &func;
+	job->begin = begin;
+	job->end = end;
+	job->grain = grain;
+	job->chunks = chunks;
+
+	for (int i = 0; i < helpers; ++i)
+		push([job]() { job->work(); });
+
+	job->work();
+
+	std::unique_lock<std::mutex> lk(job->mutex);
+	job->cv.wait(lk, [&job]() { return job->done == job->chunks; });
+
+	if (job->exception)
+		std::rethrow_exception(job->exception);
+}
@@ -136,7 +136,7 @@ Image32 EdgeDetection::apply(const Image<T>& img) {
 
 	g_mag.normalize();
 
-	float median = g_mag.computeMedian(0, true);
+	float median = g_mag.computeMedian(0, true, Quantile::Mode::approximate);
 
 	float minVal = median;
 	float maxVal = 3 * median;
@@ -24,6 +24,8 @@ FITS::FITSHeader::FITSHeader(int bitpix, std::array<uint32_t, 3> axis, bool end)
 
 void FITS::FITSHeader::addKeyword(const std::string& keyword, char* hbp, int& iter) {
 
+	keyword_index.emplace(keyword, keyword_count);
+
 	for (; iter < keyword.length(); ++iter)
 		hbp[iter] = keyword[iter];
 
@@ -107,33 +109,123 @@ void FITS::FITSHeader::addIntegerKeyword(const std::string& keyword, int integer
 	keyword_count++;
 }
 
-int FITS::FITSHeader::keywordValue(const std::string& keyword) {
+void FITS::FITSHeader::addStringKeyword(const std::string& keyword, const std::string& value, const std::string& comment) {
+	//byte number = iter + 1
+	if (keyword_count % 36 == 0 && keyword_count != 0)
+		resizeHeaderBlock();
 
-	for (auto hl : header_block) {
-		bool matches = true;
-		for (int i = 0; i < keyword.length(); ++i)
-			if (hl[i] != keyword[i]) {
-				matches = false;
-				break;
-			}
-		if (matches) {
-			std::string value;
+	int iter = 0;
+	char* hbp = &header_block[keyword_count][0];
 
-			for (int i = 10; i < 80; ++i) {
-				if (hl[i] == '/')
-					break;
+	addKeyword(keyword, hbp, iter);
 
-				else if (hl[i] != ' ')
-					value.push_back(hl[i]);
-			}
+	hbp[iter++] = '\'';
 
-			return std::stoi(value);
+	for (char l : value) {
+		if (iter >= 77)
+			break;
+		hbp[iter++] = l;
+		if (l == '\'')
+			hbp[iter++] = l;
+	}
 
+	//fixed format strings are at least 8 characters
+	for (; iter < 19; ++iter)
+		hbp[iter] = ' ';
+
+	hbp[iter++] = '\'';
+
+	if (!comment.empty())
+		addKeywordComment(comment, hbp, iter);
+
+	for (; iter < 80; ++iter)
+		hbp[iter] = ' ';
+
+	keyword_count++;
+}
+
+int FITS::FITSHeader::keywordValue(const std::string& keyword)const {
+
+	return int(keywordDouble(keyword));
+}
+
+const FITS::FITSHeader::header_line* FITS::FITSHeader::findKeyword(const std::string& keyword)const {
+
+	auto it = keyword_index.find(keyword);
+
+	return (it != keyword_index.end()) ? &header_block[it->second] : nullptr;
+}
+
+std::string FITS::FITSHeader::keywordString(const std::string& keyword)const {
+
+	const header_line* hl = findKeyword(keyword);
+	if (!hl)
+		return "";
+
+	int i = 10;
+	for (; i < 80 && (*hl)[i] == ' '; ++i);
+
+	if (i == 80 || (*hl)[i] != '\'')
+		return "";
+
+	std::string value;
+
+	for (++i; i < 80; ++i) {
+		if ((*hl)[i] == '\'') {
+			//'' is an escaped quote
+			if (i + 1 < 80 && (*hl)[i + 1] == '\'') {
+				value.push_back('\'');
+				++i;
+				continue;
+			}
+			break;
 		}
+		value.push_back((*hl)[i]);
+	}
+
+	//trailing spaces are not significant
+	while (!value.empty() && value.back() == ' ')
+		value.pop_back();
+
+	return value;
+}
+
+double FITS::FITSHeader::keywordDouble(const std::string& keyword, double default_value)const {
+
+	const header_line* hl = findKeyword(keyword);
+	if (!hl)
+		return default_value;
+
+	std::string value;
+
+	for (int i = 10; i < 80; ++i) {
+		if ((*hl)[i] == '/')
+			break;
+
+		else if ((*hl)[i] != ' ')
+			value.push_back(((*hl)[i] == 'D') ? 'E' : (*hl)[i]);
 	}
 
-	//return "NoKeyWordFound";
-	return 0;
+	char* end = nullptr;
+	double v = std::strtod(value.c_str(), &end);
+
+	return (end == value.c_str()) ? default_value : v;
+}
+
+bool FITS::FITSHeader::keywordLogical(const std::string& keyword)const {
+
+	const header_line* hl = findKeyword(keyword);
+	if (!hl)
+		return false;
+
+	for (int i = 10; i < 80; ++i) {
+		if ((*hl)[i] == 'T')
+			return true;
+		else if ((*hl)[i] != ' ')
+			return false;
+	}
+
+	return false;
 }
 
 void FITS::FITSHeader::endHeader() {
@@ -159,29 +251,39 @@ void FITS::FITSHeader::endHeader() {
 
 }
 
-void FITS::FITSHeader::read(std::fstream& stream) {
+void FITS::FITSHeader::read(std::fstream& stream, std::streampos start) {
 
-	stream.seekg(0);
+	stream.seekg(start);
 
-	for (int kw = 0; ; ++kw) {
+	header_block.clear();
+	keyword_index.clear();
 
-		if (kw != 0 && kw % 36 == 0)
-			resizeHeaderBlock();
+	for (int block = 0; ; ++block) {
 
-		char end[4] = { 'E','N','D',' ' };
-		stream.read(header_block[kw].data(), 80);
-		bool matches = true;
+		resizeHeaderBlock();
+		header_line* lines = &header_block[block * 36];
 
-		for (int i = 0; i < 4; ++i)
-			if (header_block[kw][i] != end[i]) {
-				matches = false;
-				break;
-			}
+		stream.read(lines[0].data(), 36 * 80);
 
-		if (matches)
+		if (stream.gcount() != 36 * 80)
 			return;
-	}
 
+		for (int l = 0; l < 36; ++l) {
+			const header_line& hl = lines[l];
+
+			if (hl[0] == 'E' && hl[1] == 'N' && hl[2] == 'D' && hl[3] == ' ')
+				return;
+
+			std::string keyword(hl.data(), 8);
+			while (!keyword.empty() && keyword.back() == ' ')
+				keyword.pop_back();
+
+			if (keyword.empty() || keyword == "COMMENT" || keyword == "HISTORY")
+				continue;
+
+			keyword_index.emplace(std::move(keyword), block * 36 + l);
+		}
+	}
 }
 
 void FITS::FITSHeader::write(std::fstream& stream) {
@@ -233,17 +335,153 @@ bool FITS::isFITSFile() {
 	return false;
 }
 
-void FITS::open(std::filesystem::path path) {
+bool FITS::HeaderCache::find(const std::filesystem::path& path, FITSHeader& header, std::streampos& data_pos) {
 
-	ImageFile::open(path);
+	std::error_code ec;
+	auto write_time = std::filesystem::last_write_time(path, ec);
+	if (ec)
+		return false;
+
+	auto size = std::filesystem::file_size(path, ec);
+	if (ec)
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_entries.find(path.string());
+	if (it == m_entries.end() || it->second.write_time != write_time || it->second.size != size)
+		return false;
+
+	header = it->second.header;
+	data_pos = it->second.data_pos;
+
+	return true;
+}
+
+void FITS::HeaderCache::insert(const std::filesystem::path& path, const FITSHeader& header, std::streampos data_pos) {
+
+	std::error_code ec;
+	auto write_time = std::filesystem::last_write_time(path, ec);
+	if (ec)
+		return;
 
-	if (!isFITSFile())
+	auto size = std::filesystem::file_size(path, ec);
+	if (ec)
 		return;
 
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_entries.size() >= m_max_entries)
+		m_entries.clear();
+
+	m_entries[path.string()] = { write_time, size, header, data_pos };
+}
+
+void FITS::HeaderCache::erase(const std::filesystem::path& path) {
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.erase(path.string());
+}
+
+FITS::HeaderCache& FITS::headerCache() {
+
+	static HeaderCache cache;
+	return cache;
+}
+
+bool FITS::readHeader() {
+
 	m_fits_header.read(m_stream);
 
+	if (!m_stream || !m_fits_header.keywordLogical("SIMPLE")) {
+		m_stream.clear();
+		return false;
+	}
+
 	m_data_pos = m_fits_header.header_block.size() * 80;
 
+	//compressed images follow an empty primary hdu
+	if (m_fits_header.keywordValue("NAXIS") == 0 && m_fits_header.keywordLogical("EXTEND")) {
+		FITSHeader ext;
+		ext.read(m_stream, m_data_pos);
+
+		if (m_stream && ext.keywordString("XTENSION") == "BINTABLE" && ext.keywordLogical("ZIMAGE"))
+			m_fits_header = std::move(ext);
+
+		m_stream.clear();
+	}
+
+	return true;
+}
+
+FITS::FrameInfo FITS::frameInfo()const {
+
+	const FITSHeader& h = m_fits_header;
+
+	FrameInfo info;
+	info.tile_compressed = h.keywordLogical("ZIMAGE");
+
+	std::string z = (info.tile_compressed) ? "Z" : "";
+
+	info.cols = h.keywordValue(z + "NAXIS1");
+	info.rows = h.keywordValue(z + "NAXIS2");
+	info.channels = (h.keywordValue(z + "NAXIS") > 2) ? h.keywordValue(z + "NAXIS3") : 1;
+
+	switch (h.keywordValue(z + "BITPIX")) {
+	case 16:
+		info.type = ImageType::USHORT;
+		break;
+	case -32:
+		info.type = ImageType::FLOAT;
+		break;
+	default:
+		info.type = ImageType::UBYTE;
+		break;
+	}
+
+	info.exposure = h.keywordDouble("EXPTIME", h.keywordDouble("EXPOSURE"));
+	info.gain = h.keywordDouble("GAIN");
+	info.ccd_temp = h.keywordDouble("CCD-TEMP", h.keywordDouble("CCD_TEMP"));
+	info.filter = h.keywordString("FILTER");
+
+	return info;
+}
+
+FITS::FrameInfo FITS::readFrameInfo(const std::filesystem::path& path) {
+
+	FITS fits;
+
+	if (!headerCache().find(path, fits.m_fits_header, fits.m_data_pos)) {
+		fits.ImageFile::open(path);
+
+		if (!fits.readHeader())
+			return FrameInfo();
+
+		headerCache().insert(path, fits.m_fits_header, fits.m_data_pos);
+	}
+
+	return fits.frameInfo();
+}
+
+void FITS::open(std::filesystem::path path) {
+
+	ImageFile::open(path);
+
+	if (!headerCache().find(path, m_fits_header, m_data_pos)) {
+		if (!readHeader())
+			return;
+
+		headerCache().insert(path, m_fits_header, m_data_pos);
+	}
+
+	if (m_fits_header.keywordLogical("ZIMAGE")) {
+		if (openTiledImage()) {
+			m_px_count = rows() * cols();
+			resizeBuffer();
+		}
+		return;
+	}
+
 	m_img_type = imageTypefromFile();
 
 	int naxis = m_fits_header.keywordValue("NAXIS");
@@ -263,6 +501,7 @@ void FITS::open(std::filesystem::path path) {
 void FITS::create(std::filesystem::path path) {
 
 	path += ".fits";
+	headerCache().erase(path);
 	ImageFile::create(path);
 }
 
@@ -272,11 +511,529 @@ void FITS::close() {
 
 	m_fits_header = FITSHeader();
 	m_data_pos = 2880;
+
+	m_tiled = TiledImage();
+	m_cached_tile_row = -1;
+	m_tile_cache.clear();
+}
+
+static uint64_t readBigEndian(const uint8_t* src, int bytes) {
+
+	uint64_t v = 0;
+	for (int i = 0; i < bytes; ++i)
+		v = (v << 8) | src[i];
+
+	return v;
+}
+
+static void writeBigEndian(uint64_t v, uint8_t* dst, int bytes) {
+
+	for (int i = bytes - 1; i >= 0; --i, v >>= 8)
+		dst[i] = v & 0xFF;
+}
+
+static double readBigEndianReal(const uint8_t* src, int bytes) {
+
+	if (bytes == 4) {
+		uint32_t v = readBigEndian(src, 4);
+		float f;
+		memcpy(&f, &v, 4);
+		return f;
+	}
+
+	uint64_t v = readBigEndian(src, 8);
+	double d;
+	memcpy(&d, &v, 8);
+	return d;
+}
+
+//gzip of big endian items, GZIP_2 groups the bytes of each item first
+static std::vector<uint8_t> gzipTile(const std::vector<uint8_t>& src, size_t item_size, bool shuffle) {
+
+	if (!shuffle || item_size == 1)
+		return Compression::compress(Compression::Codec::gzip, src.data(), src.size());
+
+	std::vector<uint8_t> shuffled(src.size());
+	Compression::shuffle(src.data(), shuffled.data(), src.size(), item_size);
+	return Compression::compress(Compression::Codec::gzip, shuffled.data(), shuffled.size());
+}
+
+static bool gunzipTile(const std::vector<uint8_t>& src, std::vector<uint8_t>& dst, size_t item_size, bool shuffle) {
+
+	if (!Compression::decompress(Compression::Codec::gzip, src.data(), src.size(), dst.data(), dst.size()))
+		return false;
+
+	if (shuffle && item_size > 1) {
+		std::vector<uint8_t> shuffled = dst;
+		Compression::unshuffle(shuffled.data(), dst.data(), dst.size(), item_size);
+	}
+
+	return true;
+}
+
+//random sequence used by the subtractive dithering of quantized floats
+static const std::vector<float>& ditherSequence() {
+
+	static const std::vector<float> sequence = []() {
+		std::vector<float> rand(10000);
+
+		double a = 16807.0;
+		double m = 2147483647.0;
+		double seed = 1.0;
+
+		for (auto& r : rand) {
+			double temp = a * seed;
+			seed = temp - m * int(temp / m);
+			r = seed / m;
+		}
+
+		return rand;
+	}();
+
+	return sequence;
+}
+
+bool FITS::openTiledImage() {
+
+	const FITSHeader& ext = m_fits_header;
+
+	TiledImage tiled;
+
+	std::string cmp = ext.keywordString("ZCMPTYPE");
+	if (cmp == "RICE_1" || cmp == "RICE_ONE")
+		tiled.codec = TileCodec::rice;
+	else if (cmp == "GZIP_1")
+		tiled.codec = TileCodec::gzip;
+	else if (cmp == "GZIP_2")
+		tiled.codec = TileCodec::gzip_shuffle;
+	else
+		return false;
+
+	tiled.zbitpix = ext.keywordValue("ZBITPIX");
+	int znaxis = ext.keywordValue("ZNAXIS");
+
+	if (znaxis < 2 || znaxis > 3)
+		return false;
+
+	std::array<uint32_t, 3> axis = { uint32_t(ext.keywordValue("ZNAXIS1")), uint32_t(ext.keywordValue("ZNAXIS2")), 1 };
+	if (znaxis == 3)
+		axis[2] = ext.keywordValue("ZNAXIS3");
+
+	for (int i = 0; i < 3; ++i) {
+		std::string key = "ZTILE" + std::to_string(i + 1);
+		int size = ext.hasKeyword(key) ? ext.keywordValue(key) : ((i == 0) ? axis[0] : 1);
+		tiled.tile_size[i] = std::clamp<uint32_t>(size, 1, std::max<uint32_t>(axis[i], 1));
+		tiled.tile_count[i] = (axis[i] + tiled.tile_size[i] - 1) / tiled.tile_size[i];
+	}
+
+	tiled.bytepix = (tiled.zbitpix == 8) ? 1 : (tiled.zbitpix == 16) ? 2 : 4;
+
+	for (int i = 1; ext.hasKeyword("ZNAME" + std::to_string(i)); ++i) {
+		std::string name = ext.keywordString("ZNAME" + std::to_string(i));
+		int value = ext.keywordValue("ZVAL" + std::to_string(i));
+
+		if (name == "BLOCKSIZE")
+			tiled.block_size = value;
+		else if (name == "BYTEPIX")
+			tiled.bytepix = value;
+	}
+
+	if (tiled.bytepix != 1 && tiled.bytepix != 2 && tiled.bytepix != 4)
+		return false;
+
+	tiled.bzero = ext.keywordDouble("BZERO", 0.0);
+	tiled.dither_seed = ext.keywordValue("ZDITHER0");
+	if (tiled.dither_seed <= 0)
+		tiled.dither_seed = 1;
+
+	if (ext.hasKeyword("ZBLANK")) {
+		tiled.has_blank = true;
+		tiled.blank = ext.keywordValue("ZBLANK");
+	}
+
+	//binary table layout
+	uint64_t row_bytes = ext.keywordValue("NAXIS1");
+	uint64_t row_count = ext.keywordValue("NAXIS2");
+	int fields = ext.keywordValue("TFIELDS");
+
+	struct Column {
+		int offset = -1;
+		int bytes = 0; //element size of reals, descriptor size of P/Q
+	};
+
+	Column data_col, gzip_col, scale_col, zero_col, blank_col;
+
+	int offset = 0;
+	for (int i = 1; i <= fields; ++i) {
+		std::string ttype = ext.keywordString("TTYPE" + std::to_string(i));
+		std::string tform = ext.keywordString("TFORM" + std::to_string(i));
+
+		size_t p = 0;
+		int repeat = 0;
+		for (; p < tform.size() && std::isdigit(tform[p]); ++p)
+			repeat = repeat * 10 + (tform[p] - '0');
+
+		if (p == 0)
+			repeat = 1;
+
+		if (p == tform.size())
+			return false;
+
+		char type = tform[p];
+		int width = 0;
+
+		switch (type) {
+		case 'P': width = 8; break;
+		case 'Q': width = 16; break;
+		case 'L': case 'B': case 'A': width = repeat; break;
+		case 'X': width = (repeat + 7) / 8; break;
+		case 'I': width = 2 * repeat; break;
+		case 'J': case 'E': width = 4 * repeat; break;
+		case 'K': case 'D': case 'C': width = 8 * repeat; break;
+		case 'M': width = 16 * repeat; break;
+		default: return false;
+		}
+
+		Column col = { offset, (type == 'P') ? 4 : (type == 'Q') ? 8 : (type == 'E' || type == 'J') ? 4 : 8 };
+
+		if (ttype == "COMPRESSED_DATA")
+			data_col = col;
+		else if (ttype == "GZIP_COMPRESSED_DATA")
+			gzip_col = col;
+		else if (ttype == "ZSCALE")
+			scale_col = col;
+		else if (ttype == "ZZERO")
+			zero_col = col;
+		else if (ttype == "ZBLANK")
+			blank_col = col;
+
+		offset += width;
+	}
+
+	if (data_col.offset < 0)
+		return false;
+
+	bool quantized = scale_col.offset >= 0 || ext.hasKeyword("ZSCALE");
+
+	if (tiled.zbitpix == -32 && quantized) {
+		std::string q = ext.keywordString("ZQUANTIZ");
+
+		if (q == "SUBTRACTIVE_DITHER_1")
+			tiled.quantize = Quantize::subtractive_dither_1;
+		else if (q == "SUBTRACTIVE_DITHER_2")
+			tiled.quantize = Quantize::subtractive_dither_2;
+		else
+			tiled.quantize = Quantize::no_dither;
+	}
+
+	size_t tile_total = size_t(tiled.tile_count[0]) * tiled.tile_count[1] * tiled.tile_count[2];
+	if (row_count != tile_total)
+		return false;
+
+	switch (tiled.zbitpix) {
+	case 8:
+		m_img_type = ImageType::UBYTE;
+		break;
+	case 16:
+		m_img_type = ImageType::USHORT;
+		break;
+	case -32:
+		m_img_type = ImageType::FLOAT;
+		break;
+	default:
+		return false;
+	}
+
+	uint64_t table_pos = uint64_t(m_data_pos) + ext.header_block.size() * 80;
+	uint64_t heap_pos = table_pos + (ext.hasKeyword("THEAP") ? ext.keywordValue("THEAP") : row_bytes * row_count);
+
+	std::vector<uint8_t> table(row_bytes * row_count);
+	m_stream.seekg(table_pos);
+	m_stream.read((char*)table.data(), table.size());
+
+	if (m_stream.gcount() != std::streamsize(table.size())) {
+		m_stream.clear();
+		return false;
+	}
+
+	auto descriptor = [&](const uint8_t* row, const Column& col, uint64_t& size, uint64_t& position) {
+		size = readBigEndian(row + col.offset, col.bytes);
+		position = heap_pos + readBigEndian(row + col.offset + col.bytes, col.bytes);
+	};
+
+	tiled.tiles.resize(tile_total);
+	double header_scale = ext.keywordDouble("ZSCALE", 1.0);
+	double header_zero = ext.keywordDouble("ZZERO", 0.0);
+
+	for (size_t t = 0; t < tile_total; ++t) {
+		const uint8_t* row = &table[t * row_bytes];
+		Tile& tile = tiled.tiles[t];
+
+		descriptor(row, data_col, tile.size, tile.position);
+
+		if (gzip_col.offset >= 0)
+			descriptor(row, gzip_col, tile.gzip_size, tile.gzip_position);
+
+		tile.scale = (scale_col.offset >= 0) ? readBigEndianReal(row + scale_col.offset, scale_col.bytes) : header_scale;
+		tile.zero = (zero_col.offset >= 0) ? readBigEndianReal(row + zero_col.offset, zero_col.bytes) : header_zero;
+	}
+
+	if (blank_col.offset >= 0) {
+		//per tile blank values are rare, the first one is used for the whole image
+		tiled.has_blank = true;
+		tiled.blank = int32_t(readBigEndian(&table[blank_col.offset], 4));
+	}
+
+	m_cols = axis[0];
+	m_rows = axis[1];
+	m_channels = axis[2];
+
+	m_tiled = std::move(tiled);
+
+	return true;
+}
+
+size_t FITS::tilePixelCount(int tile)const {
+
+	std::array<uint32_t, 3> origin = tileOrigin(tile);
+	std::array<uint32_t, 3> axis = { cols(), rows(), channels() };
+
+	size_t count = 1;
+	for (int i = 0; i < 3; ++i)
+		count *= std::min(m_tiled.tile_size[i], axis[i] - origin[i]);
+
+	return count;
+}
+
+std::array<uint32_t, 3> FITS::tileOrigin(int tile)const {
+
+	const auto& tc = m_tiled.tile_count;
+	const auto& ts = m_tiled.tile_size;
+
+	return { (tile % tc[0]) * ts[0], ((tile / tc[0]) % tc[1]) * ts[1], (tile / (tc[0] * tc[1])) * ts[2] };
+}
+
+void FITS::readTile(int tile, std::vector<uint8_t>& data, std::vector<uint8_t>& gzip_data) {
+
+	const Tile& t = m_tiled.tiles[tile];
+
+	data.resize(t.size);
+	if (t.size) {
+		m_stream.seekg(t.position);
+		m_stream.read((char*)data.data(), t.size);
+	}
+
+	gzip_data.resize(t.gzip_size);
+	if (t.gzip_size) {
+		m_stream.seekg(t.gzip_position);
+		m_stream.read((char*)gzip_data.data(), t.gzip_size);
+	}
+}
+
+template<typename T>
+bool FITS::decodeTile(int tile, const std::vector<uint8_t>& data, const std::vector<uint8_t>& gzip_data, T* dst)const {
+
+	const TiledImage& ti = m_tiled;
+	const Tile& t = ti.tiles[tile];
+	size_t count = tilePixelCount(tile);
+
+	bool shuffle = ti.codec == TileCodec::gzip_shuffle;
+
+	//lossless floats, either the whole image or tiles that could not be quantized
+	if (ti.zbitpix == -32 && (ti.quantize == Quantize::none || data.empty())) {
+		const std::vector<uint8_t>& src = (data.empty()) ? gzip_data : data;
+
+		if (ti.codec == TileCodec::rice && !data.empty())
+			return false;
+
+		std::vector<uint8_t> bytes(count * 4);
+		if (!gunzipTile(src, bytes, 4, shuffle && !data.empty()))
+			return false;
+
+		for (size_t i = 0; i < count; ++i)
+			dst[i] = Pixel<T>::toType(float(readBigEndianReal(&bytes[i * 4], 4)));
+
+		return true;
+	}
+
+	std::vector<int32_t> raw(count);
+
+	if (ti.codec == TileCodec::rice) {
+		switch (ti.bytepix) {
+		case 1: {
+			std::vector<uint8_t> v(count);
+			if (!Compression::riceDecompress(data.data(), data.size(), v.data(), count, ti.block_size))
+				return false;
+			std::copy(v.begin(), v.end(), raw.begin());
+			break;
+		}
+		case 2: {
+			std::vector<int16_t> v(count);
+			if (!Compression::riceDecompress(data.data(), data.size(), v.data(), count, ti.block_size))
+				return false;
+			std::copy(v.begin(), v.end(), raw.begin());
+			break;
+		}
+		case 4: {
+			if (!Compression::riceDecompress(data.data(), data.size(), raw.data(), count, ti.block_size))
+				return false;
+			break;
+		}
+		}
+	}
+
+	else {
+		int item_size = (ti.zbitpix == -32) ? 4 : abs(ti.zbitpix) / 8;
+		std::vector<uint8_t> bytes(count * item_size);
+
+		if (!gunzipTile(data, bytes, item_size, shuffle))
+			return false;
+
+		for (size_t i = 0; i < count; ++i) {
+			uint64_t v = readBigEndian(&bytes[i * item_size], item_size);
+			raw[i] = (item_size == 1) ? int32_t(v) : (item_size == 2) ? int16_t(v) : int32_t(v);
+		}
+	}
+
+	switch (ti.zbitpix) {
+	case 8: {
+		for (size_t i = 0; i < count; ++i)
+			dst[i] = Pixel<T>::toType(uint8_t(raw[i]));
+		break;
+	}
+
+	case 16: {
+		int64_t bzero = std::llround(ti.bzero);
+		for (size_t i = 0; i < count; ++i)
+			dst[i] = Pixel<T>::toType(uint16_t(std::clamp<int64_t>(raw[i] + bzero, 0, 65535)));
+		break;
+	}
+
+	case -32: {
+		//zero valued pixels of SUBTRACTIVE_DITHER_2, restored to exactly 0
+		constexpr int32_t zero_value = -2147483646;
+
+		//blank pixels are undefined, NaN for float output and 0 for integer types
+		constexpr T blank_value = std::numeric_limits<T>::quiet_NaN();
+
+		const std::vector<float>& rand = ditherSequence();
+		bool dither = ti.quantize != Quantize::no_dither;
+
+		int iseed = (tile + ti.dither_seed - 1) % rand.size();
+		int next = rand[iseed] * 500;
+
+		for (size_t i = 0; i < count; ++i) {
+			float v = 0.0f;
+
+			if (ti.has_blank && raw[i] == ti.blank)
+				dst[i] = blank_value;
+			else {
+				if (ti.quantize == Quantize::subtractive_dither_2 && raw[i] == zero_value)
+					v = 0.0f;
+				else if (dither)
+					v = (double(raw[i]) - rand[next] + 0.5) * t.scale + t.zero;
+				else
+					v = raw[i] * t.scale + t.zero;
+
+				dst[i] = Pixel<T>::toType(v);
+			}
+
+			if (dither && ++next == rand.size()) {
+				if (++iseed == rand.size())
+					iseed = 0;
+				next = rand[iseed] * 500;
+			}
+		}
+		break;
+	}
+	}
+
+	return true;
+}
+
+template<typename T>
+void FITS::decodeTiles(const std::vector<int>& tiles, std::vector<std::vector<T>>& dst) {
+
+	int count = tiles.size();
+
+	std::vector<std::vector<uint8_t>> data(count);
+	std::vector<std::vector<uint8_t>> gzip_data(count);
+
+	for (int i = 0; i < count; ++i)
+		readTile(tiles[i], data[i], gzip_data[i]);
+
+	if (!m_stream)
+		throw std::runtime_error("Corrupt FITS tile");
+
+	dst.resize(count);
+
+	std::atomic_bool corrupt = false;
+
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < count; ++i) {
+		dst[i].resize(tilePixelCount(tiles[i]));
+
+		if (!decodeTile(tiles[i], data[i], gzip_data[i], dst[i].data()))
+			corrupt = true;
+
+		std::vector<uint8_t>().swap(data[i]);
+		std::vector<uint8_t>().swap(gzip_data[i]);
+	}
+
+	if (corrupt)
+		throw std::runtime_error("Corrupt FITS tile");
+}
+
+template<typename T>
+void FITS::readTiled(Image<T>& dst) {
+
+	dst = Image<T>(rows(), cols(), channels());
+
+	std::vector<int> tiles(m_tiled.tiles.size());
+	std::iota(tiles.begin(), tiles.end(), 0);
+
+	std::vector<std::vector<T>> decoded;
+	decodeTiles(tiles, decoded);
+
+#pragma omp parallel for
+	for (int t = 0; t < int(tiles.size()); ++t) {
+		std::array<uint32_t, 3> o = tileOrigin(t);
+		uint32_t w = std::min(m_tiled.tile_size[0], cols() - o[0]);
+		uint32_t h = std::min(m_tiled.tile_size[1], rows() - o[1]);
+		uint32_t d = std::min(m_tiled.tile_size[2], channels() - o[2]);
+
+		const T* src = decoded[t].data();
+
+		for (uint32_t z = 0; z < d; ++z)
+			for (uint32_t y = 0; y < h; ++y, src += w)
+				std::copy(src, src + w, &dst(o[0], o[1] + y, o[2] + z));
+
+		std::vector<T>().swap(decoded[t]);
+	}
+}
+
+void FITS::copyTileRow(int tile, const std::vector<float>& decoded, uint32_t row, uint32_t channel, float* dst)const {
+
+	std::array<uint32_t, 3> o = tileOrigin(tile);
+	uint32_t w = std::min(m_tiled.tile_size[0], cols() - o[0]);
+	uint32_t h = std::min(m_tiled.tile_size[1], rows() - o[1]);
+
+	const float* src = &decoded[(size_t(channel - o[2]) * h + (row - o[1])) * w];
+	std::copy(src, src + w, dst + o[0]);
 }
 
 template<typename T>
 void FITS::read(Image<T>& dst) {
 
+	if (isTileCompressed()) {
+		readTiled(dst);
+
+		if (imageType() == ImageType::FLOAT)
+			dst.normalize();
+
+		return close();
+	}
+
 	dst = Image<T>(rows(), cols(), channels());
 
 	m_stream.seekg(dataPosition());
@@ -302,6 +1059,15 @@ template void FITS::read(Image32&);
 
 void FITS::readAny(Image32& dst) {
 
+	if (isTileCompressed()) {
+		readTiled(dst);
+
+		if (imageType() == ImageType::FLOAT)
+			dst.normalize();
+
+		return close();
+	}
+
 	dst = Image32(rows(), cols(), channels());
 
 	m_stream.seekg(dataPosition());
@@ -364,6 +1130,28 @@ void FITS::readRow_toFloat(float* dst, uint32_t row, uint32_t channel) {
 	//if (row >= rows() || channel >= channels())
 		//return;
 
+	if (isTileCompressed()) {
+		const auto& ts = m_tiled.tile_size;
+		const auto& tc = m_tiled.tile_count;
+
+		int tile_row = (channel / ts[2]) * tc[1] + row / ts[1];
+
+		if (tile_row != m_cached_tile_row) {
+			std::vector<int> tiles(tc[0]);
+			std::iota(tiles.begin(), tiles.end(), tile_row * tc[0]);
+
+			//a failed decode leaves the cache partly overwritten
+			m_cached_tile_row = -1;
+			decodeTiles(tiles, m_tile_cache);
+			m_cached_tile_row = tile_row;
+		}
+
+		for (uint32_t tx = 0; tx < tc[0]; ++tx)
+			copyTileRow(m_cached_tile_row * tc[0] + tx, m_tile_cache[tx], row, channel, dst);
+
+		return;
+	}
+
 	switch (imageType()) {
 	case ImageType::UBYTE: {
 		std::vector<uint8_t> buffer(cols());
@@ -388,6 +1176,36 @@ void FITS::readRow_toFloat(float* dst, uint32_t row, uint32_t channel) {
 	}
 }
 
+void FITS::readRows_toFloat(float* dst, uint32_t row, uint32_t count, uint32_t channel) {
+
+	if (!isTileCompressed()) {
+		for (uint32_t y = 0; y < count; ++y)
+			readRow_toFloat(dst + size_t(y) * cols(), row + y, channel);
+		return;
+	}
+
+	const auto& ts = m_tiled.tile_size;
+	const auto& tc = m_tiled.tile_count;
+
+	uint32_t z = channel / ts[2];
+	std::vector<int> tiles;
+
+	for (uint32_t ty = row / ts[1]; ty <= (row + count - 1) / ts[1]; ++ty)
+		for (uint32_t tx = 0; tx < tc[0]; ++tx)
+			tiles.push_back((z * tc[1] + ty) * tc[0] + tx);
+
+	std::vector<std::vector<float>> decoded;
+	decodeTiles(tiles, decoded);
+
+	for (int i = 0; i < tiles.size(); ++i) {
+		uint32_t y0 = tileOrigin(tiles[i])[1];
+		uint32_t y1 = std::min({ y0 + ts[1], row + count, rows() });
+
+		for (uint32_t y = std::max(y0, row); y < y1; ++y)
+			copyTileRow(tiles[i], decoded[i], y, channel, dst + size_t(y - row) * cols());
+	}
+}
+
 template<typename T>
 void FITS::writePixels_8(const Image<T>& src) {
 
@@ -460,8 +1278,165 @@ template void FITS::writePixels_float(const Image16&);
 template void FITS::writePixels_float(const Image32&);
 
 
+template<typename T>
+void FITS::writeTiled(const Image<T>& src, ImageType new_type, TileCodec codec) {
+
+	//rice only codes integers, floats are kept lossless rather than quantized
+	if (new_type == ImageType::FLOAT && codec == TileCodec::rice)
+		codec = TileCodec::gzip_shuffle;
+
+	int item_size = typeSize(new_type);
+	int bitpix = ((new_type == ImageType::FLOAT) ? -8 : 8) * item_size;
+	bool shuffle = codec == TileCodec::gzip_shuffle;
+
+	uint32_t tile_rows = m_write_tile_rows;
+	uint32_t tiles_y = (src.rows() + tile_rows - 1) / tile_rows;
+	int tile_count = tiles_y * src.channels();
+
+	std::vector<std::vector<uint8_t>> compressed(tile_count);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int t = 0; t < tile_count; ++t) {
+		uint32_t ch = t / tiles_y;
+		uint32_t y0 = (t % tiles_y) * tile_rows;
+		size_t count = size_t(std::min(tile_rows, src.rows() - y0)) * src.cols();
+		const T* s = &src(0, y0, ch);
+
+		switch (new_type) {
+		case ImageType::UBYTE: {
+			std::vector<uint8_t> px(count);
+			for (size_t i = 0; i < count; ++i)
+				px[i] = Pixel<uint8_t>::toType(s[i]);
+
+			compressed[t] = (codec == TileCodec::rice) ? Compression::riceCompress(px.data(), count) : gzipTile(px, 1, shuffle);
+			break;
+		}
+		case ImageType::USHORT: {
+			std::vector<int16_t> px(count);
+			for (size_t i = 0; i < count; ++i)
+				px[i] = Pixel<uint16_t>::toType(s[i]) - 32768;
+
+			if (codec == TileCodec::rice) {
+				compressed[t] = Compression::riceCompress(px.data(), count);
+				break;
+			}
+
+			std::vector<uint8_t> bytes(count * 2);
+			for (size_t i = 0; i < count; ++i)
+				writeBigEndian(uint16_t(px[i]), &bytes[i * 2], 2);
+
+			compressed[t] = gzipTile(bytes, 2, shuffle);
+			break;
+		}
+		case ImageType::FLOAT: {
+			std::vector<uint8_t> bytes(count * 4);
+			for (size_t i = 0; i < count; ++i) {
+				float f = Pixel<float>::toType(s[i]);
+				uint32_t v;
+				memcpy(&v, &f, 4);
+				writeBigEndian(v, &bytes[i * 4], 4);
+			}
+
+			compressed[t] = gzipTile(bytes, 4, shuffle);
+			break;
+		}
+		}
+	}
+
+	//empty primary hdu, the image is in the tile table extension
+	FITSHeader primary;
+	primary.addLogicalKeyword("SIMPLE", true, "FASTStck FITS");
+	primary.addIntegerKeyword("BITPIX", 8);
+	primary.addIntegerKeyword("NAXIS", 0);
+	primary.addLogicalKeyword("EXTEND", true);
+	primary.endHeader();
+	primary.write(m_stream);
+
+	uint64_t heap_size = 0;
+	uint64_t max_size = 0;
+	for (const auto& c : compressed) {
+		heap_size += c.size();
+		max_size = std::max<uint64_t>(max_size, c.size());
+	}
+
+	int naxis = (src.channels() > 1) ? 3 : 2;
+
+	FITSHeader table;
+	table.addStringKeyword("XTENSION", "BINTABLE", "binary table extension");
+	table.addIntegerKeyword("BITPIX", 8);
+	table.addIntegerKeyword("NAXIS", 2);
+	table.addIntegerKeyword("NAXIS1", 8, "width of table in bytes");
+	table.addIntegerKeyword("NAXIS2", tile_count, "number of tiles");
+	table.addIntegerKeyword("PCOUNT", heap_size, "size of heap");
+	table.addIntegerKeyword("GCOUNT", 1);
+	table.addIntegerKeyword("TFIELDS", 1);
+	table.addStringKeyword("TTYPE1", "COMPRESSED_DATA");
+	table.addStringKeyword("TFORM1", "1PB(" + std::to_string(max_size) + ")");
+	table.addLogicalKeyword("ZIMAGE", true, "tile compressed image");
+	table.addIntegerKeyword("ZBITPIX", bitpix);
+	table.addIntegerKeyword("ZNAXIS", naxis);
+	table.addIntegerKeyword("ZNAXIS1", src.cols());
+	table.addIntegerKeyword("ZNAXIS2", src.rows());
+	if (naxis == 3)
+		table.addIntegerKeyword("ZNAXIS3", src.channels());
+	table.addIntegerKeyword("ZTILE1", src.cols());
+	table.addIntegerKeyword("ZTILE2", tile_rows);
+	if (naxis == 3)
+		table.addIntegerKeyword("ZTILE3", 1);
+
+	switch (codec) {
+	case TileCodec::rice:
+		table.addStringKeyword("ZCMPTYPE", "RICE_1");
+		table.addStringKeyword("ZNAME1", "BLOCKSIZE");
+		table.addIntegerKeyword("ZVAL1", 32);
+		table.addStringKeyword("ZNAME2", "BYTEPIX");
+		table.addIntegerKeyword("ZVAL2", item_size);
+		break;
+	case TileCodec::gzip:
+		table.addStringKeyword("ZCMPTYPE", "GZIP_1");
+		break;
+	case TileCodec::gzip_shuffle:
+		table.addStringKeyword("ZCMPTYPE", "GZIP_2");
+		break;
+	}
+
+	if (new_type == ImageType::FLOAT)
+		table.addStringKeyword("ZQUANTIZ", "NONE", "lossless float compression");
+
+	if (new_type == ImageType::USHORT) {
+		table.addIntegerKeyword("BZERO", 32768);
+		table.addIntegerKeyword("BSCALE", 1);
+	}
+
+	table.endHeader();
+	table.write(m_stream);
+
+	std::vector<uint8_t> descriptors(tile_count * 8);
+	uint64_t heap_offset = 0;
+
+	for (int t = 0; t < tile_count; ++t) {
+		writeBigEndian(compressed[t].size(), &descriptors[t * 8], 4);
+		writeBigEndian(heap_offset, &descriptors[t * 8 + 4], 4);
+		heap_offset += compressed[t].size();
+	}
+
+	m_stream.write((char*)descriptors.data(), descriptors.size());
+
+	for (const auto& c : compressed)
+		m_stream.write((char*)c.data(), c.size());
+
+	int padding_length = (2880 - m_stream.tellp() % 2880) % 2880;
+	std::vector<uint8_t> zeros(padding_length, 0);
+	m_stream.write((char*)zeros.data(), padding_length);
+
+	close();
+}
+
 template <typename T>
-void FITS::write(const Image<T>& src, ImageType new_type) {
+void FITS::write(const Image<T>& src, ImageType new_type, TileCodec codec) {
+
+	if (codec != TileCodec::none)
+		return writeTiled(src, new_type, codec);
 
 	resizeBuffer(src.cols() * typeSize(new_type));
 
@@ -491,6 +1466,6 @@ void FITS::write(const Image<T>& src, ImageType new_type) {
 
 	close();
 }
-template void FITS::write(const Image8&, ImageType);
-template void FITS::write(const Image16&, ImageType);
-template void FITS::write(const Image32&, ImageType);
\ No newline at end of file
+template void FITS::write(const Image8&, ImageType, TileCodec);
+template void FITS::write(const Image16&, ImageType, TileCodec);
+template void FITS::write(const Image32&, ImageType, TileCodec);
\ No newline at end of file
@@ -5,7 +5,7 @@
 using ABE = AutomaticBackgroundExtraction;
 using ABED = AutomaticBackgroundExtractionDialog;
 
-ABED::AutomaticBackgroundExtractionDialog(Workspace* parent) : ProcessDialog("Automatic Background Extraction", QSize(530, 380), parent, true) {
+ABED::AutomaticBackgroundExtractionDialog(Workspace* parent) : ProcessDialog("Automatic Background Extraction", QSize(530, 420), parent, true) {
 
     addSampleGeneration();
     addSampleRejection();
@@ -150,9 +150,13 @@ void ABED::addOther() {
     addLabel(m_correction_combo, new QLabel("Correction Method:   ", drawArea()));
     connect(m_correction_combo, &QComboBox::activated, this, [this](int index) { m_abe.setCorrectionMethod(ABE::Correction(index)); });
 
+    m_downsample_sb = new SpinBox(m_abe.downsampleFactor(), 1, 8, drawArea());
+    m_downsample_sb->move(175, 330);
+    addLabel(m_downsample_sb, new QLabel("Model Downsample:   ", drawArea()));
+    connect(m_downsample_sb, &QSpinBox::valueChanged, this, [this](int val) { m_abe.setDownsampleFactor(val); });
 
     m_apply_to_preview_pb = new PushButton(m_apply_to_preview, drawArea());
-    m_apply_to_preview_pb->move(15, 335);
+    m_apply_to_preview_pb->move(15, 375);
     m_apply_to_preview_pb->resize(500, m_apply_to_preview_pb->height());
     m_apply_to_preview_pb->setDisabled(true);
 
@@ -4,7 +4,7 @@
 #include "ImageWindow.h"
 
 
-BilateralFilterDialog::BilateralFilterDialog(Workspace* parent) : ProcessDialog("BilateralFilter", QSize(470, 145), parent) {
+BilateralFilterDialog::BilateralFilterDialog(Workspace* parent) : ProcessDialog("BilateralFilter", QSize(470, 185), parent) {
 
 	setDefaultTimerInterval(750);
 
@@ -16,6 +16,8 @@ BilateralFilterDialog::BilateralFilterDialog(Workspace* parent) : ProcessDialog(
 	m_circular_cb->move(30, 102);
 	connect(m_circular_cb, &QCheckBox::clicked, this, [this](bool v) { m_bf.setCircularKernel(v); applytoPreview(); });
 
+	addMethodInputs();
+
 	this->show();
 }
 
@@ -105,6 +107,22 @@ void BilateralFilterDialog::addKernelSizeInputs() {
 	connect(m_kernel_size_cb, &QComboBox::activated, this, activation);
 }
 
+void BilateralFilterDialog::addMethodInputs() {
+
+	m_method_cb = new ComboBox(drawArea());
+	m_method_cb->addItems({ "Brute Force", "Fast" });
+	m_method_cb->setCurrentIndex(int(m_bf.method()));
+	m_method_cb->move(140, 140);
+	addLabel(m_method_cb, new QLabel("Method:", drawArea()));
+
+	auto activation = [this](int index) {
+		m_bf.setMethod(BilateralFilter::Method(index));
+		applytoPreview();
+	};
+
+	connect(m_method_cb, &QComboBox::activated, this, activation);
+}
+
 void BilateralFilterDialog::resetDialog() {
 
 	m_bf = BilateralFilter();
@@ -117,6 +135,7 @@ void BilateralFilterDialog::resetDialog() {
 
 	m_kernel_size_cb->setCurrentIndex(0);
 	m_circular_cb->setChecked(m_bf.isCircular());
+	m_method_cb->setCurrentIndex(int(m_bf.method()));
 
 	applytoPreview();
 }
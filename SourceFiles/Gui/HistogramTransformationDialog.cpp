@@ -346,21 +346,18 @@ void HTD::onImageSelection() {
 
 	auto img = m_image_sel->currentImage();
 	if (img) {
-		m_current_histogram.resize(img->channels());
-		for (int ch = 0; ch < img->channels(); ++ch) {
-			switch (img->type()) {
-			case ImageType::UBYTE:
-				m_current_histogram[ch].constructHistogram(*img, ch);
-				break;
-
-			case ImageType::USHORT:
-				m_current_histogram[ch].constructHistogram(*recastImage<uint16_t>(img), ch);
-				break;
-
-			case ImageType::FLOAT:
-				m_current_histogram[ch].constructHistogram(*recastImage<float>(img), ch);
-				break;
-			}
+		switch (img->type()) {
+		case ImageType::UBYTE:
+			m_current_histogram = HistogramBuilder::build(img->view());
+			break;
+
+		case ImageType::USHORT:
+			m_current_histogram = HistogramBuilder::build(recastImage<uint16_t>(img)->view());
+			break;
+
+		case ImageType::FLOAT:
+			m_current_histogram = HistogramBuilder::build(recastImage<float>(img)->view());
+			break;
 		}
 		m_htv->setHistogram(m_current_histogram);
 		return onChange();
@@ -36,12 +36,7 @@ HistogramView::HistogramView(const QSize& size, QWidget* parent) : QGraphicsView
 template<typename T>
 void HistogramView::drawHistogramView(const Image<T>& img, Histogram::Resolution resolution) {
 
-	m_histograms.resize(img.channels());
-
-	for (int ch = 0; ch < img.channels(); ++ch) {
-		m_histograms[ch].constructHistogram(img, ch);
-		m_histograms[ch].resample(resolution);
-	}
+	m_histograms = HistogramBuilder::build(img.view(), resolution);
 
 	this->drawHistogram();
 }
@@ -5,7 +5,7 @@
 
 using LHE = LocalHistogramEqualization;
 using LHED = LocalHistogramEqualizationDialog;
-LHED::LocalHistogramEqualizationDialog(Workspace* parent) : ProcessDialog("LocalHistogramEqualization", QSize(475, 180), parent) {
+LHED::LocalHistogramEqualizationDialog(Workspace* parent) : ProcessDialog("LocalHistogramEqualization", QSize(475, 215), parent) {
 
 	setDefaultTimerInterval(500);
 
@@ -39,6 +39,8 @@ LHED::LocalHistogramEqualizationDialog(Workspace* parent) : ProcessDialog("Local
 	};
 	connect(m_hist_res_combo, &QComboBox::activated, this, activated);
 
+	addMethodInputs();
+
 	this->show();
 }
 
@@ -124,6 +126,25 @@ void LHED::addAmountInputs() {
 	connect(m_amount_input, &InputBase::editingFinished, this, edited);
 }
 
+void LHED::addMethodInputs() {
+
+	m_method_combo = new ComboBox(drawArea());
+	m_method_combo->addItems({ "Tiled", "Sliding Window" });
+	m_method_combo->setCurrentIndex(int(m_lhe.method()));
+	m_method_combo->move(200, 175);
+	addLabel(m_method_combo, new QLabel("Method:", drawArea()));
+
+	//circular kernel only applies to the sliding window
+	m_circular_cb->setEnabled(m_lhe.method() == LHE::Method::sliding);
+
+	auto activated = [this](int index) {
+		m_lhe.setMethod(LHE::Method(index));
+		m_circular_cb->setEnabled(m_lhe.method() == LHE::Method::sliding);
+		applytoPreview();
+	};
+	connect(m_method_combo, &QComboBox::activated, this, activated);
+}
+
 void LHED::resetDialog() {
 
 	m_lhe = LHE();
@@ -133,6 +154,10 @@ void LHED::resetDialog() {
 	m_amount_input->reset();
 
 	m_circular_cb->setChecked(true);
+	m_lhe.setCircularKernel(true);
+
+	m_method_combo->setCurrentIndex(int(m_lhe.method()));
+	m_circular_cb->setEnabled(m_lhe.method() == LHE::Method::sliding);
 
 	applytoPreview();
 }
@@ -281,29 +281,37 @@ void PSFUtilityDialog::closeEvent(QCloseEvent* e) {
 template<typename T>
 Statistics::StatsVector  Statistics::computeStatistics(const Image<T>& img, bool clip) {
 
+	return computeStatistics(ImageStatistics(img), img.type(), clip);
+}
+template Statistics::StatsVector  Statistics::computeStatistics(const Image8& img, bool clip);
+template Statistics::StatsVector  Statistics::computeStatistics(const Image16& img, bool clip);
+template Statistics::StatsVector  Statistics::computeStatistics(const Image32& img, bool clip);
+
+Statistics::StatsVector Statistics::computeStatistics(const ImageStatistics& stats, ImageType type, bool clip) {
+
 	StatsVector  statsvector;
-	statsvector.reserve(img.channels());
-
-	for (int ch = 0; ch < img.channels(); ++ch) {
-		Statistics stats;
-		stats.type = img.type();
-		stats.pixel_count = (clip) ?  img.computeClippedPxCount(ch) : img.pxCount();
-		stats.min = img.computeMin(ch, clip);
-		stats.max = img.computeMax(ch, clip);
-		stats.mean = img.computeMean(ch, clip);
-		stats.median = img.computeMedian(ch, clip);
-		stats.stdDev = img.computeStdDev(ch, stats.mean, clip);
-		stats.avgDev = img.computeAvgDev(ch, T(stats.median), clip);
-		stats.MAD = img.computeMAD(ch, T(stats.median), clip);
-
-		statsvector.emplace_back(stats);
+	statsvector.reserve(stats.channels());
+
+	for (int ch = 0; ch < stats.channels(); ++ch) {
+		const auto& c = stats.channel(ch, clip);
+
+		Statistics s;
+		s.type = type;
+		s.pixel_count = c.count;
+		s.min = c.min;
+		s.max = c.max;
+		s.mean = c.mean;
+		s.median = c.median;
+		s.stdDev = c.stdDev;
+		s.avgDev = c.avgDev;
+		s.MAD = c.MAD;
+		s.sqrtBWMV = c.sqrtBWMV;
+
+		statsvector.emplace_back(s);
 	}
 
 	return statsvector;
 }
-template Statistics::StatsVector  Statistics::computeStatistics(const Image8& img, bool clip);
-template Statistics::StatsVector  Statistics::computeStatistics(const Image16& img, bool clip);
-template Statistics::StatsVector  Statistics::computeStatistics(const Image32& img, bool clip);
 
 Statistics Statistics::toBitDepth(BitDepth bitdepth)const {
 
@@ -335,7 +343,7 @@ Statistics Statistics::toBitDepth(BitDepth bitdepth)const {
 StatisticsDialog::StatisticsDialog(const QString& img_name, const Statistics::StatsVector& statsvector, int precision, QWidget* parent) : m_stats_vector(&statsvector), Dialog(parent) {
 
 	this->setTitle(img_name + " Statistics");
-	this->resizeDialog(530, 340);
+	this->resizeDialog(530, 370);
 
 	this->setFocus();
 
@@ -385,16 +393,17 @@ void StatisticsDialog::updateStats(const Statistics::StatsVector& statsvector) {
 		m_stats_table->setCellWidget(3, col, new Label(QString::number(s.stdDev, 'f', precision)));
 		m_stats_table->setCellWidget(4, col, new Label(QString::number(s.avgDev, 'f', precision)));
 		m_stats_table->setCellWidget(5, col, new Label(QString::number(s.MAD, 'f', precision)));
-		m_stats_table->setCellWidget(6, col, new Label(QString::number(s.min, 'f', precision)));
-		m_stats_table->setCellWidget(7, col, new Label(QString::number(s.max, 'f', precision)));
+		m_stats_table->setCellWidget(6, col, new Label(QString::number(s.sqrtBWMV, 'f', precision)));
+		m_stats_table->setCellWidget(7, col, new Label(QString::number(s.min, 'f', precision)));
+		m_stats_table->setCellWidget(8, col, new Label(QString::number(s.max, 'f', precision)));
 	}
 }
 
 void StatisticsDialog::addStatsTable() {
 
-	m_stats_table = new QTableWidget(8, 1, drawArea());
+	m_stats_table = new QTableWidget(9, 1, drawArea());
 	m_stats_table->setFocusPolicy(Qt::FocusPolicy::NoFocus);
-	m_stats_table->resize(500, 280);
+	m_stats_table->resize(500, 310);
 	m_stats_table->move(15, 45);
 
 	m_stats_table->horizontalHeader()->setFixedHeight(35);
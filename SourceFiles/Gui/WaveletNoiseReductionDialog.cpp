@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "WaveletNoiseReductionDialog.h"
+#include "ImageWindow.h"
+#include "FastStack.h"
+
+
+using WNR = WaveletNoiseReduction;
+
+WaveletNoiseReductionDialog::WaveletNoiseReductionDialog(Workspace* parent) : ProcessDialog("WaveletNoiseReduction", QSize(400, 265), parent) {
+
+	setDefaultTimerInterval(250);
+
+	addWaveletInputs();
+	addLayerInputs();
+
+	this->show();
+}
+
+void WaveletNoiseReductionDialog::addWaveletInputs() {
+
+	m_layers_sb = new SpinBox(m_wnr.layers(), 1, WNR::maxLayers(), drawArea());
+	m_layers_sb->move(150, 15);
+	addLabel(m_layers_sb, new QLabel("Wavelet layers:", drawArea()));
+
+	auto layers = [this](int val) {
+		m_wnr.setLayers(val);
+
+		for (int i = 0; i < m_layer_combo->count(); ++i)
+			m_layer_combo->setItemText(i, "Layer " + QString::number(i + 1) + ((i < val) ? "" : " (unused)"));
+
+		startTimer();
+	};
+	connect(m_layers_sb, &QSpinBox::valueChanged, this, layers);
+
+	m_scaling_func_combo = new ComboBox(drawArea());
+	m_scaling_func_combo->addItems({ "3x3 Linear Interpolation", "3x3 Small Scale", "5x5 B3 Spline","5x5 Gaussian" });
+	m_scaling_func_combo->setCurrentIndex(int(m_wnr.scalingFuntion()));
+	m_scaling_func_combo->move(150, 55);
+	addLabel(m_scaling_func_combo, new QLabel("Scaling Function:", drawArea()));
+
+	auto scaling_func = [this](int index) {
+		m_wnr.setScalingFuntion(Wavelet::ScalingFunction(index));
+		startTimer();
+	};
+	connect(m_scaling_func_combo, &QComboBox::activated, this, scaling_func);
+
+	m_method_combo = new ComboBox(drawArea());
+	m_method_combo->addItem("Linear", QVariant::fromValue(WNR::Method::linear));
+	m_method_combo->addItem("Median", QVariant::fromValue(WNR::Method::median));
+	m_method_combo->setCurrentIndex(int(m_wnr.method()));
+	m_method_combo->move(150, 95);
+	addLabel(m_method_combo, new QLabel("Method:", drawArea()));
+
+	auto method = [this](int index) {
+		m_wnr.setMethod(m_method_combo->itemData(index).value<WNR::Method>());
+		startTimer();
+	};
+	connect(m_method_combo, &QComboBox::activated, this, method);
+}
+
+void WaveletNoiseReductionDialog::addLayerInputs() {
+
+	m_layer_combo = new ComboBox(drawArea());
+	for (int i = 0; i < WNR::maxLayers(); ++i)
+		m_layer_combo->addItem("Layer " + QString::number(i + 1) + ((i < m_wnr.layers()) ? "" : " (unused)"));
+	m_layer_combo->move(150, 135);
+	addLabel(m_layer_combo, new QLabel("Edit layer:", drawArea()));
+	connect(m_layer_combo, &QComboBox::activated, this, &WaveletNoiseReductionDialog::onLayerChanged);
+
+	m_layer_enabled_cb = new CheckBox("Enabled", drawArea());
+	m_layer_enabled_cb->move(290, 137);
+	connect(m_layer_enabled_cb, &QCheckBox::clicked, this, [this](bool v) {
+		m_wnr.setLayerEnabled(m_layer_combo->currentIndex(), v);
+		startTimer();
+		});
+
+	m_threshold_input = new DoubleInput("Threshold:   ", m_wnr.layerParameters(0).threshold, new DoubleValidator(0.0, 10.0, 2), drawArea(), 100);
+	m_threshold_input->move(90, 180);
+	m_threshold_input->setSliderWidth(225);
+
+	auto threshold = [this]() {
+		m_wnr.setLayerThreshold(m_layer_combo->currentIndex(), m_threshold_input->valuef());
+		startTimer();
+	};
+	connect(m_threshold_input, &InputBase::actionTriggered, this, threshold);
+	connect(m_threshold_input, &InputBase::editingFinished, this, threshold);
+
+	m_amount_input = new DoubleInput("Amount:   ", m_wnr.layerParameters(0).amount, new DoubleValidator(0.0, 1.0, 2), drawArea(), 100);
+	m_amount_input->move(90, 220);
+	m_amount_input->setSliderWidth(225);
+
+	auto amount = [this]() {
+		m_wnr.setLayerAmount(m_layer_combo->currentIndex(), m_amount_input->valuef());
+		startTimer();
+	};
+	connect(m_amount_input, &InputBase::actionTriggered, this, amount);
+	connect(m_amount_input, &InputBase::editingFinished, this, amount);
+
+	onLayerChanged(0);
+}
+
+void WaveletNoiseReductionDialog::onLayerChanged(int layer) {
+
+	auto& lp = m_wnr.layerParameters(layer);
+
+	m_layer_enabled_cb->setChecked(lp.enabled);
+
+	m_threshold_input->setLineEditValue(lp.threshold);
+	m_threshold_input->setSliderValue(lp.threshold * 100);
+
+	m_amount_input->setLineEditValue(lp.amount);
+	m_amount_input->setSliderValue(lp.amount * 100);
+}
+
+void WaveletNoiseReductionDialog::resetDialog() {
+
+	m_wnr = WaveletNoiseReduction();
+
+	m_layers_sb->setValue(m_wnr.layers());
+	m_scaling_func_combo->setCurrentIndex(int(m_wnr.scalingFuntion()));
+	m_method_combo->setCurrentIndex(int(m_wnr.method()));
+
+	m_layer_combo->setCurrentIndex(0);
+	onLayerChanged(0);
+
+	applytoPreview();
+}
+
+void WaveletNoiseReductionDialog::apply() {
+
+	if (!workspace()->hasSubWindows())
+		return;
+
+	switch (currentImageType()) {
+	case ImageType::UBYTE:
+		return currentImageWindow()->applyToSource(m_wnr, &WNR::apply);
+
+	case ImageType::USHORT:
+		return currentImageWindow<uint16_t>()->applyToSource(m_wnr, &WNR::apply);
+
+	case ImageType::FLOAT:
+		return currentImageWindow<float>()->applyToSource(m_wnr, &WNR::apply);
+	}
+}
+
+void WaveletNoiseReductionDialog::applyPreview() {
+
+	if (!isPreviewValid())
+		return;
+
+	switch (preview()->type()) {
+	case ImageType::UBYTE:
+		return preview()->updatePreview(m_wnr, &WNR::apply);
+
+	case ImageType::USHORT:
+		return preview<uint16_t>()->updatePreview(m_wnr, &WNR::apply);
+
+	case ImageType::FLOAT:
+		return preview<float>()->updatePreview(m_wnr, &WNR::apply);
+	}
+}
@@ -2,6 +2,7 @@
 #include "ImageCalibration.h"
 #include "FITS.h"
 #include "TIFF.h"
+#include "XISF.h"
 #include "FastStack.h"
 //#include "ImageStackingDialog.h"
 
@@ -22,6 +23,12 @@ void ImageCalibrator::loadMasterDark() {
 		tiff.readAny(m_master_dark);
 	}
 
+	else if (XISF::isXISF(m_dark_path)) {
+		XISF xisf;
+		xisf.open(m_dark_path);
+		xisf.readAny(m_master_dark);
+	}
+
 	else
 		return;
 }
@@ -43,6 +50,12 @@ void ImageCalibrator::loadMasterFlat() {
 		tiff.readAny(m_master_flat);
 	}
 
+	else if (XISF::isXISF(m_flat_path)) {
+		XISF xisf;
+		xisf.open(m_flat_path);
+		xisf.readAny(m_master_flat);
+	}
+
 	else
 		return;
 
@@ -273,6 +286,13 @@ static void ReadImageFile(std::filesystem::path path, Image32& dst) {
 		tiff.readAny(dst);
 		tiff.close();
 	}
+
+	else if (XISF::isXISF(filename)) {
+		XISF xisf;
+		xisf.open(path);
+		xisf.readAny(dst);
+		xisf.close();
+	}
 }
 
 static void showMessageBox(const QString& text, const QString& informative_text) {
@@ -3,6 +3,7 @@
 #include "FastStack.h"
 #include "FITS.h"
 #include "TIFF.h"
+#include "XISF.h"
 #include "Bitmap.h"
 
 ImageFileReader::ImageFileReader(Workspace* workspace) : m_workspace(workspace) {}
@@ -23,19 +24,24 @@ Status ImageFileReader::read(std::filesystem::path file_path) {
 	if (FITS::isFITS(filename)) {
 		FITS fits;
 		fits.open(file_path);
-		switch (fits.imageType()) {
-		case ImageType::UBYTE: {
-			fits.read(img8);
-			break;
-		}
-		case ImageType::USHORT: {
-			fits.read(img16);
-			break;
-		}
-		case ImageType::FLOAT: {
-			fits.read(img32);
-			break;
+		try {
+			switch (fits.imageType()) {
+			case ImageType::UBYTE: {
+				fits.read(img8);
+				break;
+			}
+			case ImageType::USHORT: {
+				fits.read(img16);
+				break;
+			}
+			case ImageType::FLOAT: {
+				fits.read(img32);
+				break;
+			}
+			}
 		}
+		catch (const std::exception& e) {
+			return { false, e.what() };
 		}
 		fits.close();
 	}
@@ -45,21 +51,56 @@ Status ImageFileReader::read(std::filesystem::path file_path) {
 		TIFF tiff;
 		tiff.open(file_path);
 
-		switch (tiff.imageType()) {
-		case ImageType::UBYTE: {
-			tiff.read(img8);
-			break;
+		try {
+			switch (tiff.imageType()) {
+			case ImageType::UBYTE: {
+				tiff.read(img8);
+				break;
+			}
+			case ImageType::USHORT: {
+				tiff.read(img16);
+				break;
+			}
+			case ImageType::FLOAT: {
+				tiff.read(img32);
+				break;
+			}
+			}
 		}
-		case ImageType::USHORT: {
-			tiff.read(img16);
-			break;
+		catch (const std::exception& e) {
+			return { false, e.what() };
 		}
-		case ImageType::FLOAT: {
-			tiff.read(img32);
-			break;
+		tiff.close();
+	}
+
+	else if (XISF::isXISF(filename)) {
+
+		XISF xisf;
+		xisf.open(file_path);
+
+		if (xisf.pxCount() == 0)
+			return { false, "Unsupported XISF File!" };
+
+		try {
+			switch (xisf.imageType()) {
+			case ImageType::UBYTE: {
+				xisf.read(img8);
+				break;
+			}
+			case ImageType::USHORT: {
+				xisf.read(img16);
+				break;
+			}
+			case ImageType::FLOAT: {
+				xisf.read(img32);
+				break;
+			}
+			}
 		}
+		catch (const std::exception& e) {
+			return { false, e.what() };
 		}
-		tiff.close();
+		xisf.close();
 	}
 
 	else if (WeightMapImage::isWeightMapImage(filename)) {
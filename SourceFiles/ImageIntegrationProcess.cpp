@@ -5,19 +5,20 @@
 #include "ImageGeometry.h"
 #include "FITS.h"
 #include "TIFF.h"
+#include "XISF.h"
 #include "FastStack.h"
 
 template<typename T>
-void TempFolder::writeTempFits(const Image<T>& src, std::filesystem::path file_path) {
+void TempFolder::writeTempFits(const Image<T>& src, std::filesystem::path file_path, FITS::TileCodec codec) {
 	FITS fits;
 	auto path = folderPath().append(file_path.stem().concat("_temp").string());
 	fits.create(path);
-	fits.write(src, ImageType::FLOAT);
+	fits.write(src, ImageType::FLOAT, codec);
 	m_fv.push_back(path += ".fits");
 }
-template void TempFolder::writeTempFits(const Image8&, std::filesystem::path);
-template void TempFolder::writeTempFits(const Image16&, std::filesystem::path);
-template void TempFolder::writeTempFits(const Image32&, std::filesystem::path);
+template void TempFolder::writeTempFits(const Image8&, std::filesystem::path, FITS::TileCodec);
+template void TempFolder::writeTempFits(const Image16&, std::filesystem::path, FITS::TileCodec);
+template void TempFolder::writeTempFits(const Image32&, std::filesystem::path, FITS::TileCodec);
 
 
 
@@ -43,6 +44,11 @@ bool ImageIntegrationProcess::isLightsSameSize() {
 			dynamic_cast<TIFF*>(imagefile.get())->open(file);
 		}
 
+		else if (XISF::isXISF(file)) {
+			imagefile = std::make_unique<XISF>();
+			dynamic_cast<XISF*>(imagefile.get())->open(file);
+		}
+
 		if (file_it == m_paths.begin()) {
 			ref_rows = imagefile->rows();
 			ref_cols = imagefile->cols();
@@ -89,21 +95,40 @@ Status ImageIntegrationProcess::integrateImages(Image32& output) {
 		auto file = (*file_it).light;
 		m_iss.emitText(file.filename().string().c_str());
 
-		if (FITS::isFITS(file)) {
-			FITS fits;
-			fits.open(file);
-			fits.readAny(output);
-		}
+		{
+			StageTimer::Scope stage(m_stage_timer, "read");
 
-		else if (TIFF::isTIFF(file)) {
-			TIFF tiff;
-			tiff.open(file);
-			tiff.readAny(output);
+			try {
+				if (FITS::isFITS(file)) {
+					FITS fits;
+					fits.open(file);
+					fits.readAny(output);
+				}
+
+				else if (TIFF::isTIFF(file)) {
+					TIFF tiff;
+					tiff.open(file);
+					tiff.readAny(output);
+				}
+
+				else if (XISF::isXISF(file)) {
+					XISF xisf;
+					xisf.open(file);
+					xisf.readAny(output);
+				}
+			}
+			catch (const std::exception& e) {
+				return { false, QString(file.filename().string().c_str()) + ": " + e.what() };
+			}
 		}
 
-		calibrator.calibrateImage(output);
+		{
+			StageTimer::Scope stage(m_stage_timer, "calibration");
+			calibrator.calibrateImage(output);
+		}
 
 		if (file_it == m_paths.begin() && count != 0) {
+			StageTimer::Scope stage(m_stage_timer, "star detection");
 			ref_sv = m_sd.DAOFIND(output);
 			m_iss.emitPSFData(ref_sv.size(), m_sd.meanPSF());
 			ref_sv.shrink_to_size(m_maxstars);
@@ -111,9 +136,15 @@ Status ImageIntegrationProcess::integrateImages(Image32& output) {
 
 		else if (file_it != m_paths.begin()){
 			if ((*file_it).alignment.empty()) {
-				StarVector tgt_sv = m_sd.DAOFIND(output);
+				StarVector tgt_sv;
+				{
+					StageTimer::Scope stage(m_stage_timer, "star detection");
+					tgt_sv = m_sd.DAOFIND(output);
+				}
 				m_iss.emitPSFData(tgt_sv.size(), m_sd.meanPSF());
 				tgt_sv.shrink_to_size(m_maxstars);
+
+				StageTimer::Scope stage(m_stage_timer, "registration");
 				StarPairVector spv = sm.matchStars(ref_sv, tgt_sv);
 
 				Matrix h = Homography::computeHomography(spv);
@@ -130,6 +161,7 @@ Status ImageIntegrationProcess::integrateImages(Image32& output) {
 			}
 
 			else {
+				StageTimer::Scope stage(m_stage_timer, "registration");
 				Matrix h = alignmentDataReader((*file_it).alignment);
 				m_iss.emitMatrix(h);
 				homography_trans.setHomography(h);
@@ -138,6 +170,7 @@ Status ImageIntegrationProcess::integrateImages(Image32& output) {
 
 		}
 		
+		StageTimer::Scope stage(m_stage_timer, "temp write");
 		temp.writeTempFits(output, file);
 	}
 
@@ -4,6 +4,7 @@
 #include "FastStackToolBar.h"
 #include "ImageGeometryDialogs.h"
 #include "ImageWindowMenu.h"
+#include "ThreadPool.h"
 //#include "ProcessDialog.h"
 
 
@@ -102,6 +103,10 @@ static QImage::Format qimageFormat(int channels = 3) {
     }
 }
 
+static DisplayBuffer displayBuffer(QImage& img) {
+    return { img.bits(), uint32_t(img.depth() / 8), size_t(img.bytesPerLine()) };
+}
+
 
 
 
@@ -405,7 +410,9 @@ void ImageWindow<T>::setMask(const ImageWindow<uint8_t>* mask) {
         return;
 
     m_mask = mask;
+    m_mask_tiles.clear();
     connect(m_mask, &ImageWindowBase::windowClosed, this, &ImageWindow<T>::removeMask);
+    connect(m_mask, &ImageWindowBase::windowUpdated, this, [this]() { m_mask_tiles.clear(); });
     m_mask_display = QImage(cols(), rows(), QImage::Format_ARGB32);
     m_image_label->setMask(&m_mask_display);
 
@@ -420,6 +427,7 @@ void ImageWindow<T>::removeMask() {
 
     m_mask = nullptr;
     m_mask_display = QImage();
+    m_mask_tiles.clear();
     m_image_label->removeMask();
     m_image_label->draw();
     if (previewExists())
@@ -438,6 +446,7 @@ template<typename T>
 void ImageWindow<T>::invertMask(bool invert) {
 
     m_invert_mask = invert;
+    m_mask_tiles.clear();
     displayImage();
     if(previewExists())
         preview()->updatePreview(false);
@@ -471,6 +480,7 @@ void ImageWindow<T>::convertToGrayscale() {
         return;
 
     m_source.toGrayscale();
+    sourceChanged();
     m_dchannels = m_source.channels();
 
     m_display = QImage(cols(), rows(), QImage::Format::Format_Grayscale8);
@@ -716,7 +726,7 @@ void ImageWindow<T>::resizeImageLabel() {
     if (label_rect != m_image_label->geometry())
         m_image_label->setGeometry(label_rect);
 
-    if (rows() != m_display.height() || cols() != m_display.height()) {
+    if (rows() != m_display.height() || cols() != m_display.width()) {
         m_display = QImage(cols(), rows(), m_display.format());
         if (!m_mask_display.isNull())
             m_mask_display = QImage(cols(), rows(), m_mask_display.format());
@@ -740,31 +750,33 @@ void ImageWindow<T>::displayImage() {
 template<typename T>
 void ImageWindow<T>::displayMask() {
 
-    m_mask_display.fill(Qt::black);
+    auto render = [this](int x, int y, const DisplayBuffer& tile) {
+        switch (m_mask->type()) {
+        case ImageType::UBYTE: {
+            auto iw8 = m_mask;
+            if (m_factor > 1)
+                return upsampleToWindow_Mask(iw8->source(), factor(), x, y, tile);
+            else
+                return binToWindow_Mask(iw8->source(), 1 / factor(), x, y, tile);
+        }
+        case ImageType::USHORT: {
+            auto iw16 = imageRecast<uint16_t>(m_mask);
+            if (m_factor > 1)
+                return upsampleToWindow_Mask(iw16->source(), factor(), x, y, tile);
+            else
+                return binToWindow_Mask(iw16->source(), 1 / factor(), x, y, tile);
+        }
+        case ImageType::FLOAT: {
+            auto iw32 = imageRecast<float>(m_mask);
+            if (m_factor > 1)
+                return upsampleToWindow_Mask(iw32->source(), factor(), x, y, tile);
+            else
+                return binToWindow_Mask(iw32->source(), 1 / factor(), x, y, tile);
+        }
+        }
+    };
 
-    switch (m_mask->type()) {
-    case ImageType::UBYTE: {
-        auto iw8 = m_mask;
-        if (m_factor > 1)
-            return upsampleToWindow_Mask(iw8->source(), factor());
-        else
-            return binToWindow_Mask(iw8->source(), 1 / factor());
-    }
-    case ImageType::USHORT: {
-        auto iw16 = imageRecast<uint16_t>(m_mask);
-        if (m_factor > 1)
-            return upsampleToWindow_Mask(iw16->source(), factor());
-        else
-            return binToWindow_Mask(iw16->source(), 1 / factor());
-    }
-    case ImageType::FLOAT: {
-        auto iw32 = imageRecast<float>(m_mask);
-        if (m_factor > 1)
-            return upsampleToWindow_Mask(iw32->source(), factor());
-        else
-            return binToWindow_Mask(iw32->source(), 1 / factor());
-    }
-    }
+    m_mask_tiles.draw(factorPoll(), 0, displayOriginX(), displayOriginY(), cols(), rows(), render, displayBuffer(m_mask_display));
 }
 
 
@@ -806,70 +818,17 @@ void ImageWindow<T>::pan(int x, int y) {
 template<typename T>
 void ImageWindow<T>::binToWindow(int factor) {
 
-    if (m_dchannels == 3)
-        return binToWindow_RGB(factor);
-
-    int factor2 = factor * factor;
-
-    for (int ch = 0; ch < channels(); ++ch) {
-        for (int y = 0, y_s = m_offset.y; y < rows(); ++y, y_s += factor) {
-            for (int x = 0, x_s = m_offset.x; x < cols(); ++x, x_s += factor) {
-
-                float pix = 0;
-
-                for (int j = 0; j < factor; ++j)
-                    for (int i = 0; i < factor; ++i)
-                        pix += m_source(x_s + i, y_s + j, ch);
-
-                pix /= factor2;
-
-                if (m_enable_stf) {
-                    pix = Pixel<float>::toType(T(pix));
-                    pix = Pixel<T>::toType(m_ht.transformPixel(ColorComponent::rgb_k, pix));
-                }
-
-                m_display.scanLine(y)[channels() * x + ch] = Pixel<uint8_t>::toType(T(pix));
-            }       
-        }
-    }
-}
-
-template<typename T>
-void ImageWindow<T>::binToWindow_RGB(int factor) {
-
-    int factor2 = factor * factor;
-
-    for (int y = 0, y_s = m_offset.y; y < rows(); ++y, y_s += factor) {
-        uint8_t* p = m_display.scanLine(y);
-        for (int x = 0, x_s = m_offset.x; x < cols(); ++x, x_s += factor, p += 3) {
-
-            float r = 0, g = 0, b = 0;
-
-            for (int j = 0; j < factor; ++j) {
-                for (int i = 0; i < factor; ++i) {
-                    auto color = m_source.color(x_s + i, y_s + j);
-                    r += color.red;
-                    g += color.green;
-                    b += color.blue;
-                }
-            }
+    int level = m_pyramid.levelForFactor(factor);
+    const Image<T>& src = m_pyramid.level(level);
+    int bin = m_pyramid.residualFactor(factor, level);
 
-            r /= factor2;
-            g /= factor2;
-            b /= factor2;
-
-            if (m_enable_stf) {
-                ColorF c = ColorConversion::toColorF(Color<T>(r, g, b));
-                r = Pixel<T>::toType(m_ht.transformPixel(ColorComponent::rgb_k, c.red));
-                g = Pixel<T>::toType(m_ht.transformPixel(ColorComponent::rgb_k, c.green));
-                b = Pixel<T>::toType(m_ht.transformPixel(ColorComponent::rgb_k, c.blue));
-            }
+    auto render = [&](int x, int y, const DisplayBuffer& tile) {
+        auto xs = DisplayRenderer::binIndices(double(x) * factor, DisplayTileCache::m_tile_size, factor, level, bin, src.cols());
+        auto ys = DisplayRenderer::binIndices(double(y) * factor, DisplayTileCache::m_tile_size, factor, level, bin, src.rows());
+        DisplayRenderer::render(src, xs, ys, bin, m_display_lut, tile);
+    };
 
-            *p = Pixel<uint8_t>::toType(T(r));
-            *(p + 1) = Pixel<uint8_t>::toType(T(g));
-            *(p + 2)= Pixel<uint8_t>::toType(T(b));
-        }
-    }
+    m_tiles.draw(factorPoll(), m_enable_stf, displayOriginX(), displayOriginY(), cols(), rows(), render, displayBuffer(m_display));
 }
 
 template<typename T>
@@ -929,51 +888,13 @@ void ImageWindow<T>::binToWindow_Colorspace(int factor) {
 template<typename T>
 void ImageWindow<T>::upsampleToWindow(int factor) {
 
-    if (m_dchannels == 3)
-        return upsampleToWindow_RGB(factor);
-
-    double dd = 1.0 / factor;
-
-    for (int ch = 0; ch < channels(); ++ch) {
-        double y_s = m_offset.y;
-        for (int y = 0; y < rows(); ++y, y_s += dd) {
-            double x_s = m_offset.x;
-            for (int x = 0; x < cols(); ++x, x_s += dd) {
-                T pix = m_source(x_s, y_s, ch);
-
-                if (m_enable_stf)
-                    pix = Pixel<T>::toType(m_ht.transformPixel(ColorComponent::rgb_k, Pixel<float>::toType(pix)));
-
-                m_display.scanLine(y)[channels() * x + ch] = Pixel<uint8_t>::toType(pix);
-            }
-        }
-    }
-}
-
-template<typename T>
-void ImageWindow<T>::upsampleToWindow_RGB(int factor) {
-
-    double dd = 1.0 / factor;    
-
-    double y_s = m_offset.y;
-    for (int y = 0; y < rows(); ++y, y_s += dd) {
-        double x_s = m_offset.x;
-        uint8_t* p = m_display.scanLine(y);
-        for (int x = 0; x < cols(); ++x, x_s += dd, p += 3) {
-
-            auto color = m_source.color<T>(x_s, y_s);
-
-            if (m_enable_stf) {
-                color.red = Pixel<T>::toType(m_ht.transformPixel(ColorComponent::rgb_k, Pixel<float>::toType(color.red)));
-                color.green = Pixel<T>::toType(m_ht.transformPixel(ColorComponent::rgb_k, Pixel<float>::toType(color.green)));                //b = Pixel<float>::toType(T(b));
-                color.blue = Pixel<T>::toType(m_ht.transformPixel(ColorComponent::rgb_k, Pixel<float>::toType(color.blue)));
-            }
+    auto render = [&](int x, int y, const DisplayBuffer& tile) {
+        auto xs = DisplayRenderer::upsampleIndices(x, DisplayTileCache::m_tile_size, factor, m_source.cols());
+        auto ys = DisplayRenderer::upsampleIndices(y, DisplayTileCache::m_tile_size, factor, m_source.rows());
+        DisplayRenderer::render(m_source, xs, ys, 1, m_display_lut, tile);
+    };
 
-            *p = Pixel<uint8_t>::toType(color.red);
-            *(p + 1) = Pixel<uint8_t>::toType(color.green);
-            *(p + 2) = Pixel<uint8_t>::toType(color.blue);
-        }
-    }
+    m_tiles.draw(factorPoll(), m_enable_stf, displayOriginX(), displayOriginY(), cols(), rows(), render, displayBuffer(m_display));
 }
 
 
@@ -1026,7 +947,7 @@ void ImageWindow<T>::openStatisticsDialog() {
         int precision = (m_source.type() == ImageType::FLOAT) ? 7 : 1;
 
         if (m_sv.empty())
-            m_sv = Statistics::computeStatistics(m_source);
+            computeStatistics();
 
         m_stats_dialog = std::make_unique<StatisticsDialog>(name(), m_sv, precision, m_workspace);
 
@@ -1036,8 +957,8 @@ void ImageWindow<T>::openStatisticsDialog() {
 
             int precision = (m_source.type() == ImageType::FLOAT) ? 7 : 1;
 
-            if (v && m_sv_clipped.empty())
-                m_sv_clipped = Statistics::computeStatistics(m_source, v);
+            if (m_sv.empty())
+                computeStatistics();
 
             m_stats_dialog->updateStats((v) ? m_sv_clipped : m_sv);
         };
@@ -1046,6 +967,15 @@ void ImageWindow<T>::openStatisticsDialog() {
     }
 }
 
+template<typename T>
+void ImageWindow<T>::computeStatistics() {
+
+    //one pass fills both, so toggling clipped never recomputes
+    ImageStatistics stats(m_source);
+    m_sv = Statistics::computeStatistics(stats, m_source.type());
+    m_sv_clipped = Statistics::computeStatistics(stats, m_source.type(), true);
+}
+
 template<typename T>
 void ImageWindow<T>::updateStatisticsDialog() {
 
@@ -1053,10 +983,8 @@ void ImageWindow<T>::updateStatisticsDialog() {
     m_sv_clipped.clear();
 
     if (m_stats_dialog != nullptr) {
-
-        auto& sv = (m_stats_dialog->isChecked()) ? m_sv_clipped : m_sv;
-        sv = Statistics::computeStatistics(m_source, m_stats_dialog->isChecked());
-        m_stats_dialog->updateStats(sv);
+        computeStatistics();
+        m_stats_dialog->updateStats((m_stats_dialog->isChecked()) ? m_sv_clipped : m_sv);
     }
 }
 
@@ -1074,11 +1002,15 @@ void ImageWindow<T>::enableSTF(bool enable) {
 
     m_enable_stf = enable;
 
+    //tiles drawn through the old curve would otherwise be reused
     if (m_compute_stf) {
         m_ht.computeSTFCurve(m_source);
         m_compute_stf = false;
+        m_tiles.clear();
     }
 
+    m_display_lut.build((m_enable_stf) ? &m_ht : nullptr);
+
     displayImage();
 
     if (m_preview) {
@@ -1570,23 +1502,40 @@ void PreviewWindow<T>::resizeSource() {
 }
 
 template<typename T>
-void PreviewWindow<T>::updateSource() {
+const Image<T>& PreviewWindow<T>::sourceCache(int apron) {
 
     resizeSource();
+
+    SourceKey key = sourceKey(m_image_window->sourceRevision(), apron);
+
+    if (key == m_source_key && m_source_cache.channels() == channels())
+        return m_source_cache;
+
     const Image<T>& src = m_image_window->source();
 
     float _s = 1 / scaleFactor();
+    int f = (_s > 1.0f) ? int(_s) : 1;
+    int f2 = f * f;
 
-    if (_s > 1.0f) {
-        int f = _s;
-        int f2 = f * f;
+    //as many apron pixels on each side as keep every bin inside the parent
+    m_apron_left = math::min(apron, int(m_zwtl.x() / _s));
+    m_apron_top = math::min(apron, int(m_zwtl.y() / _s));
+    int right = math::clip(int((src.cols() - f - m_zwtl.x()) / _s) - int(cols() - 1), 0, apron);
+    int bottom = math::clip(int((src.rows() - f - m_zwtl.y()) / _s) - int(rows() - 1), 0, apron);
 
+    uint32_t r = rows() + m_apron_top + bottom;
+    uint32_t c = cols() + m_apron_left + right;
+
+    if (m_source_cache.rows() != r || m_source_cache.cols() != c || m_source_cache.channels() != channels())
+        m_source_cache = Image<T>(r, c, channels());
+
+    ThreadPool::parallelFor(0, r, [&](int start, int end) {
         for (int ch = 0; ch < channels(); ++ch) {
-            for (int y = 0; y < rows(); ++y) {
-                float y_s = y * _s + m_zwtl.y();
+            for (int y = start; y < end; ++y) {
+                float y_s = (y - m_apron_top) * _s + m_zwtl.y();
 
-                for (int x = 0; x < cols(); ++x) {
-                    float x_s = x * _s + m_zwtl.x();
+                for (int x = 0; x < c; ++x) {
+                    float x_s = (x - m_apron_left) * _s + m_zwtl.x();
 
                     double pix = 0;
 
@@ -1594,60 +1543,77 @@ void PreviewWindow<T>::updateSource() {
                         for (int i = 0; i < f; ++i)
                             pix += src(x_s + i, y_s + j, ch);
 
-                    m_source(x, y, ch) = pix / f2;
+                    m_source_cache(x, y, ch) = pix / f2;
                 }
             }
         }
-    }
+    });
 
-    else {
-        for (int ch = 0; ch < channels(); ++ch) {
-            for (int y = 0; y < rows(); ++y) {
-                int y_s = y * _s + m_zwtl.y();
+    m_source_key = key;
+    return m_source_cache;
+}
 
-                for (int x = 0; x < cols(); ++x) {
-                    int x_s = x * _s + m_zwtl.x();
+template<typename T>
+void PreviewWindow<T>::updateSource() {
 
-                    m_source(x, y, ch) = src(x_s, y_s, ch);
-                }
-            }
-        }
-    }
+    const Image<T>& cache = sourceCache(m_source_key.apron);
+    cache.region(m_apron_left, m_apron_top, cols(), rows()).copyTo(m_source.view());
 }
 
 template<typename T>
-void PreviewWindow<T>::updatePreview_Mask() {
+void PreviewWindow<T>::setSource(Image<T>&& img) {
 
-    if (!m_image_window->maskExists())
-        return displayImage();
+    if (img.rows() == rows() && img.cols() == cols() && img.channels() == channels())
+        m_source = std::move(img);
+    else
+        std::as_const(img).region(m_apron_left, m_apron_top, cols(), rows()).copyTo(m_source.view());
+}
 
-    resizeSource();
-    Image<T> mod = Image<T>(m_source);
-    updateSource();
+template<typename T>
+const Image32& PreviewWindow<T>::maskCache() {
 
-    Image32 mask = [this]() -> Image32 {
-        switch (m_image_window->mask()->type()) {
+    auto mw = m_image_window->mask();
+    SourceKey key = sourceKey(mw->sourceRevision(), 0);
 
-        case ImageType::UBYTE:
-            return this->getMask<uint8_t>();
+    if (mw == m_cached_mask && key == m_mask_key)
+        return m_mask_cache;
 
-        case ImageType::USHORT:
-            return this->getMask<uint16_t>();
+    switch (mw->type()) {
+    case ImageType::UBYTE:
+        m_mask_cache = getMask<uint8_t>();
+        break;
 
-        case ImageType::FLOAT:
-            return this->getMask<float>();
+    case ImageType::USHORT:
+        m_mask_cache = getMask<uint16_t>();
+        break;
 
-        default:
-            return this->getMask<uint8_t>();
+    case ImageType::FLOAT:
+        m_mask_cache = getMask<float>();
+        break;
+    }
 
-        }
-    }();
+    m_cached_mask = mw;
+    m_mask_key = key;
+    return m_mask_cache;
+}
+
+template<typename T>
+void PreviewWindow<T>::updatePreview_Mask() {
+
+    if (!m_image_window->maskExists())
+        return displayImage();
+
+    //m_source holds the processed pixels, the cache the unprocessed ones the mask blends back in
+    const Image<T>& original = sourceCache(m_source_key.apron);
+    const Image32& mask = maskCache();
 
     bool invert = m_image_window->maskInverted();
 
     bool apply_stf = m_image_window->stfEnabled();
     auto ht = m_image_window->histogramTransformation();
 
+    DisplayBuffer dst = displayBuffer(m_display);
+
     for (int ch = 0; ch < channels(); ++ch) {
         int mask_ch = (ch < mask.channels()) ? ch : 0;
         for (int y = 0; y < rows(); ++y) {
@@ -1658,17 +1624,16 @@ void PreviewWindow<T>::updatePreview_Mask() {
                 if (invert)
                     m = 1 - m;
 
-                float pix = Pixel<float>::toType(T(m_source(x, y, ch) * (1 - m) + mod(x, y, ch) * m));
+                float pix = Pixel<float>::toType(T(original(x + m_apron_left, y + m_apron_top, ch) * (1 - m) + m_source(x, y, ch) * m));
 
                 if (apply_stf)
                     pix = ht.transformPixel(ColorComponent::rgb_k, pix);
 
-                m_display.scanLine(y)[channels() * x + ch] = 255 * pix;
+                dst.row(y)[channels() * x + ch] = 255 * pix;
             }
         }
     }
 
-    mod.copyTo(m_source);
     m_image_label->draw();
 }
 
@@ -1687,25 +1652,13 @@ void PreviewWindow<T>::updatePreview(bool from_parent) {
 template<typename T>
 void PreviewWindow<T>::displayImage() {
 
-    if (m_image_window->stfEnabled()) {
-
-        auto ht = m_image_window->histogramTransformation();
+    if (m_source.rows() != m_display.height() || m_source.cols() != m_display.width() || qimageFormat(m_source.channels()) != m_display.format())
+        m_display = QImage(m_source.cols(), m_source.rows(), qimageFormat(m_source.channels()));
 
-        if (rows() != m_display.height() || cols() != m_display.width() || channels() != m_display.depth() / 3)
-            m_display = QImage(cols(), rows(), qimageFormat(channels()));
+    auto xs = DisplayRenderer::upsampleIndices(0, m_source.cols(), 1, m_source.cols());
+    auto ys = DisplayRenderer::upsampleIndices(0, m_source.rows(), 1, m_source.rows());
 
-        for (int ch = 0; ch < channels(); ++ch) {
-            for (int y = 0; y < rows(); ++y) {
-                for (int x = 0; x < cols(); ++x) {
-                    float pix = ht.transformPixel(ColorComponent::rgb_k, Pixel<float>::toType(m_source(x, y, ch)));
-                    m_display.scanLine(y)[channels() * x + ch] = Pixel<uint8_t>::toType(pix);
-                }
-            }
-        }
-    }
-
-    else
-        ImagetoQImage(m_source, m_display);
+    DisplayRenderer::render(m_source, xs, ys, 1, m_image_window->displayLUT(), displayBuffer(m_display));
 
     m_image_label->draw();
 }
@@ -3,6 +3,7 @@
 //#include "ImageWindow.h"
 #include "FITS.h"
 #include "TIFF.h"
+#include "XISF.h"
 #include "Bitmap.h"
 
 #include"FastStack.h"
@@ -264,6 +265,7 @@ WaveletTransformationMenu::WaveletTransformationMenu(Workspace* workspace, QWidg
 
 	this->setTitle("Wavelet Transformation");
 	this->addAction(tr("Wavelet Layers"), this, &WaveletTransformationMenu::waveletLayersSelection);
+	this->addAction(tr("Wavelet Noise Reduction"), this, &WaveletTransformationMenu::waveletNoiseReductionSelection);
 }
 
 void WaveletTransformationMenu::waveletLayersSelection() {
@@ -274,6 +276,14 @@ void WaveletTransformationMenu::waveletLayersSelection() {
 	}
 }
 
+void WaveletTransformationMenu::waveletNoiseReductionSelection() {
+
+	if (m_wnrd == nullptr) {
+		m_wnrd = std::make_unique<WaveletNoiseReductionDialog>(m_workspace);
+		connect(m_wnrd.get(), &ProcessDialog::windowClosed, this, [this]() { m_wnrd.reset(); });
+	}
+}
+
 
 
 
@@ -472,11 +482,31 @@ void MenuBar::SaveAs() {
 
 		switch (type) {
 		case ImageType::UBYTE:
-			return fits.write(iw8->source(), fw->imageType());
+			return fits.write(iw8->source(), fw->imageType(), fw->tileCodec());
+		case ImageType::USHORT:
+			return fits.write(iw16->source(), fw->imageType(), fw->tileCodec());
+		case ImageType::FLOAT:
+			return fits.write(iw32->source(), fw->imageType(), fw->tileCodec());
+		}
+	}
+
+	if (ext == ".xisf") {
+
+		XISFWindow* xw = new XISFWindow(type, m_workspace);
+
+		if (xw->exec() != QDialog::Accepted)
+			return;
+
+		XISF xisf;
+		xisf.create(file_path);
+
+		switch (type) {
+		case ImageType::UBYTE:
+			return xisf.write(iw8->source(), xw->imageType(), xw->codec(), xw->byteShuffle());
 		case ImageType::USHORT:
-			return fits.write(iw16->source(), fw->imageType());
+			return xisf.write(iw16->source(), xw->imageType(), xw->codec(), xw->byteShuffle());
 		case ImageType::FLOAT:
-			return fits.write(iw32->source(), fw->imageType());
+			return xisf.write(iw32->source(), xw->imageType(), xw->codec(), xw->byteShuffle());
 		}
 	}
 
@@ -490,11 +520,11 @@ void MenuBar::SaveAs() {
 		tiff.create(file_path);
 		switch (type) {
 		case ImageType::UBYTE:
-			return tiff.write(iw8->source(), tw->imageType(), tw->planarContig());
+			return tiff.write(iw8->source(), tw->imageType(), tw->planarContig(), tw->codec(), tw->tiled());
 		case ImageType::USHORT:
-			return tiff.write(iw16->source(), tw->imageType(), tw->planarContig());
+			return tiff.write(iw16->source(), tw->imageType(), tw->planarContig(), tw->codec(), tw->tiled());
 		case ImageType::FLOAT:
-			return tiff.write(iw32->source(), tw->imageType(), tw->planarContig());
+			return tiff.write(iw32->source(), tw->imageType(), tw->planarContig(), tw->codec(), tw->tiled());
 		}
 	}
 
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "TIFF.h"
+#include "Compression.h"
 
 void TIFF::IFD::AddEntry(TIFFTAG tag, FieldType type, uint32_t count, uint32_t value) {
     DirectoryEntry entry;
@@ -75,70 +76,58 @@ void TIFF::IFD::Write(std::fstream& stream) {
     stream.write((char*)&num_dir, 2);
     stream.write((char*)directory.data(), directory.size() * 12);
 
+    //single image, no next ifd
+    uint32_t next_ifd = 0;
+    stream.write((char*)&next_ifd, 4);
+
     stream.write((char*)offset_data.data(), offset_data.size());
 }
 
 
 
-void TIFF::getStripVectors() {
-
-    //strip offsets
-    int offset = tiffValueOffset(TIFFTAG::StripOffsets);
-    m_stream.seekg(offset);
-    m_strip_offsets.resize(tiffCount(TIFFTAG::StripOffsets));
-
-    m_stream.read((char*)m_strip_offsets.data(), m_strip_offsets.size() * 4);
-
-
-    //strip byte counts
-    offset = tiffValueOffset(TIFFTAG::StripByteCounts);
-    m_stream.seekg(offset);
+std::vector<uint32_t> TIFF::readArray(TIFFTAG tag) {
 
-    m_strip_byte_counts.resize(tiffCount(TIFFTAG::StripByteCounts));
-
-    if (tiffType(TIFFTAG::StripByteCounts) == FieldType::SHORT) {
-        std::vector<uint16_t> buffer(m_strip_byte_counts.size());
-        m_stream.read((char*)buffer.data(), buffer.size() * 2);
-        for (int i = 0; i < m_strip_byte_counts.size(); ++i)
-            m_strip_byte_counts[i] = buffer[i];
-        return;
-    }
+    FieldType type = tiffType(tag);
+    uint32_t count = tiffCount(tag);
+    uint32_t value = tiffValueOffset(tag);
+    size_t size = (type == FieldType::SHORT) ? 2 : 4;
 
-    m_stream.read((char*)m_strip_byte_counts.data(), m_strip_byte_counts.size() * 4);
+    std::vector<uint32_t> array(count);
 
-    if (byteswap) {
-        for (int i = 0; i < m_strip_offsets.size(); ++i) {
-            m_strip_offsets[i] = _byteswap_ulong(m_strip_offsets[i]);
-            m_strip_byte_counts[i] = _byteswap_ulong(m_strip_byte_counts[i]);
+    if (count * size <= 4) {
+        if (count == 1)
+            array[0] = value;
+        else if (count == 2 && size == 2) {
+            array[0] = (byteswap) ? value >> 16 : value & 0xFFFF;
+            array[1] = (byteswap) ? value & 0xFFFF : value >> 16;
         }
+        return array;
     }
-}
-
-void TIFF::makeStripVectors(ImageType type) {
-    int mem_row_size = m_cols * typeSize(type);
-
-    if (m_planar_config == PlanarConfig::Seperate) {
 
-        m_strip_offsets.resize(m_rows * m_channels);
-        m_strip_byte_counts.resize(m_rows * m_channels, mem_row_size);
+    m_stream.seekg(value);
 
+    if (size == 2) {
+        std::vector<uint16_t> buffer(count);
+        m_stream.read((char*)buffer.data(), count * 2);
+        for (uint32_t i = 0; i < count; ++i)
+            array[i] = (byteswap) ? _byteswap_ushort(buffer[i]) : buffer[i];
     }
 
-    else if (m_planar_config == PlanarConfig::Contiguous) {
-
-        mem_row_size *= m_channels;
-        m_strip_offsets.resize(m_rows);
-
-        m_strip_byte_counts.resize(m_rows, mem_row_size);
-
-        m_strip_offsets[0] = 8;
-
+    else {
+        m_stream.read((char*)array.data(), count * 4);
+        if (byteswap)
+            for (auto& v : array)
+                v = _byteswap_ulong(v);
     }
 
-    for (int i = 1; i < m_strip_offsets.size(); ++i)
-        m_strip_offsets[i] = mem_row_size + m_strip_offsets[i - 1];
+    return array;
 }
 
+void TIFF::getStripVectors() {
+
+    m_strip_offsets = readArray((m_tiled) ? TIFFTAG::TileOffsets : TIFFTAG::StripOffsets);
+    m_strip_byte_counts = readArray((m_tiled) ? TIFFTAG::TileByteCounts : TIFFTAG::StripByteCounts);
+}
 
 ImageType TIFF::imageTypefromFile() {
 
@@ -158,6 +147,15 @@ ImageType TIFF::imageTypefromFile() {
     }
 }
 
+bool TIFF::hasTag(TIFFTAG tag)const {
+
+    for (const auto& entry : ifd.directory)
+        if ((int)tag == entry.tag)
+            return true;
+
+    return false;
+}
+
 TIFF::FieldType TIFF::tiffType(TIFFTAG tag) {
     for (auto entry : ifd.directory) {
         if ((int)tag == entry.tag)
@@ -242,12 +240,41 @@ void TIFF::open(std::filesystem::path path) {
 
     m_planar_config = PlanarConfig(tiffValue(TIFFTAG::PlanarConfiguration));
 
+    uint32_t codec = tiffValue(TIFFTAG::Compression);
+    if (codec == 32946)
+        codec = uint32_t(Codec::deflate);
+
+    m_codec = Codec(codec);
+    m_predictor = Predictor(tiffValue(TIFFTAG::Predictor));
+
+    m_tiled = hasTag(TIFFTAG::TileWidth);
+
+    if (m_tiled) {
+        m_chunk_width = tiffValue(TIFFTAG::TileWidth);
+        m_chunk_height = tiffValue(TIFFTAG::TileLength);
+    }
+    else {
+        m_chunk_width = m_cols;
+        m_chunk_height = (hasTag(TIFFTAG::RowsPerStrip)) ? std::min(tiffValue(TIFFTAG::RowsPerStrip), m_rows) : m_rows;
+    }
+
+    bool supported = m_codec == Codec::none || m_codec == Codec::lzw || m_codec == Codec::deflate;
+
+    if (!supported || m_chunk_width == 0 || m_chunk_height == 0) {
+        m_rows = m_cols = 0;
+        return;
+    }
+
     m_px_count = m_rows * m_cols;
 
     getStripVectors();
 
-    //SetBuffer();
-    resizeBuffer(m_strip_byte_counts[0]);
+    if (m_strip_offsets.size() < chunkCount() || m_strip_byte_counts.size() < chunkCount()) {
+        m_rows = m_cols = 0;
+        return;
+    }
+
+    resizeBuffer();
 }
 
 void TIFF::create(std::filesystem::path path) {
@@ -265,82 +292,250 @@ void TIFF::close() {
     ifd = IFD();
     m_data_pos = 8;
 
+    m_planar_config = PlanarConfig::Contiguous;
+    m_codec = Codec::none;
+    m_predictor = Predictor::none;
+    m_tiled = false;
+    m_chunk_width = m_chunk_height = 0;
+
     m_strip_offsets.clear();
     m_strip_byte_counts.clear();
+
+    m_cached_chunk_row = -1;
+    m_chunk_cache.clear();
 }
 
-void TIFF::readScanLine_toFloat(float* dst, uint32_t row, uint32_t channel) {
+std::array<uint32_t, 3> TIFF::chunkOrigin(int chunk)const {
 
-    int buffer_size = cols();
-    uint32_t sample = channel;
+    uint32_t per_plane = chunksAcross() * chunksDown();
+    uint32_t c = chunk % per_plane;
 
-    if (planarConfig() == PlanarConfig::Contiguous) {
-        buffer_size *= channels();
-        sample = 0;
-    }
+    return { (c % chunksAcross()) * m_chunk_width, (c / chunksAcross()) * m_chunk_height, chunk / per_plane };
+}
 
-    switch (imageType()) {
-    case ImageType::UBYTE: {
-        std::vector<uint8_t>buffer(buffer_size);
-        readScanLine(buffer.data(), row, sample);
-        for (int x = 0; x < cols(); ++x)
-            dst[x] = Pixel<float>::toType(buffer[x + channel]);
+uint32_t TIFF::chunkRows(int chunk)const {
 
-        return;
+    if (m_tiled)
+        return m_chunk_height;
+
+    return std::min(m_chunk_height, m_rows - chunkOrigin(chunk)[1]);
+}
+
+template<typename S>
+static void horizontalAccumulate(S* row, size_t count, int stride) {
+
+    for (size_t i = stride; i < count; ++i)
+        row[i] += row[i - stride];
+}
+
+template<typename S>
+static void horizontalDifference(S* row, size_t count, int stride) {
+
+    for (size_t i = count - 1; i >= size_t(stride); --i)
+        row[i] -= row[i - stride];
+}
+
+//bytes of each sample are split into planes, most significant first, then byte differenced
+static void floatingPointAccumulate(uint8_t* row, size_t count, int bytes, int stride, std::vector<uint8_t>& temp) {
+
+    size_t size = count * bytes;
+    horizontalAccumulate(row, size, stride);
+
+    temp.assign(row, row + size);
+
+    for (size_t i = 0; i < count; ++i)
+        for (int b = 0; b < bytes; ++b)
+            row[i * bytes + b] = temp[(bytes - b - 1) * count + i];
+}
+
+static void floatingPointDifference(uint8_t* row, size_t count, int bytes, int stride, std::vector<uint8_t>& temp) {
+
+    size_t size = count * bytes;
+    temp.assign(row, row + size);
+
+    for (size_t i = 0; i < count; ++i)
+        for (int b = 0; b < bytes; ++b)
+            row[(bytes - b - 1) * count + i] = temp[i * bytes + b];
+
+    horizontalDifference(row, size, stride);
+}
+
+bool TIFF::decodeChunk(int chunk, const std::vector<uint8_t>& src, std::vector<uint8_t>& dst)const {
+
+    int bytes = typeSize(imageType());
+    int stride = chunkSamples();
+    size_t row_samples = size_t(m_chunk_width) * stride;
+    uint32_t rows = chunkRows(chunk);
+
+    dst.resize(rows * row_samples * bytes);
+
+    //every codec has to produce the whole chunk, a short one means the file is truncated or corrupt
+    switch (m_codec) {
+    case Codec::none:
+        if (src.size() < dst.size())
+            return false;
+        std::copy(src.begin(), src.begin() + dst.size(), dst.begin());
+        break;
+
+    case Codec::lzw:
+        if (!Compression::lzwDecompress(src.data(), src.size(), dst.data(), dst.size()))
+            return false;
+        break;
+
+    case Codec::deflate:
+        if (!Compression::decompress(Compression::Codec::zlib, src.data(), src.size(), dst.data(), dst.size()))
+            return false;
+        break;
     }
-    case ImageType::USHORT: {
-        std::vector<uint16_t>buffer(buffer_size);
-        readScanLine(buffer.data(), row, sample);
-        for (int x = 0; x < cols(); ++x)
-            dst[x] = Pixel<float>::toType(buffer[x + channel]);
-        return;
+
+    //the floating point predictor leaves samples in native order
+    if (m_predictor == Predictor::floating_point) {
+        std::vector<uint8_t> temp;
+        for (uint32_t r = 0; r < rows; ++r)
+            floatingPointAccumulate(&dst[r * row_samples * bytes], row_samples, bytes, stride, temp);
+        return true;
+    }
+
+    if (byteswap) {
+        if (bytes == 2)
+            for (uint16_t* p = (uint16_t*)dst.data(), *end = p + dst.size() / 2; p < end; ++p)
+                *p = _byteswap_ushort(*p);
+        else if (bytes == 4)
+            for (uint32_t* p = (uint32_t*)dst.data(), *end = p + dst.size() / 4; p < end; ++p)
+                *p = _byteswap_ulong(*p);
     }
-    case ImageType::FLOAT: {
 
-        if (planarConfig() == PlanarConfig::Contiguous) {
-            std::vector<float>buffer(buffer_size);
-            readScanLine(buffer.data(), row, sample);
-            for (int x = 0; x < cols(); ++x)
-                dst[x] = Pixel<float>::toType(buffer[x + channel]);
+    if (m_predictor == Predictor::horizontal) {
+        for (uint32_t r = 0; r < rows; ++r) {
+            uint8_t* row = &dst[r * row_samples * bytes];
+            if (bytes == 1)
+                horizontalAccumulate(row, row_samples, stride);
+            else if (bytes == 2)
+                horizontalAccumulate((uint16_t*)row, row_samples, stride);
+            else
+                horizontalAccumulate((uint32_t*)row, row_samples, stride);
         }
+    }
 
-        else
-            readScanLine(dst, row, sample);
+    return true;
+}
+
+void TIFF::decodeChunks(const std::vector<int>& chunks, std::vector<std::vector<uint8_t>>& dst) {
+
+    int count = chunks.size();
+    std::vector<std::vector<uint8_t>> data(count);
+
+    for (int i = 0; i < count; ++i) {
+        data[i].resize(m_strip_byte_counts[chunks[i]]);
+        m_stream.seekg(m_strip_offsets[chunks[i]]);
+        m_stream.read((char*)data[i].data(), data[i].size());
     }
+
+    if (!m_stream)
+        throw std::runtime_error("Corrupt TIFF image data");
+
+    dst.resize(count);
+
+    std::atomic_bool corrupt = false;
+
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; ++i) {
+        if (!decodeChunk(chunks[i], data[i], dst[i]))
+            corrupt = true;
+        std::vector<uint8_t>().swap(data[i]);
     }
+
+    if (corrupt)
+        throw std::runtime_error("Corrupt TIFF image data");
 }
 
 template<typename T>
-void TIFF::read(Image<T>& dst) {
+void TIFF::copyChunk(int chunk, const std::vector<uint8_t>& data, Image<T>& dst)const {
 
-    m_stream.seekg(dataPosition());
+    std::array<uint32_t, 3> o = chunkOrigin(chunk);
+    uint32_t w = std::min(m_chunk_width, m_cols - o[0]);
+    uint32_t h = std::min(chunkRows(chunk), m_rows - o[1]);
+    uint32_t spp = chunkSamples();
 
-    dst = Image<T>(rows(), cols(), channels());
+    const T* src = (const T*)data.data();
 
-    if (channels() == 1 || planarConfig() == PlanarConfig::Seperate) {
+    for (uint32_t y = 0; y < h; ++y) {
+        const T* row = src + size_t(y) * m_chunk_width * spp;
 
-        for (int ch = 0; ch < dst.channels(); ++ch) {
-            for (int row = 0; row < rows(); ++row) {
-                readScanLine(&dst(0, row, ch), row, ch);
-            }
-        }
+        if (spp == 1)
+            std::copy(row, row + w, &dst(o[0], o[1] + y, o[2]));
+
+        else
+            for (uint32_t x = 0; x < w; ++x)
+                for (uint32_t c = 0; c < spp; ++c)
+                    dst(o[0] + x, o[1] + y, c) = row[x * spp + c];
     }
+}
+
+void TIFF::readScanLine_toFloat(float* dst, uint32_t row, uint32_t channel) {
+
+    uint32_t plane = (planarConfig() == PlanarConfig::Contiguous) ? 0 : channel;
+    uint32_t sample = (planarConfig() == PlanarConfig::Contiguous) ? channel : 0;
+
+    int chunk_row = plane * chunksDown() + row / m_chunk_height;
 
-    else if (channels() == 3 && planarConfig() == PlanarConfig::Contiguous) {
-        std::vector<T> buffer(cols() * channels());
-        for (int row = 0; row < rows(); ++row) {
-            readScanLine(buffer.data(), row);
-            for (int c = 0, i = 0; c < m_cols; ++c) {
-                dst(c, row, 0) = buffer[i++];
-                dst(c, row, 1) = buffer[i++];
-                dst(c, row, 2) = buffer[i++];
-            }
+    if (chunk_row != m_cached_chunk_row) {
+        std::vector<int> chunks(chunksAcross());
+        std::iota(chunks.begin(), chunks.end(), chunk_row * chunksAcross());
+
+        //a failed decode leaves the cache partly overwritten
+        m_cached_chunk_row = -1;
+        decodeChunks(chunks, m_chunk_cache);
+        m_cached_chunk_row = chunk_row;
+    }
+
+    uint32_t spp = chunkSamples();
+    uint32_t y = row % m_chunk_height;
+
+    for (uint32_t cx = 0; cx < chunksAcross(); ++cx) {
+        uint32_t x0 = cx * m_chunk_width;
+        uint32_t w = std::min(m_chunk_width, m_cols - x0);
+        size_t offset = size_t(y) * m_chunk_width * spp + sample;
+
+        switch (imageType()) {
+        case ImageType::UBYTE: {
+            const uint8_t* src = m_chunk_cache[cx].data() + offset;
+            for (uint32_t x = 0; x < w; ++x)
+                dst[x0 + x] = Pixel<float>::toType(src[x * spp]);
+            break;
+        }
+        case ImageType::USHORT: {
+            const uint16_t* src = (const uint16_t*)m_chunk_cache[cx].data() + offset;
+            for (uint32_t x = 0; x < w; ++x)
+                dst[x0 + x] = Pixel<float>::toType(src[x * spp]);
+            break;
+        }
+        case ImageType::FLOAT: {
+            const float* src = (const float*)m_chunk_cache[cx].data() + offset;
+            for (uint32_t x = 0; x < w; ++x)
+                dst[x0 + x] = src[x * spp];
+            break;
+        }
         }
     }
+}
 
-    if (byteswap)
-        for (auto& p : dst)
-            p = _byteswap_ushort(p);
+template<typename T>
+void TIFF::read(Image<T>& dst) {
+
+    dst = Image<T>(rows(), cols(), channels());
+
+    std::vector<int> chunks(chunkCount());
+    std::iota(chunks.begin(), chunks.end(), 0);
+
+    std::vector<std::vector<uint8_t>> decoded;
+    decodeChunks(chunks, decoded);
+
+#pragma omp parallel for
+    for (int c = 0; c < int(chunks.size()); ++c) {
+        copyChunk(c, decoded[c], dst);
+        std::vector<uint8_t>().swap(decoded[c]);
+    }
 
     if (dst.type() == ImageType::FLOAT)
         dst.normalize();
@@ -383,63 +578,192 @@ void TIFF::readAny(Image32& dst) {
     close();
 }
 
-template<typename T>
-void TIFF::write(const Image<T>& src, ImageType new_type, bool planar_contiguous) {
+template<typename D, typename T>
+std::vector<uint8_t> TIFF::encodeChunk(const Image<T>& src, int chunk)const {
 
-    using enum PlanarConfig;
+    std::array<uint32_t, 3> o = chunkOrigin(chunk);
+    uint32_t w = std::min(m_chunk_width, m_cols - o[0]);
+    uint32_t h = std::min(chunkRows(chunk), m_rows - o[1]);
+    uint32_t spp = chunkSamples();
+    size_t row_samples = size_t(m_chunk_width) * spp;
 
-    TIFFHeader header;
-    header.offset = src.totalPxCount() * typeSize(new_type) + 8;
+    //edge tiles are zero padded
+    std::vector<D> buffer(chunkRows(chunk) * row_samples, 0);
 
-    m_stream.write((char*)&header, sizeof(header));
+    for (uint32_t y = 0; y < h; ++y) {
+        D* row = &buffer[y * row_samples];
+
+        if (spp == 1)
+            for (uint32_t x = 0; x < w; ++x)
+                row[x] = Pixel<D>::toType(src(o[0] + x, o[1] + y, o[2]));
+
+        else
+            for (uint32_t x = 0; x < w; ++x)
+                for (uint32_t c = 0; c < spp; ++c)
+                    row[x * spp + c] = Pixel<D>::toType(src(o[0] + x, o[1] + y, c));
+    }
+
+    uint8_t* data = (uint8_t*)buffer.data();
+    size_t size = buffer.size() * sizeof(D);
+
+    if (m_predictor == Predictor::horizontal) {
+        for (size_t y = 0; y < chunkRows(chunk); ++y)
+            horizontalDifference(&buffer[y * row_samples], row_samples, spp);
+    }
+
+    else if (m_predictor == Predictor::floating_point) {
+        std::vector<uint8_t> temp;
+        for (size_t y = 0; y < chunkRows(chunk); ++y)
+            floatingPointDifference(data + y * row_samples * sizeof(D), row_samples, sizeof(D), spp, temp);
+    }
+
+    switch (m_codec) {
+    case Codec::lzw:
+        return Compression::lzwCompress(data, size);
+    case Codec::deflate:
+        return Compression::compress(Compression::Codec::zlib, data, size);
+    default:
+        return std::vector<uint8_t>(data, data + size);
+    }
+}
+
+void TIFF::makeIFD(uint32_t ifd_offset) {
+
+    ifd = IFD();
+
+    int entry_count = (m_tiled) ? 15 : 14;
+    if (m_predictor != Predictor::none)
+        entry_count++;
+
+    uint32_t data_offset = ifd_offset + 2 + 12 * entry_count + 4;
+
+    //values over 4 bytes go after the directory
+    auto addArray = [&](TIFFTAG tag, FieldType type, const void* values, uint32_t count, uint32_t size) {
+        uint32_t num_bytes = count * size;
+
+        if (num_bytes <= 4) {
+            uint32_t value = 0;
+            memcpy(&value, values, num_bytes);
+            return ifd.AddEntry(tag, type, count, value);
+        }
+
+        ifd.AddEntry(tag, type, count, data_offset, (char*)values, num_bytes);
+        data_offset += num_bytes;
+    };
+
+    uint16_t bits = typeSize(m_img_type) * 8;
+    uint16_t sample_format = (m_img_type == ImageType::FLOAT) ? 3 : 1;
+
+    std::vector<uint16_t> bits_per_sample(m_channels, bits);
+    std::vector<uint16_t> sample_formats(m_channels, sample_format);
+
+    ifd.AddEntry(TIFFTAG::ImageWidth, FieldType::LONG, 1, m_cols);
+    ifd.AddEntry(TIFFTAG::ImageLength, FieldType::LONG, 1, m_rows);
+    addArray(TIFFTAG::BitsPerSample, FieldType::SHORT, bits_per_sample.data(), m_channels, 2);
+    ifd.AddEntry(TIFFTAG::Compression, FieldType::SHORT, 1, uint32_t(m_codec));
+    ifd.AddEntry(TIFFTAG::PhotometricInterpretation, FieldType::SHORT, 1, (m_channels == 1) ? 1 : 2);
+    ifd.AddEntry(TIFFTAG::SamplesPerPixel, FieldType::SHORT, 1, m_channels);
+
+    if (m_tiled) {
+        ifd.AddEntry(TIFFTAG::TileWidth, FieldType::LONG, 1, m_chunk_width);
+        ifd.AddEntry(TIFFTAG::TileLength, FieldType::LONG, 1, m_chunk_height);
+    }
+    else
+        ifd.AddEntry(TIFFTAG::RowsPerStrip, FieldType::LONG, 1, m_chunk_height);
+
+    int res[2] = { 72,1 };
+    addArray(TIFFTAG::XResolution, FieldType::RATIONAL, res, 1, 8);
+    addArray(TIFFTAG::YResolution, FieldType::RATIONAL, res, 1, 8);
+    ifd.AddEntry(TIFFTAG::PlanarConfiguration, FieldType::SHORT, 1, (uint32_t)m_planar_config);
+    ifd.AddEntry(TIFFTAG::ResolutionUnit, FieldType::SHORT, 1, 2);
+
+    if (m_predictor != Predictor::none)
+        ifd.AddEntry(TIFFTAG::Predictor, FieldType::SHORT, 1, uint32_t(m_predictor));
+
+    addArray(TIFFTAG::SampleFormat, FieldType::SHORT, sample_formats.data(), m_channels, 2);
+
+    uint32_t count = m_strip_offsets.size();
+    addArray((m_tiled) ? TIFFTAG::TileOffsets : TIFFTAG::StripOffsets, FieldType::LONG, m_strip_offsets.data(), count, 4);
+    addArray((m_tiled) ? TIFFTAG::TileByteCounts : TIFFTAG::StripByteCounts, FieldType::LONG, m_strip_byte_counts.data(), count, 4);
+}
+
+template<typename T>
+void TIFF::write(const Image<T>& src, ImageType new_type, bool planar_contiguous, Codec codec, bool tiled) {
+
+    using enum PlanarConfig;
 
     m_rows = src.rows();
     m_cols = src.cols();
     m_channels = src.channels();
+    m_img_type = new_type;
 
-    m_planar_config = (planar_contiguous) ? Contiguous : Seperate;
+    m_planar_config = (planar_contiguous || m_channels == 1) ? Contiguous : Seperate;
 
-    makeStripVectors(new_type);
-    resizeBuffer(m_strip_byte_counts[0]);
+    m_codec = codec;
+    if (codec == Codec::none)
+        m_predictor = Predictor::none;
+    else
+        m_predictor = (new_type == ImageType::FLOAT) ? Predictor::floating_point : Predictor::horizontal;
 
-    switch (new_type) {
-    case ImageType::UBYTE: {
-            if (m_channels == 1 || m_planar_config == Seperate)
-                writePixels_Seperate<uint8_t>(src);
-            else if (m_planar_config == Contiguous)
-                writePixels_Contiguous<uint8_t>(src);
+    m_tiled = tiled;
 
-            break;
-        }
+    if (m_tiled)
+        m_chunk_width = m_chunk_height = m_write_tile_size;
 
-    case ImageType::USHORT: {
-            if (m_channels == 1 || m_planar_config == Seperate)
-                writePixels_Seperate<uint16_t>(src);
-            else if (m_planar_config == Contiguous)
-                writePixels_Contiguous<uint16_t>(src);
+    else {
+        uint32_t row_size = m_cols * chunkSamples() * typeSize(new_type);
+        m_chunk_width = m_cols;
+        m_chunk_height = std::clamp<uint32_t>(m_write_strip_bytes / row_size, 1, m_rows);
+    }
 
+    int count = chunkCount();
+    std::vector<std::vector<uint8_t>> chunks(count);
+
+#pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < count; ++c) {
+        switch (new_type) {
+        case ImageType::UBYTE:
+            chunks[c] = encodeChunk<uint8_t>(src, c);
+            break;
+        case ImageType::USHORT:
+            chunks[c] = encodeChunk<uint16_t>(src, c);
+            break;
+        case ImageType::FLOAT:
+            chunks[c] = encodeChunk<float>(src, c);
             break;
         }
+    }
 
-    case ImageType::FLOAT: {
-            if (m_channels == 1 || m_planar_config == Seperate)
-                writePixels_Seperate<float>(src);
-            else if (m_planar_config == Contiguous)
-                writePixels_Contiguous<float>(src);
+    TIFFHeader header;
+    m_stream.write((char*)&header, sizeof(header));
 
-            break;
-        }
+    m_strip_offsets.resize(count);
+    m_strip_byte_counts.resize(count);
+
+    uint32_t offset = sizeof(header);
+
+    for (int c = 0; c < count; ++c) {
+        m_strip_offsets[c] = offset;
+        m_strip_byte_counts[c] = chunks[c].size();
+        m_stream.write((char*)chunks[c].data(), chunks[c].size());
+        offset += chunks[c].size();
     }
 
-    ifd = IFD(src, new_type, planar_contiguous);
+    //the ifd starts on a word boundary
+    if (offset % 2) {
+        m_stream.put(0);
+        offset++;
+    }
 
+    makeIFD(offset);
     ifd.Write(m_stream);
 
-    m_stream.write((char*)m_strip_offsets.data(), 4 * m_strip_offsets.size());
-    m_stream.write((char*)m_strip_byte_counts.data(), 4 * m_strip_byte_counts.size());
+    header.offset = offset;
+    m_stream.seekp(0);
+    m_stream.write((char*)&header, sizeof(header));
 
     close();
 }
-template void TIFF::write(const Image8&, ImageType, bool);
-template void TIFF::write(const Image16&, ImageType, bool);
-template void TIFF::write(const Image32&, ImageType, bool);
\ No newline at end of file
+template void TIFF::write(const Image8&, ImageType, bool, Codec, bool);
+template void TIFF::write(const Image16&, ImageType, bool, Codec, bool);
+template void TIFF::write(const Image32&, ImageType, bool, Codec, bool);
@@ -7,15 +7,21 @@
 
 
 template<typename T>
-Wavelet::Images::Images(const Image<T> src, bool to_grayscale) {
+Wavelet::Images::Images(const Image<T>& src, bool to_grayscale) {
+
+	load(src, to_grayscale);
+}
+
+template<typename T>
+void Wavelet::Images::load(const Image<T>& src, bool to_grayscale) {
 
 	src.copyTo(source);
 
 	if (to_grayscale)
 		source.toGrayscale();
 
-	convolved = Image32(source.rows(), source.cols(), source.channels());
-	wavelet = Image32(source.rows(), source.cols(), source.channels());
+	if (!wavelet.isSameShape(source))
+		wavelet = Image32(source.rows(), source.cols(), source.channels());
 }
 
 const std::vector<float>& Wavelet::scalingFunctionKernel(ScalingFunction sf)const {
@@ -42,7 +48,7 @@ const std::vector<float>& Wavelet::scalingFunctionKernel(ScalingFunction sf)cons
 
 void Wavelet::atrous(uint8_t layer, Images& images) {
 
-	int _2i = pow(2, layer);
+	int step = 1 << layer;
 
 	const std::vector<float>& sfv = scalingFunctionKernel(m_scaling_func);
 
@@ -50,78 +56,155 @@ void Wavelet::atrous(uint8_t layer, Images& images) {
 	for (float v : sfv)
 		sfv_sum += v;
 
-	int left = -(int(sfv.size() - 1) / 2) * _2i;
+	std::vector<float> kernel(sfv.size());
+	for (int i = 0; i < sfv.size(); ++i)
+		kernel[i] = sfv[i] / sfv_sum;
 
-	for (int ch = 0; ch < images.source.channels(); ++ch) {
-#pragma omp parallel for
-		for (int y = 0; y < images.source.rows(); ++y)
-			for (int x = 0; x < images.source.cols(); ++x) {
+	int taps = kernel.size();
+	int halo = ((taps - 1) / 2) * step;
 
-				float sum = 0;
+	Image32& src = images.source;
+	Image32& dst = images.wavelet;
 
-				for (int i = 0, d = left; i < sfv.size(); ++i, d += _2i)
-					sum += images.source.at_replicated(x + d, y, ch) * sfv[i];
+	int rows = src.rows();
+	int cols = src.cols();
 
-				images.wavelet(x, y, ch) = sum;
-			}
+	//replicated border is applied once per row, taps then run over contiguous rows
+	std::vector<float> padded(cols + 2 * halo);
 
-#pragma omp parallel for
-		for (int y = 0; y < images.wavelet.rows(); ++y)
-			for (int x = 0; x < images.wavelet.cols(); ++x) {
+	for (int ch = 0; ch < src.channels(); ++ch) {
+#pragma omp parallel for firstprivate(padded)
+		for (int y = 0; y < rows; ++y) {
 
-				float sum = 0;
+			float* p = &padded[halo];
+			std::fill(p, p + cols, 0.0f);
 
-				for (int i = 0, d = left; i < sfv.size(); ++i, d += _2i)
-					sum += images.wavelet.at_replicated(x, y + d, ch) * sfv[i];
+			for (int i = 0; i < taps; ++i) {
+				const float* row = &src(0, std::clamp(y + i * step - halo, 0, rows - 1), ch);
+				float k = kernel[i];
+				for (int x = 0; x < cols; ++x)
+					p[x] += k * row[x];
+			}
+
+			for (int x = 0; x < halo; ++x) {
+				padded[x] = p[0];
+				p[cols + x] = p[cols - 1];
+			}
+
+			float* out = &dst(0, y, ch);
+			std::fill(out, out + cols, 0.0f);
 
-				images.convolved(x, y, ch) = sum;
+			for (int i = 0; i < taps; ++i) {
+				const float* q = &padded[i * step];
+				float k = kernel[i];
+				for (int x = 0; x < cols; ++x)
+					out[x] += k * q[x];
 			}
+		}
 	}
 
-	for (int el = 0; el < images.source.totalPxCount(); ++el)
-		images.wavelet[el] = images.source[el] - images.convolved[el];
+	//wavelet buffer holds the convolved image, swap it into source and leave the difference behind
+#pragma omp parallel for
+	for (int el = 0; el < src.totalPxCount(); ++el) {
+		float c = dst[el];
+		dst[el] = src[el] - c;
+		src[el] = c;
+	}
+}
+
+void Wavelet::transform(Images& images, const LayerFunction& func, bool residual) {
 
-	images.convolved.copyTo(images.source);
+	for (int i = 0; i < m_layers; ++i) {
+		atrous(i, images);
+		func(i, images.wavelet);
+	}
+
+	if (residual)
+		func(m_layers, images.source);
 }
 
+template<typename T>
+void Wavelet::transform(const Image<T>& src, const LayerFunction& func, bool residual, bool to_grayscale) {
+
+	Images images(src, to_grayscale);
+	transform(images, func, residual);
+}
+template void Wavelet::transform(const Image8&, const LayerFunction&, bool, bool);
+template void Wavelet::transform(const Image16&, const LayerFunction&, bool, bool);
+template void Wavelet::transform(const Image32&, const LayerFunction&, bool, bool);
+
 const int8_t getSign(float val) {
 	return (val < 0) ? -1 : 1;
 }
 
-void Wavelet::LinearNoiseReduction(float threshold, float amount) {
+//only works on non-normalized wavelet images
+double Wavelet::kSigma(const Image32& img, int ch, float K, float eps, int n) {
 
-	amount = fabsf(amount - 1);
+	const float* data = &img(0, 0, ch);
+	int size = img.pxCount();
 
-	/*for (int ch = 0; ch < m_wavelet.channels(); ++ch) {
+	//clipping passes read the layer in place, sampled down to ~4M pixels
+	int step = math::max(1, size >> 22);
 
-		WaveletHistogram histogram (m_wavelet, ch);
-		float median = histogram.Median();
-		histogram = WaveletHistogram(m_wavelet, ch, median);
-		threshold *= histogram.MAD() / 0.6745;
+	double s0 = 0;
+	double Ks = std::numeric_limits<double>::max();
 
-		for (float& w : image_channel(m_wavelet, ch)) {
-			float val = fabsf(w);
-			w = (val < threshold) ? w * amount : getSign(w) * (val - threshold);
+	for (int it = 0; it < n; ++it) {
+
+		double sum = 0, sum2 = 0;
+		int count = 0;
+
+#pragma omp parallel for reduction(+:sum, sum2, count)
+		for (int el = 0; el < size; el += step) {
+			float val = data[el];
+			if (abs(val) < Ks) {
+				sum += val;
+				sum2 += val * val;
+				count++;
+			}
 		}
-	}*/
+
+		if (count < 2)
+			return 0;
+
+		double mean = sum / count;
+		double s = sqrt(math::max(0.0, sum2 / count - mean * mean));
+
+		if (1 + s == 1)
+			return 0;
+		if (eps > 0 && it > 1 && (s0 - s) / s0 < eps)
+			return s;
+		s0 = s;
+
+		Ks = K * s;
+	}
+
+	return s0;
 }
 
-void Wavelet::MedianNoiseReduction(float threshold, float amount) {
+void Wavelet::LinearNoiseReduction(Image32& wavelet, int ch, float threshold, float amount) {
 
-	/*amount = fabsf(amount - 1);
+	amount = fabsf(amount - 1);
 
-	for (int ch = 0; ch < m_wavelet.channels(); ++ch) {
+	float* w = &wavelet(0, 0, ch);
 
-		WaveletHistogram histogram(m_wavelet, ch);
-		float median = histogram.Median();
-		histogram = WaveletHistogram(m_wavelet, ch, median);
-		threshold *= histogram.MAD() / 0.6745;
+#pragma omp parallel for
+	for (int el = 0; el < wavelet.pxCount(); ++el) {
+		float val = fabsf(w[el]);
+		w[el] = (val < threshold) ? w[el] * amount : getSign(w[el]) * (val - threshold);
+	}
+}
 
-		for (float& w : image_channel(m_wavelet, ch))
-			w = (abs(w) < threshold) ? w * amount : w;
+void Wavelet::MedianNoiseReduction(Image32& wavelet, int ch, float threshold, float amount) {
 
-	}*/
+	amount = fabsf(amount - 1);
 
+	float* w = &wavelet(0, 0, ch);
+
+#pragma omp parallel for
+	for (int el = 0; el < wavelet.pxCount(); ++el)
+		if (fabsf(w[el]) < threshold)
+			w[el] *= amount;
 }
 
 
@@ -131,18 +214,15 @@ template<typename T>
 ImageVector<float> WaveletLayerCreator::generateWaveletLayers(const Image<T>& src) {
 
 	std::vector<Image32> imgs;
-	imgs.reserve(layers());
-
-	Images images(src);
+	imgs.reserve(layers() + m_residual);
 
-	for (int i = 0; i < layers(); ++i) {
-		atrous(i, images);
-		images.wavelet.normalize();
-		imgs.push_back(images.wavelet);
-	}
+	auto func = [&](int layer, Image32& wavelet) {
+		if (layer < layers())
+			wavelet.normalize();
+		imgs.push_back(wavelet);
+	};
 
-	if (m_residual)
-		imgs.push_back(images.convolved);
+	transform(src, func, m_residual);
 
 	return imgs;
 }
@@ -154,71 +234,91 @@ template std::vector<Image32> WaveletLayerCreator::generateWaveletLayers(const I
 
 
 
-//only works on non-normalized wavelet images
-double StructureMaps::kSigma(const Image32& img, float K, float eps, int n) {
-
-	std::vector<float> pixels(img.totalPxCount());
-	memcpy(&pixels[0], img.data(), img.totalPxCount() * sizeof(float));
-
-	double s0 = 0;
-	for (int it = 0; it < n; ++it) {
-
-		if (pixels.size() < 2)
-			return 0;
-
-		double s = math::standardDeviation(pixels);
-
-		if (1 + s == 1)
-			return 0;
-		if (eps > 0 && it > 1 && (s0 - s) / s0 < eps)
-			return s;
-		s0 = s;
-
-		std::vector<float> other;
-		other.reserve(pixels.size());
-
-		double Ks = K * s;
-
-		for (float val : pixels)
-			if (abs(val) < Ks)
-				other.emplace_back(val);
-
-		std::swap(pixels, other);
-	}
-
-	return 0;
-}
-
 template<typename T>
 Image8Vector StructureMaps::generateMaps(const Image<T>& img) {
 
 	Image8Vector star_imgs;
 	star_imgs.reserve(layers());
 
-	Images images(img, true);
+	auto func = [&](int layer, Image32& w) {
 
-	auto& w = images.wavelet;
-
-	for (int i = 0; i < layers(); ++i) {
-
-		atrous(i, images);
 		w.normalize();
 
-		float median = w.computeMedian(0);
+		float median = w.computeMedian(0, false, Quantile::Mode::approximate);
 		float sigma = w.compute_nMAD(0);
 
 		float threshold = median + m_K * sigma;
 
 		Image8 bi_wavelet(img.rows(), img.cols());
 
+#pragma omp parallel for
 		for (int el = 0; el < bi_wavelet.totalPxCount(); ++el)
 			bi_wavelet[el] = (w[el] >= threshold) ? 1 : 0;
 
 		star_imgs.emplace_back(std::move(bi_wavelet));
-	}
+	};
+
+	transform(img, func, false, true);
 
 	return star_imgs;
 }
 template Image8Vector StructureMaps::generateMaps(const Image8&);
 template Image8Vector StructureMaps::generateMaps(const Image16&);
 template Image8Vector StructureMaps::generateMaps(const Image32&);
+
+
+
+
+
+void WaveletNoiseReduction::reduceNoise(Image32& wavelet, const LayerParameters& lp)const {
+
+	for (int ch = 0; ch < wavelet.channels(); ++ch) {
+
+		float threshold = lp.threshold * kSigma(wavelet, ch, m_K);
+
+		switch (m_method) {
+		case Method::linear:
+			LinearNoiseReduction(wavelet, ch, threshold, lp.amount);
+			break;
+
+		case Method::median:
+			MedianNoiseReduction(wavelet, ch, threshold, lp.amount);
+			break;
+		}
+	}
+}
+
+template<typename T>
+void WaveletNoiseReduction::apply(Image<T>& img) {
+
+	auto buffers = m_buffers->acquire();
+	Images& images = buffers->images;
+	images.load(img);
+
+	Image32& recon = buffers->reconstruction;
+	if (!recon.isSameShape(img))
+		recon = Image32(img.rows(), img.cols(), img.channels());
+
+	recon.fillZero();
+
+	auto func = [&](int layer, Image32& wavelet) {
+
+		if (layer < layers() && m_layer_params[layer].enabled)
+			reduceNoise(wavelet, m_layer_params[layer]);
+
+#pragma omp parallel for
+		for (int el = 0; el < recon.totalPxCount(); ++el)
+			recon[el] += wavelet[el];
+	};
+
+	transform(images, func, true);
+
+#pragma omp parallel for
+	for (int el = 0; el < img.totalPxCount(); ++el)
+		img[el] = Pixel<T>::toType(math::clipf(recon[el]));
+
+	m_buffers->release(std::move(buffers));
+}
+template void WaveletNoiseReduction::apply(Image8&);
+template void WaveletNoiseReduction::apply(Image16&);
+template void WaveletNoiseReduction::apply(Image32&);
@@ -0,0 +1,606 @@
+#include "pch.h"
+#include "XISF.h"
+
+static QString codecName(Compression::Codec codec) {
+
+	switch (codec) {
+	case Compression::Codec::zlib:
+		return "zlib";
+	case Compression::Codec::lz4:
+		return "lz4";
+	case Compression::Codec::lz4hc:
+		return "lz4hc";
+	default:
+		return "";
+	}
+}
+
+template<typename S>
+static S loadSample(const uint8_t* src, size_t i, size_t stride) {
+	S v;
+	memcpy(&v, src + i * stride * sizeof(S), sizeof(S));
+	return v;
+}
+
+template<typename D, typename T>
+static void encodeSamples(const Image<T>& src, uint8_t* dst) {
+
+	D* d = reinterpret_cast<D*>(dst);
+
+#pragma omp parallel for
+	for (int el = 0; el < src.totalPxCount(); ++el)
+		d[el] = Pixel<D>::toType(src[el]);
+}
+
+
+
+
+bool XISF::isXISFFile() {
+
+	m_stream.seekg(0);
+
+	char signature[8] = {};
+	m_stream.read(signature, 8);
+
+	return m_stream && std::equal(signature, signature + 8, "XISF0100");
+}
+
+size_t XISF::sampleSize()const {
+
+	switch (m_sample_format) {
+	case SampleFormat::UInt8:
+		return 1;
+	case SampleFormat::UInt16:
+		return 2;
+	case SampleFormat::UInt32:
+	case SampleFormat::Float32:
+		return 4;
+	case SampleFormat::Float64:
+		return 8;
+	default:
+		return 1;
+	}
+}
+
+bool XISF::readHeader(const QByteArray& xml) {
+
+	QXmlStreamReader reader(xml);
+
+	while (!reader.atEnd()) {
+		reader.readNext();
+
+		//only the first image of the unit is read
+		if (!reader.isStartElement() || reader.name() != QLatin1String("Image"))
+			continue;
+
+		auto attributes = reader.attributes();
+
+		QStringList geometry = attributes.value("geometry").toString().split(':');
+		if (geometry.size() < 2)
+			return false;
+
+		m_cols = geometry[0].toUInt();
+		m_rows = geometry[1].toUInt();
+		m_file_channels = (geometry.size() > 2) ? geometry[2].toUInt() : 1;
+
+		if (m_rows == 0 || m_cols == 0 || m_file_channels == 0)
+			return false;
+
+		//extra channels are alpha
+		m_channels = (m_file_channels >= 3) ? 3 : 1;
+		m_px_count = rows() * cols();
+
+		QString format = attributes.value("sampleFormat").toString();
+
+		if (format == "UInt8") {
+			m_sample_format = SampleFormat::UInt8;
+			m_img_type = ImageType::UBYTE;
+		}
+		else if (format == "UInt16") {
+			m_sample_format = SampleFormat::UInt16;
+			m_img_type = ImageType::USHORT;
+		}
+		else if (format == "UInt32") {
+			m_sample_format = SampleFormat::UInt32;
+			m_img_type = ImageType::FLOAT;
+		}
+		else if (format == "Float32") {
+			m_sample_format = SampleFormat::Float32;
+			m_img_type = ImageType::FLOAT;
+		}
+		else if (format == "Float64") {
+			m_sample_format = SampleFormat::Float64;
+			m_img_type = ImageType::FLOAT;
+		}
+		else
+			return false;
+
+		m_pixel_storage = (attributes.value("pixelStorage").toString() == "Normal") ? PixelStorage::normal : PixelStorage::planar;
+		m_big_endian = (attributes.value("byteOrder").toString() == "big");
+
+		QStringList bounds = attributes.value("bounds").toString().split(':');
+		if (bounds.size() == 2 && bounds[0].toDouble() != bounds[1].toDouble())
+			m_bounds = { bounds[0].toDouble(), bounds[1].toDouble() };
+
+		//inline and embedded data blocks are not supported
+		QStringList location = attributes.value("location").toString().split(':');
+		if (location.size() != 3 || location[0] != "attachment")
+			return false;
+
+		m_block_pos = location[1].toULongLong();
+		m_block_size = location[2].toULongLong();
+		m_uncompressed_size = uint64_t(m_px_count) * m_file_channels * sampleSize();
+
+		QStringList compression = attributes.value("compression").toString().split(':');
+		if (compression.size() >= 2) {
+			QString codec = compression[0];
+
+			m_byte_shuffle = codec.endsWith("+sh");
+			if (m_byte_shuffle)
+				codec.chop(3);
+
+			if (codec == "zlib")
+				m_codec = Compression::Codec::zlib;
+			else if (codec == "lz4")
+				m_codec = Compression::Codec::lz4;
+			else if (codec == "lz4hc")
+				m_codec = Compression::Codec::lz4hc;
+			else
+				return false;
+
+			m_uncompressed_size = compression[1].toULongLong();
+			m_item_size = (compression.size() > 2) ? compression[2].toUInt() : sampleSize();
+
+			if (m_byte_shuffle && m_item_size != sampleSize())
+				return false;
+		}
+
+		uint64_t position = m_block_pos;
+		uint64_t offset = 0;
+
+		QString subblocks = attributes.value("subblocks").toString();
+		if (m_codec != Compression::Codec::none && !subblocks.isEmpty()) {
+			for (const QString& sb : subblocks.split(':')) {
+				QStringList sizes = sb.split(',');
+				if (sizes.size() != 2)
+					return false;
+
+				Subblock subblock = { sizes[0].toULongLong(), sizes[1].toULongLong(), position, offset };
+				position += subblock.compressed_size;
+				offset += subblock.size;
+				m_subblocks.push_back(subblock);
+			}
+		}
+		else
+			m_subblocks.push_back({ m_block_size, m_uncompressed_size, m_block_pos, 0 });
+
+		return true;
+	}
+
+	return false;
+}
+
+QByteArray XISF::writeHeader(ImageType type, uint64_t position, uint64_t size, const QString& compression, const QString& subblocks)const {
+
+	QByteArray xml;
+	QXmlStreamWriter writer(&xml);
+
+	writer.writeStartDocument();
+	writer.writeDefaultNamespace("http://www.pixinsight.com/xisf");
+	writer.writeStartElement("xisf");
+	writer.writeAttribute("version", "1.0");
+
+	writer.writeStartElement("Image");
+	writer.writeAttribute("geometry", QString("%1:%2:%3").arg(cols()).arg(rows()).arg(channels()));
+
+	switch (type) {
+	case ImageType::UBYTE:
+		writer.writeAttribute("sampleFormat", "UInt8");
+		break;
+	case ImageType::USHORT:
+		writer.writeAttribute("sampleFormat", "UInt16");
+		break;
+	case ImageType::FLOAT:
+		writer.writeAttribute("sampleFormat", "Float32");
+		writer.writeAttribute("bounds", "0:1");
+		break;
+	}
+
+	writer.writeAttribute("colorSpace", (channels() == 3) ? "RGB" : "Gray");
+	writer.writeAttribute("location", QString("attachment:%1:%2").arg(position).arg(size));
+
+	if (!compression.isEmpty()) {
+		writer.writeAttribute("compression", compression);
+		writer.writeAttribute("subblocks", subblocks);
+	}
+
+	writer.writeEndElement();
+
+	writer.writeStartElement("Metadata");
+
+	writer.writeStartElement("Property");
+	writer.writeAttribute("id", "XISF:CreationTime");
+	writer.writeAttribute("type", "TimePoint");
+	writer.writeAttribute("value", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+	writer.writeEndElement();
+
+	writer.writeStartElement("Property");
+	writer.writeAttribute("id", "XISF:CreatorApplication");
+	writer.writeAttribute("type", "String");
+	writer.writeAttribute("value", "FastStack");
+	writer.writeEndElement();
+
+	writer.writeEndElement();
+
+	writer.writeEndElement();
+	writer.writeEndDocument();
+
+	return xml;
+}
+
+std::vector<uint8_t> XISF::decompressSubblock(int index) {
+
+	const Subblock& sb = m_subblocks[index];
+
+	std::vector<uint8_t> compressed(sb.compressed_size);
+	m_stream.seekg(sb.position);
+	m_stream.read((char*)compressed.data(), compressed.size());
+
+	std::vector<uint8_t> data(sb.size);
+	if (!m_stream || !Compression::decompress(m_codec, compressed.data(), compressed.size(), data.data(), data.size()))
+		throw std::runtime_error("Corrupt XISF data block");
+
+	return data;
+}
+
+const std::vector<uint8_t>& XISF::subblock(int index) {
+
+	for (auto& cached : m_subblock_cache)
+		if (cached.first == index)
+			return cached.second;
+
+	std::vector<uint8_t> data = decompressSubblock(index);
+	size_t bytes = data.size();
+
+	while (!m_subblock_cache.empty() && m_shared_cached_bytes + bytes > m_max_cached_bytes) {
+		size_t evicted = m_subblock_cache.front().second.size();
+		m_shared_cached_bytes -= evicted;
+		m_cached_bytes -= evicted;
+		m_subblock_cache.pop_front();
+	}
+
+	m_subblock_cache.emplace_back(index, std::move(data));
+	m_shared_cached_bytes += bytes;
+	m_cached_bytes += bytes;
+
+	return m_subblock_cache.back().second;
+}
+
+void XISF::clearSubblockCache() {
+
+	m_shared_cached_bytes -= m_cached_bytes;
+	m_cached_bytes = 0;
+	m_subblock_cache.clear();
+}
+
+void XISF::readUncompressed(uint64_t offset, uint64_t size, uint8_t* dst) {
+
+	if (m_codec == Compression::Codec::none) {
+		m_stream.seekg(m_block_pos + offset);
+		m_stream.read((char*)dst, size);
+		if (!m_stream)
+			throw std::runtime_error("Corrupt XISF data block");
+		return;
+	}
+
+	for (int i = 0; i < m_subblocks.size() && size > 0; ++i) {
+		const Subblock& sb = m_subblocks[i];
+
+		if (offset >= sb.offset + sb.size)
+			continue;
+
+		//a block without a subblock table is cached whole as well, so row reads and byte planes decompress it once
+		const auto& data = subblock(i);
+
+		uint64_t start = offset - sb.offset;
+		uint64_t n = math::min(size, sb.size - start);
+
+		memcpy(dst, data.data() + start, n);
+		dst += n;
+		offset += n;
+		size -= n;
+	}
+}
+
+void XISF::readSamples(uint64_t first, uint64_t count, uint8_t* dst) {
+
+	size_t ss = sampleSize();
+
+	if (!m_byte_shuffle || ss == 1)
+		return readUncompressed(first * ss, count * ss, dst);
+
+	//byte k of every sample is stored contiguously in plane k
+	uint64_t samples = m_uncompressed_size / ss;
+	std::vector<uint8_t> plane(count);
+
+	for (int k = 0; k < ss; ++k) {
+		readUncompressed(k * samples + first, count, plane.data());
+		for (uint64_t i = 0; i < count; ++i)
+			dst[i * ss + k] = plane[i];
+	}
+}
+
+std::vector<uint8_t> XISF::readBlock() {
+
+	std::vector<uint8_t> block(m_uncompressed_size);
+
+	if (m_codec == Compression::Codec::none) {
+		m_stream.seekg(m_block_pos);
+		m_stream.read((char*)block.data(), block.size());
+		if (!m_stream)
+			throw std::runtime_error("Corrupt XISF data block");
+		return block;
+	}
+
+	std::vector<uint8_t> compressed(m_block_size);
+	m_stream.seekg(m_block_pos);
+	m_stream.read((char*)compressed.data(), compressed.size());
+
+	if (!m_stream)
+		throw std::runtime_error("Corrupt XISF data block");
+
+	std::vector<uint8_t> shuffled((m_byte_shuffle) ? m_uncompressed_size : 0);
+	uint8_t* dst = (m_byte_shuffle) ? shuffled.data() : block.data();
+
+	std::atomic_bool corrupt = false;
+
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < m_subblocks.size(); ++i) {
+		const Subblock& sb = m_subblocks[i];
+		if (!Compression::decompress(m_codec, &compressed[sb.position - m_block_pos], sb.compressed_size, dst + sb.offset, sb.size))
+			corrupt = true;
+	}
+
+	if (corrupt)
+		throw std::runtime_error("Corrupt XISF data block");
+
+	if (m_byte_shuffle)
+		Compression::unshuffle(shuffled.data(), block.data(), block.size(), m_item_size);
+
+	return block;
+}
+
+void XISF::swapBytes(uint8_t* data, size_t count)const {
+
+	size_t ss = sampleSize();
+	if (ss == 1)
+		return;
+
+#pragma omp parallel for
+	for (int64_t i = 0; i < count; ++i)
+		std::reverse(data + i * ss, data + (i + 1) * ss);
+}
+
+template<typename T>
+void XISF::convertSamples(const uint8_t* src, T* dst, size_t count, size_t stride)const {
+
+	float scale = 1.0 / (m_bounds[1] - m_bounds[0]);
+	float low = m_bounds[0];
+
+	switch (m_sample_format) {
+	case SampleFormat::UInt8:
+		for (size_t i = 0; i < count; ++i)
+			dst[i] = Pixel<T>::toType(loadSample<uint8_t>(src, i, stride));
+		return;
+
+	case SampleFormat::UInt16:
+		for (size_t i = 0; i < count; ++i)
+			dst[i] = Pixel<T>::toType(loadSample<uint16_t>(src, i, stride));
+		return;
+
+	case SampleFormat::UInt32:
+		for (size_t i = 0; i < count; ++i)
+			dst[i] = Pixel<T>::toType(loadSample<uint32_t>(src, i, stride) / 4294967295.0);
+		return;
+
+	case SampleFormat::Float32:
+		for (size_t i = 0; i < count; ++i)
+			dst[i] = Pixel<T>::toType((loadSample<float>(src, i, stride) - low) * scale);
+		return;
+
+	case SampleFormat::Float64:
+		for (size_t i = 0; i < count; ++i)
+			dst[i] = Pixel<T>::toType(float((loadSample<double>(src, i, stride) - low) * scale));
+		return;
+	}
+}
+
+void XISF::open(std::filesystem::path path) {
+
+	ImageFile::open(path);
+
+	if (!isXISFFile())
+		return;
+
+	uint32_t header_length = 0;
+	uint32_t reserved = 0;
+	m_stream.read((char*)&header_length, 4);
+	m_stream.read((char*)&reserved, 4);
+
+	QByteArray xml(header_length, Qt::Uninitialized);
+	m_stream.read(xml.data(), header_length);
+
+	if (!readHeader(xml)) {
+		m_rows = m_cols = m_px_count = 0;
+		return;
+	}
+
+	resizeBuffer();
+}
+
+void XISF::create(std::filesystem::path path) {
+
+	path += ".xisf";
+	ImageFile::create(path);
+}
+
+void XISF::close() {
+
+	ImageFile::close();
+
+	m_sample_format = SampleFormat::UInt8;
+	m_pixel_storage = PixelStorage::planar;
+	m_big_endian = false;
+	m_file_channels = 1;
+	m_bounds = { 0.0, 1.0 };
+
+	m_block_pos = m_block_size = m_uncompressed_size = 0;
+
+	m_codec = Compression::Codec::none;
+	m_byte_shuffle = false;
+	m_item_size = 1;
+	m_subblocks.clear();
+	clearSubblockCache();
+}
+
+template<typename T>
+void XISF::read(Image<T>& dst) {
+
+	dst = Image<T>(rows(), cols(), channels());
+
+	std::vector<uint8_t> block = readBlock();
+
+	if (m_big_endian)
+		swapBytes(block.data(), block.size() / sampleSize());
+
+	size_t ss = sampleSize();
+	bool planar = (m_pixel_storage == PixelStorage::planar);
+
+	for (int ch = 0; ch < dst.channels(); ++ch) {
+#pragma omp parallel for
+		for (int y = 0; y < dst.rows(); ++y) {
+			uint64_t first = (planar) ? uint64_t(ch) * pxCount() + uint64_t(y) * cols() : uint64_t(y) * cols() * m_file_channels + ch;
+			convertSamples(block.data() + first * ss, &dst(0, y, ch), cols(), (planar) ? 1 : m_file_channels);
+		}
+	}
+
+	close();
+}
+template void XISF::read(Image8&);
+template void XISF::read(Image16&);
+template void XISF::read(Image32&);
+
+void XISF::readAny(Image32& dst) {
+	read(dst);
+}
+
+void XISF::readRow_toFloat(float* dst, uint32_t row, uint32_t channel) {
+
+	size_t ss = sampleSize();
+	bool planar = (m_pixel_storage == PixelStorage::planar);
+	size_t stride = (planar) ? 1 : m_file_channels;
+
+	uint64_t first = (planar) ? uint64_t(channel) * pxCount() + uint64_t(row) * cols() : uint64_t(row) * cols() * m_file_channels;
+	uint64_t count = uint64_t(cols()) * stride;
+
+	std::vector<uint8_t> buffer(count * ss);
+	readSamples(first, count, buffer.data());
+
+	if (m_big_endian)
+		swapBytes(buffer.data(), count);
+
+	convertSamples(buffer.data() + ((planar) ? 0 : channel * ss), dst, cols(), stride);
+}
+
+template <typename T>
+void XISF::write(const Image<T>& src, ImageType new_type, Compression::Codec codec, bool byte_shuffle) {
+
+	m_rows = src.rows();
+	m_cols = src.cols();
+	m_channels = m_file_channels = src.channels();
+	m_px_count = src.pxCount();
+
+	size_t ss = typeSize(new_type);
+	std::vector<uint8_t> block(src.totalPxCount() * ss);
+
+	switch (new_type) {
+	case ImageType::UBYTE:
+		encodeSamples<uint8_t>(src, block.data());
+		break;
+	case ImageType::USHORT:
+		encodeSamples<uint16_t>(src, block.data());
+		break;
+	case ImageType::FLOAT:
+		encodeSamples<float>(src, block.data());
+		break;
+	}
+
+	QString compression, subblocks;
+	std::vector<std::vector<uint8_t>> compressed;
+	uint64_t block_size = block.size();
+
+	if (codec != Compression::Codec::none) {
+
+		bool shuffle = byte_shuffle && ss > 1;
+
+		std::vector<uint8_t> shuffled;
+		const uint8_t* data = block.data();
+
+		if (shuffle) {
+			shuffled.resize(block.size());
+			Compression::shuffle(block.data(), shuffled.data(), block.size(), ss);
+			data = shuffled.data();
+		}
+
+		int count = (block.size() + m_write_subblock_size - 1) / m_write_subblock_size;
+		compressed.resize(count);
+
+#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < count; ++i) {
+			size_t offset = i * m_write_subblock_size;
+			compressed[i] = Compression::compress(codec, data + offset, math::min(m_write_subblock_size, block.size() - offset));
+		}
+
+		compression = codecName(codec) + ((shuffle) ? "+sh" : "") + ":" + QString::number(block.size());
+		if (shuffle)
+			compression += ":" + QString::number(ss);
+
+		block_size = 0;
+		for (int i = 0; i < count; ++i) {
+			size_t size = math::min(m_write_subblock_size, block.size() - i * m_write_subblock_size);
+			subblocks += QString("%1%2,%3").arg((i == 0) ? "" : ":").arg(compressed[i].size()).arg(size);
+			block_size += compressed[i].size();
+		}
+	}
+
+	//the data block follows the header, whose length depends on the block position
+	uint64_t position = 0, previous = 0;
+	QByteArray xml;
+	do {
+		previous = position;
+		xml = writeHeader(new_type, position, block_size, compression, subblocks);
+		position = ((16 + xml.size() + 4095) / 4096) * 4096;
+	} while (position != previous);
+
+	uint32_t header_length = xml.size();
+	uint32_t reserved = 0;
+
+	m_stream.write("XISF0100", 8);
+	m_stream.write((char*)&header_length, 4);
+	m_stream.write((char*)&reserved, 4);
+	m_stream.write(xml.data(), xml.size());
+
+	std::vector<char> zeros(position - 16 - xml.size(), 0);
+	m_stream.write(zeros.data(), zeros.size());
+
+	if (codec == Compression::Codec::none)
+		m_stream.write((char*)block.data(), block.size());
+	else
+		for (auto& sb : compressed)
+			m_stream.write((char*)sb.data(), sb.size());
+
+	close();
+}
+template void XISF::write(const Image8&, ImageType, Compression::Codec, bool);
+template void XISF::write(const Image16&, ImageType, Compression::Codec, bool);
+template void XISF::write(const Image32&, ImageType, Compression::Codec, bool);
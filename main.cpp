@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "FastStack.h"
+#include "BatchRunner.h"
+#include "Benchmark.h"
 
 class DarkPalette : public QPalette {
 public:
@@ -35,6 +37,12 @@ public:
 
 int main(int argc, char *argv[])
 {
+    //batch jobs run before any gui or event loop exists
+    if (argc == 3 && std::string(argv[1]) == "--batch")
+        return BatchRunner().runFile(argv[2]);
+
+    if ((argc == 2 || argc == 3) && std::string(argv[1]) == "--benchmark")
+        return Benchmark().runToFile((argc == 3) ? argv[2] : "");
 
     QGuiApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
     QCoreApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);